@@ -34,6 +34,13 @@ void checkpt_main(vpic_simulation** _simulation)
  */
 vpic_simulation** restore_main(void)
 {
+    // Checkpts read by restore_remap must not clobber the live simulation
+    static vpic_simulation * detached = NULL;
+    if( restoring_detached() )
+    {
+        RESTORE_PTR( detached );
+        return &detached;
+    }
     RESTORE_PTR( simulation );
     return &simulation;
 }
@@ -53,6 +60,21 @@ void checkpt(const char* fbase, int tag)
     checkpt_objects( fname );
 }
 
+/**
+ * @brief Checkpoint to the partner (buddy) checkpoint directories
+ *
+ * @param fbase File name base for dumping
+ * @param tag File tag to label what this checkpoint is (often used: time step)
+ */
+void buddy_checkpt(const char* fbase, int tag)
+{
+    char fname[256];
+    if( !fbase ) ERROR(( "NULL filename base" ));
+    sprintf( fname, "%s.%i", fbase, tag );
+    if( world_rank==0 ) log_printf( "*** Buddy checkpointing to \"%s\"\n", fname );
+    checkpt_buddy_objects( fname );
+}
+
 /**
  * @brief Program main which triggers a vpic run
  *
@@ -70,6 +92,9 @@ int main(int argc, char** argv)
     // TODO: this would be better if it was bool-like in nature
     const char * fbase = strip_cmdline_string(&argc, &argv, "--restore", NULL);
 
+    // Restore from a checkpoint written on a different number of ranks
+    const char * rbase = strip_cmdline_string(&argc, &argv, "--restore_remap", NULL);
+
     // Detect if we should perform a restore as per the user request
     if( fbase )
     {
@@ -80,15 +105,31 @@ int main(int argc, char** argv)
         // that communication within reanimate functions is safe),
         // reanimate all the objects and issue a final barrier to
         // so that all processes come of a restore together.
-        if( world_rank==0 ) log_printf( "*** Restoring from \"%s\"\n", fbase );
-        char fname[256];
-        sprintf( fname, "%s.%i", fbase, world_rank );
-        restore_objects( fname );
+        // If buddy checkpointing is enabled and every rank's buddy
+        // checkpt survived, restore from those instead.
+        if( !restore_buddy_objects( fbase ) )
+        {
+            if( world_rank==0 ) log_printf( "*** Restoring from \"%s\"\n", fbase );
+            char fname[256];
+            sprintf( fname, "%s.%i", fbase, world_rank );
+            restore_objects( fname );
+        }
         mp_barrier();
         reanimate_objects();
         mp_barrier();
 
     }
+    else if( rbase )
+    {
+        // The deck sets up the domain decomposition for this run and
+        // the state is then redistributed from the old checkpt files.
+        if( world_rank==0 )
+            log_printf( "*** Restoring from \"%s\" onto %i ranks\n",
+                        rbase, world_size );
+        simulation = new vpic_simulation();
+        simulation->restore_remap( rbase, argc, argv );
+        REGISTER_OBJECT( &simulation, checkpt_main, restore_main, NULL );
+    }
     else // We are initializing from scratch.
     {
         // Perform basic initialization
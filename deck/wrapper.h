@@ -9,6 +9,7 @@
  */
 
 #include <iostream> // For std::cerr and friends
+#include <type_traits>
 
 #include "vpic/vpic.h"
 #include "util/util_base.h"
@@ -208,48 +209,70 @@ vpic_simulation::user_particle_collisions( void )
     }}}                                                                  \
   } while(0)
 
+// The regular region macros below evaluate rgn once per cell center
+// into a region mask and set things from the mask, both in parallel on
+// the pipelines.  So rgn (and the field equations) must be thread safe:
+// they should only read deck variables, not update them.  A region used
+// by several macros can be evaluated once with define_region and passed
+// as their rgn:
+//
+//   region_mask_t * slab = define_region( x>0 && x<1 );
+//   set_region_material( slab, metal, metal );
+//   set_region_bc( slab, absorb, absorb, absorb );
+//   delete_region_mask( slab );
+//
+// A mask is only valid for the grid it was made from.
+
+template<class R> struct _region_eval {
+  static int rgn( void * r, double x, double y, double z ) {
+    return (*(const R *)r)( x, y, z ) ? 1 : 0;
+  }
+  static double eqn( void * r, int c, double x, double y, double z ) {
+    return (*(const R *)r)( c, x, y, z );
+  }
+};
+
+template<class R> inline region_mask_t *
+_define_region( const grid_t * g, const R & r ) {
+  return new_region_mask( g, _region_eval<R>::rgn, (void *)&r );
+}
+
+// The mask of rgn, which is either an expression of x, y and z or a
+// mask from define_region.  A mask made here is freed when this goes
+// out of scope.
+
+class _region_t {
+public:
+  template<class R> _region_t( const grid_t * g, const R & r ) : own( NULL ) {
+    init( g, r, std::is_pointer<decltype( r( 0., 0., 0. ) )>() );
+  }
+  ~_region_t() { delete_region_mask( own ); }
+  operator const region_mask_t *() const { return rm; }
+private:
+  template<class R> void init( const grid_t * g, const R & r, std::true_type ) {
+    rm = r( 0., 0., 0. );
+  }
+  template<class R> void init( const grid_t * g, const R & r, std::false_type ) {
+    rm = own = _define_region( g, r );
+  }
+  _region_t( const _region_t & );
+  _region_t & operator=( const _region_t & );
+  const region_mask_t * rm;
+  region_mask_t * own;
+};
+
+#define define_region( rgn ) \
+  _define_region( grid, [&]( double x, double y, double z ) { return (rgn); } )
+
+#define _region( rgn ) \
+  _region_t _rgn( grid, [&]( double x, double y, double z ) { return (rgn); } )
+
 #define set_region_material( rgn, vmat, smat ) do {                    \
     const material_id _vmat = get_material_id( (vmat) );               \
     const material_id _smat = get_material_id( (smat) );               \
     if( _vmat==-1 && _smat==-1 ) break;                                \
-    const double _x0 = grid->x0, _y0 = grid->y0, _z0 = grid->z0;       \
-    const double _dx = grid->dx, _dy = grid->dy, _dz = grid->dz;       \
-    const int    _nx = grid->nx, _ny = grid->ny, _nz = grid->nz;       \
-    for( int _k=0; _k<_nz+2; _k++ ) { const double _zl = _z0 + _dz*(_k-1.5), _zc = _z0 + _dz*(_k-0.5); \
-    for( int _j=0; _j<_ny+2; _j++ ) { const double _yl = _y0 + _dy*(_j-1.5), _yc = _y0 + _dy*(_j-0.5); field_t *_f = &field(0,_j,_k); \
-    for( int _i=0; _i<_nx+2; _i++ ) { const double _xl = _x0 + _dx*(_i-1.5), _xc = _x0 + _dx*(_i-0.5); double x, y, z; \
-          int _rccc, _rlcc, _rclc, _rllc, _rccl, _rlcl, _rcll, _rlll;  \
-          x = _xc; y = _yc; z = _zc; _rccc = (rgn);		       \
-          x = _xl;                   _rlcc = (rgn);		       \
-          x = _xc; y = _yl;          _rclc = (rgn);		       \
-          x = _xl;                   _rllc = (rgn);		       \
-          x = _xc; y = _yc; z = _zl; _rccl = (rgn);		       \
-          x = _xl;                   _rlcl = (rgn);		       \
-          x = _xc; y = _yl;          _rcll = (rgn);		       \
-          x = _xl;                   _rlll = (rgn);		       \
-          if( _smat!=-1 ) {                                            \
-            if( _rccc || _rclc || _rccl || _rcll )  _f->ematx = _smat; \
-            if( _rccc || _rccl || _rlcc || _rlcl )  _f->ematy = _smat; \
-            if( _rccc || _rlcc || _rclc || _rllc )  _f->ematz = _smat; \
-            if( _rccc || _rlcc )                    _f->fmatx = _smat; \
-            if( _rccc || _rclc )                    _f->fmaty = _smat; \
-            if( _rccc || _rccl )                    _f->fmatz = _smat; \
-            if( _rccc || _rlcc || _rclc || _rllc ||		       \
-                _rccl || _rlcl || _rcll || _rlll )  _f->nmat  = _smat; \
-          }                                                            \
-          if( _vmat!=-1 ) {                                            \
-            if( _rccc && _rclc && _rccl && _rcll )  _f->ematx = _vmat; \
-            if( _rccc && _rccl && _rlcc && _rlcl )  _f->ematy = _vmat; \
-            if( _rccc && _rlcc && _rclc && _rllc )  _f->ematz = _vmat; \
-            if( _rccc && _rlcc )                    _f->fmatx = _vmat; \
-            if( _rccc && _rclc )                    _f->fmaty = _vmat; \
-            if( _rccc && _rccl )                    _f->fmatz = _vmat; \
-            if( _rccc && _rlcc && _rclc && _rllc &&		       \
-                _rccl && _rlcl && _rcll && _rlll )  _f->nmat  = _vmat; \
-            if( _rccc )                             _f->cmat  = _vmat; \
-          }							       \
-          _f++;                                                        \
-    }}}                                                                \
+    _region( rgn );                                                    \
+    set_mask_material( _rgn, _vmat, _smat );                           \
   } while(0)
 
 #define set_region_bc( rgn, vpbc, ipbc, epbc ) do {                      \
@@ -257,47 +280,8 @@ vpic_simulation::user_particle_collisions( void )
     const int64_t _ipbc = get_particle_bc_id( (particle_bc_t *)(ipbc) ); \
     const int64_t _epbc = get_particle_bc_id( (particle_bc_t *)(epbc) ); \
     if( !_vpbc && !_ipbc && !_epbc ) break;                              \
-    const double _x0 = grid->x0, _y0 = grid->y0, _z0 = grid->z0;         \
-    const double _dx = grid->dx, _dy = grid->dy, _dz = grid->dz;         \
-    const int    _nx = grid->nx, _ny = grid->ny, _nz = grid->nz;         \
-    int64_t * _n0 = grid->neighbor;                                      \
-    for( int _k=1; _k<_nz+1; _k++ ) { const double _zl = _z0 + _dz*(_k-1.5), _zc = _z0 + _dz*(_k-0.5), _zh = _z0 + _dz*(_k+0.5); \
-    for( int _j=1; _j<_ny+1; _j++ ) { const double _yl = _y0 + _dy*(_j-1.5), _yc = _y0 + _dy*(_j-0.5), _yh = _y0 + _dy*(_j+0.5); int64_t * _n = _n0 + 6*voxel(1,_j,_k); \
-    for( int _i=1; _i<_nx+1; _i++ ) { const double _xl = _x0 + _dx*(_i-1.5), _xc = _x0 + _dx*(_i-0.5), _xh = _x0 + _dx*(_i+0.5); double x, y, z; \
-          int _rc, _r0, _r1, _r2, _r3, _r4, _r5;                         \
-          x = _xc; y = _yc; z = _zc; _rc = (rgn);                        \
-          x = _xl; y = _yc; z = _zc; _r0 = (rgn);                        \
-          x = _xc; y = _yl; z = _zc; _r1 = (rgn);                        \
-          x = _xc; y = _yc; z = _zl; _r2 = (rgn);                        \
-          x = _xh; y = _yc; z = _zc; _r3 = (rgn);                        \
-          x = _xc; y = _yh; z = _zc; _r4 = (rgn);                        \
-          x = _xc; y = _yc; z = _zh; _r5 = (rgn);                        \
-          if( _vpbc ) {                                                  \
-            if( _rc && _r0  ) _n[0] = _vpbc;                             \
-            if( _rc && _r1  ) _n[1] = _vpbc;                             \
-            if( _rc && _r2  ) _n[2] = _vpbc;                             \
-            if( _rc && _r3  ) _n[3] = _vpbc;                             \
-            if( _rc && _r4  ) _n[4] = _vpbc;                             \
-            if( _rc && _r5  ) _n[5] = _vpbc;                             \
-          }                                                              \
-          if( _ipbc ) {                                                  \
-            if( _rc && !_r0 ) _n[0] = _ipbc;                             \
-            if( _rc && !_r1 ) _n[1] = _ipbc;                             \
-            if( _rc && !_r2 ) _n[2] = _ipbc;                             \
-            if( _rc && !_r3 ) _n[3] = _ipbc;                             \
-            if( _rc && !_r4 ) _n[4] = _ipbc;                             \
-            if( _rc && !_r5 ) _n[5] = _ipbc;                             \
-          }                                                              \
-          if( _epbc ) {                                                  \
-            if( !_rc && _r0 ) _n[0] = _epbc;                             \
-            if( !_rc && _r1 ) _n[1] = _epbc;                             \
-            if( !_rc && _r2 ) _n[2] = _epbc;                             \
-            if( !_rc && _r3 ) _n[3] = _epbc;                             \
-            if( !_rc && _r4 ) _n[4] = _epbc;                             \
-            if( !_rc && _r5 ) _n[5] = _epbc;                             \
-          }                                                              \
-          _n += 6;                                                       \
-    }}}                                                                  \
+    _region( rgn );                                                      \
+    set_mask_bc( _rgn, _vpbc, _ipbc, _epbc );                            \
   } while(0)
 
 // rgn is a logical equation that specifies the interior of the volume
@@ -308,26 +292,8 @@ vpic_simulation::user_particle_collisions( void )
 // deck segment.
 
 #define define_volume_emitter( e, rgn ) do {                      \
-    /* Count the number of cells in the emitter */                \
-    const double _x0 = grid->x0, _y0 = grid->y0, _z0 = grid->z0;  \
-    const double _dx = grid->dx, _dy = grid->dy, _dz = grid->dz;  \
-    const int    _nx = grid->nx, _ny = grid->ny, _nz = grid->nz;  \
-    int _nc = 0;                                                  \
-    for( int _k=1; _k<_nz+1; _k++ ) { const double _zc = _z0 + _dz*(_k-0.5); \
-    for( int _j=1; _j<_ny+1; _j++ ) { const double _yc = _y0 + _dy*(_j-0.5); \
-    for( int _i=1; _i<_nx+1; _i++ ) { const double _xc = _x0 + _dx*(_i-0.5); double x, y, z; \
-          x = _xc; y = _yc; z = _zc; if( (rgn) ) _nc++;           \
-    }}}                                                           \
-    /* Define the emitter */                                      \
-    int32_t * _c = size_emitter( define_emitter( (e) ), _nc );    \
-    _nc = 0;                                                      \
-    for( int _k=1; _k<_nz+1; _k++ ) { const double _zc = _z0 + _dz*(_k-0.5); \
-    for( int _j=1; _j<_ny+1; _j++ ) { const double _yc = _y0 + _dy*(_j-0.5); \
-    for( int _i=1; _i<_nx+1; _i++ ) { const double _xc = _x0 + _dx*(_i-0.5); double x, y, z; \
-          x = _xc; y = _yc; z = _zc;                              \
-          if( (rgn) ) _c[_nc++] =                                 \
-            COMPONENT_ID( voxel(_i,_j,_k), BOUNDARY(0,0,0) );     \
-    }}}                                                           \
+    _region( rgn );                                               \
+    define_mask_volume_emitter( (e), _rgn );                      \
   } while(0)
 
 // rgn is a logical equation.
@@ -336,50 +302,8 @@ vpic_simulation::user_particle_collisions( void )
 // A surface emitter emits into the exterior of the region.
 
 #define define_surface_emitter( e, rgn ) do {                    \
-    /* Count the number of faces in emitter surface */           \
-    const double _x0 = grid->x0, _y0 = grid->y0, _z0 = grid->z0; \
-    const double _dx = grid->dx, _dy = grid->dy, _dz = grid->dz; \
-    const int    _nx = grid->nx, _ny = grid->ny, _nz = grid->nz; \
-    int _nf = 0;                                                 \
-    for( int _k=1; _k<_nz+1; _k++ ) { const double _zl = _z0 + _dz*(_k-1.5), _zc = _z0 + _dz*(_k-0.5), _zh = _z0 + _dz*(_k+0.5); \
-    for( int _j=1; _j<_ny+1; _j++ ) { const double _yl = _y0 + _dy*(_j-1.5), _yc = _y0 + _dy*(_j-0.5), _yh = _y0 + _dy*(_j+0.5); \
-    for( int _i=1; _i<_nx+1; _i++ ) { const double _xl = _x0 + _dx*(_i-1.5), _xc = _x0 + _dx*(_i-0.5), _xh = _x0 + _dx*(_i+0.5); double x, y, z; \
-          int _rc, _r0, _r1, _r2, _r3, _r4, _r5;                 \
-          x = _xc; y = _yc; z = _zc; _rc = (rgn);                \
-          x = _xl; y = _yc; z = _zc; _r0 = (rgn);                \
-          x = _xc; y = _yl; z = _zc; _r1 = (rgn);                \
-          x = _xc; y = _yc; z = _zl; _r2 = (rgn);                \
-          x = _xh; y = _yc; z = _zc; _r3 = (rgn);                \
-          x = _xc; y = _yh; z = _zc; _r4 = (rgn);                \
-          x = _xc; y = _yc; z = _zh; _r5 = (rgn);                \
-          if( !_rc && _r0 ) _nf++;                               \
-          if( !_rc && _r1 ) _nf++;                               \
-          if( !_rc && _r2 ) _nf++;                               \
-          if( !_rc && _r3 ) _nf++;                               \
-          if( !_rc && _r4 ) _nf++;                               \
-          if( !_rc && _r5 ) _nf++;                               \
-    }}}                                                          \
-    /* Define the emitter */                                     \
-    int32_t * _c = size_emitter( define_emitter( (e) ), _nf );   \
-    _nf = 0;                                                     \
-    for( int _k=1; _k<_nz+1; _k++ ) { const double _zl = _z0 + _dz*(_k-1.5), _zc = _z0 + _dz*(_k-0.5), _zh = _z0 + _dz*(_k+0.5); \
-    for( int _j=1; _j<_ny+1; _j++ ) { const double _yl = _y0 + _dy*(_j-1.5), _yc = _y0 + _dy*(_j-0.5), _yh = _y0 + _dy*(_j+0.5); \
-    for( int _i=1; _i<_nx+1; _i++ ) { const double _xl = _x0 + _dx*(_i-1.5), _xc = _x0 + _dx*(_i-0.5), _xh = _x0 + _dx*(_i+0.5); double x, y, z; \
-          int _rc, _r0, _r1, _r2, _r3, _r4, _r5;                 \
-          x = _xc; y = _yc; z = _zc; _rc = (rgn);                \
-          x = _xl; y = _yc; z = _zc; _r0 = (rgn);                \
-          x = _xc; y = _yl; z = _zc; _r1 = (rgn);                \
-          x = _xc; y = _yc; z = _zl; _r2 = (rgn);                \
-          x = _xh; y = _yc; z = _zc; _r3 = (rgn);                \
-          x = _xc; y = _yh; z = _zc; _r4 = (rgn);                \
-          x = _xc; y = _yc; z = _zh; _r5 = (rgn);                \
-          if( !_rc && _r0 ) _c[_nf++] = COMPONENT_ID( voxel(_i,_j,_k), BOUNDARY(-1, 0, 0) ); \
-          if( !_rc && _r1 ) _c[_nf++] = COMPONENT_ID( voxel(_i,_j,_k), BOUNDARY( 0,-1, 0) ); \
-          if( !_rc && _r2 ) _c[_nf++] = COMPONENT_ID( voxel(_i,_j,_k), BOUNDARY( 0, 0,-1) ); \
-          if( !_rc && _r3 ) _c[_nf++] = COMPONENT_ID( voxel(_i,_j,_k), BOUNDARY( 1, 0, 0) ); \
-          if( !_rc && _r4 ) _c[_nf++] = COMPONENT_ID( voxel(_i,_j,_k), BOUNDARY( 0, 1, 0) ); \
-          if( !_rc && _r5 ) _c[_nf++] = COMPONENT_ID( voxel(_i,_j,_k), BOUNDARY( 0, 0, 1) ); \
-    }}}                                                          \
+    _region( rgn );                                              \
+    define_mask_surface_emitter( (e), _rgn );                    \
   } while(0)
 
 // The equations are only evaluated inside the mesh-mapped region
@@ -387,29 +311,19 @@ vpic_simulation::user_particle_collisions( void )
 #define set_region_field( rgn,                                        \
                           eqn_ex, eqn_ey, eqn_ez,                     \
                           eqn_bx, eqn_by, eqn_bz ) do {               \
-    const double _x0 = grid->x0, _y0 = grid->y0, _z0 = grid->z0;      \
-    const double _dx = grid->dx, _dy = grid->dy, _dz = grid->dz;      \
-    const double _c  = grid->cvac;                                    \
-    const int    _nx = grid->nx, _ny = grid->ny, _nz = grid->nz;      \
-    for( int _k=0; _k<_nz+2; _k++ ) { const double _zl = _z0 + _dz*(_k-1.5), _ze = _z0 + _dz*_k, _zc = _z0 + _dz*(_k-0.5); \
-    for( int _j=0; _j<_ny+2; _j++ ) { const double _yl = _y0 + _dy*(_j-1.5), _ye = _y0 + _dy*_j, _yc = _y0 + _dy*(_j-0.5); field_t *_f = &field(0,_j,_k); \
-    for( int _i=0; _i<_nx+2; _i++ ) { const double _xl = _x0 + _dx*(_i-1.5), _xe = _x0 + _dx*_i, _xc = _x0 + _dx*(_i-0.5); double x, y, z; \
-          int _rccc, _rlcc, _rclc, _rllc, _rccl, _rlcl, _rcll;        \
-          x = _xc; y = _yc; z = _zc; _rccc = (rgn);                   \
-          x = _xl;                   _rlcc = (rgn);                   \
-          x = _xc; y = _yl;          _rclc = (rgn);                   \
-          x = _xl;                   _rllc = (rgn);                   \
-          x = _xc; y = _yc; z = _zl; _rccl = (rgn);                   \
-          x = _xl;                   _rlcl = (rgn);                   \
-          x = _xc; y = _yl;          _rcll = (rgn);                   \
-          x = _xc; y = _ye; z = _ze; if( _rccc || _rclc || _rccl || _rcll ) _f->ex  =    (eqn_ex); \
-          x = _xe; y = _yc; z = _ze; if( _rccc || _rccl || _rlcc || _rlcl ) _f->ey  =    (eqn_ey); \
-          x = _xe; y = _ye; z = _zc; if( _rccc || _rlcc || _rclc || _rllc ) _f->ez  =    (eqn_ez); \
-          x = _xe; y = _yc; z = _zc; if( _rccc || _rlcc )                   _f->cbx = _c*(eqn_bx); \
-          x = _xc; y = _ye; z = _zc; if( _rccc || _rclc )                   _f->cby = _c*(eqn_by); \
-          x = _xc; y = _yc; z = _ze; if( _rccc || _rccl )                   _f->cbz = _c*(eqn_bz); \
-          _f++;                                                       \
-    }}}                                                               \
+    _region( rgn );                                                   \
+    auto _eqn = [&]( int _c, double x, double y, double z ) -> double { \
+      switch( _c ) {                                                  \
+      case 0:  return (eqn_ex);                                       \
+      case 1:  return (eqn_ey);                                       \
+      case 2:  return (eqn_ez);                                       \
+      case 3:  return (eqn_bx);                                       \
+      case 4:  return (eqn_by);                                       \
+      default: return (eqn_bz);                                       \
+      }                                                               \
+    };                                                                \
+    set_mask_field( _rgn, _region_eval<decltype(_eqn)>::eqn,          \
+                    (void *)&_eqn );                                  \
   } while(0)
 
 // In main.cxx
@@ -418,4 +332,8 @@ void
 checkpt( const char * fbase,
          int tag );
 
+void
+buddy_checkpt( const char * fbase,
+               int tag );
+
 //-----------------------------------------------------------------------------
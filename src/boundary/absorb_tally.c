@@ -13,6 +13,9 @@ typedef struct absorb_tally {
   /**/  species_t     * sp_list;
   const field_array_t * fa;
   /**/  int           * tally;
+  /**/  int           * pipeline_tally; // Tallies of the pipelines
+  int n_sp;
+  int n_pipeline;
 } absorb_tally_t;
 
 int
@@ -22,19 +25,28 @@ interact_absorb_tally( absorb_tally_t      * RESTRICT at,
                        particle_mover_t    * RESTRICT pm,
                        particle_injector_t * RESTRICT pi,
                        int                            max_pi,
-                       int                            face ) {
-  at->tally[ sp->id ]++;
-  accumulate_rhob( at->fa->f, p, at->fa->g, sp->q );
+                       int                            face,
+                       particle_bc_ctx_t   * RESTRICT ctx ) {
+  at->pipeline_tally[ ctx->pipeline_rank*at->n_sp + sp->id ]++;
+  accumulate_rhob_array( ctx->rhob, p, at->fa->g, sp->q );
   return 0;
 }
 
+void
+finish_absorb_tally( absorb_tally_t * RESTRICT at ) {
+  int * RESTRICT t = at->pipeline_tally;
+  for( int rank=0; rank<at->n_pipeline; rank++, t += at->n_sp )
+    for( int id=0; id<at->n_sp; id++ ) at->tally[id] += t[id], t[id] = 0;
+}
+
 void
 checkpt_absorb_tally( const particle_bc_t * RESTRICT pbc ) {
   const absorb_tally_t * RESTRICT at = (const absorb_tally_t *)pbc->params;
   CHECKPT( at, 1 );
   CHECKPT_PTR( at->sp_list );
   CHECKPT_PTR( at->fa );
-  CHECKPT( at->tally, num_species( at->sp_list ) );
+  CHECKPT( at->tally, at->n_sp );
+  CHECKPT( at->pipeline_tally, at->n_sp*at->n_pipeline );
   checkpt_particle_bc_internal( pbc );
 }
 
@@ -45,12 +57,14 @@ restore_absorb_tally( void ) {
   RESTORE_PTR( at->sp_list );
   RESTORE_PTR( at->fa );
   RESTORE( at->tally );
+  RESTORE( at->pipeline_tally );
   return restore_particle_bc_internal( at );
 }
 
 void
 delete_absorb_tally( particle_bc_t * RESTRICT pbc ) {
   absorb_tally_t * at = (absorb_tally_t *)pbc->params;
+  FREE( at->pipeline_tally );
   FREE( at->tally );
   FREE( at );
   delete_particle_bc_internal( pbc );
@@ -66,14 +80,19 @@ absorb_tally( /**/  species_t      * RESTRICT sp_list,
   MALLOC( at, 1 );
   at->sp_list = sp_list;
   at->fa      = fa;
-  MALLOC( at->tally, num_species( sp_list ) );
-  CLEAR( at->tally, num_species( sp_list ) );  
-  return new_particle_bc_internal( at,
-                                   (particle_bc_func_t)interact_absorb_tally,
-                                   delete_absorb_tally,
-                                   (checkpt_func_t)checkpt_absorb_tally,
-                                   (restore_func_t)restore_absorb_tally,
-                                   NULL );
+  at->n_sp       = num_species( sp_list );
+  at->n_pipeline = N_PIPELINE;
+  MALLOC( at->tally, at->n_sp );
+  CLEAR( at->tally, at->n_sp );
+  MALLOC( at->pipeline_tally, at->n_sp*at->n_pipeline );
+  CLEAR( at->pipeline_tally, at->n_sp*at->n_pipeline );
+  return new_particle_bc_pipeline_internal( at,
+           (particle_bc_pipeline_func_t)interact_absorb_tally,
+           (particle_bc_finish_func_t)finish_absorb_tally,
+           delete_absorb_tally,
+           (checkpt_func_t)checkpt_absorb_tally,
+           (restore_func_t)restore_absorb_tally,
+           NULL );
 }
 
 int *
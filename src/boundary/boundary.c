@@ -7,6 +7,8 @@ void
 checkpt_particle_bc_internal( const particle_bc_t * RESTRICT pbc ) {
   CHECKPT( pbc, 1 );
   CHECKPT_SYM( pbc->interact );
+  CHECKPT_SYM( pbc->interact_pipeline );
+  CHECKPT_SYM( pbc->finish );
   CHECKPT_SYM( pbc->delete_pbc );
   CHECKPT_PTR( pbc->next );
 }
@@ -17,6 +19,8 @@ restore_particle_bc_internal( void * params ) {
   RESTORE( pbc );
   pbc->params = params;
   RESTORE_SYM( pbc->interact );
+  RESTORE_SYM( pbc->interact_pipeline );
+  RESTORE_SYM( pbc->finish );
   RESTORE_SYM( pbc->delete_pbc );
   RESTORE_PTR( pbc->next );
   return pbc;
@@ -40,6 +44,26 @@ new_particle_bc_internal( void * params,
   return pbc;
 }
 
+particle_bc_t *
+new_particle_bc_pipeline_internal( void * params,
+                                   particle_bc_pipeline_func_t interact,
+                                   particle_bc_finish_func_t finish,
+                                   delete_particle_bc_func_t delete_pbc,
+                                   checkpt_func_t checkpt,
+                                   restore_func_t restore,
+                                   reanimate_func_t reanimate ) {
+  particle_bc_t * pbc;
+  MALLOC( pbc, 1 );
+  CLEAR( pbc, 1 );
+  pbc->params            = params;
+  pbc->interact_pipeline = interact;
+  pbc->finish            = finish;
+  pbc->delete_pbc        = delete_pbc;
+  /* id, next set by append_particle_bc */
+  REGISTER_OBJECT( pbc, checkpt, restore, reanimate );
+  return pbc;
+}
+
 void
 delete_particle_bc_internal( particle_bc_t * pbc ) {
   UNREGISTER_OBJECT( pbc );
@@ -1,5 +1,7 @@
 #define IN_boundary
-#include "boundary_private.h"
+#include "pipeline/boundary_pipeline.h"
+
+#include "../util/pipelines/pipelines_exec.h"
 
 // If this is defined particle and mover buffers will not resize dynamically
 // (This is the common case for the users)
@@ -30,8 +32,22 @@ using namespace v4;
 //#define MIN_NP 32768 // 32768 particles is 1 MiB of memory.
 #endif
 
+// Particle storage larger than a chunk grows and shrinks a whole number
+// of chunks at a time.  Storage is resized with REALLOC_ARENA, which
+// remaps the pages of the array rather than copying it, so a resize
+// costs about the same however many particles the species has.
+#ifndef NP_CHUNK
+#define NP_CHUNK 65536 // 2 MiB of particles (one huge page)
+#endif
+
+static void
+resize_particles( species_t * sp,
+                  int n ) {
+  REALLOC_ARENA( sp->p, sp->np, n, 128, "particle" );
+  if( sp->tag ) REALLOC_ARENA( sp->tag, sp->np, n, 128, "particle" );
+  sp->max_np = n;
+}
 
-enum { MAX_PBC = 32, MAX_SP = 32 };
 
 void
 boundary_p( particle_bc_t       * RESTRICT pbc_list,
@@ -64,10 +80,33 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
   // Temporary store for local particle injectors
   // FIXME: Ugly static usage
   static particle_injector_t * RESTRICT ALIGNED(16) ci = NULL;
+  static int64_t * RESTRICT ALIGNED(16) ci_tag = NULL;
   static int max_ci = 0;
 
+  // Pipeline scratch: the mover codes, the pipeline injector buffers
+  // and rhob arrays.  Mover blocks are numbered from the start of the
+  // timestep so that each block of every call in the timestep has its
+  // own rng substream.
+  static int * RESTRICT ALIGNED(16) code = NULL;
+  static int max_code = 0;
+  static boundary_p_seg_t seg[ MAX_PIPELINE ];
+  static float * RESTRICT ALIGNED(128) r = NULL;
+  static size_t max_r = 0;
+  static int64_t block_step = -1;
+  static int block0 = 0;
+
+  DECLARE_ALIGNED_ARRAY( boundary_p_pipeline_args_t, 128, args, 1 );
+
   int n_send[6], n_recv[6], n_ci;
 
+  // If any species is tagged, every injector sent or injected locally
+  // carries a tag (0 for untagged species).  Tags are sent as a block
+  // following the injectors in each message.  If no species is tagged,
+  // nothing changes.
+
+  int tagged = 0, max_send = 0;
+  size_t sz_inj;
+
   species_t * sp;
   int face;
 
@@ -77,13 +116,18 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
   if( !fa || !aa || sp_list->g!=aa->g || fa->g!=aa->g )
     ERROR(( "Bad args" ));
 
+  LIST_FOR_EACH( sp, sp_list ) if( sp->tag ) tagged = 1;
+  sz_inj = sizeof(particle_injector_t) + ( tagged ? sizeof(int64_t) : 0 );
+
   // Unpack the particle boundary conditions
 
+  particle_bc_t * pbc_array[MAX_PBC];
   particle_bc_func_t pbc_interact[MAX_PBC];
   void * pbc_params[MAX_PBC];
   const int nb = num_particle_bc( pbc_list );
   if( nb>MAX_PBC ) ERROR(( "Update this to support more particle boundary conditions" ));
   for( particle_bc_t * pbc=pbc_list; pbc; pbc=pbc->next ) {
+    pbc_array[   -pbc->id-3] = pbc;
     pbc_interact[-pbc->id-3] = pbc->interact;
     pbc_params[  -pbc->id-3] = pbc->params;
    }
@@ -126,6 +170,7 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
   do {
 
     particle_injector_t * RESTRICT ALIGNED(16) pi_send[6];
+    int64_t             * RESTRICT ALIGNED(8)  pt_send[6];
 
     // Presize the send and injection buffers
     //
@@ -151,39 +196,116 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
     // above overalloc).
 
     int nm = 0; LIST_FOR_EACH( sp, sp_list ) nm += sp->nm;
+    max_send = nm;
 
     for( face=0; face<6; face++ )
       if( shared[face] ) {
-        mp_size_send_buffer( mp, f2b[face], 16+nm*sizeof(particle_injector_t) );
+        mp_size_send_buffer( mp, f2b[face], 16+nm*sz_inj );
         pi_send[face] = (particle_injector_t *)(((char *)mp_send_buffer(mp,f2b[face]))+16);
+        pt_send[face] = (int64_t *)(pi_send[face] + nm);
         n_send[face] = 0;
       }
 
     if( max_ci<nm ) {
       particle_injector_t * new_ci = ci;
+      int64_t * new_ci_tag = ci_tag;
       FREE_ALIGNED( new_ci );
       MALLOC_ALIGNED( new_ci, nm, 16 );
+      FREE_ALIGNED( new_ci_tag );
+      MALLOC_ALIGNED( new_ci_tag, nm, 16 );
       ci     = new_ci;
+      ci_tag = new_ci_tag;
       max_ci = nm;
     }
     n_ci = 0;
 
+    // Set up the pipelines.  A pipeline clears its rhob array when it
+    // first needs it.
+
+    if( g->step!=block_step ) block_step = g->step, block0 = 0;
+
+    int rank, stride = POW2_CEIL( g->nv, 32 );
+
+    if( max_r < (size_t)N_PIPELINE*(size_t)stride ) {
+      FREE_ALIGNED( r );
+      max_r = (size_t)N_PIPELINE*(size_t)stride;
+      MALLOC_ALIGNED( r, max_r, 128 );
+    }
+
+    for( rank=0; rank<N_PIPELINE; rank++ ) seg[rank].rhob = 0;
+
+    args->r        = r;
+    args->f        = f;
+    args->seg      = seg;
+    args->pbc      = pbc_array;
+    args->neighbor = neighbor;
+    args->g        = g;
+    args->step     = g->step;
+    args->rangel   = rangel;
+    args->rangeh   = rangeh;
+    args->rangem   = rangem;
+    args->nb       = nb;
+    args->tagged   = tagged;
+    args->nv       = g->nv;
+    args->stride   = stride;
+
     // For each species, load the movers
 
     LIST_FOR_EACH( sp, sp_list ) {
-      const float   sp_q  = sp->q;
       const int32_t sp_id = sp->id;
 
       particle_t * RESTRICT ALIGNED(128) p0 = sp->p;
+      int64_t    * RESTRICT ALIGNED(128) t0 = sp->tag;
       int np = sp->np;
 
       particle_mover_t * RESTRICT ALIGNED(16)  pm = sp->pm + sp->nm - 1;
       nm = sp->nm;
 
       particle_injector_t * RESTRICT ALIGNED(16) pi;
-      int i, voxel;
+      int i, m, n, n_block;
       int64_t nn;
 
+      if( !nm ) continue;
+
+      // Size the mover codes and the pipeline injector buffers (the
+      // handlers inject at most one particle per mover, see above)
+
+      if( max_code<nm ) {
+        FREE_ALIGNED( code );
+        MALLOC_ALIGNED( code, nm, 16 );
+        max_code = nm;
+      }
+
+      n_block = ( nm + BOUNDARY_BLOCK - 1 ) / BOUNDARY_BLOCK;
+
+      for( rank=0; rank<N_PIPELINE; rank++ ) {
+        DISTRIBUTE( n_block, 1, rank, N_PIPELINE, i, n );
+        n *= BOUNDARY_BLOCK;
+        if( seg[rank].max_pi<n ) {
+          FREE_ALIGNED( seg[rank].pi );
+          FREE_ALIGNED( seg[rank].pt );
+          MALLOC_ALIGNED( seg[rank].pi, n, 16 );
+          MALLOC_ALIGNED( seg[rank].pt, n, 16 );
+          seg[rank].max_pi = n;
+        }
+      }
+
+      // The pipelines absorb particles and run the custom boundaries
+      // that can run in parallel.  They leave the rest to the host.
+
+      args->sp     = sp;
+      args->p0     = p0;
+      args->t0     = t0;
+      args->pm     = sp->pm;
+      args->code   = code;
+      args->nm     = nm;
+      args->block0 = block0;
+
+      EXEC_PIPELINES( boundary_p, args, 0 );
+      WAIT_PIPELINES();
+
+      block0 += n_block;
+
       // Note that particle movers for each species are processed in
       // reverse order.  This allows us to backfill holes in the
       // particle list created by boundary conditions and/or
@@ -193,26 +315,18 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
       // property if all aged particle injection occurs after
       // advance_p and before this
 
-      for( ; nm; pm--, nm-- ) {
+      for( m=nm-1; nm; pm--, nm--, m-- ) {
         i = pm->i;
-        voxel = p0[i].i;
-        face = voxel & 7;
-        voxel >>= 3;
-        p0[i].i = voxel;
-        nn = neighbor[ 6*voxel + face ];
-
-        // Absorb
-
-        if( nn==absorb_particles ) {
-          // Ideally, we would batch all rhob accumulations together
-          // for efficiency
-          accumulate_rhob( f, p0+i, g, sp_q );
-          goto backfill;
-        }
+
+        // Handled by a pipeline
+
+        if( code[m]==BOUNDARY_P_DONE ) goto backfill;
 
         // Send to a neighboring node
 
-        if( ((nn>=0) & (nn< rangel)) | ((nn>rangeh) & (nn<=rangem)) ) {
+        if( code[m]>=BOUNDARY_P_SEND && code[m]<BOUNDARY_P_CUSTOM ) {
+          face = code[m] - BOUNDARY_P_SEND;
+          nn = neighbor[ 6*p0[i].i + face ];
           pi = &pi_send[face][n_send[face]++];
 #         ifdef V4_ACCELERATION
           copy_4x1( &pi->dx,    &p0[i].dx  );
@@ -226,6 +340,7 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
           (&pi->dx)[axis[face]] = dir[face];
           pi->i                 = nn - range[face];
           pi->sp_id             = sp_id;
+          if( tagged ) pt_send[face][n_send[face]-1] = t0 ? t0[i] : 0;
           goto backfill;
         }
 
@@ -246,11 +361,20 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
         // Since most boundary handlers do local reinjection and are
         // charge neutral, this means most boundary handlers do
         // nothing to rhob.
-
-        nn = -nn - 3; // Assumes reflective/absorbing are -1, -2
-        if( (nn>=0) & (nn<nb) ) {
-          n_ci += pbc_interact[nn]( pbc_params[nn], sp, p0+i, pm,
-                                    ci+n_ci, 1, face );
+        //
+        // Handlers with an interact_pipeline function were run by the
+        // pipelines above.  The others are run here.
+
+        if( code[m]>=BOUNDARY_P_CUSTOM ) {
+          nn   = ( code[m] - BOUNDARY_P_CUSTOM ) / 6;
+          face = ( code[m] - BOUNDARY_P_CUSTOM ) % 6;
+          // A reinjected particle keeps the tag of the incident one.
+          // Any other particles the handler makes get new tags.
+          n = pbc_interact[nn]( pbc_params[nn], sp, p0+i, pm,
+                                ci+n_ci, 1, face );
+          if( tagged ) tag_injectors( ci_tag+n_ci, ci+n_ci, n, sp->id,
+                                      t0 ? t0[i] : BOUNDARY_P_NEW_TAG );
+          n_ci += n;
           goto backfill;
         }
 
@@ -268,13 +392,36 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
 #       else
         p0[i] = p0[np];
 #       endif
+        if( t0 ) t0[i] = t0[np];
 
       }
 
       sp->np = np;
       sp->nm = 0;
+
+      // Append the injectors of the pipelines.  Each pipeline made
+      // them in reverse mover order, so appending the pipelines in
+      // reverse order keeps the injectors in reverse mover order.
+
+      for( rank=N_PIPELINE-1; rank>=0; rank-- ) {
+        COPY( ci + n_ci, seg[rank].pi, seg[rank].n_pi );
+        if( tagged ) COPY( ci_tag + n_ci, seg[rank].pt, seg[rank].n_pi );
+        n_ci += seg[rank].n_pi;
+      }
+    }
+
+    // Add the charge the pipelines absorbed to rhob and let the
+    // custom boundaries reduce their pipeline state
+
+    for( rank=0; rank<N_PIPELINE; rank++ ) if( seg[rank].rhob ) break;
+    if( rank<N_PIPELINE ) {
+      EXEC_PIPELINES( reduce_boundary_p, args, 0 );
+      WAIT_PIPELINES();
     }
 
+    for( particle_bc_t * pbc=pbc_list; pbc; pbc=pbc->next )
+      if( pbc->finish ) pbc->finish( pbc->params );
+
   } while(0);
 
   // Finish exchanging particle counts and start exchanging actual
@@ -291,6 +438,13 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
 
   for( face=0; face<6; face++ )
     if( shared[face] ) {
+      if( tagged ) {
+        // Pack the tags right behind the injectors actually used
+        char * buf = ((char *)mp_send_buffer( mp, f2b[face] )) + 16;
+        memmove( buf + n_send[face]*sizeof(particle_injector_t),
+                 buf + max_send*sizeof(particle_injector_t),
+                 n_send[face]*sizeof(int64_t) );
+      }
       *((int *)mp_send_buffer( mp, f2b[face] )) = n_send[face];
       mp_begin_send( mp, f2b[face], sizeof(int), bc[face], f2b[face] );
     }
@@ -299,9 +453,8 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
     if( shared[face] )  {
       mp_end_recv( mp, f2b[face] );
       n_recv[face] = *((int *)mp_recv_buffer( mp, f2b[face] ));
-      mp_size_recv_buffer( mp, f2b[face],
-                           16+n_recv[face]*sizeof(particle_injector_t) );
-      mp_begin_recv( mp, f2b[face], 16+n_recv[face]*sizeof(particle_injector_t),
+      mp_size_recv_buffer( mp, f2b[face], 16+n_recv[face]*sz_inj );
+      mp_begin_recv( mp, f2b[face], 16+n_recv[face]*sz_inj,
                      bc[face], f2rb[face] );
     }
 
@@ -311,7 +464,7 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
       // FIXME: ASSUMES MP WON'T MUCK WITH REST OF SEND BUFFER. IF WE
       // DID MORE EFFICIENT MOVER ALLOCATION ABOVE, THIS WOULD BE
       // ROBUSTED AGAINST MP IMPLEMENTATION VAGARIES
-      mp_begin_send( mp, f2b[face], 16+n_send[face]*sizeof(particle_injector_t),
+      mp_begin_send( mp, f2b[face], 16+n_send[face]*sz_inj,
                      bc[face], f2b[face] );
     }
 
@@ -331,48 +484,48 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
       if( shared[face] ) max_inj += n_recv[face];
 
     LIST_FOR_EACH( sp, sp_list ) {
-      particle_mover_t * new_pm;
-      particle_t * new_p;
-
       n = sp->np + max_inj;
       if( n>sp->max_np ) {
-        n += 0.3125*n; // Increase by 31.25% (~<"silver
-        /**/                     // ratio") to minimize resizes (max
-        /**/                     // rate that avoids excessive heap
-        /**/                     // fragmentation)
+        if( n<NP_CHUNK ) {
+          n += 0.3125*n; // Increase by 31.25% (~<"silver
+          /**/                     // ratio") to minimize resizes (max
+          /**/                     // rate that avoids excessive heap
+          /**/                     // fragmentation)
+        } else {
+          n = ( n/NP_CHUNK + 1 )*NP_CHUNK;
+        }
         //float resize_ratio = (float)n/sp->max_np;
         WARNING(( "Resizing local %s particle storage from %i to %i",
                   sp->name, sp->max_np, n ));
-        MALLOC_ALIGNED( new_p, n, 128 );
-        COPY( new_p, sp->p, sp->np );
-        FREE_ALIGNED( sp->p );
-        sp->p = new_p, sp->max_np = n;
+        resize_particles( sp, n );
 
         /*nm = sp->max_nm * resize_ratio;
         WARNING(( "Resizing local %s mover storage from %i to %i",
                   sp->name, sp->max_nm, nm ));
-        MALLOC_ALIGNED( new_pm, nm, 128 );
+        MALLOC_ARENA( new_pm, nm, 128, "mover" );
         COPY( new_pm, sp->pm, sp->nm );
         FREE_ALIGNED( sp->pm );
         sp->pm = new_pm;
         sp->max_nm = nm;*/
       }
-      else if(sp->max_np > MIN_NP && n < sp->max_np>>1)
+      else if( sp->max_np>=2*NP_CHUNK ? n < sp->max_np-2*NP_CHUNK :
+               ( sp->max_np>MIN_NP && n < sp->max_np>>1 ) )
       {
-        n += 0.125*n; // Overallocate by less since this rank is decreasing
-        if (n<MIN_NP) n = MIN_NP;
+        if( n<NP_CHUNK ) {
+          n += 0.125*n; // Overallocate by less since this rank is decreasing
+          if (n<MIN_NP) n = MIN_NP;
+        } else {
+          n = ( n/NP_CHUNK + 1 )*NP_CHUNK;
+        }
         //float resize_ratio = (float)n/sp->max_np;
         WARNING(( "Resizing (shrinking) local %s particle storage from "
                     "%i to %i", sp->name, sp->max_np, n));
-        MALLOC_ALIGNED( new_p, n, 128 );
-        COPY( new_p, sp->p, sp->np );
-        FREE_ALIGNED( sp->p );
-        sp->p = new_p, sp->max_np = n;
+        resize_particles( sp, n );
 
         /*nm = sp->max_nm * resize_ratio;
         WARNING(( "Resizing (shrinking) local %s mover storage from "
                     "%i to %i", sp->name, sp->max_nm, nm));
-        MALLOC_ALIGNED( new_pm, nm, 128 );
+        MALLOC_ARENA( new_pm, nm, 128, "mover" );
         COPY( new_pm, sp->pm, sp->nm );
         FREE_ALIGNED( sp->pm );
         sp->pm = new_pm, sp->max_nm = nm;*/
@@ -387,16 +540,13 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
         WARNING(( "This happened.  Resizing local %s mover storage from "
                     "%i to %i based on not enough movers",
                   sp->name, sp->max_nm, nm ));
-        MALLOC_ALIGNED( new_pm, nm, 128 );
-        COPY( new_pm, sp->pm, sp->nm );
-        FREE_ALIGNED( sp->pm );
-        sp->pm = new_pm;
+        REALLOC_ARENA( sp->pm, sp->nm, nm, 128, "mover" );
         sp->max_nm = nm;
 
         /*n = sp->max_np * resize_ratio;
         WARNING(( "Resizing local %s particle storage from %i to %i",
                   sp->name, sp->max_np, n ));
-        MALLOC_ALIGNED( new_p, n, 128 );
+        MALLOC_ARENA( new_p, n, 128, "particle" );
         COPY( new_p, sp->p, sp->np );
         FREE_ALIGNED( sp->p );
         sp->p = new_p, sp->max_np = n;*/
@@ -411,6 +561,8 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
 
     particle_t       * RESTRICT ALIGNED(32) sp_p[ MAX_SP];
     particle_mover_t * RESTRICT ALIGNED(32) sp_pm[MAX_SP];
+    int64_t          * RESTRICT ALIGNED(32) sp_tag[MAX_SP];
+    int64_t sp_next_tag[MAX_SP];
     float sp_q[MAX_SP];
     int sp_np[MAX_SP];
     int sp_nm[MAX_SP];
@@ -425,6 +577,8 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
     LIST_FOR_EACH( sp, sp_list ) {
       sp_p[  sp->id ] = sp->p;
       sp_pm[ sp->id ] = sp->pm;
+      sp_tag[sp->id ] = sp->tag;
+      sp_next_tag[sp->id] = sp->next_tag;
       sp_q[  sp->id ] = sp->q;
       sp_np[ sp->id ] = sp->np;
       sp_nm[ sp->id ] = sp->nm;
@@ -442,15 +596,17 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
       /**/  particle_t          * RESTRICT ALIGNED(32) p;
       /**/  particle_mover_t    * RESTRICT ALIGNED(16) pm;
       const particle_injector_t * RESTRICT ALIGNED(16) pi;
+      const int64_t             * RESTRICT ALIGNED(8)  pt;
       int np, nm, n, id;
 
       face++; if( face==7 ) face = 0;
-      if( face==6 ) pi = ci, n = n_ci;
+      if( face==6 ) pi = ci, pt = ci_tag, n = n_ci;
       else if( shared[face] ) {
         mp_end_recv( mp, f2b[face] );
         pi = (const particle_injector_t *)
           (((char *)mp_recv_buffer(mp,f2b[face]))+16);
         n  = n_recv[face];
+        pt = (const int64_t *)( pi + n );
       } else continue;
 
       // Reverse order injection is done to reduce thrashing of the
@@ -462,7 +618,8 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
       // RECEIVED FROM OTHER NODES) HAVE VALID PARTICLE IDS.
 
       pi += n-1;
-      for( ; n; pi--, n-- ) {
+      pt += n-1;
+      for( ; n; pi--, pt--, n-- ) {
         id = pi->sp_id;
         p  = sp_p[id];  np = sp_np[id];
         pm = sp_pm[id]; nm = sp_nm[id];
@@ -477,6 +634,8 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
         p[np].dx=pi->dx; p[np].dy=pi->dy; p[np].dz=pi->dz; p[np].i=pi->i;
         p[np].ux=pi->ux; p[np].uy=pi->uy; p[np].uz=pi->uz; p[np].w=pi->w;
 #       endif
+        if( sp_tag[id] )
+          sp_tag[id][np] = *pt!=BOUNDARY_P_NEW_TAG ? *pt : sp_next_tag[id]++;
         sp_np[id] = np+1;
 
 #       ifdef DISABLE_DYNAMIC_RESIZING
@@ -509,6 +668,7 @@ boundary_p( particle_bc_t       * RESTRICT pbc_list,
 #     endif
       sp->np=sp_np[sp->id];
       sp->nm=sp_nm[sp->id];
+      sp->next_tag=sp_next_tag[sp->id];
     }
 
   } while(0);
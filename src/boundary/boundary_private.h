@@ -30,12 +30,50 @@ typedef int /* Number of particles injected */
                                             the voxel containing the above
                                             particle was hit */
 
+/* Boundary conditions that can handle several particles at once
+   provide an interact_pipeline function instead.  boundary_p calls it
+   from the pipelines, each with its own injector buffer, with the
+   same arguments as an interact function plus the context below.  It
+   must only write per-pipeline state (indexed by pipeline_rank) and
+   must add charge to ctx->rhob (with accumulate_rhob_array) rather
+   than to the field rhob.  Draws should come from the counter-based
+   substream (see seek_rng) of ctx->step and ctx->block, which numbers
+   the blocks of BOUNDARY_BLOCK movers of a timestep; a pipeline
+   processes the movers of a block in order.  Once the pipelines are
+   done, boundary_p calls finish (if not NULL) on the host to reduce
+   the per-pipeline state. */
+
+enum { BOUNDARY_BLOCK = 256 };
+
+typedef struct particle_bc_ctx {
+  float * rhob;      /* Pipeline rhob array */
+  int64_t step;      /* Timestep ... */
+  int block;         /* ... and mover block of the rng substream */
+  int pipeline_rank; /* Pipeline making the call */
+} particle_bc_ctx_t;
+
+typedef int /* Number of particles injected */
+(*particle_bc_pipeline_func_t)(
+  void                * RESTRICT b,
+  species_t           * RESTRICT sp,
+  particle_t          * RESTRICT p,
+  particle_mover_t    * RESTRICT pm,
+  particle_injector_t * RESTRICT pi,
+  int                            max_pi,
+  int                            face,
+  particle_bc_ctx_t   * RESTRICT ctx );
+
+typedef void
+(*particle_bc_finish_func_t)( void * RESTRICT b );
+
 typedef void
 (*delete_particle_bc_func_t)( particle_bc_t * RESTRICT pbc );
 
 struct particle_bc {
   void * params;
-  particle_bc_func_t interact;
+  particle_bc_func_t interact;                   /* NULL if ... */
+  particle_bc_pipeline_func_t interact_pipeline; /* ... this is not */
+  particle_bc_finish_func_t finish;
   delete_particle_bc_func_t delete_pbc;
   int64_t id;
   particle_bc_t * next;
@@ -57,6 +95,15 @@ new_particle_bc_internal( void * params,
                           restore_func_t restore,
                           reanimate_func_t reanimate );
 
+particle_bc_t *
+new_particle_bc_pipeline_internal( void * params,
+                                   particle_bc_pipeline_func_t interact,
+                                   particle_bc_finish_func_t finish,
+                                   delete_particle_bc_func_t delete_pbc,
+                                   checkpt_func_t checkpt,
+                                   restore_func_t restore,
+                                   reanimate_func_t reanimate );
+
 void
 delete_particle_bc_internal( particle_bc_t * pbc );
 
@@ -42,11 +42,21 @@
  
 /* Private interface ********************************************************/
 
+typedef struct maxwellian_reflux_pipeline {
+  frandn_buf_t nb; // Normal deviates for the perp spectra
+  int64_t step;    // Substream the pipeline generator ...
+  int block;       // ... was last sought to
+} maxwellian_reflux_pipeline_t;
+
 typedef struct maxwellian_reflux {
-  species_t * sp_list;
-  rng_t     * rng;
-  float     * ut_para;
-  float     * ut_perp;
+  species_t  * sp_list;
+  rng_pool_t * rp;                  // Seed of the rng substreams
+  rng_pool_t * crp;                 // Pipeline generators
+  maxwellian_reflux_pipeline_t * pl; // Pipeline state
+  int n_pipeline;
+  int stream;
+  float      * ut_para;
+  float      * ut_perp;
 } maxwellian_reflux_t;
 
 #ifndef M_SQRT2
@@ -61,9 +71,12 @@ interact_maxwellian_reflux( maxwellian_reflux_t * RESTRICT mr,
                             particle_mover_t    * RESTRICT pm,
                             particle_injector_t * RESTRICT pi,
                             int                            max_pi,
-                            int                            face ) {
+                            int                            face,
+                            particle_bc_ctx_t   * RESTRICT ctx ) {
   const grid_t * RESTRICT g   = sp->g;
-  /**/  rng_t  * RESTRICT rng = mr->rng;
+  /**/  rng_t  * RESTRICT rng = mr->crp->rng[ ctx->pipeline_rank ];
+
+  maxwellian_reflux_pipeline_t * RESTRICT pl = mr->pl + ctx->pipeline_rank;
 
   const int32_t sp_id   = sp->id;
   const float   ut_para = mr->ut_para[sp_id]; 
@@ -116,10 +129,20 @@ interact_maxwellian_reflux( maxwellian_reflux_t * RESTRICT mr,
   // number.
 
   // Note: This assumes ut_para > 0
-  
+  //
+  // Each block of movers draws from its own substream so the reflux
+  // does not depend on which pipeline handles the block.
+
+  if( pl->step!=ctx->step || pl->block!=ctx->block ) {
+    seek_rng( rng, mr->rp->seed, mr->stream, ctx->step, ctx->block );
+    pl->step = ctx->step;
+    pl->block = ctx->block;
+    pl->nb.n = 0;
+  }
+
   u[0] = ut_para*scale[face]*sqrtf(frande(rng));
-  u[1] = ut_perp*frandn(rng);
-  u[2] = ut_perp*frandn(rng);
+  u[1] = ut_perp*frandn_buf(rng,&pl->nb);
+  u[2] = ut_perp*frandn_buf(rng,&pl->nb);
   ux   = u[perm[face][0]];
   uy   = u[perm[face][1]];
   uz   = u[perm[face][2]];
@@ -182,7 +205,9 @@ checkpt_maxwellian_reflux( const particle_bc_t * RESTRICT pbc ) {
     (const maxwellian_reflux_t *)pbc->params;
   CHECKPT( mr, 1 );
   CHECKPT_PTR( mr->sp_list );
-  CHECKPT_PTR( mr->rng     );
+  CHECKPT_PTR( mr->rp      );
+  CHECKPT_PTR( mr->crp     );
+  CHECKPT( mr->pl, mr->n_pipeline );
   CHECKPT( mr->ut_para, num_species( mr->sp_list ) );
   CHECKPT( mr->ut_perp, num_species( mr->sp_list ) );
   checkpt_particle_bc_internal( pbc );
@@ -193,7 +218,9 @@ restore_maxwellian_reflux( void ) {
   maxwellian_reflux_t * mr;
   RESTORE( mr );
   RESTORE_PTR( mr->sp_list );
-  RESTORE_PTR( mr->rng     );
+  RESTORE_PTR( mr->rp      );
+  RESTORE_PTR( mr->crp     );
+  RESTORE( mr->pl );
   RESTORE( mr->ut_para );
   RESTORE( mr->ut_perp );
   return restore_particle_bc_internal( mr );
@@ -201,7 +228,12 @@ restore_maxwellian_reflux( void ) {
 
 void
 delete_maxwellian_reflux( particle_bc_t * RESTRICT pbc ) {
-  FREE( pbc->params );
+  maxwellian_reflux_t * mr = (maxwellian_reflux_t *)pbc->params;
+  delete_rng_pool( mr->crp );
+  FREE( mr->pl );
+  FREE( mr->ut_para );
+  FREE( mr->ut_perp );
+  FREE( mr );
   delete_particle_bc_internal( pbc );
 }
 
@@ -213,18 +245,28 @@ maxwellian_reflux( species_t  * RESTRICT sp_list,
   if( !sp_list || !rp ) ERROR(( "Bad args" ));
   maxwellian_reflux_t * mr;
   MALLOC( mr, 1 );
-  mr->sp_list = sp_list;
-  mr->rng     = rp->rng[0];
+  mr->sp_list    = sp_list;
+  mr->rp         = rp;
+  mr->crp        = new_rng_pool( N_PIPELINE, 0, 0 );
+  mr->n_pipeline = N_PIPELINE;
+  mr->stream     = rng_pool_stream( rp );
+  MALLOC( mr->pl, mr->n_pipeline );
+  for( int rank=0; rank<mr->n_pipeline; rank++ ) {
+    mr->pl[rank].nb.n  = 0;
+    mr->pl[rank].step  = -1;
+    mr->pl[rank].block = -1;
+  }
   MALLOC( mr->ut_para, num_species( mr->sp_list ) );
   MALLOC( mr->ut_perp, num_species( mr->sp_list ) );
   CLEAR( mr->ut_para, num_species( mr->sp_list ) );
   CLEAR( mr->ut_perp, num_species( mr->sp_list ) );
-  return new_particle_bc_internal( mr,
-                                   (particle_bc_func_t)interact_maxwellian_reflux,
-                                   delete_maxwellian_reflux,
-                                   (checkpt_func_t)checkpt_maxwellian_reflux,
-                                   (restore_func_t)restore_maxwellian_reflux,
-                                   NULL );
+  return new_particle_bc_pipeline_internal( mr,
+           (particle_bc_pipeline_func_t)interact_maxwellian_reflux,
+           NULL,
+           delete_maxwellian_reflux,
+           (checkpt_func_t)checkpt_maxwellian_reflux,
+           (restore_func_t)restore_maxwellian_reflux,
+           NULL );
 }
 
 /* FIXME: NOMINALLY, THIS INTERFACE SHOULD TAKE kT */
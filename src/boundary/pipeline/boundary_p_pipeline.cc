@@ -0,0 +1,181 @@
+#define IN_boundary
+
+#include "boundary_pipeline.h"
+
+#include "../../util/pipelines/pipelines_exec.h"
+
+//----------------------------------------------------------------------------//
+// Each pipeline takes a contiguous range of blocks of BOUNDARY_BLOCK movers
+// and handles the interactions it can without touching shared state:
+// absorption (into its own rhob array) and custom boundaries that have an
+// interact_pipeline function (into its own injector buffer).  It notes
+// what the host has to do for the other movers in the mover codes.  The
+// particles are not removed here; the host backfills them afterward.
+//----------------------------------------------------------------------------//
+
+void
+boundary_p_pipeline_scalar( boundary_p_pipeline_args_t * args,
+                            int pipeline_rank,
+                            int n_pipeline )
+{
+  /**/  species_t        * RESTRICT              sp       = args->sp;
+  /**/  particle_t       * RESTRICT ALIGNED(128) p0       = args->p0;
+  const int64_t          * RESTRICT ALIGNED(128) t0       = args->t0;
+  /**/  particle_mover_t * RESTRICT ALIGNED(16)  pm0      = args->pm;
+  /**/  int              * RESTRICT ALIGNED(16)  code     = args->code;
+  const int64_t          * RESTRICT ALIGNED(128) neighbor = args->neighbor;
+  const grid_t           *                       g        = args->g;
+  /**/  boundary_p_seg_t *                       seg      = args->seg + pipeline_rank;
+  /**/  particle_bc_t   ** RESTRICT              pbc      = args->pbc;
+  /**/  float            * RESTRICT ALIGNED(128) r        = args->r;
+
+  const int64_t rangel = args->rangel;
+  const int64_t rangeh = args->rangeh;
+  const int64_t rangem = args->rangem;
+  const float   sp_q   = sp->q;
+  const int     nb     = args->nb;
+
+  particle_bc_ctx_t ctx[1];
+  particle_mover_t * RESTRICT ALIGNED(16) pm;
+  int64_t nn;
+  int b, n_block, m, m0, i, n, voxel, face;
+
+  // No straggler cleanup needed.
+  if ( pipeline_rank == n_pipeline )
+  {
+    return;
+  }
+
+  DISTRIBUTE( ( args->nm + BOUNDARY_BLOCK - 1 ) / BOUNDARY_BLOCK, 1,
+              pipeline_rank, n_pipeline, b, n_block );
+
+  m0 = b*BOUNDARY_BLOCK;
+  m  = ( b + n_block )*BOUNDARY_BLOCK;
+  if ( m > args->nm ) m = args->nm;
+
+  r += (size_t) pipeline_rank * (size_t) args->stride;
+
+  ctx->rhob          = seg->rhob ? r : NULL;
+  ctx->step          = args->step;
+  ctx->pipeline_rank = pipeline_rank;
+
+  seg->n_pi = 0;
+
+# define USE_RHOB()                                                     \
+  if ( !ctx->rhob )                                                     \
+  {                                                                     \
+    CLEAR( r, args->nv );                                               \
+    ctx->rhob = r;                                                      \
+    seg->rhob = 1;                                                      \
+  }
+
+  // Movers are processed in reverse order like the host does so that
+  // injectors come out in the same order.
+
+  for( m--; m >= m0; m-- )
+  {
+    pm    = pm0 + m;
+    i     = pm->i;
+    voxel = p0[i].i;
+    face  = voxel & 7;
+    voxel >>= 3;
+    p0[i].i = voxel;
+    nn = neighbor[ 6*voxel + face ];
+
+    // Absorb
+
+    if ( nn == absorb_particles )
+    {
+      USE_RHOB();
+
+      accumulate_rhob_array( ctx->rhob, p0 + i, g, sp_q );
+
+      code[m] = BOUNDARY_P_DONE;
+
+      continue;
+    }
+
+    // Send to a neighboring node (the host packs the send buffers)
+
+    if ( ( ( nn >= 0 ) & ( nn < rangel ) ) |
+         ( ( nn > rangeh ) & ( nn <= rangem ) ) )
+    {
+      code[m] = BOUNDARY_P_SEND + face;
+
+      continue;
+    }
+
+    // User-defined handling (see the notes in boundary_p)
+
+    nn = -nn - 3; // Assumes reflective/absorbing are -1, -2
+
+    if ( ( nn >= 0 ) & ( nn < nb ) )
+    {
+      if ( !pbc[nn]->interact_pipeline )
+      {
+        code[m] = BOUNDARY_P_CUSTOM + 6*(int) nn + face;
+
+        continue;
+      }
+
+      USE_RHOB();
+
+      ctx->block = args->block0 + m / BOUNDARY_BLOCK;
+
+      n = pbc[nn]->interact_pipeline( pbc[nn]->params, sp, p0 + i, pm,
+                                      seg->pi + seg->n_pi, 1, face, ctx );
+
+      if ( args->tagged )
+      {
+        tag_injectors( seg->pt + seg->n_pi, seg->pi + seg->n_pi, n, sp->id,
+                       t0 ? t0[i] : BOUNDARY_P_NEW_TAG );
+      }
+
+      seg->n_pi += n;
+
+      code[m] = BOUNDARY_P_DONE;
+
+      continue;
+    }
+
+    code[m] = BOUNDARY_P_UNKNOWN;
+  }
+
+# undef USE_RHOB
+}
+
+//----------------------------------------------------------------------------//
+// Add the pipeline rhob arrays in use to the rhob of the fields.
+//----------------------------------------------------------------------------//
+
+void
+reduce_boundary_p_pipeline_scalar( boundary_p_pipeline_args_t * args,
+                                   int pipeline_rank,
+                                   int n_pipeline )
+{
+  /**/  field_t          * RESTRICT ALIGNED(128) f   = args->f;
+  const float            * RESTRICT ALIGNED(128) r   = args->r;
+  const boundary_p_seg_t *                       seg = args->seg;
+
+  const size_t sr = args->stride;
+  const int    np = N_PIPELINE;
+
+  float rho;
+  int i, i1, k;
+
+  DISTRIBUTE( args->nv, 16, pipeline_rank, n_pipeline, i, i1 );
+
+  i1 += i;
+
+  for( ; i < i1; i++ )
+  {
+    rho = f[i].rhob;
+
+    for( k = 0; k < np; k++ )
+    {
+      if ( seg[k].rhob ) rho += r[ k*sr + i ];
+    }
+
+    f[i].rhob = rho;
+  }
+}
@@ -0,0 +1,116 @@
+#ifndef _boundary_pipeline_h_
+#define _boundary_pipeline_h_
+
+#ifndef IN_boundary
+#error "Only include boundary_pipeline.h in boundary source files"
+#endif
+
+#include "../boundary_private.h"
+
+enum { MAX_PBC = 32, MAX_SP = 32 };
+
+// What the pipelines decided for each mover of a species.  The host
+// handles the movers that are not BOUNDARY_P_DONE.
+
+enum {
+  BOUNDARY_P_DONE    = -1, // Absorbed or handled by a pipeline
+  BOUNDARY_P_UNKNOWN = -2, // Unknown boundary interaction
+  BOUNDARY_P_SEND    =  0, // Send across face (code - BOUNDARY_P_SEND)
+  BOUNDARY_P_CUSTOM  =  6  // Host runs custom boundary nn on face f
+  /**/                     // (code = BOUNDARY_P_CUSTOM + 6*nn + f)
+};
+
+// The tag of an injector that is a new particle.  It is tagged from the
+// next_tag of its species when injected.
+
+#define BOUNDARY_P_NEW_TAG ((int64_t)-1)
+
+// Tag the n injectors a custom boundary made for an incident particle of
+// species id with tag t (BOUNDARY_P_NEW_TAG if the species is untagged).
+// The first injector of the same species continues the incident particle
+// and keeps its tag.  The others are new particles.
+
+static inline void
+tag_injectors( int64_t * RESTRICT pt,
+               const particle_injector_t * RESTRICT pi,
+               int n,
+               int id,
+               int64_t t )
+{
+  for( ; n; n--, pi++, pt++ )
+  {
+    if ( pi->sp_id == id )
+    {
+      *pt = t;
+      t   = BOUNDARY_P_NEW_TAG;
+    }
+
+    else
+    {
+      *pt = BOUNDARY_P_NEW_TAG;
+    }
+  }
+}
+
+// The injectors a pipeline made for a species (in reverse mover order)
+// and whether its rhob array is in use.
+
+typedef struct boundary_p_seg
+{
+  MEM_PTR( particle_injector_t, 16 ) pi; // Injector buffer
+  MEM_PTR( int64_t,             8  ) pt; // Tags of the injectors
+  int max_pi;                            // Injectors the buffer holds
+  int n_pi;                              // Injectors in the buffer
+  int rhob;                              // Pipeline rhob array in use
+
+  PAD_STRUCT( 2*SIZEOF_MEM_PTR + 3*sizeof(int) )
+
+} boundary_p_seg_t;
+
+typedef struct boundary_p_pipeline_args
+{
+  MEM_PTR( species_t,           1   ) sp;       // Species
+  MEM_PTR( particle_t,          128 ) p0;       // Particle array
+  MEM_PTR( const int64_t,       128 ) t0;       // Particle tags (or NULL)
+  MEM_PTR( particle_mover_t,    16  ) pm;       // Mover array
+  MEM_PTR( int,                 16  ) code;     // Per mover decision
+  MEM_PTR( const int64_t,       128 ) neighbor; // Voxel face neighbors
+  MEM_PTR( const grid_t,        1   ) g;        // Local domain grid
+  MEM_PTR( float,               128 ) r;        // Pipeline rhob arrays
+  MEM_PTR( field_t,             128 ) f;        // Field array
+  MEM_PTR( boundary_p_seg_t,    128 ) seg;      // Per pipeline results
+  MEM_PTR( particle_bc_t *,     1   ) pbc;      // Custom boundaries
+  int64_t                             step;     // Timestep
+  int64_t                             rangel;   // Local voxel range ...
+  int64_t                             rangeh;   // ... and the range of ...
+  int64_t                             rangem;   // ... all the voxels
+  int                                 nm;       // Movers
+  int                                 nb;       // Custom boundaries
+  int                                 block0;   // First mover block
+  int                                 tagged;   // Injectors carry tags
+  int                                 nv;       // Voxels per rhob array
+  int                                 stride;   // Rhob array stride
+
+  PAD_STRUCT( 11*SIZEOF_MEM_PTR + 4*sizeof(int64_t) + 6*sizeof(int) )
+
+} boundary_p_pipeline_args_t;
+
+BEGIN_C_DECLS
+
+// PROTOTYPE_PIPELINE( boundary_p, boundary_p_pipeline_args_t );
+
+void
+boundary_p_pipeline_scalar( boundary_p_pipeline_args_t * args,
+                            int pipeline_rank,
+                            int n_pipeline );
+
+// PROTOTYPE_PIPELINE( reduce_boundary_p, boundary_p_pipeline_args_t );
+
+void
+reduce_boundary_p_pipeline_scalar( boundary_p_pipeline_args_t * args,
+                                   int pipeline_rank,
+                                   int n_pipeline );
+
+END_C_DECLS
+
+#endif // _boundary_pipeline_h_
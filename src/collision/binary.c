@@ -19,15 +19,8 @@ apply_binary_collision_model( binary_collision_model_t * cm )
     return;
   }
 
-  if ( cm->spi->last_sorted != cm->spi->g->step )
-  {
-    sort_p( cm->spi );
-  }
-
-  if ( cm->spj->last_sorted != cm->spi->g->step )
-  {
-    sort_p( cm->spj );
-  }
+  // The species are sorted by the pipeline abstraction as it may fuse
+  // the sort with the collisions.
 
   // Conditionally execute this when more abstractions are available.
   apply_binary_collision_model_pipeline( cm );
@@ -43,10 +36,13 @@ checkpt_binary_collision_model( const collision_op_t * cop )
   CHECKPT_STR( cm->name );
   CHECKPT_SYM( cm->rate_constant );
   CHECKPT_SYM( cm->collision );
+  CHECKPT_SYM( cm->rate_constant_batch );
+  CHECKPT_SYM( cm->collision_batch );
   CHECKPT_PTR( cm->params );
   CHECKPT_PTR( cm->spi );
   CHECKPT_PTR( cm->spj );
   CHECKPT_PTR( cm->rp );
+  CHECKPT_PTR( cm->crp );
 
   checkpt_collision_op_internal( cop );
 }
@@ -60,10 +56,13 @@ restore_binary_collision_model( void )
   RESTORE_STR( cm->name );
   RESTORE_SYM( cm->rate_constant );
   RESTORE_SYM( cm->collision );
+  RESTORE_SYM( cm->rate_constant_batch );
+  RESTORE_SYM( cm->collision_batch );
   RESTORE_PTR( cm->params );
   RESTORE_PTR( cm->spi );
   RESTORE_PTR( cm->spj );
   RESTORE_PTR( cm->rp );
+  RESTORE_PTR( cm->crp );
 
   return restore_collision_op_internal( cm );
 }
@@ -74,6 +73,7 @@ delete_binary_collision_model( collision_op_t * cop )
   binary_collision_model_t * cm
     = (binary_collision_model_t *) cop->params;
 
+  delete_rng_pool( cm->crp );
   FREE( cm->name );
   FREE( cm );
 
@@ -87,11 +87,37 @@ binary_collision_model( const char * RESTRICT name,
                         binary_rate_constant_func_t rate_constant,
                         binary_collision_func_t collision,
                         void * RESTRICT params,
-                        species_t * RESTRICT spi,
-                        species_t * RESTRICT spj,
+                        species_t *          spi,
+                        species_t *          spj,
                         rng_pool_t * RESTRICT rp,
                         double sample,
                         int interval )
+{
+  return binary_collision_model_batch( name,
+                                       rate_constant,
+                                       collision,
+                                       NULL,
+                                       NULL,
+                                       params,
+                                       spi,
+                                       spj,
+                                       rp,
+                                       sample,
+                                       interval );
+}
+
+collision_op_t *
+binary_collision_model_batch( const char * RESTRICT name,
+                              binary_rate_constant_func_t rate_constant,
+                              binary_collision_func_t collision,
+                              binary_rate_constant_batch_func_t rate_constant_batch,
+                              binary_collision_batch_func_t collision_batch,
+                              void * RESTRICT params,
+                              species_t *          spi,
+                              species_t *          spj,
+                              rng_pool_t * RESTRICT rp,
+                              double sample,
+                              int interval )
 {
   binary_collision_model_t * cm;
 
@@ -126,12 +152,17 @@ binary_collision_model( const char * RESTRICT name,
 
   cm->rate_constant = rate_constant;
   cm->collision     = collision;
+  cm->rate_constant_batch = rate_constant_batch;
+  cm->collision_batch     = collision_batch;
   cm->params        = params;
   cm->spi           = spi;
   cm->spj           = spj;
   cm->rp            = rp;
+  cm->crp           = new_rng_pool( N_PIPELINE, 0, 0 );
+  cm->stream        = rng_pool_stream( rp );
   cm->sample        = sample;
   cm->interval      = interval;
+  cm->fuse_sort     = 0;
 
   return new_collision_op_internal( cm,
                                     ( collision_op_func_t ) apply_binary_collision_model,
@@ -140,3 +171,45 @@ binary_collision_model( const char * RESTRICT name,
                                     ( restore_func_t ) restore_binary_collision_model,
                                     NULL );
 }
+
+collision_op_t *
+fuse_sort_binary_collision_model( collision_op_t * cop )
+{
+  if ( !cop ||
+       cop->apply != (collision_op_func_t) apply_binary_collision_model )
+  {
+    ERROR( ( "Bad args" ) );
+  }
+
+  ( (binary_collision_model_t *) cop->params )->fuse_sort = 1;
+
+  return cop;
+}
+
+int
+sorted_by_collision_op_list( const collision_op_t * cop_list,
+                             const species_t * sp )
+{
+  const collision_op_t * cop;
+  const binary_collision_model_t * cm;
+
+  LIST_FOR_EACH( cop, cop_list )
+  {
+    if ( cop->apply != (collision_op_func_t) apply_binary_collision_model )
+    {
+      continue;
+    }
+
+    cm = (const binary_collision_model_t *) cop->params;
+
+    if ( cm->fuse_sort                          &&
+         cm->spi == sp                          &&
+         cm->interval > 0                       &&
+         !( sp->g->step % cm->interval ) )
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -8,13 +8,19 @@ typedef struct binary_collision_model
   char * name;
   binary_rate_constant_func_t rate_constant;
   binary_collision_func_t collision;
+  binary_rate_constant_batch_func_t rate_constant_batch;
+  binary_collision_batch_func_t collision_batch;
   void * params;
   species_t  * spi;
   species_t  * spj;
   rng_pool_t * rp;
+  rng_pool_t * crp; // Generators sought to the counter-based streams
+  int stream;       // Counter-based stream of the rp seed
   double sample;
   int interval;
+  int fuse_sort;    // Collide spi while sorting it (see sort_p_fused)
   int n_large_pr[ MAX_PIPELINE ];
+  int v_split[ MAX_PIPELINE+1 ]; // Voxels of each pipeline
 } binary_collision_model_t;
 
 void
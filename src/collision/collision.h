@@ -128,6 +128,65 @@ unary_collision_model( const char       * RESTRICT name,
                        /**/  rng_pool_t * RESTRICT rp,
                        int                         interval );
 
+/* A model can also provide batched versions of the above, which the
+   unary collision pipeline uses to process the particles of a species
+   UNARY_BATCH at a time.  A unary_rate_constant_batch_func_t sets, for
+   c=0:n-1:
+
+     K[c] = rate_constant( params, sp, &p[c] )
+
+   K is 64-byte aligned and holds UNARY_BATCH entries.  p is the first
+   particle of the batch, whose index in the particle array of sp is a
+   multiple of 16, and n is a multiple of 16 (the per-particle function
+   is used for the particles left over at the end of the species).
+
+   The pipeline tests the particles of a batch for collision with
+   random numbers it draws in bulk and passes the indices of those that
+   collided to a unary_collision_batch_func_t, which does, for
+   c=0:n-1:
+
+     collision( params, sp, &p[k[c]], rng )
+
+   where p is the particle array of sp.  k is 64-byte aligned, holds
+   UNARY_BATCH distinct indices and entries n and up of it to the next
+   multiple of 16 are valid particle indices so that particles can be
+   loaded a SIMD vector at a time.
+
+   Either batched function can be NULL, in which case the per-particle
+   function is used instead.  As for binary models, the random numbers
+   are drawn in a different order when batching, so the results of a
+   run with and without batched functions are statistically, but not
+   bitwise, the same. */
+
+#define UNARY_BATCH 64
+
+typedef void
+(*unary_rate_constant_batch_func_t)( /**/  void       * RESTRICT params,
+                                     const species_t  * RESTRICT sp,
+                                     const particle_t * ALIGNED(32) p,
+                                     /**/  float * RESTRICT ALIGNED(64) K,
+                                     int n );
+
+typedef void
+(*unary_collision_batch_func_t)( /**/  void       * RESTRICT params,
+                                 const species_t  * RESTRICT sp,
+                                 /**/  particle_t * ALIGNED(32) p,
+                                 const int * RESTRICT ALIGNED(64) k,
+                                 int n,
+                                 /**/  rng_t      * RESTRICT rng );
+
+collision_op_t *
+unary_collision_model_batch(
+    const char       * RESTRICT name,
+    unary_rate_constant_func_t       rate_constant,
+    unary_collision_func_t           collision,
+    unary_rate_constant_batch_func_t rate_constant_batch,
+    unary_collision_batch_func_t     collision_batch,
+    /**/  void       * RESTRICT params,
+    /**/  species_t  * RESTRICT sp,
+    /**/  rng_pool_t * RESTRICT rp,
+    int                         interval );
+
 /* In binary.c */
 
 /* A binary_rate_constant_func_t returns the lab-frame rate constant
@@ -232,19 +291,107 @@ typedef void
 /* Declare a binary collision model with the given microscopic physics. 
    params must be a registered object or NULL.  A particle in a species
    will be tested for collision on average at least "sample" times every
-   "interval" timesteps.  */
+   "interval" timesteps.  spi and spj can be the same species (self
+   collisions), so they are not RESTRICT.  */
 
 collision_op_t *
 binary_collision_model( const char       * RESTRICT name,
                         binary_rate_constant_func_t rate_constant,
                         binary_collision_func_t     collision,
                         /**/  void       * RESTRICT params,
-                        /**/  species_t  * RESTRICT spi,
-                        /**/  species_t  * RESTRICT spj,
+                        /**/  species_t  *          spi,
+                        /**/  species_t  *          spj,
                         /**/  rng_pool_t * RESTRICT rp,
                         double                      sample,
                         int                         interval );
 
+/* A model can also provide batched versions of the above, which the
+   binary collision pipeline uses to process the candidate pairs of a
+   voxel up to BINARY_BATCH at a time.  A
+   binary_rate_constant_batch_func_t sets, for c=0:n-1:
+
+     K[c] = rate_constant( params, spi, spj, &pi[k[c]], &pj[l[c]] )
+
+   where pi and pj are the particle arrays of spi and spj (the same
+   array for intraspecies collisions).  k, l and K are 64-byte aligned
+   and hold BINARY_BATCH entries.  Entries n and up of k and l to the
+   next multiple of 16 are valid particle indices and the matching
+   entries of K can be overwritten so that rate constants can be
+   computed a SIMD vector at a time.
+
+   A binary_collision_batch_func_t does, for c=0:n-1:
+
+     collision( params, spi, spj, &pi[k[c]], &pj[l[c]], rng, type[c] )
+
+   The pairs of a batch share no particles, so they can be processed
+   in any order.
+
+   Either batched function can be NULL, in which case the per-pair
+   function is used instead.  Note that the random numbers are drawn
+   in a different order when batching so the results of a run with
+   and without batched functions are statistically, but not bitwise,
+   the same. */
+
+#define BINARY_BATCH 64
+
+typedef void
+(*binary_rate_constant_batch_func_t)( /**/  void       * RESTRICT params,
+                                      const species_t  * RESTRICT spi,
+                                      const species_t  * RESTRICT spj,
+                                      const particle_t * ALIGNED(32) pi,
+                                      const particle_t * ALIGNED(32) pj,
+                                      const int   * RESTRICT ALIGNED(64) k,
+                                      const int   * RESTRICT ALIGNED(64) l,
+                                      /**/  float * RESTRICT ALIGNED(64) K,
+                                      int n );
+
+typedef void
+(*binary_collision_batch_func_t)( /**/  void       * RESTRICT params,
+                                  const species_t  * RESTRICT spi,
+                                  const species_t  * RESTRICT spj,
+                                  /**/  particle_t * ALIGNED(32) pi,
+                                  /**/  particle_t * ALIGNED(32) pj,
+                                  const int * RESTRICT ALIGNED(64) k,
+                                  const int * RESTRICT ALIGNED(64) l,
+                                  const int * RESTRICT ALIGNED(64) type,
+                                  int n,
+                                  /**/  rng_t      * RESTRICT rng );
+
+collision_op_t *
+binary_collision_model_batch(
+    const char       * RESTRICT name,
+    binary_rate_constant_func_t       rate_constant,
+    binary_collision_func_t           collision,
+    binary_rate_constant_batch_func_t rate_constant_batch,
+    binary_collision_batch_func_t     collision_batch,
+    /**/  void       * RESTRICT params,
+    /**/  species_t  *          spi,
+    /**/  species_t  *          spj,
+    /**/  rng_pool_t * RESTRICT rp,
+    double                      sample,
+    int                         interval );
+
+/* Decks usually sort collisional species every collision interval so
+   that a binary model finds spi freshly sorted and then makes its own
+   pass over it.  A binary model fused with the sort instead sorts spi
+   itself (with sort_p_fused) on the steps it is applied and collides
+   each range of voxels as soon as the sort is done with it, while its
+   particles are still in cache.  The collisions are the same as
+   without fusing.  The performance sort skips species that a fused
+   model will sort (see sorted_by_collision_op_list), so operators
+   applied before the fused model on such a species see it unsorted.
+   Returns cop, which must be a binary collision model. */
+
+collision_op_t *
+fuse_sort_binary_collision_model( collision_op_t * cop );
+
+/* Returns non-zero if a binary model of cop_list fused with the sort
+   will sort sp this step. */
+
+int
+sorted_by_collision_op_list( const collision_op_t * cop_list,
+                             const species_t * sp );
+
 /* In hard_sphere.c */
 
 /* Based on unary_collision_model */
@@ -267,9 +414,9 @@ hard_sphere_fluid( const char * RESTRICT name, /* Model name */
 
 collision_op_t *
 hard_sphere( const char * RESTRICT name, /* Model name */
-             species_t * RESTRICT spi,   /* Species-i */
+             species_t *          spi,   /* Species-i */
              const float ri,             /* Species-i p. radius (LENGTH) */
-             species_t * RESTRICT spj,   /* Species-j */
+             species_t *          spj,   /* Species-j */
              const float rj,             /* Species-j p. radius (LENGTH) */
              rng_pool_t * RESTRICT rp,   /* Entropy pool */
              const double sample,        /* Sampling density */
@@ -298,8 +445,8 @@ large_angle_coulomb_fluid(
 
 collision_op_t *
 large_angle_coulomb( const char * RESTRICT name, /* Model name */
-                     species_t * RESTRICT spi,   /* Species-i */
-                     species_t * RESTRICT spj,   /* Species-j */
+                     species_t *          spi,   /* Species-i */
+                     species_t *          spj,   /* Species-j */
                      const float bmax,           /* Impact parameter cutoff */
                      rng_pool_t * RESTRICT rp,   /* Entropy pool */
                      const double sample,        /* Sampling density */
@@ -39,6 +39,27 @@ new_collision_op_internal( void * params,
 void
 delete_collision_op_internal( collision_op_t * cop );
 
+/* The collision pipelines draw their random numbers from counter-based
+   rng substreams (see seek_rng) so that their results do not depend
+   on the number of pipelines.  Each operator has its own stream of its
+   rng pool seed, given by rng_pool_stream, and each timestep, voxel
+   (binary) or block of COLLISION_BLOCK particles (unary and langevin)
+   has its own substream of that. */
+
+#define COLLISION_BLOCK 256
+
+/* Assign pipeline_rank of n_pipeline the contiguous range [i,i1) of
+   n particles whose blocks it processes. */
+
+#define DISTRIBUTE_COLLISION_BLOCKS(n,pipeline_rank,n_pipeline,i,i1) do { \
+    double _n_target = (double)( ( (n) + COLLISION_BLOCK - 1 ) /          \
+                                 COLLISION_BLOCK ) / (double)(n_pipeline); \
+    int _b  = (int)( 0.5 + _n_target * (double)  (pipeline_rank)    );    \
+    int _b1 = (int)( 0.5 + _n_target * (double) ((pipeline_rank)+1) );    \
+    (i)  = _b  * COLLISION_BLOCK;                                         \
+    (i1) = _b1 * COLLISION_BLOCK < (n) ? _b1 * COLLISION_BLOCK : (n);     \
+  } while(0)
+
 END_C_DECLS
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -47,12 +68,22 @@ END_C_DECLS
 typedef struct langevin_pipeline_args {
   MEM_PTR( particle_t, 128 ) p;
   MEM_PTR( rng_t,      128 ) rng[ MAX_PIPELINE ];
+  int64_t step;
   float decay; 
   float drive;
   int np;
-  PAD_STRUCT( (1+MAX_PIPELINE)*SIZEOF_MEM_PTR+2*sizeof(float)+sizeof(int) )
+  int seed;
+  int stream;
+  PAD_STRUCT( (1+MAX_PIPELINE)*SIZEOF_MEM_PTR+sizeof(int64_t)+2*sizeof(float)+3*sizeof(int) )
 } langevin_pipeline_args_t;
 
 // PROTOTYPE_PIPELINE( langevin, langevin_pipeline_args_t );
 
+/* The pipelines draw the normal deviates for a block of particles into
+   n[ COLLISION_BLOCK*k + c ], k=0:2, c=0:nc-1, and update particle i+c
+   of the block as:
+     u_k = decay u_k + drive n[ COLLISION_BLOCK*k + c ]
+   The v4, v8 and v16 variants update 4, 8 and 16 particles at a time
+   and agree with the scalar one to rounding. */
+
 #endif /* _collision_h_ */
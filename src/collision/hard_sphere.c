@@ -1,4 +1,5 @@
 #include "collision.h"
+#include "pipeline/binary_batch.h"
 
 /* Private interface *********************************************************/
 
@@ -298,7 +299,7 @@ hard_sphere_fluid_collision( const hard_sphere_t * RESTRICT hs,
     urz -= w*frandn(rng);
   }
   
-  COMPUTE_MOMENTUM_TRANSFER(urx,urz,urz,ax,ay,az,rng);
+  COMPUTE_MOMENTUM_TRANSFER(urx,ury,urz,ax,ay,az,rng);
 
   w = hs->twomu_mi;
   pi->ux -= w*ax;
@@ -339,6 +340,58 @@ hard_sphere_collision( const hard_sphere_t * RESTRICT hs,
 
 #undef CMOV
 
+/* Batched versions of the above (see collision.h) */
+
+void
+hard_sphere_fluid_rate_constant_batch( const hard_sphere_t * RESTRICT hs,
+                                       const species_t     * RESTRICT spi,
+                                       const particle_t    * ALIGNED(32) pi,
+                                       /**/  float * RESTRICT ALIGNED(64) K,
+                                       int n ) {
+  fluid_rate_constant_batch( pi, hs->udx, hs->udy, hs->udz, hs->ut2,
+                             hs->alpha_Kt2ut4, hs->beta_Kt2ut2,
+                             hs->gamma_Kt2, K, n );
+}
+
+void
+hard_sphere_fluid_collision_batch( const hard_sphere_t * RESTRICT hs,
+                                   const species_t     * RESTRICT spi,
+                                   /**/  particle_t    * ALIGNED(32) pi,
+                                   const int * RESTRICT ALIGNED(64) k,
+                                   int n,
+                                   /**/  rng_t         * RESTRICT rng ) {
+  hard_sphere_fluid_scatter_batch( pi, k, n, hs->udx, hs->udy, hs->udz,
+                                   hs->ut, hs->twomu_mi, rng );
+}
+
+void
+hard_sphere_rate_constant_batch( const hard_sphere_t * RESTRICT hs,
+                                 const species_t     * RESTRICT spi,
+                                 const species_t     * RESTRICT spj,
+                                 const particle_t    * ALIGNED(32) pi,
+                                 const particle_t    * ALIGNED(32) pj,
+                                 const int   * RESTRICT ALIGNED(64) k,
+                                 const int   * RESTRICT ALIGNED(64) l,
+                                 /**/  float * RESTRICT ALIGNED(64) K,
+                                 int n ) {
+  relative_speed_batch( pi, pj, k, l, hs->Kc, K, n );
+}
+
+void
+hard_sphere_collision_batch( const hard_sphere_t * RESTRICT hs,
+                             const species_t     * RESTRICT spi,
+                             const species_t     * RESTRICT spj,
+                             /**/  particle_t    * ALIGNED(32) pi,
+                             /**/  particle_t    * ALIGNED(32) pj,
+                             const int * RESTRICT ALIGNED(64) k,
+                             const int * RESTRICT ALIGNED(64) l,
+                             const int * RESTRICT ALIGNED(64) type,
+                             int n,
+                             /**/  rng_t         * RESTRICT rng ) {
+  hard_sphere_scatter_batch( pi, pj, k, l, type, n,
+                             hs->twomu_mi, hs->twomu_mj, rng );
+}
+
 void
 checkpt_hard_sphere( const hard_sphere_t * hs ) {
   CHECKPT( hs, 1 );
@@ -387,17 +440,19 @@ hard_sphere_fluid( const char * RESTRICT name, /* Model name */
   hs->ut2          += FLT_MIN;
 
   REGISTER_OBJECT( hs, checkpt_hard_sphere, restore_hard_sphere, NULL );
-  return unary_collision_model( name,
-                   (unary_rate_constant_func_t)hard_sphere_fluid_rate_constant,
-                   (unary_collision_func_t)    hard_sphere_fluid_collision,
-                                hs, sp, rp, interval );
+  return unary_collision_model_batch( name,
+          (unary_rate_constant_func_t)      hard_sphere_fluid_rate_constant,
+          (unary_collision_func_t)          hard_sphere_fluid_collision,
+          (unary_rate_constant_batch_func_t)hard_sphere_fluid_rate_constant_batch,
+          (unary_collision_batch_func_t)    hard_sphere_fluid_collision_batch,
+                                      hs, sp, rp, interval );
 }
 
 collision_op_t *
 hard_sphere( const char * RESTRICT name, /* Model name */
-             species_t * RESTRICT spi,   /* Species-i */
+             species_t *          spi,   /* Species-i */
              const float ri,             /* Species-i p. radius (LENGTH) */
-             species_t * RESTRICT spj,   /* Species-j */
+             species_t *          spj,   /* Species-j */
              const float rj,             /* Species-j p. radius (LENGTH) */
              rng_pool_t * RESTRICT rp,   /* Entropy pool */
              const double sample,        /* Sampling density */
@@ -414,9 +469,11 @@ hard_sphere( const char * RESTRICT name, /* Model name */
   hs->Kc       = spi->g->cvac*M_PI*(ri+rj)*(ri+rj);
 
   REGISTER_OBJECT( hs, checkpt_hard_sphere, restore_hard_sphere, NULL );
-  return binary_collision_model( name,
-                        (binary_rate_constant_func_t)hard_sphere_rate_constant,
-                        (binary_collision_func_t)    hard_sphere_collision,
-                                 hs, spi, spj, rp, sample, interval );
+  return binary_collision_model_batch( name,
+          (binary_rate_constant_func_t)      hard_sphere_rate_constant,
+          (binary_collision_func_t)          hard_sphere_collision,
+          (binary_rate_constant_batch_func_t)hard_sphere_rate_constant_batch,
+          (binary_collision_batch_func_t)    hard_sphere_collision_batch,
+                                       hs, spi, spj, rp, sample, interval );
 }
 
@@ -29,6 +29,7 @@ checkpt_langevin( const collision_op_t * cop )
   CHECKPT( l, 1 );
   CHECKPT_PTR( l->sp );
   CHECKPT_PTR( l->rp );
+  CHECKPT_PTR( l->crp );
 
   checkpt_collision_op_internal( cop );
 }
@@ -41,6 +42,7 @@ restore_langevin( void )
   RESTORE( l );
   RESTORE_PTR( l->sp );
   RESTORE_PTR( l->rp );
+  RESTORE_PTR( l->crp );
 
   return restore_collision_op_internal( l );
 }
@@ -48,7 +50,10 @@ restore_langevin( void )
 void
 delete_langevin( collision_op_t * cop )
 {
-  FREE( cop->params );
+  langevin_t * l = ( langevin_t * ) cop->params;
+
+  delete_rng_pool( l->crp );
+  FREE( l );
 
   delete_collision_op_internal( cop );
 }
@@ -76,6 +81,8 @@ langevin( float kT,
 
   l->sp       = sp;
   l->rp       = rp;
+  l->crp      = new_rng_pool( N_PIPELINE, 0, 0 );
+  l->stream   = rng_pool_stream( rp );
   l->kT       = kT;
   l->nu       = nu;
   l->interval = interval;
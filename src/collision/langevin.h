@@ -7,12 +7,18 @@ typedef struct langevin
 {
   species_t  * sp;
   rng_pool_t * rp;
+  rng_pool_t * crp; // Generators sought to the counter-based streams
+  int stream;       // Counter-based stream of the rp seed
   float kT;
   float nu;
   int interval;
 } langevin_t;
 
+BEGIN_C_DECLS
+
 void
 apply_langevin_pipeline( langevin_t * l );
 
+END_C_DECLS
+
 #endif /* _langevin_h_ */
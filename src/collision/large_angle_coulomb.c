@@ -1,4 +1,5 @@
 #include "collision.h"
+#include "pipeline/binary_batch.h"
 
 /* Private interface *********************************************************/
 
@@ -145,7 +146,7 @@ large_angle_coulomb_fluid_collision(
     urz -= w*frandn(rng);
   }
   
-  COMPUTE_MOMENTUM_TRANSFER(urx,urz,urz,ax,ay,az,rng);
+  COMPUTE_MOMENTUM_TRANSFER(urx,ury,urz,ax,ay,az,rng);
 
   w = lac->twomu_mi;
   pi->ux -= w*ax;
@@ -187,6 +188,62 @@ large_angle_coulomb_collision(
 
 #undef CMOV
 
+/* Batched versions of the above (see collision.h) */
+
+void
+large_angle_coulomb_fluid_rate_constant_batch(
+    const large_angle_coulomb_t * RESTRICT lac,
+    const species_t             * RESTRICT spi,
+    const particle_t            * ALIGNED(32) pi,
+    /**/  float * RESTRICT ALIGNED(64) K,
+    int n ) {
+  fluid_rate_constant_batch( pi, lac->udx, lac->udy, lac->udz, lac->ut2,
+                             lac->alpha_Kt2ut4, lac->beta_Kt2ut2,
+                             lac->gamma_Kt2, K, n );
+}
+
+void
+large_angle_coulomb_fluid_collision_batch(
+    const large_angle_coulomb_t * RESTRICT lac,
+    const species_t             * RESTRICT spi,
+    /**/  particle_t            * ALIGNED(32) pi,
+    const int * RESTRICT ALIGNED(64) k,
+    int n,
+    /**/  rng_t                 * RESTRICT rng ) {
+  coulomb_fluid_scatter_batch( pi, k, n, lac->udx, lac->udy, lac->udz,
+                               lac->ut, lac->cc, lac->twomu_mi, rng );
+}
+
+void
+large_angle_coulomb_rate_constant_batch(
+    const large_angle_coulomb_t * RESTRICT lac,
+    const species_t             * RESTRICT spi,
+    const species_t             * RESTRICT spj,
+    const particle_t            * ALIGNED(32) pi,
+    const particle_t            * ALIGNED(32) pj,
+    const int   * RESTRICT ALIGNED(64) k,
+    const int   * RESTRICT ALIGNED(64) l,
+    /**/  float * RESTRICT ALIGNED(64) K,
+    int n ) {
+  relative_speed_batch( pi, pj, k, l, lac->Kc, K, n );
+}
+
+void
+large_angle_coulomb_collision_batch(
+    const large_angle_coulomb_t * RESTRICT lac,
+    const species_t             * RESTRICT spi,
+    const species_t             * RESTRICT spj,
+    /**/  particle_t            * ALIGNED(32) pi,
+    /**/  particle_t            * ALIGNED(32) pj,
+    const int * RESTRICT ALIGNED(64) k,
+    const int * RESTRICT ALIGNED(64) l,
+    const int * RESTRICT ALIGNED(64) type,
+    int n,
+    /**/  rng_t                 * RESTRICT rng ) {
+  coulomb_scatter_batch( pi, pj, k, l, type, n,
+                         lac->cc, lac->twomu_mi, lac->twomu_mj, rng );
+}
+
 void
 checkpt_large_angle_coulomb( const large_angle_coulomb_t * lac ) {
   CHECKPT( lac, 1 );
@@ -242,16 +299,18 @@ large_angle_coulomb_fluid(
   REGISTER_OBJECT( lac,
                    checkpt_large_angle_coulomb,
                    restore_large_angle_coulomb, NULL );
-  return unary_collision_model( name,
-           (unary_rate_constant_func_t)large_angle_coulomb_fluid_rate_constant,
-           (unary_collision_func_t)    large_angle_coulomb_fluid_collision,
-                                lac, sp, rp, interval );
+  return unary_collision_model_batch( name,
+     (unary_rate_constant_func_t)      large_angle_coulomb_fluid_rate_constant,
+     (unary_collision_func_t)          large_angle_coulomb_fluid_collision,
+     (unary_rate_constant_batch_func_t)large_angle_coulomb_fluid_rate_constant_batch,
+     (unary_collision_batch_func_t)    large_angle_coulomb_fluid_collision_batch,
+                                      lac, sp, rp, interval );
 }
 
 collision_op_t *
 large_angle_coulomb( const char * RESTRICT name, /* Model name */
-                     species_t * RESTRICT spi,   /* Species-i */
-                     species_t * RESTRICT spj,   /* Species-j */
+                     species_t *          spi,   /* Species-i */
+                     species_t *          spj,   /* Species-j */
                      const float bmax,           /* Impact parameter cutoff */
                      rng_pool_t * RESTRICT rp,   /* Entropy pool */
                      const double sample,        /* Sampling density */
@@ -272,9 +331,11 @@ large_angle_coulomb( const char * RESTRICT name, /* Model name */
   REGISTER_OBJECT( lac,
                    checkpt_large_angle_coulomb,
                    restore_large_angle_coulomb, NULL );
-  return binary_collision_model( name,
-                (binary_rate_constant_func_t)large_angle_coulomb_rate_constant,
-                (binary_collision_func_t)    large_angle_coulomb_collision,
-                                 lac, spi, spj, rp, sample, interval );
+  return binary_collision_model_batch( name,
+    (binary_rate_constant_func_t)      large_angle_coulomb_rate_constant,
+    (binary_collision_func_t)          large_angle_coulomb_collision,
+    (binary_rate_constant_batch_func_t)large_angle_coulomb_rate_constant_batch,
+    (binary_collision_batch_func_t)    large_angle_coulomb_collision_batch,
+                                       lac, spi, spj, rp, sample, interval );
 }
 
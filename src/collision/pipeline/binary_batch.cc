@@ -0,0 +1,410 @@
+#include "binary_batch.h"
+
+#include "../../util/v4/v4.h"
+#include "../../util/v8/v8.h"
+#include "../../util/v16/v16.h"
+
+#include <float.h>
+
+/* Private interface *********************************************************/
+
+/* Use the widest SIMD kernels available */
+
+#if defined(V16_ACCELERATION)
+# define BINARY_BATCH_KERNEL(name) name##_v16
+#elif defined(V8_ACCELERATION)
+# define BINARY_BATCH_KERNEL(name) name##_v8
+#elif defined(V4_ACCELERATION)
+# define BINARY_BATCH_KERNEL(name) name##_v4
+#else
+# define BINARY_BATCH_KERNEL(name) name##_scalar
+#endif
+
+void
+relative_speed_batch_scalar( const particle_t * ALIGNED(32) pi,
+                             const particle_t * ALIGNED(32) pj,
+                             const int   * RESTRICT ALIGNED(64) k,
+                             const int   * RESTRICT ALIGNED(64) l,
+                             float Kc,
+                             float * RESTRICT ALIGNED(64) K,
+                             int n )
+{
+  float urx, ury, urz;
+  int c;
+
+  for( c=0; c<n; c++ )
+  {
+    urx = pi[k[c]].ux - pj[l[c]].ux;
+    ury = pi[k[c]].uy - pj[l[c]].uy;
+    urz = pi[k[c]].uz - pj[l[c]].uz;
+    K[c] = Kc*sqrtf( urx*urx + ury*ury + urz*urz );
+  }
+}
+
+/* The T vector construction of COMPUTE_MOMENTUM_TRANSFER in
+   hard_sphere.c: T is perpendicular to ur and lies in the plane of ur
+   and the axis along which |ur| is the smallest. */
+
+#define CMOV(a,b) if(t0<t1) a=b
+
+#define COMPUTE_T(urx,ury,urz,ur2,tx,ty,tz) do {                        \
+    float t0, t1, t2, stack[3];                                         \
+    int d0, d1, d2;                                                     \
+    t0 = urx*urx;      d0=0;       d1=1;       d2=2;       t1=t0;  ur2  = t0; \
+    t0 = ury*ury; CMOV(d0,1); CMOV(d1,2); CMOV(d2,0); CMOV(t1,t0); ur2 += t0; \
+    t0 = urz*urz; CMOV(d0,2); CMOV(d1,0); CMOV(d2,1);              ur2 += t0; \
+    stack[0] = urx;                                                     \
+    stack[1] = ury;                                                     \
+    stack[2] = urz;                                                     \
+    t1  = stack[d1];                                                    \
+    t2  = stack[d2];                                                    \
+    t0  = 1 / sqrtf( t1*t1 + t2*t2 + FLT_MIN );                         \
+    stack[d0] =  0;                                                     \
+    stack[d1] =  t0*t2;                                                 \
+    stack[d2] = -t0*t1;                                                 \
+    tx = stack[0];                                                      \
+    ty = stack[1];                                                      \
+    tz = stack[2];                                                      \
+  } while(0)
+
+void
+hard_sphere_transfer_scalar( binary_scatter_t * RESTRICT ALIGNED(64) s,
+                             int n )
+{
+  float urx, ury, urz, ur2, ur, tx, ty, tz, b2, t0, t1, t2;
+  int c;
+
+  for( c=0; c<n; c++ )
+  {
+    urx = s->urx[c], ury = s->ury[c], urz = s->urz[c];
+    COMPUTE_T( urx, ury, urz, ur2, tx, ty, tz );
+    ur = sqrtf( ur2 );
+
+    b2 = s->bcs[c]*s->bcs[c] + s->bsn[c]*s->bsn[c];
+    t0 = 1 - b2;
+    t2 = sqrtf( t0 );
+    t1 = t2*s->bcs[c]*ur;
+    t2 *= s->bsn[c];
+
+    s->urx[c] = (t0*urx - t1*tx) - t2*( ury*tz - urz*ty );
+    s->ury[c] = (t0*ury - t1*ty) - t2*( urz*tx - urx*tz );
+    s->urz[c] = (t0*urz - t1*tz) - t2*( urx*ty - ury*tx );
+  }
+}
+
+void
+coulomb_transfer_scalar( binary_scatter_t * RESTRICT ALIGNED(64) s,
+                         float cc,
+                         int n )
+{
+  float urx, ury, urz, ur2, ur, tx, ty, tz, b2, t0, t1, t2;
+  int c;
+
+  for( c=0; c<n; c++ )
+  {
+    urx = s->urx[c], ury = s->ury[c], urz = s->urz[c];
+    COMPUTE_T( urx, ury, urz, ur2, tx, ty, tz );
+    ur = sqrtf( ur2 );
+
+    b2 = s->bcs[c]*s->bcs[c] + s->bsn[c]*s->bsn[c];
+    t1 = cc*ur2;
+    t0 = 1/(1+(t1*t1)*b2);
+    t2 = t0*t1;
+    t1 = t2*s->bcs[c]*ur;
+    t2 = t2*s->bsn[c];
+
+    s->urx[c] = (t0*urx - t1*tx) - t2*( ury*tz - urz*ty );
+    s->ury[c] = (t0*ury - t1*ty) - t2*( urz*tx - urx*tz );
+    s->urz[c] = (t0*urz - t1*tz) - t2*( urx*ty - ury*tx );
+  }
+}
+
+#undef COMPUTE_T
+#undef CMOV
+
+void
+fluid_rate_constant_batch_scalar( const particle_t * ALIGNED(32) p,
+                                  float udx,
+                                  float udy,
+                                  float udz,
+                                  float ut2,
+                                  float alpha_Kt2ut4,
+                                  float beta_Kt2ut2,
+                                  float gamma_Kt2,
+                                  float * RESTRICT ALIGNED(64) K,
+                                  int n )
+{
+  static const float gamma = (3.*M_PI-8.)/(24.-6*M_PI);
+
+  float urx, ury, urz, ur2;
+  int c;
+
+  for( c=0; c<n; c++ )
+  {
+    urx = p[c].ux - udx;
+    ury = p[c].uy - udy;
+    urz = p[c].uz - udz;
+    ur2 = urx*urx + ury*ury + urz*urz;
+    K[c] = sqrtf( ( alpha_Kt2ut4 + ur2*( beta_Kt2ut2 + ur2*gamma_Kt2 ) ) /
+                  ( ut2 + ur2*gamma ) );
+  }
+}
+
+/* Sample the impact parameters of the n entries of s in entry order
+   exactly as COMPUTE_MOMENTUM_TRANSFER draws them.  Entries past n
+   are padded with a harmless relative momentum and impact
+   parameter. */
+
+static int
+sample_scatter( binary_scatter_t * RESTRICT ALIGNED(64) s,
+                int n,
+                rng_t * RESTRICT rng )
+{
+  float bcs, bsn;
+  int c;
+
+  for( c=0; c<n; c++ )
+  {
+    do {
+      bcs = 2*frand_c0(rng) - 1;
+      bsn = 2*frand_c0(rng) - 1;
+    } while( bcs*bcs + bsn*bsn>=1 );
+    s->bcs[c] = bcs;
+    s->bsn[c] = bsn;
+  }
+
+  for( ; c&15; c++ )
+  {
+    s->urx[c] = 1, s->ury[c] = 0, s->urz[c] = 0;
+    s->bcs[c] = 0, s->bsn[c] = 0;
+  }
+
+  return c;
+}
+
+/* Load the relative momenta of the pairs into s and sample their
+   impact parameters */
+
+static int
+load_scatter( binary_scatter_t * RESTRICT ALIGNED(64) s,
+              const particle_t * ALIGNED(32) pi,
+              const particle_t * ALIGNED(32) pj,
+              const int * RESTRICT ALIGNED(64) k,
+              const int * RESTRICT ALIGNED(64) l,
+              int n,
+              rng_t * RESTRICT rng )
+{
+  int c;
+
+  for( c=0; c<n; c++ )
+  {
+    s->urx[c] = pi[k[c]].ux - pj[l[c]].ux;
+    s->ury[c] = pi[k[c]].uy - pj[l[c]].uy;
+    s->urz[c] = pi[k[c]].uz - pj[l[c]].uz;
+  }
+
+  return sample_scatter( s, n, rng );
+}
+
+/* Load the momenta of the particles relative to fluid particles drawn
+   from the drifting Maxwellian into s and sample their impact
+   parameters.  The thermal momenta of the fluid particles are drawn in
+   bulk before the impact parameters. */
+
+static int
+load_fluid_scatter( binary_scatter_t * RESTRICT ALIGNED(64) s,
+                    const particle_t * ALIGNED(32) p,
+                    const int * RESTRICT ALIGNED(64) k,
+                    int n,
+                    float udx,
+                    float udy,
+                    float udz,
+                    float ut,
+                    rng_t * RESTRICT rng )
+{
+  DECLARE_ALIGNED_ARRAY( float, 64, un, 3*BINARY_BATCH );
+  int c;
+
+  if( ut ) frandn_fill( rng, un, 1, 3*n );
+  else     CLEAR( un, 3*n );
+
+  for( c=0; c<n; c++ )
+  {
+    s->urx[c] = ( p[k[c]].ux - udx ) - ut*un[3*c  ];
+    s->ury[c] = ( p[k[c]].uy - udy ) - ut*un[3*c+1];
+    s->urz[c] = ( p[k[c]].uz - udz ) - ut*un[3*c+2];
+  }
+
+  return sample_scatter( s, n, rng );
+}
+
+/* Apply the momentum transfers in s to the particles selected by type */
+
+static void
+store_scatter( const binary_scatter_t * RESTRICT ALIGNED(64) s,
+               particle_t * ALIGNED(32) pi,
+               particle_t * ALIGNED(32) pj,
+               const int * RESTRICT ALIGNED(64) k,
+               const int * RESTRICT ALIGNED(64) l,
+               const int * RESTRICT ALIGNED(64) type,
+               int n,
+               float twomu_mi,
+               float twomu_mj )
+{
+  particle_t * p;
+  int c;
+
+  for( c=0; c<n; c++ )
+  {
+    if( type[c] & 1 )
+    {
+      p = &pi[k[c]];
+      p->ux -= twomu_mi*s->urx[c];
+      p->uy -= twomu_mi*s->ury[c];
+      p->uz -= twomu_mi*s->urz[c];
+    }
+
+    if( type[c] & 2 )
+    {
+      p = &pj[l[c]];
+      p->ux += twomu_mj*s->urx[c];
+      p->uy += twomu_mj*s->ury[c];
+      p->uz += twomu_mj*s->urz[c];
+    }
+  }
+}
+
+/* Apply the momentum transfers in s to the particles colliding with
+   the fluid */
+
+static void
+store_fluid_scatter( const binary_scatter_t * RESTRICT ALIGNED(64) s,
+                     particle_t * ALIGNED(32) p,
+                     const int * RESTRICT ALIGNED(64) k,
+                     int n,
+                     float twomu_mi )
+{
+  particle_t * q;
+  int c;
+
+  for( c=0; c<n; c++ )
+  {
+    q = &p[k[c]];
+    q->ux -= twomu_mi*s->urx[c];
+    q->uy -= twomu_mi*s->ury[c];
+    q->uz -= twomu_mi*s->urz[c];
+  }
+}
+
+/* Public interface **********************************************************/
+
+void
+relative_speed_batch( const particle_t * ALIGNED(32) pi,
+                      const particle_t * ALIGNED(32) pj,
+                      const int   * RESTRICT ALIGNED(64) k,
+                      const int   * RESTRICT ALIGNED(64) l,
+                      float Kc,
+                      float * RESTRICT ALIGNED(64) K,
+                      int n )
+{
+  BINARY_BATCH_KERNEL(relative_speed_batch)( pi, pj, k, l, Kc, K, n );
+}
+
+void
+hard_sphere_scatter_batch( particle_t * ALIGNED(32) pi,
+                           particle_t * ALIGNED(32) pj,
+                           const int * RESTRICT ALIGNED(64) k,
+                           const int * RESTRICT ALIGNED(64) l,
+                           const int * RESTRICT ALIGNED(64) type,
+                           int n,
+                           float twomu_mi,
+                           float twomu_mj,
+                           rng_t * RESTRICT rng )
+{
+  DECLARE_ALIGNED_ARRAY( binary_scatter_t, 64, s, 1 );
+  int nv = load_scatter( s, pi, pj, k, l, n, rng );
+  BINARY_BATCH_KERNEL(hard_sphere_transfer)( s, nv );
+  store_scatter( s, pi, pj, k, l, type, n, twomu_mi, twomu_mj );
+}
+
+void
+coulomb_scatter_batch( particle_t * ALIGNED(32) pi,
+                       particle_t * ALIGNED(32) pj,
+                       const int * RESTRICT ALIGNED(64) k,
+                       const int * RESTRICT ALIGNED(64) l,
+                       const int * RESTRICT ALIGNED(64) type,
+                       int n,
+                       float cc,
+                       float twomu_mi,
+                       float twomu_mj,
+                       rng_t * RESTRICT rng )
+{
+  DECLARE_ALIGNED_ARRAY( binary_scatter_t, 64, s, 1 );
+  int nv = load_scatter( s, pi, pj, k, l, n, rng );
+  BINARY_BATCH_KERNEL(coulomb_transfer)( s, cc, nv );
+  store_scatter( s, pi, pj, k, l, type, n, twomu_mi, twomu_mj );
+}
+
+void
+fluid_rate_constant_batch( const particle_t * ALIGNED(32) p,
+                           float udx,
+                           float udy,
+                           float udz,
+                           float ut2,
+                           float alpha_Kt2ut4,
+                           float beta_Kt2ut2,
+                           float gamma_Kt2,
+                           float * RESTRICT ALIGNED(64) K,
+                           int n )
+{
+  BINARY_BATCH_KERNEL(fluid_rate_constant_batch)( p, udx, udy, udz, ut2,
+                                                  alpha_Kt2ut4, beta_Kt2ut2,
+                                                  gamma_Kt2, K, n );
+}
+
+void
+hard_sphere_fluid_scatter_batch( particle_t * ALIGNED(32) p,
+                                 const int * RESTRICT ALIGNED(64) k,
+                                 int n,
+                                 float udx,
+                                 float udy,
+                                 float udz,
+                                 float ut,
+                                 float twomu_mi,
+                                 rng_t * RESTRICT rng )
+{
+  DECLARE_ALIGNED_ARRAY( binary_scatter_t, 64, s, 1 );
+  int nb, nv;
+
+  for( ; n; n-=nb, k+=nb )
+  {
+    nb = n<BINARY_BATCH ? n : BINARY_BATCH;
+    nv = load_fluid_scatter( s, p, k, nb, udx, udy, udz, ut, rng );
+    BINARY_BATCH_KERNEL(hard_sphere_transfer)( s, nv );
+    store_fluid_scatter( s, p, k, nb, twomu_mi );
+  }
+}
+
+void
+coulomb_fluid_scatter_batch( particle_t * ALIGNED(32) p,
+                             const int * RESTRICT ALIGNED(64) k,
+                             int n,
+                             float udx,
+                             float udy,
+                             float udz,
+                             float ut,
+                             float cc,
+                             float twomu_mi,
+                             rng_t * RESTRICT rng )
+{
+  DECLARE_ALIGNED_ARRAY( binary_scatter_t, 64, s, 1 );
+  int nb, nv;
+
+  for( ; n; n-=nb, k+=nb )
+  {
+    nb = n<BINARY_BATCH ? n : BINARY_BATCH;
+    nv = load_fluid_scatter( s, p, k, nb, udx, udy, udz, ut, rng );
+    BINARY_BATCH_KERNEL(coulomb_transfer)( s, cc, nv );
+    store_fluid_scatter( s, p, k, nb, twomu_mi );
+  }
+}
@@ -0,0 +1,152 @@
+#ifndef _binary_batch_h_
+#define _binary_batch_h_
+
+/* Batched kernels for the binary collision models whose rate constant
+   is K = Kc |ui-uj| and whose collisions are elastic scatterings off a
+   uniformly sampled impact parameter (hard_sphere and
+   large_angle_coulomb) and for their unary variants against a
+   drifting Maxwellian fluid (hard_sphere_fluid and
+   large_angle_coulomb_fluid).  See collision.h for the conventions of
+   the batched model functions these implement. */
+
+#include "../collision.h"
+
+/* Scratch for the scattering kernels.  On input, ur{xyz} hold the
+   relative momenta ui-uj of the pairs and b{cs,sn} the sampled impact
+   parameter (normalized to the cutoff).  On output, ur{xyz} hold the
+   momentum transfers a{xyz} of the pairs. */
+
+typedef struct binary_scatter {
+  float urx[ BINARY_BATCH ], ury[ BINARY_BATCH ], urz[ BINARY_BATCH ];
+  float bcs[ BINARY_BATCH ], bsn[ BINARY_BATCH ];
+} binary_scatter_t;
+
+BEGIN_C_DECLS
+
+/* K[c] = Kc |pi[k[c]].u - pj[l[c]].u| for c=0:n-1 (rounded up to a
+   multiple of 16) */
+
+void
+relative_speed_batch( const particle_t * ALIGNED(32) pi,
+                      const particle_t * ALIGNED(32) pj,
+                      const int   * RESTRICT ALIGNED(64) k,
+                      const int   * RESTRICT ALIGNED(64) l,
+                      float Kc,
+                      float * RESTRICT ALIGNED(64) K,
+                      int n );
+
+/* Collide the pairs pi[k[c]], pj[l[c]], c=0:n-1, as hard_sphere_collision
+   and large_angle_coulomb_collision do. */
+
+void
+hard_sphere_scatter_batch( particle_t * ALIGNED(32) pi,
+                           particle_t * ALIGNED(32) pj,
+                           const int * RESTRICT ALIGNED(64) k,
+                           const int * RESTRICT ALIGNED(64) l,
+                           const int * RESTRICT ALIGNED(64) type,
+                           int n,
+                           float twomu_mi,
+                           float twomu_mj,
+                           rng_t * RESTRICT rng );
+
+void
+coulomb_scatter_batch( particle_t * ALIGNED(32) pi,
+                       particle_t * ALIGNED(32) pj,
+                       const int * RESTRICT ALIGNED(64) k,
+                       const int * RESTRICT ALIGNED(64) l,
+                       const int * RESTRICT ALIGNED(64) type,
+                       int n,
+                       float cc,
+                       float twomu_mi,
+                       float twomu_mj,
+                       rng_t * RESTRICT rng );
+
+/* K[c] for particle p[c], c=0:n-1 (a multiple of 16), against the
+   fluid as hard_sphere_fluid_rate_constant computes it (see
+   hard_sphere.c for the parameters) */
+
+void
+fluid_rate_constant_batch( const particle_t * ALIGNED(32) p,
+                           float udx,
+                           float udy,
+                           float udz,
+                           float ut2,
+                           float alpha_Kt2ut4,
+                           float beta_Kt2ut2,
+                           float gamma_Kt2,
+                           float * RESTRICT ALIGNED(64) K,
+                           int n );
+
+/* Collide the particles p[k[c]], c=0:n-1, with the fluid as
+   hard_sphere_fluid_collision and large_angle_coulomb_fluid_collision
+   do. */
+
+void
+hard_sphere_fluid_scatter_batch( particle_t * ALIGNED(32) p,
+                                 const int * RESTRICT ALIGNED(64) k,
+                                 int n,
+                                 float udx,
+                                 float udy,
+                                 float udz,
+                                 float ut,
+                                 float twomu_mi,
+                                 rng_t * RESTRICT rng );
+
+void
+coulomb_fluid_scatter_batch( particle_t * ALIGNED(32) p,
+                             const int * RESTRICT ALIGNED(64) k,
+                             int n,
+                             float udx,
+                             float udy,
+                             float udz,
+                             float ut,
+                             float cc,
+                             float twomu_mi,
+                             rng_t * RESTRICT rng );
+
+/* The kernels behind the above in scalar (in binary_batch.cc) and SIMD
+   (in binary_batch_v*.cc) variants.  The widest available is used.
+   The transfer kernels compute the momentum transfers of the first n
+   (a multiple of 16) entries of s. */
+
+#define PROTOTYPE_BINARY_BATCH(v)                                       \
+  void                                                                  \
+  relative_speed_batch_##v( const particle_t * ALIGNED(32) pi,          \
+                            const particle_t * ALIGNED(32) pj,          \
+                            const int   * RESTRICT ALIGNED(64) k,       \
+                            const int   * RESTRICT ALIGNED(64) l,       \
+                            float Kc,                                   \
+                            float * RESTRICT ALIGNED(64) K,             \
+                            int n );                                    \
+                                                                        \
+  void                                                                  \
+  hard_sphere_transfer_##v( binary_scatter_t * RESTRICT ALIGNED(64) s,  \
+                            int n );                                    \
+                                                                        \
+  void                                                                  \
+  coulomb_transfer_##v( binary_scatter_t * RESTRICT ALIGNED(64) s,      \
+                        float cc,                                       \
+                        int n );                                        \
+                                                                        \
+  void                                                                  \
+  fluid_rate_constant_batch_##v( const particle_t * ALIGNED(32) p,      \
+                                 float udx,                             \
+                                 float udy,                             \
+                                 float udz,                             \
+                                 float ut2,                             \
+                                 float alpha_Kt2ut4,                    \
+                                 float beta_Kt2ut2,                     \
+                                 float gamma_Kt2,                       \
+                                 float * RESTRICT ALIGNED(64) K,        \
+                                 int n )
+
+PROTOTYPE_BINARY_BATCH(scalar);
+PROTOTYPE_BINARY_BATCH(v4);
+PROTOTYPE_BINARY_BATCH(v8);
+PROTOTYPE_BINARY_BATCH(v16);
+
+#undef PROTOTYPE_BINARY_BATCH
+
+END_C_DECLS
+
+#endif /* _binary_batch_h_ */
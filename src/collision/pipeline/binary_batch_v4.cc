@@ -0,0 +1,227 @@
+#include "binary_batch.h"
+
+#include "../../util/v4/v4.h"
+
+#include <float.h>
+
+#if defined(V4_ACCELERATION)
+
+using namespace v4;
+
+void
+relative_speed_batch_v4( const particle_t * ALIGNED(32) pi,
+                         const particle_t * ALIGNED(32) pj,
+                         const int   * RESTRICT ALIGNED(64) k,
+                         const int   * RESTRICT ALIGNED(64) l,
+                         float Kc,
+                         float * RESTRICT ALIGNED(64) K,
+                         int n )
+{
+  const v4float kc( Kc );
+
+  v4float uix, uiy, uiz, wi, ujx, ujy, ujz, wj, urx, ury, urz;
+
+  int c;
+
+  for( c=0; c<n; c+=4 )
+  {
+    load_4x4_tr( &pi[k[c  ]].ux, &pi[k[c+1]].ux,
+                 &pi[k[c+2]].ux, &pi[k[c+3]].ux,
+                 uix, uiy, uiz, wi );
+
+    load_4x4_tr( &pj[l[c  ]].ux, &pj[l[c+1]].ux,
+                 &pj[l[c+2]].ux, &pj[l[c+3]].ux,
+                 ujx, ujy, ujz, wj );
+
+    urx = uix - ujx;
+    ury = uiy - ujy;
+    urz = uiz - ujz;
+
+    store_4x1( kc*sqrt( urx*urx + ury*ury + urz*urz ), K+c );
+  }
+}
+
+/* Compute T for ur = (urx,ury,urz) as COMPUTE_MOMENTUM_TRANSFER does
+   (see hard_sphere.c).  The component of T along the axis where |ur|
+   is the smallest, d0, is zero and the other two are formed from the
+   components of ur along the axes d1 = d0+1 and d2 = d0+2 (mod 3). */
+
+static inline void
+compute_t( const v4float &urx, const v4float &ury, const v4float &urz,
+           v4float &ur2, v4float &tx, v4float &ty, v4float &tz )
+{
+  const v4float zero( 0.0f ), one( 1.0f ), tiny( FLT_MIN );
+
+  v4float x2, y2, z2, a, b, r, p, m;
+  v4int c1, c2;
+
+  x2 = urx*urx;
+  y2 = ury*ury;
+  z2 = urz*urz;
+  ur2 = x2 + y2 + z2;
+
+  c1 = y2 < x2;                    // d0 is 1 (if not 2)
+  c2 = z2 < merge( c1, y2, x2 );   // d0 is 2
+
+  a = merge( c2, urx, merge( c1, urz, ury ) );   // ur[d1]
+  b = merge( c2, ury, merge( c1, urx, urz ) );   // ur[d2]
+
+  r = one / sqrt( a*a + b*b + tiny );
+  p =  r*b;
+  m = -r*a;
+
+  tx = merge( c2, p,    merge( c1, m,    zero ) );
+  ty = merge( c2, m,    merge( c1, zero, p    ) );
+  tz = merge( c2, zero, merge( c1, p,    m    ) );
+}
+
+void
+hard_sphere_transfer_v4( binary_scatter_t * RESTRICT ALIGNED(64) s,
+                         int n )
+{
+  const v4float one( 1.0f );
+
+  v4float urx, ury, urz, ur2, ur, tx, ty, tz, bcs, bsn, t0, t1, t2;
+
+  int c;
+
+  for( c=0; c<n; c+=4 )
+  {
+    load_4x1( s->urx+c, urx );
+    load_4x1( s->ury+c, ury );
+    load_4x1( s->urz+c, urz );
+    load_4x1( s->bcs+c, bcs );
+    load_4x1( s->bsn+c, bsn );
+
+    compute_t( urx, ury, urz, ur2, tx, ty, tz );
+    ur = sqrt( ur2 );
+
+    t0 = one - ( bcs*bcs + bsn*bsn );
+    t2 = sqrt( t0 );
+    t1 = t2*bcs*ur;
+    t2 = t2*bsn;
+
+    store_4x1( (t0*urx - t1*tx) - t2*( ury*tz - urz*ty ), s->urx+c );
+    store_4x1( (t0*ury - t1*ty) - t2*( urz*tx - urx*tz ), s->ury+c );
+    store_4x1( (t0*urz - t1*tz) - t2*( urx*ty - ury*tx ), s->urz+c );
+  }
+}
+
+void
+coulomb_transfer_v4( binary_scatter_t * RESTRICT ALIGNED(64) s,
+                     float cc,
+                     int n )
+{
+  const v4float one( 1.0f ), vcc( cc );
+
+  v4float urx, ury, urz, ur2, ur, tx, ty, tz, bcs, bsn, t0, t1, t2;
+
+  int c;
+
+  for( c=0; c<n; c+=4 )
+  {
+    load_4x1( s->urx+c, urx );
+    load_4x1( s->ury+c, ury );
+    load_4x1( s->urz+c, urz );
+    load_4x1( s->bcs+c, bcs );
+    load_4x1( s->bsn+c, bsn );
+
+    compute_t( urx, ury, urz, ur2, tx, ty, tz );
+    ur = sqrt( ur2 );
+
+    t1 = vcc*ur2;
+    t0 = one / ( one + (t1*t1)*( bcs*bcs + bsn*bsn ) );
+    t2 = t0*t1;
+    t1 = t2*bcs*ur;
+    t2 = t2*bsn;
+
+    store_4x1( (t0*urx - t1*tx) - t2*( ury*tz - urz*ty ), s->urx+c );
+    store_4x1( (t0*ury - t1*ty) - t2*( urz*tx - urx*tz ), s->ury+c );
+    store_4x1( (t0*urz - t1*tz) - t2*( urx*ty - ury*tx ), s->urz+c );
+  }
+}
+
+void
+fluid_rate_constant_batch_v4( const particle_t * ALIGNED(32) p,
+                             float udx,
+                             float udy,
+                             float udz,
+                             float ut2,
+                             float alpha_Kt2ut4,
+                             float beta_Kt2ut2,
+                             float gamma_Kt2,
+                             float * RESTRICT ALIGNED(64) K,
+                             int n )
+{
+  const v4float vudx( udx ), vudy( udy ), vudz( udz ), vut2( ut2 );
+  const v4float alpha( alpha_Kt2ut4 ), beta( beta_Kt2ut2 );
+  const v4float gamma( gamma_Kt2 ), g( (3.*M_PI-8.)/(24.-6*M_PI) );
+
+  v4float ux, uy, uz, w, urx, ury, urz, ur2;
+
+  int c;
+
+  for( c=0; c<n; c+=4 )
+  {
+    load_4x4_tr( &p[c  ].ux, &p[c+1].ux, &p[c+2].ux, &p[c+3].ux,
+                 ux, uy, uz, w );
+
+    urx = ux - vudx;
+    ury = uy - vudy;
+    urz = uz - vudz;
+    ur2 = urx*urx + ury*ury + urz*urz;
+
+    store_4x1( sqrt( ( alpha + ur2*( beta + ur2*gamma ) ) /
+                     ( vut2 + ur2*g ) ), K+c );
+  }
+}
+
+#else
+
+void
+relative_speed_batch_v4( const particle_t * ALIGNED(32) pi,
+                         const particle_t * ALIGNED(32) pj,
+                         const int   * RESTRICT ALIGNED(64) k,
+                         const int   * RESTRICT ALIGNED(64) l,
+                         float Kc,
+                         float * RESTRICT ALIGNED(64) K,
+                         int n )
+{
+  // No v4 implementation.
+  ERROR( ( "No relative_speed_batch_v4 implementation." ) );
+}
+
+void
+hard_sphere_transfer_v4( binary_scatter_t * RESTRICT ALIGNED(64) s,
+                         int n )
+{
+  // No v4 implementation.
+  ERROR( ( "No hard_sphere_transfer_v4 implementation." ) );
+}
+
+void
+coulomb_transfer_v4( binary_scatter_t * RESTRICT ALIGNED(64) s,
+                     float cc,
+                     int n )
+{
+  // No v4 implementation.
+  ERROR( ( "No coulomb_transfer_v4 implementation." ) );
+}
+
+void
+fluid_rate_constant_batch_v4( const particle_t * ALIGNED(32) p,
+                             float udx,
+                             float udy,
+                             float udz,
+                             float ut2,
+                             float alpha_Kt2ut4,
+                             float beta_Kt2ut2,
+                             float gamma_Kt2,
+                             float * RESTRICT ALIGNED(64) K,
+                             int n )
+{
+  // No v4 implementation.
+  ERROR( ( "No fluid_rate_constant_batch_v4 implementation." ) );
+}
+
+#endif
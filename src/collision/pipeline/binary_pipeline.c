@@ -12,23 +12,165 @@
 
 /* Private interface *********************************************************/
 
-void
-binary_pipeline_scalar( binary_collision_model_t * RESTRICT cm,
-                        int pipeline_rank,
-                        int n_pipeline )
+/* Test nc candidate pairs of the voxel for collision a batch at a time
+   with the model's batched functions.  This makes the same decisions
+   as the per-pair loop in binary_pipeline_scalar.  The rate constants
+   of a batch are computed before any of its pairs collide though, so
+   the rate constant of a pair with a particle that already collided
+   in this batch is stale.  Such pairs are caught with a 64-bit mask of
+   (hashed) particles that collided in the batch and their rate
+   constant is recomputed with the per-pair function once the pending
+   collisions are done.  Collisions are rare, so this hardly happens.
+
+   The random numbers for picking the pairs and testing them are made
+   in bulk too.  A pair index is the high word of the product of a 32-bit
+   rand and the number of particles, rejecting the few rands that
+   would make the indices slightly nonuniform.  Unlike the division in
+   binary_pipeline_scalar, this can be vectorized. */
+
+static void
+binary_voxel_batch( binary_collision_model_t * RESTRICT cm,
+                    rng_t * RESTRICT rng,
+                    int k0, int nk,
+                    int l0, int nl,
+                    int nc,
+                    float pr_norm,
+                    int * RESTRICT n_large_pr )
 {
-  if ( pipeline_rank == n_pipeline )
+  binary_rate_constant_func_t       rate_constant       = cm->rate_constant;
+  binary_collision_func_t           collision           = cm->collision;
+  binary_rate_constant_batch_func_t rate_constant_batch = cm->rate_constant_batch;
+  binary_collision_batch_func_t     collision_batch     = cm->collision_batch;
+
+  /**/  void       * RESTRICT params = cm->params;
+  const species_t  * RESTRICT spi    = cm->spi;
+  const species_t  * RESTRICT spj    = cm->spj;
+  /**/  particle_t *          spi_p  = spi->p;
+  /**/  particle_t *          spj_p  = spj->p;
+
+  DECLARE_ALIGNED_ARRAY( int,   64, kb, BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( int,   64, lb, BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( float, 64, K,  BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( int,   64, kq, BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( int,   64, lq, BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( int,   64, tq, BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( unsigned, 64, u,  2*BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( float,    64, pr, BINARY_BATCH );
+
+  /* 2^32 mod nk and 2^32 mod nl */
+  const uint32_t tk = ( 0U - (uint32_t)nk ) % (uint32_t)nk;
+  const uint32_t tl = ( 0U - (uint32_t)nl ) % (uint32_t)nl;
+
+  uint64_t collided, touched, mk, ml;
+  float pr_coll, wk, wl, w_max, w_min;
+  int c, nb, nq, n_reject, k, l, type;
+
+  for( ; nc; nc-=nb )
   {
-    return; /* No host straggler cleanup */
+    nb = nc<BINARY_BATCH ? nc : BINARY_BATCH;
+
+    /* Pick the pairs of the batch uniformly at random from all pairs
+       of particles in the voxel and pad the index lists to a multiple
+       of 16 with a valid pair. */
+
+    uirand_fill( rng, u, 1, 2*nb );
+    n_reject = 0;
+    for( c=0; c<nb; c++ )
+    {
+      mk = (uint64_t)u[2*c  ]*(uint64_t)nk;
+      ml = (uint64_t)u[2*c+1]*(uint64_t)nl;
+      kb[c] = k0 + (int)( mk>>32 );
+      lb[c] = l0 + (int)( ml>>32 );
+      n_reject += ( (uint32_t)mk<tk ) | ( (uint32_t)ml<tl );
+    }
+
+    if( n_reject ) /* Virtually never */
+      for( c=0; c<nb; c++ )
+      {
+        mk = (uint64_t)u[2*c  ]*(uint64_t)nk;
+        ml = (uint64_t)u[2*c+1]*(uint64_t)nl;
+        while( (uint32_t)mk<tk ) mk = (uint64_t)uirand(rng)*(uint64_t)nk;
+        while( (uint32_t)ml<tl ) ml = (uint64_t)uirand(rng)*(uint64_t)nl;
+        kb[c] = k0 + (int)( mk>>32 );
+        lb[c] = l0 + (int)( ml>>32 );
+      }
+
+    for( c=nb; c&15; c++ ) kb[c] = kb[0], lb[c] = lb[0];
+
+    frand_c0_fill( rng, pr, 1, nb );
+
+    if( rate_constant_batch )
+      rate_constant_batch( params, spi, spj, spi_p, spj_p, kb, lb, K, nb );
+    else
+      for( c=0; c<nb; c++ )
+        K[c] = rate_constant( params, spi, spj, &spi_p[kb[c]], &spj_p[lb[c]] );
+
+    collided = 0;
+    nq = 0;
+
+    for( c=0; c<nb; c++ )
+    {
+      k = kb[c];
+      l = lb[c];
+      touched = ( ((uint64_t)1)<<(k&63) ) | ( ((uint64_t)1)<<(l&63) );
+
+      if( collided & touched )
+      {
+        if( nq ) collision_batch( params, spi, spj, spi_p, spj_p,
+                                  kq, lq, tq, nq, rng );
+        nq = 0;
+        K[c] = rate_constant( params, spi, spj, &spi_p[k], &spj_p[l] );
+      }
+
+      wk = spi_p[k].w;
+      wl = spj_p[l].w;
+      w_max = (wk>wl) ? wk : wl;
+      pr_coll = w_max * pr_norm * K[c];
+      if( pr_coll>1 ) (*n_large_pr)++;
+
+      if( pr[c]>=pr_coll ) continue; /* Didn't collide */
+
+      w_min = (wk>wl) ? wl : wk;
+      type = 1; if( wl==w_min ) type++;
+      if( w_max==w_min || w_max*frand_c0(rng)<w_min ) type = 3;
+
+      /* A computational particle colliding with itself is left to the
+         per-pair function as the batched ones may assume the two
+         particles of a pair are distinct. */
+
+      if( collision_batch && ( k!=l || spi_p!=spj_p ) )
+      {
+        kq[nq] = k, lq[nq] = l, tq[nq] = type, nq++;
+      }
+
+      else
+      {
+        collision( params, spi, spj, &spi_p[k], &spj_p[l], rng, type );
+      }
+
+      collided |= touched;
+    }
+
+    if( nq ) collision_batch( params, spi, spj, spi_p, spj_p,
+                              kq, lq, tq, nq, rng );
   }
+}
+
+/* Test the candidate pairs of the voxels [v,v1) for collision and
+   return the number of pairs with a large collision probability */
 
+static int
+binary_voxels( binary_collision_model_t * RESTRICT cm,
+               rng_t * RESTRICT rng,
+               int v,
+               int v1 )
+{
   binary_rate_constant_func_t rate_constant = cm->rate_constant;
   binary_collision_func_t     collision     = cm->collision;
 
   /**/  void       * RESTRICT params        = cm->params;
   /**/  species_t  * RESTRICT spi           = cm->spi;
   /**/  species_t  * RESTRICT spj           = cm->spj;
-  /**/  rng_t      * RESTRICT rng           = cm->rp->rng[ pipeline_rank ];
 
   /**/  particle_t * RESTRICT spi_p         = spi->p;
   const int        * RESTRICT spi_partition = spi->partition;
@@ -41,14 +183,9 @@ binary_pipeline_scalar( binary_collision_model_t * RESTRICT cm,
   const float  dtinterval_dV = ( g->dt * (float)cm->interval ) / g->dV;
 
   float pr_norm, pr_coll, wk, wl, w_max, w_min;
-  int v, v1, k, k0, nk, rk, l, l0, nl, rl, np, nc, type, n_large_pr = 0;
+  int k, k0, nk, rk, l, l0, nl, rl, np, nc, type, n_large_pr = 0;
 
-  /* Stripe the (mostly non-ghost) voxels over threads for load balance */
-
-  v  = VOXEL( 0,0,0,             g->nx,g->ny,g->nz ) + pipeline_rank;
-  v1 = VOXEL( g->nx,g->ny,g->nz, g->nx,g->ny,g->nz ) + 1;
-
-  for( ; v<v1; v+=n_pipeline )
+  for( ; v<v1; v++ )
   {
     /* Find the species i computational particles, k, and the species j
        computational particles, l, in this voxel, determine the number
@@ -106,6 +243,16 @@ binary_pipeline_scalar( binary_collision_model_t * RESTRICT cm,
 
     pr_norm = dtinterval_dV*((float)np / (float)nc);
 
+    /* Draw from the rng substream of this voxel */
+
+    seek_rng( rng, cm->rp->seed, cm->stream, g->step, v );
+
+    if( cm->rate_constant_batch || cm->collision_batch )
+    {
+      binary_voxel_batch( cm, rng, k0, nk, l0, nl, nc, pr_norm, &n_large_pr );
+      continue;
+    }
+
     /* For each candidate pair */
 
     for( ; nc; nc-- )
@@ -153,7 +300,86 @@ binary_pipeline_scalar( binary_collision_model_t * RESTRICT cm,
     }
   }
 
-  cm->n_large_pr[pipeline_rank] = n_large_pr;
+  return n_large_pr;
+}
+
+void
+binary_pipeline_scalar( binary_collision_model_t * RESTRICT cm,
+                        int pipeline_rank,
+                        int n_pipeline )
+{
+  if ( pipeline_rank == n_pipeline )
+  {
+    return; /* No host straggler cleanup */
+  }
+
+  /* Process the voxels split_voxels assigned to this pipeline */
+
+  cm->n_large_pr[ pipeline_rank ] =
+    binary_voxels( cm,
+                   cm->crp->rng[ pipeline_rank ],
+                   cm->v_split[ pipeline_rank   ],
+                   cm->v_split[ pipeline_rank+1 ] );
+}
+
+/* The sort_voxel_func_t of models fused with the sort of spi.  As
+   every voxel draws from its own rng substream, the collisions are the
+   same as those of a separate pass whichever pipeline sorts which
+   voxels. */
+
+static void
+binary_sort_voxels( binary_collision_model_t * cm,
+                    int v0,
+                    int v1,
+                    int pipeline_rank )
+{
+  cm->n_large_pr[ pipeline_rank ] +=
+    binary_voxels( cm, cm->crp->rng[ pipeline_rank ], v0, v1 );
+}
+
+/* Split the (mostly non-ghost) voxels into contiguous ranges, one per
+   pipeline, with about the same number of candidate pairs in each.
+   The cost of a voxel is taken to be its number of candidate pairs
+   (nc in binary_pipeline_scalar) such that voxels without pairs cost
+   nothing.  The split is a function of the particle counts and the
+   number of pipelines only, so runs are reproducible. */
+
+static void
+split_voxels( binary_collision_model_t * cm,
+              int n_pipeline )
+{
+  const grid_t * RESTRICT g             = cm->spi->g;
+  const int    * RESTRICT spi_partition = cm->spi->partition;
+  const int    * RESTRICT spj_partition = cm->spj->partition;
+
+  const double sample = (cm->spi==cm->spj ? 0.5 : 1)*cm->sample;
+
+  const int v0 = VOXEL( 0,0,0,             g->nx,g->ny,g->nz );
+  const int v1 = VOXEL( g->nx,g->ny,g->nz, g->nx,g->ny,g->nz ) + 1;
+
+  int64_t n_pair = 0, n_pair_before = 0;
+  int v, p, nk, nl;
+
+# define VOXEL_COST(v)                                                  \
+  ( nk = spi_partition[(v)+1] - spi_partition[(v)],                     \
+    nl = spj_partition[(v)+1] - spj_partition[(v)],                     \
+    ( nk && nl ) ? (int)( 0.5 + sample*(double)( nk>nl ? nk : nl ) ) : 0 )
+
+  for( v=v0; v<v1; v++ ) n_pair += VOXEL_COST(v);
+
+  /* Pipeline p starts at the first voxel with at least p/n_pipeline of
+     the pairs before it */
+
+  cm->v_split[0] = v0;
+  for( p=1, v=v0; v<v1 && p<n_pipeline; v++ )
+  {
+    while( p<n_pipeline && n_pair_before*n_pipeline >= n_pair*p )
+      cm->v_split[p++] = v;
+    n_pair_before += VOXEL_COST(v);
+  }
+  for( ; p<=n_pipeline; p++ ) cm->v_split[p] = v1;
+
+# undef VOXEL_COST
 }
 
 void
@@ -166,19 +392,40 @@ apply_binary_collision_model_pipeline( binary_collision_model_t * cm )
     return;
   }
 
-  if ( cm->spi->last_sorted != cm->spi->g->step )
+  /* If the model is fused with the sort and spi still needs sorting,
+     collide each voxel range as soon as the sort is done with it.
+     Otherwise, sort what needs sorting and make a separate pass. */
+
+  if ( cm->fuse_sort && cm->spi->last_sorted != cm->spi->g->step )
   {
-    sort_p( cm->spi );
+    if ( cm->spj != cm->spi && cm->spj->last_sorted != cm->spi->g->step )
+    {
+      sort_p( cm->spj );
+    }
+
+    CLEAR( cm->n_large_pr, N_PIPELINE );
+
+    sort_p_fused( cm->spi, (sort_voxel_func_t) binary_sort_voxels, cm );
   }
 
-  if ( cm->spj->last_sorted != cm->spi->g->step )
+  else
   {
-    sort_p( cm->spj );
-  }
+    if ( cm->spi->last_sorted != cm->spi->g->step )
+    {
+      sort_p( cm->spi );
+    }
 
-  EXEC_PIPELINES( binary, cm, 0 );
+    if ( cm->spj->last_sorted != cm->spi->g->step )
+    {
+      sort_p( cm->spj );
+    }
+
+    split_voxels( cm, N_PIPELINE );
 
-  WAIT_PIPELINES();
+    EXEC_PIPELINES( binary, cm, 0 );
+
+    WAIT_PIPELINES();
+  }
 
   for( p = 0; p < N_PIPELINE; p++ )
   {
@@ -5,6 +5,8 @@
 #include "../langevin.h"
 #include "../unary.h"
 
+BEGIN_C_DECLS
+
 void
 binary_pipeline_scalar( binary_collision_model_t * RESTRICT cm,
                         int pipeline_rank,
@@ -15,9 +17,26 @@ langevin_pipeline_scalar( langevin_pipeline_args_t * RESTRICT args,
                           int pipeline_rank,
                           int n_pipeline );
 
+void
+langevin_pipeline_v4( langevin_pipeline_args_t * RESTRICT args,
+                      int pipeline_rank,
+                      int n_pipeline );
+
+void
+langevin_pipeline_v8( langevin_pipeline_args_t * RESTRICT args,
+                      int pipeline_rank,
+                      int n_pipeline );
+
+void
+langevin_pipeline_v16( langevin_pipeline_args_t * RESTRICT args,
+                       int pipeline_rank,
+                       int n_pipeline );
+
 void
 unary_pipeline_scalar( unary_collision_model_t * RESTRICT cm,
                        int pipeline_rank,
                        int n_pipeline );
 
+END_C_DECLS
+
 #endif /* _collision_pipeline_h_ */
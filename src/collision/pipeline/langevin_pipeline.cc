@@ -1,5 +1,9 @@
 #define IN_collision
 
+#define HAS_V4_PIPELINE
+#define HAS_V8_PIPELINE
+#define HAS_V16_PIPELINE
+
 #include "collision_pipeline.h"
 
 #include "../langevin.h"
@@ -23,24 +27,42 @@ langevin_pipeline_scalar( langevin_pipeline_args_t * RESTRICT args,
   float                 decay = args->decay;
   float                 drive = args->drive;
 
-  double n_target = (double)args->np / (double)n_pipeline;
+  /* Assign each pipeline a contiguous range of blocks of
+     COLLISION_BLOCK particles, each with its own rng substream. */
+
+  int i, i1;
+
+  DISTRIBUTE_COLLISION_BLOCKS( args->np, pipeline_rank, n_pipeline, i, i1 );
+
+  DECLARE_ALIGNED_ARRAY( float, 64, n, 3*COLLISION_BLOCK );
+
+  const float * RESTRICT nx = n;
+  const float * RESTRICT ny = n +   COLLISION_BLOCK;
+  const float * RESTRICT nz = n + 2*COLLISION_BLOCK;
 
-  /**/  int i  = (int)( 0.5 + n_target * (double)  pipeline_rank    );
-  const int i1 = (int)( 0.5 + n_target * (double) (pipeline_rank+1) );
+  int c, nc;
 
-  for( ; i < i1; i++ )
+  /* Draw the normal deviates for a whole block at a time */
+
+  for( ; i < i1; i += nc )
   {
-    p[i].ux = decay * p[i].ux + drive * frandn(rng);
-    p[i].uy = decay * p[i].uy + drive * frandn(rng);
-    p[i].uz = decay * p[i].uz + drive * frandn(rng);
-  }
-}
+    nc = i1 - i < COLLISION_BLOCK ? i1 - i : COLLISION_BLOCK;
 
-#if defined(V4_ACCELERATION) && defined(HAS_V4_PIPELINE)
+    seek_rng( rng, args->seed, args->stream, args->step,
+              i / COLLISION_BLOCK );
 
-#error "V4 pipeline not implemented"
+    frandn_fill( rng, n,                    1, nc );
+    frandn_fill( rng, n +   COLLISION_BLOCK, 1, nc );
+    frandn_fill( rng, n + 2*COLLISION_BLOCK, 1, nc );
 
-#endif
+    for( c = 0; c < nc; c++ )
+    {
+      p[i+c].ux = decay * p[i+c].ux + drive * nx[c];
+      p[i+c].uy = decay * p[i+c].uy + drive * ny[c];
+      p[i+c].uz = decay * p[i+c].uz + drive * nz[c];
+    }
+  }
+}
 
 void
 apply_langevin_pipeline( langevin_t * l )
@@ -98,13 +120,16 @@ apply_langevin_pipeline( langevin_t * l )
 
   DECLARE_ALIGNED_ARRAY( langevin_pipeline_args_t, 128, args, 1 );
 
-  args->p     = l->sp->p;
+  args->p      = l->sp->p;
 
-  COPY( args->rng, l->rp->rng, N_PIPELINE );
+  COPY( args->rng, l->crp->rng, N_PIPELINE );
 
-  args->decay = exp( -nudt );
-  args->drive = sqrt( ( -expm1( -2 * nudt ) * l->kT ) / ( l->sp->m * l->sp->g->cvac ) );
-  args->np    = l->sp->np;
+  args->step   = l->sp->g->step;
+  args->decay  = exp( -nudt );
+  args->drive  = sqrt( ( -expm1( -2 * nudt ) * l->kT ) / ( l->sp->m * l->sp->g->cvac ) );
+  args->np     = l->sp->np;
+  args->seed   = l->rp->seed;
+  args->stream = l->stream;
 
   EXEC_PIPELINES( langevin, args, 0 );
 
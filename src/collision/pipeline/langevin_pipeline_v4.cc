@@ -0,0 +1,90 @@
+#define IN_collision
+
+#include "collision_pipeline.h"
+
+#include "../../util/v4/v4.h"
+
+#if defined(V4_ACCELERATION)
+
+using namespace v4;
+
+void
+langevin_pipeline_v4( langevin_pipeline_args_t * RESTRICT args,
+                      int pipeline_rank,
+                      int n_pipeline )
+{
+  particle_t * ALIGNED(128) p   = args->p;
+  rng_t      * RESTRICT     rng = args->rng[ pipeline_rank ];
+
+  const v4float decay( args->decay );
+  const v4float drive( args->drive );
+
+  v4float ux, uy, uz, w, nx, ny, nz;
+
+  int i, i1;
+
+  DISTRIBUTE_COLLISION_BLOCKS( args->np, pipeline_rank, n_pipeline, i, i1 );
+
+  DECLARE_ALIGNED_ARRAY( float, 64, n, 3*COLLISION_BLOCK );
+
+  const float * ALIGNED(64) n0 = n;
+  const float * ALIGNED(64) n1 = n +   COLLISION_BLOCK;
+  const float * ALIGNED(64) n2 = n + 2*COLLISION_BLOCK;
+
+  int c, nc;
+
+  for( ; i < i1; i += nc )
+  {
+    nc = i1 - i < COLLISION_BLOCK ? i1 - i : COLLISION_BLOCK;
+
+    seek_rng( rng, args->seed, args->stream, args->step,
+              i / COLLISION_BLOCK );
+
+    frandn_fill( rng, n,                    1, nc );
+    frandn_fill( rng, n +   COLLISION_BLOCK, 1, nc );
+    frandn_fill( rng, n + 2*COLLISION_BLOCK, 1, nc );
+
+    // Update the particles of the block 4 at a time.
+
+    for( c = 0; c + 4 <= nc; c += 4 )
+    {
+      load_4x4_tr( &p[i+c  ].ux, &p[i+c+1].ux,
+                   &p[i+c+2].ux, &p[i+c+3].ux,
+                   ux, uy, uz, w );
+
+      load_4x1( n0 + c, nx );
+      load_4x1( n1 + c, ny );
+      load_4x1( n2 + c, nz );
+
+      ux = decay*ux + drive*nx;
+      uy = decay*uy + drive*ny;
+      uz = decay*uz + drive*nz;
+
+      store_4x4_tr( ux, uy, uz, w,
+                    &p[i+c  ].ux, &p[i+c+1].ux,
+                    &p[i+c+2].ux, &p[i+c+3].ux );
+    }
+
+    // Update the particles left over at the end of the last block.
+
+    for( ; c < nc; c++ )
+    {
+      p[i+c].ux = args->decay * p[i+c].ux + args->drive * n0[c];
+      p[i+c].uy = args->decay * p[i+c].uy + args->drive * n1[c];
+      p[i+c].uz = args->decay * p[i+c].uz + args->drive * n2[c];
+    }
+  }
+}
+
+#else
+
+void
+langevin_pipeline_v4( langevin_pipeline_args_t * RESTRICT args,
+                      int pipeline_rank,
+                      int n_pipeline )
+{
+  // No v4 implementation.
+  ERROR( ( "No langevin_pipeline_v4 implementation." ) );
+}
+
+#endif
@@ -0,0 +1,94 @@
+#define IN_collision
+
+#include "collision_pipeline.h"
+
+#include "../../util/v8/v8.h"
+
+#if defined(V8_ACCELERATION)
+
+using namespace v8;
+
+void
+langevin_pipeline_v8( langevin_pipeline_args_t * RESTRICT args,
+                      int pipeline_rank,
+                      int n_pipeline )
+{
+  particle_t * ALIGNED(128) p   = args->p;
+  rng_t      * RESTRICT     rng = args->rng[ pipeline_rank ];
+
+  const v8float decay( args->decay );
+  const v8float drive( args->drive );
+
+  v8float ux, uy, uz, w, nx, ny, nz;
+
+  int i, i1;
+
+  DISTRIBUTE_COLLISION_BLOCKS( args->np, pipeline_rank, n_pipeline, i, i1 );
+
+  DECLARE_ALIGNED_ARRAY( float, 64, n, 3*COLLISION_BLOCK );
+
+  const float * ALIGNED(64) n0 = n;
+  const float * ALIGNED(64) n1 = n +   COLLISION_BLOCK;
+  const float * ALIGNED(64) n2 = n + 2*COLLISION_BLOCK;
+
+  int c, nc;
+
+  for( ; i < i1; i += nc )
+  {
+    nc = i1 - i < COLLISION_BLOCK ? i1 - i : COLLISION_BLOCK;
+
+    seek_rng( rng, args->seed, args->stream, args->step,
+              i / COLLISION_BLOCK );
+
+    frandn_fill( rng, n,                    1, nc );
+    frandn_fill( rng, n +   COLLISION_BLOCK, 1, nc );
+    frandn_fill( rng, n + 2*COLLISION_BLOCK, 1, nc );
+
+    // Update the particles of the block 8 at a time.
+
+    for( c = 0; c + 8 <= nc; c += 8 )
+    {
+      load_8x4_tr( &p[i+c  ].ux, &p[i+c+1].ux,
+                   &p[i+c+2].ux, &p[i+c+3].ux,
+                   &p[i+c+4].ux, &p[i+c+5].ux,
+                   &p[i+c+6].ux, &p[i+c+7].ux,
+                   ux, uy, uz, w );
+
+      load_8x1( n0 + c, nx );
+      load_8x1( n1 + c, ny );
+      load_8x1( n2 + c, nz );
+
+      ux = decay*ux + drive*nx;
+      uy = decay*uy + drive*ny;
+      uz = decay*uz + drive*nz;
+
+      store_8x4_tr( ux, uy, uz, w,
+                    &p[i+c  ].ux, &p[i+c+1].ux,
+                    &p[i+c+2].ux, &p[i+c+3].ux,
+                    &p[i+c+4].ux, &p[i+c+5].ux,
+                    &p[i+c+6].ux, &p[i+c+7].ux );
+    }
+
+    // Update the particles left over at the end of the last block.
+
+    for( ; c < nc; c++ )
+    {
+      p[i+c].ux = args->decay * p[i+c].ux + args->drive * n0[c];
+      p[i+c].uy = args->decay * p[i+c].uy + args->drive * n1[c];
+      p[i+c].uz = args->decay * p[i+c].uz + args->drive * n2[c];
+    }
+  }
+}
+
+#else
+
+void
+langevin_pipeline_v8( langevin_pipeline_args_t * RESTRICT args,
+                      int pipeline_rank,
+                      int n_pipeline )
+{
+  // No v8 implementation.
+  ERROR( ( "No langevin_pipeline_v8 implementation." ) );
+}
+
+#endif
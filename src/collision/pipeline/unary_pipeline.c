@@ -10,6 +10,74 @@
 
 /* Private interface *********************************************************/
 
+/* Test the nb particles of a batch starting at particle i for collision
+   with the model's batched functions.  This makes the same decisions
+   as the per-particle loop in unary_pipeline_scalar but the random
+   numbers for the tests are drawn in bulk and the particles that
+   collided are handed to the batched collision function together.  As
+   a particle's collision does not change the rate constant of any
+   other, the rate constants of the whole batch can be computed first. */
+
+static void
+unary_batch( unary_collision_model_t * RESTRICT cm,
+             rng_t * RESTRICT rng,
+             int i,
+             int nb,
+             float dt,
+             int * RESTRICT n_large_pr )
+{
+  unary_rate_constant_func_t       rate_constant       = cm->rate_constant;
+  unary_collision_func_t           collision           = cm->collision;
+  unary_rate_constant_batch_func_t rate_constant_batch = cm->rate_constant_batch;
+  unary_collision_batch_func_t     collision_batch     = cm->collision_batch;
+
+  /**/  void       * RESTRICT params = cm->params;
+  const species_t  * RESTRICT sp     = cm->sp;
+  /**/  particle_t *          p      = cm->sp->p;
+
+  DECLARE_ALIGNED_ARRAY( float, 64, K,  UNARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( float, 64, pr, UNARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( int,   64, kq, UNARY_BATCH );
+
+  float pr_coll;
+  int c, nv, nq;
+
+  /* The batched rate constant function gets a multiple of 16
+     particles and the per-particle one does the rest. */
+
+  nv = rate_constant_batch ? ( nb & ~15 ) : 0;
+
+  if( nv ) rate_constant_batch( params, sp, p+i, K, nv );
+
+  for( c=nv; c<nb; c++ ) K[c] = rate_constant( params, sp, &p[i+c] );
+
+  frand_c0_fill( rng, pr, 1, nb );
+
+  /* Yes, strictly < (see unary_pipeline_scalar) */
+
+  nq = 0;
+  for( c=0; c<nb; c++ )
+  {
+    pr_coll = dt*K[c];
+    if( pr_coll>1 ) (*n_large_pr)++;
+    kq[nq] = i+c;
+    nq += ( pr[c]<pr_coll );
+  }
+
+  if( !nq ) return;
+
+  if( collision_batch )
+  {
+    for( c=nq; c&15; c++ ) kq[c] = kq[0];
+    collision_batch( params, sp, p, kq, nq, rng );
+  }
+
+  else
+  {
+    for( c=0; c<nq; c++ ) collision( params, sp, &p[kq[c]], rng );
+  }
+}
+
 void
 unary_pipeline_scalar( unary_collision_model_t * RESTRICT cm,
                        int pipeline_rank,
@@ -26,17 +94,43 @@ unary_pipeline_scalar( unary_collision_model_t * RESTRICT cm,
   /**/  void       * RESTRICT params = cm->params;
   const species_t  * RESTRICT sp     = cm->sp;
   /**/  particle_t * RESTRICT p      = cm->sp->p;
-  /**/  rng_t      * RESTRICT rng    = cm->rp->rng[ pipeline_rank ];
+  /**/  rng_t      * RESTRICT rng    = cm->crp->rng[ pipeline_rank ];
 
   const float dt = sp->g->dt * (float) cm->interval;
 
-  double n_target = (double) sp->np / (double) n_pipeline;
+  /* Split the particles into blocks of COLLISION_BLOCK particles, each
+     with its own rng substream, and assign each pipeline a contiguous
+     range of blocks. */
 
-  /**/  int i  = (int) ( 0.5 + n_target * (double)  pipeline_rank    );
-  const int i1 = (int) ( 0.5 + n_target * (double) (pipeline_rank+1) );
+  int i, i1;
+
+  DISTRIBUTE_COLLISION_BLOCKS( sp->np, pipeline_rank, n_pipeline, i, i1 );
 
   float pr_coll;
-  int n_large_pr = 0;
+  int nb, n_large_pr = 0;
+
+  /* Models with batched functions process the particles of a block
+     UNARY_BATCH (which divides COLLISION_BLOCK) at a time. */
+
+  if ( cm->rate_constant_batch || cm->collision_batch )
+  {
+    for( ; i < i1; i += nb )
+    {
+      if ( !( i % COLLISION_BLOCK ) )
+      {
+        seek_rng( rng, cm->rp->seed, cm->stream, sp->g->step,
+                  i / COLLISION_BLOCK );
+      }
+
+      nb = i1 - i < UNARY_BATCH ? i1 - i : UNARY_BATCH;
+
+      unary_batch( cm, rng, i, nb, dt, &n_large_pr );
+    }
+
+    cm->n_large_pr[ pipeline_rank ] = n_large_pr;
+
+    return;
+  }
 
   /* For each computational particle assigned to this pipeline, compute
      the probability a comoving physical particle had collision with
@@ -46,6 +140,12 @@ unary_pipeline_scalar( unary_collision_model_t * RESTRICT cm,
 
   for( ; i < i1; i++ )
   {
+    if ( !( i % COLLISION_BLOCK ) )
+    {
+      seek_rng( rng, cm->rp->seed, cm->stream, sp->g->step,
+                i / COLLISION_BLOCK );
+    }
+
     pr_coll = dt * rate_constant( params, sp, &p[i] );
 
     if ( pr_coll > 1 )
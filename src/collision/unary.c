@@ -32,9 +32,12 @@ checkpt_unary_collision_model( const collision_op_t * cop )
   CHECKPT_STR( cm->name );
   CHECKPT_SYM( cm->rate_constant );
   CHECKPT_SYM( cm->collision );
+  CHECKPT_SYM( cm->rate_constant_batch );
+  CHECKPT_SYM( cm->collision_batch );
   CHECKPT_PTR( cm->params );
   CHECKPT_PTR( cm->sp );
   CHECKPT_PTR( cm->rp );
+  CHECKPT_PTR( cm->crp );
 
   checkpt_collision_op_internal( cop );
 }
@@ -48,9 +51,12 @@ restore_unary_collision_model( void )
   RESTORE_STR( cm->name );
   RESTORE_SYM( cm->rate_constant );
   RESTORE_SYM( cm->collision );
+  RESTORE_SYM( cm->rate_constant_batch );
+  RESTORE_SYM( cm->collision_batch );
   RESTORE_PTR( cm->params );
   RESTORE_PTR( cm->sp );
   RESTORE_PTR( cm->rp );
+  RESTORE_PTR( cm->crp );
 
   return restore_collision_op_internal( cm );
 }
@@ -60,6 +66,7 @@ delete_unary_collision_model( collision_op_t * cop )
 {
   unary_collision_model_t * cm = ( unary_collision_model_t * ) cop->params;
 
+  delete_rng_pool( cm->crp );
   FREE( cm->name );
   FREE( cm );
 
@@ -76,6 +83,28 @@ unary_collision_model( const char * RESTRICT name,
                        species_t * RESTRICT sp,
                        rng_pool_t * RESTRICT rp,
                        int interval )
+{
+  return unary_collision_model_batch( name,
+                                      rate_constant,
+                                      collision,
+                                      NULL,
+                                      NULL,
+                                      params,
+                                      sp,
+                                      rp,
+                                      interval );
+}
+
+collision_op_t *
+unary_collision_model_batch( const char * RESTRICT name,
+                             unary_rate_constant_func_t rate_constant,
+                             unary_collision_func_t collision,
+                             unary_rate_constant_batch_func_t rate_constant_batch,
+                             unary_collision_batch_func_t collision_batch,
+                             void * RESTRICT params,
+                             species_t * RESTRICT sp,
+                             rng_pool_t * RESTRICT rp,
+                             int interval )
 {
   unary_collision_model_t * cm;
 
@@ -108,9 +137,13 @@ unary_collision_model( const char * RESTRICT name,
 
   cm->rate_constant = rate_constant;
   cm->collision     = collision;
+  cm->rate_constant_batch = rate_constant_batch;
+  cm->collision_batch     = collision_batch;
   cm->params        = params;
   cm->sp            = sp;
   cm->rp            = rp;
+  cm->crp           = new_rng_pool( N_PIPELINE, 0, 0 );
+  cm->stream        = rng_pool_stream( rp );
   cm->interval      = interval;
 
   return new_collision_op_internal( cm,
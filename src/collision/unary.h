@@ -8,9 +8,13 @@ typedef struct unary_collision_model
   char * name;
   unary_rate_constant_func_t rate_constant;
   unary_collision_func_t collision;
+  unary_rate_constant_batch_func_t rate_constant_batch;
+  unary_collision_batch_func_t collision_batch;
   void * params;
   species_t * sp;
   rng_pool_t * rp;
+  rng_pool_t * crp; // Generators sought to the counter-based streams
+  int stream;       // Counter-based stream of the rp seed
   int interval;
   int n_large_pr[ MAX_PIPELINE ];
 } unary_collision_model_t;
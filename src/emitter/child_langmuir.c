@@ -10,7 +10,9 @@ typedef struct child_langmuir {
   const interpolator_array_t * ia;
   /**/  field_array_t        * fa;
   /**/  accumulator_array_t  * aa;
-  /**/  rng_t                * rng;
+  /**/  rng_pool_t           * rp;
+  /**/  rng_pool_t           * crp; // Generators sought to the substreams
+  int stream;
   int n_emit_per_face;
   float ut_para;
   float ut_perp;
@@ -26,54 +28,63 @@ typedef struct child_langmuir {
 //   Total charge inject uses L as the width of a cell in the
 //   direction of emission normal. V is the avergae voltage drop
 //   across the cell (neglecting gauge issues).
+// - Each component draws from its own counter-based rng substream
+//   (keyed by rp->seed, emitter, step and component) so the emission
+//   does not depend on what else drew from the rng pool or on the
+//   number of pipelines.
 // - Particles are emitted with a half-Maxwellian distribution.
 //   See maxwellian_reflux for a derivation how this works.
 // - Particles are randomly distributed across the inject surface
 //   and have random ages.
+// - The particles are made by inject_p.  Each component has
+//   n_emit_per_face slots and the injection blocks hold whole
+//   components.
+
+typedef struct child_langmuir_emit {
+  const child_langmuir_t * cl;
+  const interpolator_t   * fi;
+  const int              * component;
+  int64_t step;
+  float norm_x, norm_y, norm_z;
+  float thresh;
+} child_langmuir_emit_t;
+
+static int
+emit_child_langmuir_block( void * _params,
+                           int first,
+                           int n,
+                           particle_t * RESTRICT ALIGNED(32) p,
+                           float * RESTRICT age,
+                           rng_t * RESTRICT rng ) {
+  const child_langmuir_emit_t * params = (const child_langmuir_emit_t *)_params;
+  const child_langmuir_t      * cl     = params->cl;
+  const interpolator_t * RESTRICT fi   = params->fi;
 
-void
-emit_child_langmuir( child_langmuir_t * RESTRICT              cl,
-                     const int        * RESTRICT ALIGNED(128) component,
-                     int                                      n_component ) {
-  /**/  species_t        * RESTRICT              sp  = cl->sp;
-  const interpolator_t   * RESTRICT ALIGNED(128) fi  = cl->ia->i;
-  /**/  field_t          * RESTRICT ALIGNED(128) f   = cl->fa->f;
-  /**/  accumulator_t    * RESTRICT ALIGNED(128) a   = cl->aa->a;
-  /**/  rng_t            * RESTRICT              rng = cl->rng;
-
-  /**/  particle_t       * RESTRICT ALIGNED(128) p   = sp->p;
-  /**/  particle_mover_t * RESTRICT ALIGNED(128) pm  = sp->pm;
-  /**/  grid_t           * RESTRICT              g   = sp->g;
-
-  const int max_np           = sp->max_np;
-  const int max_nm           = sp->max_nm;
   const int np_emit_per_face = cl->n_emit_per_face;
 
-  const float qsp     = sp->q;
-  const float rdx     = g->rdx;
-  const float rdy     = g->rdy;
-  const float rdz     = g->rdz;
-  const float cdt     = g->cvac*g->dt;
-  const float norm    = ( cl->norm*g->eps0*g->dt ) /
-                        ( sqrtf(fabsf(qsp*sp->m))*(float)np_emit_per_face );
-  const float norm_x  = norm*sqrtf(rdx)*g->dy*g->dz;
-  const float norm_y  = norm*sqrtf(rdy)*g->dz*g->dx;
-  const float norm_z  = norm*sqrtf(rdz)*g->dx*g->dy;
+  const float qsp     = cl->sp->q;
+  const float norm_x  = params->norm_x;
+  const float norm_y  = params->norm_y;
+  const float norm_z  = params->norm_z;
   const float ut_para = cl->ut_para;
   const float ut_perp = cl->ut_perp;
-  const float thresh  = fabsf(qsp)*cl->thresh_e_norm;
+  const float thresh  = params->thresh;
+
+  frandn_buf_t nb[1];
 
-  int np = sp->np, np_skipped = 0;
-  int nm = sp->nm, nm_skipped = 0;
+  float w;
+  int c, c1, cc, i, np_emit, np = 0;
 
-  float w, ux, uy, uz;
-  int c, cc, i, np_emit;
+  // Loop over the components of the block
 
-  // Loop over all components of the region
+  c  = first / np_emit_per_face;
+  c1 = c + n / np_emit_per_face;
 
-  for( c=0; c<n_component; c++ ) {
-    cc = component[c];
+  for( ; c<c1; c++ ) {
+    cc = params->component[c];
     i  = EXTRACT_LOCAL_CELL( cc );
+    seek_rng( rng, cl->rp->seed, cl->stream, params->step, cc );
+    nb->n = 0;
 
     // FIXME: COULD PROBABLY ACCELERATE BY GETTING RID OF SWITCH (USE
     // MAXWELLIAN_REFLUX TRICKS?)
@@ -83,37 +94,20 @@ emit_child_langmuir( child_langmuir_t * RESTRICT              cl,
     if( dir qsp*w > thresh ) { /* This face can emit */                 \
       w = norm_##X*sqrtf(fabsf(w*w*w));                                 \
       for( np_emit=np_emit_per_face; np_emit; np_emit-- ) {             \
-                                                                        \
-        /* Emit the particle */                                         \
-                                                                        \
-        if( np>=max_np ) { np_skipped++; continue; }                    \
-        u##X = dir ut_para*sqrtf(2*frande(rng));                        \
-        u##Y = ut_perp*frandn(rng);                                     \
-        u##Z = ut_perp*frandn(rng);                                     \
+        if( !nb->n ) { /* Draw the normals of the face in bulk */       \
+          nb->n = 2*np_emit<FRANDN_BUF ? 2*np_emit : FRANDN_BUF;        \
+          frandn_fill( rng, nb->x, 1, nb->n );                          \
+        }                                                               \
+        p[np].u##X = dir ut_para*sqrtf(2*frande(rng));                  \
+        p[np].u##Y = ut_perp*frandn_buf(rng,nb);                        \
+        p[np].u##Z = ut_perp*frandn_buf(rng,nb);                        \
         p[np].d##X = -(dir 1);                                          \
         p[np].d##Y = 2*frand_c0(rng)-1;                                 \
         p[np].d##Z = 2*frand_c0(rng)-1;                                 \
         p[np].i    = i;                                                 \
-        p[np].u##X = u##X;                                              \
-        p[np].u##Y = u##Y;                                              \
-        p[np].u##Z = u##Z;                                              \
         p[np].w    = w;                                                 \
-        accumulate_rhob( f, p+np, g, -qsp );                            \
+        age[np]    = frand_c0(rng);                                     \
         np++;                                                           \
-                                                                        \
-        /* Age the particle */                                          \
-                                                                        \
-        if( nm>=max_nm ) { nm_skipped++; continue; }                    \
-        w = ( frand_c0(rng)*cdt ) /                                     \
-          sqrtf( ( u##X*u##X + u##Y*u##Y ) + ( u##Z*u##Z + 1 ) );       \
-        DECLARE_ALIGNED_ARRAY( particle_mover_t, 16, local_pm, 1 );     \
-        local_pm->disp##X = w*u##X*rd##X;                               \
-        local_pm->disp##Y = w*u##Y*rd##Y;                               \
-        local_pm->disp##Z = w*u##Z*rd##Z;                               \
-        local_pm->i       = np-1;                                       \
-        if (move_p( p, local_pm, a, g, qsp )) {                         \
-            pm[nm++] = local_pm[0];                                     \
-        }                                                               \
       }                                                                 \
     }
 
@@ -131,13 +125,40 @@ emit_child_langmuir( child_langmuir_t * RESTRICT              cl,
 
   }
 
-  sp->np = np;
-  sp->nm = nm;
+  return np;
+}
+
+void
+emit_child_langmuir( child_langmuir_t * RESTRICT              cl,
+                     const int        * RESTRICT ALIGNED(128) component,
+                     int                                      n_component ) {
+  /**/  species_t * RESTRICT sp = cl->sp;
+  const grid_t    * RESTRICT g  = sp->g;
+
+  const int np_emit_per_face = cl->n_emit_per_face;
+
+  const float norm = ( cl->norm*g->eps0*g->dt ) /
+                     ( sqrtf(fabsf(sp->q*sp->m))*(float)np_emit_per_face );
+
+  child_langmuir_emit_t params[1];
+  int block;
+
+  params->cl        = cl;
+  params->fi        = cl->ia->i;
+  params->component = component;
+  params->step      = g->step;
+  params->norm_x    = norm*sqrtf(g->rdx)*g->dy*g->dz;
+  params->norm_y    = norm*sqrtf(g->rdy)*g->dz*g->dx;
+  params->norm_z    = norm*sqrtf(g->rdz)*g->dx*g->dy;
+  params->thresh    = fabsf(sp->q)*cl->thresh_e_norm;
+
+  block = INJECT_BLOCK / np_emit_per_face;
+  if( block<1 ) block = 1;
+  block *= np_emit_per_face;
 
-  if( np_skipped ) WARNING(( "Insufficient local particle storage.  Did not emit %i "
-                             "particles in emit_child_langmuir", np_skipped ));
-  if( nm_skipped ) WARNING(( "Insufficient local particle mover storage.  Did not age %i "
-                             "emitted particles in emit_child_langmuir", nm_skipped ));
+  inject_p( sp, emit_child_langmuir_block, params,
+            n_component*np_emit_per_face, block,
+            cl->rp, cl->crp, cl->stream, cl->fa, cl->aa );
 }
 
 void
@@ -148,7 +169,8 @@ checkpt_child_langmuir( const emitter_t * e ) {
   CHECKPT_PTR( cl->ia );
   CHECKPT_PTR( cl->fa );
   CHECKPT_PTR( cl->aa );
-  CHECKPT_PTR( cl->rng );
+  CHECKPT_PTR( cl->rp );
+  CHECKPT_PTR( cl->crp );
   checkpt_emitter_internal( e );
 }
 
@@ -160,13 +182,16 @@ restore_child_langmuir( void ) {
   RESTORE_PTR( cl->ia );
   RESTORE_PTR( cl->fa );
   RESTORE_PTR( cl->aa );
-  RESTORE_PTR( cl->rng );
+  RESTORE_PTR( cl->rp );
+  RESTORE_PTR( cl->crp );
   return restore_emitter_internal( cl );
 }
 
 void
 delete_child_langmuir( emitter_t * e ) {
-  FREE( e->params );
+  child_langmuir_t * cl = (child_langmuir_t *)e->params;
+  delete_rng_pool( cl->crp );
+  FREE( cl );
   delete_emitter_internal( e );
 }
 
@@ -195,7 +220,9 @@ child_langmuir( /**/  species_t            * RESTRICT sp,
   cl->ia              = ia;
   cl->fa              = fa;
   cl->aa              = aa;
-  cl->rng             = rp->rng[0];
+  cl->rp              = rp;
+  cl->crp             = new_rng_pool( N_PIPELINE, 0, 0 );
+  cl->stream          = rng_pool_stream( rp );
   cl->n_emit_per_face = n_emit_per_face;
   cl->ut_para         = ut_para;
   cl->ut_perp         = ut_perp;
@@ -178,7 +178,7 @@ restore_standard_field_array( void ) {
   field_array_t * fa; 
   sfa_params_t * p;
   RESTORE( fa );
-  RESTORE_ALIGNED( fa->f );
+  RESTORE_ARENA( fa->f, "field" );
   RESTORE_PTR( fa->g );
   RESTORE( p );
   RESTORE_ALIGNED( p->mc );
@@ -194,7 +194,7 @@ new_standard_field_array( grid_t           * RESTRICT g,
   field_array_t * fa;
   if( !g || !m_list || damp<0 ) ERROR(( "Bad args" ));
   MALLOC( fa, 1 );
-  MALLOC_ALIGNED( fa->f, g->nv, 128 );
+  MALLOC_ARENA( fa->f, g->nv, 128, "field" );
   CLEAR( fa->f, g->nv );
   fa->g = g;
   fa->params = create_sfa_params( g, m_list, damp );
@@ -26,7 +26,7 @@ restore_grid( void ) {
   grid_t * g;
   RESTORE( g );
   if( g->range    ) RESTORE_ALIGNED( g->range );
-  if( g->neighbor ) RESTORE_ALIGNED( g->neighbor );
+  if( g->neighbor ) RESTORE_ARENA( g->neighbor, "grid" );
   RESTORE_PTR( g->mp );
   return g;
 }
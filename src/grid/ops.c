@@ -53,7 +53,7 @@ size_grid( grid_t * g,
   g->rangeh = g->range[world_rank+1]-1;
 
   FREE_ALIGNED( g->neighbor );
-  MALLOC_ALIGNED( g->neighbor, 6*g->nv, 128 );
+  MALLOC_ARENA( g->neighbor, 6*g->nv, 128, "grid" );
 
   for( z=0; z<=lnz+1; z++ )
     for( y=0; y<=lny+1; y++ )
@@ -39,9 +39,9 @@ accumulator_array_t *
 restore_accumulator_array( void ) {
   accumulator_array_t * aa;
   RESTORE( aa );
-  RESTORE_ALIGNED( aa->a );
+  RESTORE_ARENA( aa->a, "accumulator" );
   RESTORE_PTR( aa->g );
-  if( aa->n_pipeline!=aa_n_pipeline() )
+  if( aa->n_pipeline!=aa_n_pipeline() && !restoring_detached() )
     ERROR(( "Number of accumulators restored is not the same as the number of "
             "accumulators checkpointed.  Did you change the number of threads "
             "per process between checkpt and restore?" ));
@@ -56,7 +56,8 @@ new_accumulator_array( grid_t * g ) {
   aa->n_pipeline = aa_n_pipeline();
   aa->stride     = POW2_CEIL(g->nv,2);
   aa->g          = g;
-  MALLOC_ALIGNED( aa->a, (size_t)(aa->n_pipeline+1)*(size_t)aa->stride, 128 );
+  MALLOC_ARENA( aa->a, (size_t)(aa->n_pipeline+1)*(size_t)aa->stride, 128,
+                "accumulator" );
   CLEAR( aa->a, (size_t)(aa->n_pipeline+1)*(size_t)aa->stride );
   REGISTER_OBJECT( aa, checkpt_accumulator_array, restore_accumulator_array,
                   NULL );
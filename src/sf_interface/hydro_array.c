@@ -24,7 +24,7 @@ hydro_array_t *
 restore_hydro_array( void ) {
   hydro_array_t * ha;
   RESTORE( ha );
-  RESTORE_ALIGNED( ha->h );
+  RESTORE_ARENA( ha->h, "hydro" );
   RESTORE_PTR( ha->g );
   return ha;
 }
@@ -34,7 +34,7 @@ new_hydro_array( grid_t * g ) {
   hydro_array_t * ha;
   if( !g ) ERROR(( "NULL grid" ));
   MALLOC( ha, 1 );
-  MALLOC_ALIGNED( ha->h, g->nv, 128 );
+  MALLOC_ARENA( ha->h, g->nv, 128, "hydro" );
   ha->g = g;
   clear_hydro_array( ha );
   REGISTER_OBJECT( ha, checkpt_hydro_array, restore_hydro_array, NULL );
@@ -15,7 +15,7 @@ restore_interpolator_array( void )
 {
   interpolator_array_t * ia;
   RESTORE( ia );
-  RESTORE_ALIGNED( ia->i );
+  RESTORE_ARENA( ia->i, "interpolator" );
   RESTORE_PTR( ia->g );
   return ia;
 }
@@ -26,7 +26,7 @@ new_interpolator_array( grid_t * g )
   interpolator_array_t * ia;
   if( !g ) ERROR(( "NULL grid" ));
   MALLOC( ia, 1 );
-  MALLOC_ALIGNED( ia->i, g->nv, 128 );
+  MALLOC_ARENA( ia->i, g->nv, 128, "interpolator" );
   CLEAR( ia->i, g->nv );
   ia->g = g;
   REGISTER_OBJECT( ia, checkpt_interpolator_array, restore_interpolator_array,
@@ -23,6 +23,10 @@ checkpt_species( const species_t * sp ) {
                 sp->nm    *sizeof(particle_mover_t),
                 sp->max_nm*sizeof(particle_mover_t), 1, 1, 128 );
   CHECKPT_ALIGNED( sp->partition, sp->g->nv+1, 128 );
+  if( sp->tag )
+    checkpt_data( sp->tag,
+                  sp->np    *sizeof(int64_t),
+                  sp->max_np*sizeof(int64_t), 1, 1, 128 );
   CHECKPT_PTR( sp->g );
   CHECKPT_PTR( sp->next );
 }
@@ -32,9 +36,12 @@ restore_species( void ) {
   species_t * sp;
   RESTORE( sp );
   RESTORE_STR( sp->name );
-  sp->p  = (particle_t *)      restore_data();
-  sp->pm = (particle_mover_t *)restore_data();
+  sp->p  = (particle_t *)      restore_data_arena( "particle" );
+  sp->pm = (particle_mover_t *)restore_data_arena( "mover" );
   RESTORE_ALIGNED( sp->partition );
+  sp->mover_block     = NULL;
+  sp->max_mover_block = 0;
+  if( sp->tag ) sp->tag = (int64_t *)restore_data_arena( "particle" );
   RESTORE_PTR( sp->g );
   RESTORE_PTR( sp->next );
   return sp;
@@ -43,6 +50,8 @@ restore_species( void ) {
 void
 delete_species( species_t * sp ) {
   UNREGISTER_OBJECT( sp );
+  FREE_ALIGNED( sp->tag );
+  FREE_ALIGNED( sp->mover_block );
   FREE_ALIGNED( sp->partition );
   FREE_ALIGNED( sp->pm );
   FREE_ALIGNED( sp->p );
@@ -126,10 +135,10 @@ species( const char * name,
   sp->q = q;
   sp->m = m;
 
-  MALLOC_ALIGNED( sp->p, max_local_np, 128 );
+  MALLOC_ARENA( sp->p, max_local_np, 128, "particle" );
   sp->max_np = max_local_np;
 
-  MALLOC_ALIGNED( sp->pm, max_local_nm, 128 );
+  MALLOC_ARENA( sp->pm, max_local_nm, 128, "mover" );
   sp->max_nm = max_local_nm;
 
   sp->last_sorted       = INT64_MIN;
@@ -144,3 +153,13 @@ species( const char * name,
   REGISTER_OBJECT( sp, checkpt_species, restore_species, NULL );
   return sp;
 }
+
+void
+tag_species( species_t * sp ) {
+  int n;
+  if( !sp ) ERROR(( "Bad args" ));
+  if( sp->tag ) return;
+  MALLOC_ARENA( sp->tag, sp->max_np, 128, "particle" );
+  sp->next_tag = ((int64_t)world_rank) << 40;
+  for( n=0; n<sp->np; n++ ) sp->tag[n] = sp->next_tag++;
+}
@@ -56,17 +56,50 @@ species( const char * name,
          int sort_out_of_place,
          grid_t * g );
 
+// Turn on particle tagging for the species.  Tags are 64-bit ids
+// unique across ranks (the rank is in the upper bits).  Any particles
+// already in the species are tagged.  Species that are not tagged pay
+// nothing for the tagging support.
+
+void
+tag_species( species_t * sp );
+
 // FIXME: TEMPORARY HACK UNTIL THIS SPECIES_ADVANCE KERNELS
 // CAN BE CONSTRUCTED ANALOGOUS TO THE FIELD_ADVANCE KERNELS
 // (THESE FUNCTIONS ARE NECESSARY FOR HIGHER LEVEL CODE)
 
 // In sort_p.c
 
+// A sort_voxel_func_t is called by sort_p_fused on each range of
+// voxels [v0,v1) of the species as soon as the particles in it are
+// sorted and sp->partition[v0:v1] is final.  Ranges are handed out
+// from all the pipelines at once (pipeline_rank, on 0:N_PIPELINE-1,
+// is the caller) so the function must only modify the particles in
+// its own range.
+
+typedef void
+(*sort_voxel_func_t)( void * params,
+                      int v0,
+                      int v1,
+                      int pipeline_rank );
+
 void
 sort_p( species_t * RESTRICT sp );
 
+// Sort the species as sort_p does and apply op to the particles of
+// each voxel range while they are still in cache.  This saves a
+// separate pass over the particles for operations that need them
+// freshly sorted (e.g. binary collisions).
+
+void
+sort_p_fused( species_t * RESTRICT sp,
+              sort_voxel_func_t op,
+              void * params );
+
 void
-sort_p_pipeline( species_t * sp );
+sort_p_pipeline( species_t * sp,
+                 sort_voxel_func_t op,
+                 void * params );
 
 // In advance_p.cxx
 
@@ -109,6 +142,116 @@ void
 uncenter_p_pipeline( species_t * RESTRICT sp,
                      const interpolator_array_t * RESTRICT ia );
 
+// In select_p.cc
+
+// This centers the np particles of sp (as center_p does) and compacts
+// the ones accepted by sel to the front of the particle array,
+// preserving their order.  The number of particles kept is returned.
+// The remaining particles are left in an undefined state; this is
+// meant to be used on a scratch copy of the particles (see
+// dump_particles).  index0 is the index of the first particle in the
+// full particle list (sp->tag+index0 are the tags of the particles for
+// tagged species) and is used to key the random sample of untagged
+// species.  If tag_out is not NULL, the tags of the kept particles
+// are stored there (tagged species only).
+
+int
+select_p( species_t * RESTRICT sp,
+          const interpolator_array_t * RESTRICT ia,
+          const particle_select_t * RESTRICT sel,
+          int64_t index0,
+          int64_t * RESTRICT tag_out );
+
+int
+select_p_pipeline( species_t * RESTRICT sp,
+                   const interpolator_array_t * RESTRICT ia,
+                   const particle_select_t * RESTRICT sel,
+                   int64_t index0,
+                   int64_t * RESTRICT tag_out );
+
+// In inject_p.cc
+
+// Bulk particle injection.  The n slots of an injection are split into
+// blocks of block slots which the pipelines fill in parallel.  For the
+// block starting at slot first, gen( params, first, nb, p, age, rng )
+// makes the particles of slots [first,first+nb): it writes k<=nb
+// particles (in the cell coordinates of the particle array, see
+// locate_p) into p[0:k-1] and their ages (in timesteps, as for
+// inject_particle) into age[0:k-1] and returns k.  gen is called from
+// several pipelines at once and must only write its outputs.  Before
+// each block, rng is sought to the counter-based substream of rp->seed
+// given by stream, the timestep and the block index, so the particles
+// made do not depend on the number of pipelines (rng is NULL if rp is
+// NULL).  rng is a generator of crp, which the caller keeps between
+// injections and which must hold at least N_PIPELINE generators.  gen
+// may seek rng itself (e.g. to key substreams on something other than
+// the block).
+//
+// The particles are appended to sp in slot order and tagged if sp is
+// tagged.  If fa is not NULL, the negative of their charge is added to
+// rhob (as inject_particle does).  Particles of non-zero age are moved
+// with move_p, depositing their current in the pipeline accumulators
+// of aa, and the movers of those that end up on a boundary are
+// appended to sp->pm (which grows if needed).  Slots past the particle
+// storage of sp are not made.  Returns the number of particles
+// injected.
+
+#define INJECT_BLOCK 256
+
+typedef int
+(*particle_generator_func_t)( void * params,
+                              int first,
+                              int n,
+                              particle_t * RESTRICT ALIGNED(32) p,
+                              float * RESTRICT age,
+                              rng_t * RESTRICT rng );
+
+int
+inject_p( species_t * RESTRICT sp,
+          particle_generator_func_t gen,
+          void * params,
+          int n,
+          int block,
+          rng_pool_t * RESTRICT rp,
+          rng_pool_t * RESTRICT crp,
+          int stream,
+          field_array_t * RESTRICT fa,
+          accumulator_array_t * RESTRICT aa );
+
+int
+inject_p_pipeline( species_t * RESTRICT sp,
+                   particle_generator_func_t gen,
+                   void * params,
+                   int n,
+                   int block,
+                   rng_pool_t * RESTRICT rp,
+                   rng_pool_t * RESTRICT crp,
+                   int stream,
+                   field_array_t * RESTRICT fa,
+                   accumulator_array_t * RESTRICT aa );
+
+// Inject the n particles of pl (in global coordinates) with inject_p.
+// Particles outside the local domain are skipped.
+
+int
+inject_p_load( species_t * RESTRICT sp,
+               const particle_load_t * RESTRICT pl,
+               int n,
+               field_array_t * RESTRICT fa,
+               accumulator_array_t * RESTRICT aa );
+
+// Convert the global position (x,y,z) into the cell coordinates and
+// voxel index of p.  Returns 0, leaving p alone, if the position is
+// strictly outside the local domain or on a far wall shared with a
+// neighbor (which injects it instead).
+
+int
+locate_p( const grid_t * RESTRICT g,
+          double x,
+          double y,
+          double z,
+          particle_t * RESTRICT p );
+
 // In energy.cxx
 
 // This computes the kinetic energy stored in the particles.  The
@@ -129,12 +272,25 @@ void
 accumulate_rho_p( field_array_t * RESTRICT fa,
                   const species_t * RESTRICT sp );
 
+void
+accumulate_rho_p_pipeline( field_array_t * RESTRICT fa,
+                           const species_t * RESTRICT sp );
+
 void
 accumulate_rhob( field_t * RESTRICT ALIGNED(128) f,
                  const particle_t * RESTRICT ALIGNED(32)  p,
                  const grid_t * RESTRICT g,
                  const float qsp );
 
+// As accumulate_rhob but into the array r of g->nv floats (e.g. the
+// private rhob array of a pipeline, later added to the field rhob).
+
+void
+accumulate_rhob_array( float * RESTRICT ALIGNED(16) r,
+                       const particle_t * RESTRICT ALIGNED(32) p,
+                       const grid_t * RESTRICT g,
+                       const float qsp );
+
 // In hydro_p.c
 
 void
@@ -142,6 +298,11 @@ accumulate_hydro_p( hydro_array_t * RESTRICT ha,
                     const species_t * RESTRICT sp,
                     const interpolator_array_t * RESTRICT ia );
 
+void
+accumulate_hydro_p_pipeline( hydro_array_t * RESTRICT ha,
+                             const species_t * RESTRICT sp,
+                             const interpolator_array_t * RESTRICT ia );
+
 // In move_p.cxx
 
 int
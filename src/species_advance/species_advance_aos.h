@@ -51,6 +51,35 @@ typedef struct particle_injector {
   species_id sp_id;          // Species of particle
 } particle_injector_t;
 
+// A particle_load_t is a particle to inject in bulk (see inject_p_load).
+
+typedef struct particle_load {
+  double x, y, z;            // Particle position in global coordinates
+  float ux, uy, uz;          // Particle normalized momentum
+  float w;                   // Particle weight (number of physical particles)
+  float age;                 // Age in timesteps (see inject_particle)
+} particle_load_t;
+
+// A particle_select_t describes which particles a filtered diagnostic
+// (e.g. a filtered particle dump) keeps.  Zero initialize and set the
+// fields of interest; the zero value of each field disables that test.
+// A particle is kept if it passes all enabled tests.
+
+typedef struct particle_select {
+  float min_ke;          // Keep if kinetic energy (gamma-1, in units of
+  /**/                   // m c^2) of the centered particle >= min_ke
+  int use_box;           // If non-zero, keep only particles in the box
+  float x0, y0, z0;      // Box low corner (global coordinates)
+  float x1, y1, z1;      // Box high corner (global coordinates)
+  int use_tag;           // If non-zero, keep only particles with tags on
+  int64_t tag0, tag1;    // [tag0,tag1] (tagged species only)
+  float fraction;        // If on (0,1), keep a pseudo-random sample of
+  /**/                   // this fraction of the otherwise kept particles
+  uint32_t seed;         // Seed for the sample (the sample is independent
+  /**/                   // of the thread count and chunking and, for
+  /**/                   // tagged species, is stable from step to step)
+} particle_select_t;
+
 typedef struct species {
   char * name;                        // Species name
   float q;                            // Species particle charge
@@ -61,6 +90,10 @@ typedef struct species {
 
   int nm, max_nm;                     // Number and max local movers in use
   particle_mover_t * ALIGNED(128) pm; // Particle movers
+  int max_mover_block;                // Mover blocks mover_block can hold
+  int * ALIGNED(128) mover_block;     // Bookkeeping of the mover blocks
+  /**/                                // advance_p hands out (see
+  /**/                                // begin_movers).  Not checkpointed.
 
   int64_t last_sorted;                // Step when the particles were last
                                       // sorted.
@@ -88,9 +121,31 @@ typedef struct species {
   /**/                                // Note: SFC NOT IN USE RIGHT NOW THUS
   /**/                                // g->sfc[i]=i ABOVE.
 
+  int64_t * ALIGNED(128) tag;         // Particle tags (NULL if the species
+  /**/                                // is not tagged).  Indexed 0:max_np-1.
+  /**/                                // tag[n] is a globally unique id for
+  /**/                                // p[n] and follows the particle
+  /**/                                // wherever it is moved (sort, boundary
+  /**/                                // exchange, checkpt).  See tag_species.
+  int64_t next_tag;                   // Next tag to assign on this rank
+
   grid_t * g;                         // Underlying grid
   species_id id;                      // Unique identifier for a species
   struct species *next;               // Next species in the list
 } species_t;
 
+// Give particle n of species sp a new tag if the species is tagged.
+// Anything that creates particles should do this.
+
+#define TAG_NEW_PARTICLE( sp, n ) BEGIN_PRIMITIVE {                 \
+    if( (sp)->tag ) (sp)->tag[n] = (sp)->next_tag++;                \
+  } END_PRIMITIVE
+
+// Move the tag of particle src of species sp to particle dst (e.g.
+// when backfilling a hole in the particle list).
+
+#define MOVE_TAG( sp, dst, src ) BEGIN_PRIMITIVE {                  \
+    if( (sp)->tag ) (sp)->tag[dst] = (sp)->tag[src];                \
+  } END_PRIMITIVE
+
 #endif // _species_advance_aos_h_
@@ -0,0 +1,164 @@
+#define IN_spa
+
+#include "../species_advance.h"
+
+//----------------------------------------------------------------------------//
+// Top level function to select and call particle inject function using the
+// desired particle inject abstraction.  Currently, the only abstraction
+// available is the pipeline abstraction.
+//----------------------------------------------------------------------------//
+
+int
+inject_p( species_t * RESTRICT sp,
+          particle_generator_func_t gen,
+          void * params,
+          int n,
+          int block,
+          rng_pool_t * RESTRICT rp,
+          rng_pool_t * RESTRICT crp,
+          int stream,
+          field_array_t * RESTRICT fa,
+          accumulator_array_t * RESTRICT aa )
+{
+  // Once more options are available, this should be conditionally executed
+  // based on user choice.
+  return inject_p_pipeline( sp, gen, params, n, block, rp, crp, stream, fa, aa );
+}
+
+//----------------------------------------------------------------------------//
+// Convert a global position into cell coordinates.  This is the placement
+// inject_particle has always done.
+//----------------------------------------------------------------------------//
+
+int
+locate_p( const grid_t * RESTRICT g,
+          double x,
+          double y,
+          double z,
+          particle_t * RESTRICT p )
+{
+  const double x0 = (double)g->x0, y0 = (double)g->y0, z0 = (double)g->z0;
+  const double x1 = (double)g->x1, y1 = (double)g->y1, z1 = (double)g->z1;
+  const int    nx = g->nx,         ny = g->ny,         nz = g->nz;
+
+  int ix, iy, iz;
+
+  // Do not inject if the particle is strictly outside the local domain
+  // or if a far wall of local domain shared with a neighbor
+  // FIXME: DO THIS THE PHASE-3 WAY WITH GRID->NEIGHBOR
+  // NOT THE PHASE-2 WAY WITH GRID->BC
+
+  if( (x<x0) | (x>x1) | ( (x==x1) & (g->bc[BOUNDARY(1,0,0)]>=0 ) ) ) return 0;
+  if( (y<y0) | (y>y1) | ( (y==y1) & (g->bc[BOUNDARY(0,1,0)]>=0 ) ) ) return 0;
+  if( (z<z0) | (z>z1) | ( (z==z1) & (g->bc[BOUNDARY(0,0,1)]>=0 ) ) ) return 0;
+
+  // Compute the injection cell and coordinate in cell coordinate system
+  // BJA:  Note the use of double precision here for accurate particle
+  //       placement on large meshes.
+
+  // The ifs allow for injection on the far walls of the local computational
+  // domain when necessary
+
+  x  = ((double)nx)*((x-x0)/(x1-x0)); // x is rigorously on [0,nx]
+  ix = (int)x;                        // ix is rigorously on [0,nx]
+  x -= (double)ix;                    // x is rigorously on [0,1)
+  x  = (x+x)-1;                       // x is rigorously on [-1,1)
+  if( ix==nx ) x = 1;                 // On far wall ... conditional move
+  if( ix==nx ) ix = nx-1;             // On far wall ... conditional move
+  ix++;                               // Adjust for mesh indexing
+
+  y  = ((double)ny)*((y-y0)/(y1-y0)); // y is rigorously on [0,ny]
+  iy = (int)y;                        // iy is rigorously on [0,ny]
+  y -= (double)iy;                    // y is rigorously on [0,1)
+  y  = (y+y)-1;                       // y is rigorously on [-1,1)
+  if( iy==ny ) y = 1;                 // On far wall ... conditional move
+  if( iy==ny ) iy = ny-1;             // On far wall ... conditional move
+  iy++;                               // Adjust for mesh indexing
+
+  z  = ((double)nz)*((z-z0)/(z1-z0)); // z is rigorously on [0,nz]
+  iz = (int)z;                        // iz is rigorously on [0,nz]
+  z -= (double)iz;                    // z is rigorously on [0,1)
+  z  = (z+z)-1;                       // z is rigorously on [-1,1)
+  if( iz==nz ) z = 1;                 // On far wall ... conditional move
+  if( iz==nz ) iz = nz-1;             // On far wall ... conditional move
+  iz++;                               // Adjust for mesh indexing
+
+  p->dx = (float)x; // Note: Might be rounded to be on [-1,1]
+  p->dy = (float)y; // Note: Might be rounded to be on [-1,1]
+  p->dz = (float)z; // Note: Might be rounded to be on [-1,1]
+  p->i  = VOXEL(ix,iy,iz, nx,ny,nz);
+
+  return 1;
+}
+
+//----------------------------------------------------------------------------//
+// Inject a list of particles in global coordinates.
+//----------------------------------------------------------------------------//
+
+typedef struct load_p_params {
+  const particle_load_t * pl;
+  const grid_t * g;
+} load_p_params_t;
+
+static int
+load_p( void * _params,
+        int first,
+        int n,
+        particle_t * RESTRICT ALIGNED(32) p,
+        float * RESTRICT age,
+        rng_t * RESTRICT rng )
+{
+  const load_p_params_t * params = (const load_p_params_t *)_params;
+  const particle_load_t * RESTRICT pl = params->pl + first;
+  const grid_t * g = params->g;
+  int k = 0;
+
+  for( ; n; n--, pl++ ) {
+    if( pl->w < 0 ) ERROR(( "inject_p_load: w < 0" ));
+    if( !locate_p( g, pl->x, pl->y, pl->z, p+k ) ) continue;
+    p[k].ux = pl->ux;
+    p[k].uy = pl->uy;
+    p[k].uz = pl->uz;
+    p[k].w  = pl->w;
+    age[k]  = pl->age;
+    k++;
+  }
+
+  return k;
+}
+
+int
+inject_p_load( species_t * RESTRICT sp,
+               const particle_load_t * RESTRICT pl,
+               int n,
+               field_array_t * RESTRICT fa,
+               accumulator_array_t * RESTRICT aa )
+{
+  load_p_params_t params[1];
+  int m, np = 0;
+
+  if( !sp || ( !pl && n ) || n<0 ) ERROR(( "Bad args" ));
+
+  params->g = sp->g;
+
+  // Most of a load can belong to other domains, so the load is injected
+  // in pieces no larger than the free particle storage.  This way a
+  // local particle is only dropped when the storage is really full.
+
+  while( n ) {
+    m = sp->max_np - sp->np;
+    if( !m ) {
+      WARNING(( "Insufficient local particle storage.  Not injecting the "
+                "last %i particles of a load into %s", n, sp->name ));
+      break;
+    }
+    if( m>n ) m = n;
+    params->pl = pl;
+    np += inject_p( sp, load_p, params, m, INJECT_BLOCK, NULL, NULL, 0,
+                    fa, aa );
+    pl += m;
+    n  -= m;
+  }
+
+  return np;
+}
@@ -1,6 +1,3 @@
-// FIXME: PARTICLE MOVERS NEED TO BE OVERALLOCATED IN STRUCTORS TO
-// ACCOUNT FOR SPLITTING THE MOVER ARRAY BETWEEN HOST AND PIPELINES
-
 #define IN_spa
 
 #define HAS_V4_PIPELINE
@@ -28,6 +25,7 @@ advance_p_pipeline_scalar( advance_p_pipeline_args_t * args,
 
   particle_t           * ALIGNED(32)  p;
   particle_mover_t     * ALIGNED(16)  pm;
+  particle_mover_seg_t *              seg;
   const interpolator_t * ALIGNED(16)  f;
   float                * ALIGNED(16)  a;
 
@@ -55,24 +53,12 @@ advance_p_pipeline_scalar( advance_p_pipeline_args_t * args,
 
   p = args->p0 + itmp;
 
-  // Determine which movers are reserved for this pipeline.
-  // Movers (16 bytes) should be reserved for pipelines in at least
-  // multiples of 8 such that the set of particle movers reserved for
-  // a pipeline is 128-byte aligned and a multiple of 128-byte in
-  // size.  The host is guaranteed to get enough movers to process its
-  // particles with this allocation.
-
-  max_nm = args->max_nm - ( args->np&15 );
-
-  if ( max_nm < 0 ) max_nm = 0;
-
-  DISTRIBUTE( max_nm, 8, pipeline_rank, n_pipeline, itmp, max_nm );
-
-  if ( pipeline_rank == n_pipeline ) max_nm = args->max_nm - itmp;
+  // Movers are taken from the shared pool as needed (see next_movers).
 
-  pm   = args->pm + itmp;
-  nm   = 0;
-  itmp = 0;
+  seg    = args->seg + pipeline_rank;
+  pm     = seg->pm;
+  nm     = 0;
+  max_nm = 0;
 
   // Determine which accumulator array to use
   // The host gets the first accumulator array.
@@ -217,23 +203,263 @@ advance_p_pipeline_scalar( advance_p_pipeline_args_t * args,
 
       if ( move_p( p0, local_pm, a0, g, qsp ) ) // Unlikely
       {
-        if ( nm < max_nm )
+        if ( nm == max_nm )                     // Unlikely
         {
-          pm[nm++] = local_pm[0];
+          seg->nm = nm;
+          pm      = next_movers( args, seg );
+          nm      = seg->nm;
+          max_nm  = seg->max_nm;
         }
 
-        else
-        {
-          itmp++;                               // Unlikely
-        }
+        pm[nm++] = local_pm[0];
       }
     }
   }
 
-  args->seg[pipeline_rank].pm        = pm;
-  args->seg[pipeline_rank].max_nm    = max_nm;
-  args->seg[pipeline_rank].nm        = nm;
-  args->seg[pipeline_rank].n_ignored = itmp;
+  seg->nm = nm;
+}
+
+//----------------------------------------------------------------------------//
+// Hand the next block of movers to a pipeline whose movers are full.
+// Blocks are taken in whatever order the pipelines need them; each
+// pipeline chains its blocks through block_next so that its movers can
+// be gathered in order afterwards.  Once the blocks run out, the
+// pipeline's movers go in a private overflow list that doubles as
+// needed.  The list comes straight from the system allocator (which,
+// unlike MALLOC_ALIGNED and its memory accounting, is meant to be
+// called from any thread) and is freed by end_movers.
+//----------------------------------------------------------------------------//
+
+particle_mover_t *
+next_movers( advance_p_pipeline_args_t * args,
+             particle_mover_seg_t * seg )
+{
+  void * pm;
+  int b, n;
+
+  if ( seg->block != -1 )
+  {
+    if ( seg->block >= 0 ) args->block_nm[ seg->block ] = seg->nm;
+
+    b = __sync_fetch_and_add( args->next_block, 1 );
+
+    if ( b < args->n_block )
+    {
+      if ( seg->block >= 0 ) args->block_next[ seg->block ] = b;
+      else                   seg->first                     = b;
+
+      args->block_next[b] = -1;
+
+      n = args->max_nm - b*MOVER_BLOCK;
+
+      seg->pm     = args->pm + b*MOVER_BLOCK;
+      seg->max_nm = n < MOVER_BLOCK ? n : MOVER_BLOCK;
+      seg->nm     = 0;
+      seg->block  = b;
+
+      return seg->pm;
+    }
+
+    // Out of blocks.  Start an overflow list.
+
+    seg->pm     = NULL;
+    seg->max_nm = 0;
+    seg->nm     = 0;
+    seg->block  = -1;
+  }
+
+  n = seg->max_nm ? 2*seg->max_nm : 4*MOVER_BLOCK;
+
+  if ( posix_memalign( &pm, 128, (size_t) n * sizeof(particle_mover_t) ) )
+  {
+    ERROR( ( "Unable to allocate %i overflow movers", n ) );
+  }
+
+  if ( seg->nm ) COPY( (particle_mover_t *) pm, seg->pm, seg->nm );
+  free( seg->pm );
+
+  seg->pm     = (particle_mover_t *) pm;
+  seg->max_nm = n;
+
+  return seg->pm;
+}
+
+//----------------------------------------------------------------------------//
+// Set up the mover blocks of args (args->pm, args->max_nm and
+// args->next_block must be set) and the pipelines' segments before the
+// pipelines run.  The bookkeeping of the blocks is kept with the
+// species (it only grows with sp->max_nm) and freed with it.
+//----------------------------------------------------------------------------//
+
+void
+begin_movers( species_t * sp,
+              advance_p_pipeline_args_t * args )
+{
+  int rank;
+
+  args->n_block = ( args->max_nm + MOVER_BLOCK - 1 ) / MOVER_BLOCK;
+
+  if ( sp->max_mover_block < args->n_block )
+  {
+    FREE_ALIGNED( sp->mover_block );
+
+    sp->max_mover_block = args->n_block + args->n_block/4 + 16;
+
+    MALLOC_ALIGNED( sp->mover_block, 3*sp->max_mover_block, 128 );
+  }
+
+  args->block_nm      = sp->mover_block;
+  args->block_next    = sp->mover_block + sp->max_mover_block;
+  args->next_block[0] = 0;
+
+  for( rank = 0; rank <= N_PIPELINE; rank++ )
+  {
+    args->seg[rank].pm     = NULL;
+    args->seg[rank].max_nm = 0;
+    args->seg[rank].nm     = 0;
+    args->seg[rank].block  = -2;
+    args->seg[rank].first  = -1;
+  }
+}
+
+//----------------------------------------------------------------------------//
+// After the pipelines are done, gather the movers of each pipeline, in
+// pipeline order, at the start of the species mover array.  Unless a
+// pipeline overflowed, the blocks handed out are exactly the first
+// ones of the mover array, so they are permuted in place into pipeline
+// order (following the cycles of the permutation through a one block
+// buffer) and then compacted.  Otherwise, the movers are gathered
+// through a scratch array and the mover array grows if needed.
+//----------------------------------------------------------------------------//
+
+void
+end_movers( species_t * sp,
+            advance_p_pipeline_args_t * args )
+{
+  DECLARE_ALIGNED_ARRAY( particle_mover_t, 128, buf, MOVER_BLOCK );
+  particle_mover_seg_t * seg = args->seg;
+  int * RESTRICT src = sp->mover_block + 2*sp->max_mover_block;
+  particle_mover_t * pm, * tmp;
+  int rank, b, j, k, n, nm, n_used, scratch;
+
+  // src[j] is the block that goes to slot j in pipeline order
+
+  n        = 0;
+  n_used   = 0;
+  scratch  = 0;
+
+  for( rank = 0; rank <= N_PIPELINE; rank++ )
+  {
+    if ( seg[rank].block >= 0 ) args->block_nm[ seg[rank].block ] = seg[rank].nm;
+
+    for( b = seg[rank].first; b >= 0; b = args->block_next[b] )
+    {
+      n += args->block_nm[b];
+
+      src[ n_used++ ] = b;
+    }
+
+    if ( seg[rank].block == -1 )
+    {
+      n       += seg[rank].nm;
+      scratch = 1;
+    }
+  }
+
+  // Only the last block of the mover array can be short.  If the block
+  // that goes there does not fit, take the scratch path.
+
+  if ( !scratch && n_used > 0 &&
+       args->block_nm[ src[n_used-1] ] > sp->max_nm - (n_used-1)*MOVER_BLOCK )
+  {
+    scratch = 1;
+  }
+
+  if ( !scratch )
+  {
+    // The chains are no longer needed; keep the mover count of each
+    // slot after the permutation in block_next.
+
+    for( j = 0; j < n_used; j++ ) args->block_next[j] = args->block_nm[ src[j] ];
+
+    pm = sp->pm;
+
+    for( j = 0; j < n_used; j++ )
+    {
+      if ( src[j] == j ) continue;
+
+      COPY( buf, pm + j*MOVER_BLOCK, args->block_nm[j] );
+
+      for( k = j; src[k] != j; k = b )
+      {
+        b = src[k];
+
+        COPY( pm + k*MOVER_BLOCK, pm + b*MOVER_BLOCK, args->block_nm[b] );
+
+        src[k] = k;
+      }
+
+      COPY( pm + k*MOVER_BLOCK, buf, args->block_nm[j] );
+
+      src[k] = k;
+    }
+
+    nm = 0;
+
+    for( j = 0; j < n_used; j++ )
+    {
+      if ( nm != j*MOVER_BLOCK )
+      {
+        MOVE( pm + nm, pm + j*MOVER_BLOCK, args->block_next[j] );
+      }
+
+      nm += args->block_next[j];
+    }
+  }
+
+  else
+  {
+    MALLOC_ALIGNED( tmp, n, 128 );
+
+    nm = 0;
+
+    for( rank = 0; rank <= N_PIPELINE; rank++ )
+    {
+      for( b = seg[rank].first; b >= 0; b = args->block_next[b] )
+      {
+        COPY( tmp + nm, sp->pm + b*MOVER_BLOCK, args->block_nm[b] );
+
+        nm += args->block_nm[b];
+      }
+
+      if ( seg[rank].block == -1 )
+      {
+        COPY( tmp + nm, seg[rank].pm, seg[rank].nm );
+
+        nm += seg[rank].nm;
+
+        free( seg[rank].pm );
+      }
+    }
+
+    if ( n > sp->max_nm )
+    {
+      nm = n + n/4;
+
+      WARNING( ( "Resizing local %s mover storage from %i to %i",
+                 sp->name, sp->max_nm, nm ) );
+
+      REALLOC_ARENA( sp->pm, 0, nm, 128, "mover" );
+
+      sp->max_nm = nm;
+    }
+
+    COPY( sp->pm, tmp, n );
+
+    FREE_ALIGNED( tmp );
+  }
+
+  sp->nm = n;
 }
 
 //----------------------------------------------------------------------------//
@@ -250,7 +476,7 @@ advance_p_pipeline( species_t * RESTRICT sp,
 
   DECLARE_ALIGNED_ARRAY( particle_mover_seg_t, 128, seg, MAX_PIPELINE + 1 );
 
-  int rank;
+  DECLARE_ALIGNED_ARRAY( int, 128, next_block, 1 );
 
   if ( !sp || !aa || !ia || sp->g != aa->g || sp->g != ia->g )
   {
@@ -263,6 +489,7 @@ advance_p_pipeline( species_t * RESTRICT sp,
   args->f0      = ia->i;
   args->seg     = seg;
   args->g       = sp->g;
+  args->next_block = next_block;
 
   args->qdt_2mc = (sp->q*sp->g->dt)/(2*sp->m*sp->g->cvac);
   args->cdt_dx  = sp->g->cvac*sp->g->dt*sp->g->rdx;
@@ -287,28 +514,11 @@ advance_p_pipeline( species_t * RESTRICT sp,
   // However, it is worth reconsidering this at some point in the
   // future.
 
+  begin_movers( sp, args );
+
   EXEC_PIPELINES( advance_p, args, 0 );
 
   WAIT_PIPELINES();
 
-  // FIXME: HIDEOUS HACK UNTIL BETTER PARTICLE MOVER SEMANTICS
-  // INSTALLED FOR DEALING WITH PIPELINES.  COMPACT THE PARTICLE
-  // MOVERS TO ELIMINATE HOLES FROM THE PIPELINING.
-
-  sp->nm = 0;
-  for( rank = 0; rank <= N_PIPELINE; rank++ )
-  {
-    if ( args->seg[rank].n_ignored )
-    {
-      WARNING( ( "Pipeline %i ran out of storage for %i movers",
-                 rank, args->seg[rank].n_ignored ) );
-    }
-
-    if ( sp->pm + sp->nm != args->seg[rank].pm )
-    {
-      MOVE( sp->pm + sp->nm, args->seg[rank].pm, args->seg[rank].nm );
-    }
-
-    sp->nm += args->seg[rank].nm;
-  }
+  end_movers( sp, args );
 }
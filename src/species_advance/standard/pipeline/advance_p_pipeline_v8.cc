@@ -18,6 +18,7 @@ advance_p_pipeline_v8( advance_p_pipeline_args_t * args,
 
   particle_t           * ALIGNED(128) p;
   particle_mover_t     * ALIGNED(16)  pm;
+  particle_mover_seg_t *              seg;
 
   float                * ALIGNED(32)  vp00;
   float                * ALIGNED(32)  vp01;
@@ -58,24 +59,12 @@ advance_p_pipeline_v8( advance_p_pipeline_args_t * args,
 
   nq >>= 3;
 
-  // Determine which movers are reserved for this pipeline.
-  // Movers (16 bytes) should be reserved for pipelines in at least
-  // multiples of 8 such that the set of particle movers reserved for
-  // a pipeline is 128-byte aligned and a multiple of 128-byte in
-  // size.  The host is guaranteed to get enough movers to process its
-  // particles with this allocation.
+  // Movers are taken from the shared pool as needed (see next_movers).
 
-  max_nm = args->max_nm - ( args->np&15 );
-
-  if ( max_nm < 0 ) max_nm = 0;
-
-  DISTRIBUTE( max_nm, 8, pipeline_rank, n_pipeline, itmp, max_nm );
-
-  if ( pipeline_rank == n_pipeline ) max_nm = args->max_nm - itmp;
-
-  pm   = args->pm + itmp;
-  nm   = 0;
-  itmp = 0;
+  seg    = args->seg + pipeline_rank;
+  pm     = seg->pm;
+  nm     = 0;
+  max_nm = 0;
 
   // Determine which accumulator array to use.
   // The host gets the first accumulator array.
@@ -352,14 +341,14 @@ advance_p_pipeline_v8( advance_p_pipeline_args_t * args,
       local_pm->i     = ( p - p0 ) + N;                                 \
       if ( move_p( p0, local_pm, a0, g, _qsp ) )    /* Unlikely */      \
       {                                                                 \
-        if ( nm < max_nm )                                              \
-        {                                                               \
-          v4::copy_4x1( &pm[nm++], local_pm );                          \
-        }                                                               \
-        else                                        /* Unlikely */      \
+        if ( nm == max_nm )                         /* Unlikely */      \
         {                                                               \
-          itmp++;                                                       \
+          seg->nm = nm;                                                 \
+          pm      = next_movers( args, seg );                           \
+          nm      = seg->nm;                                            \
+          max_nm  = seg->max_nm;                                        \
         }                                                               \
+        v4::copy_4x1( &pm[nm++], local_pm );                            \
       }                                                                 \
     }
 
@@ -375,10 +364,7 @@ advance_p_pipeline_v8( advance_p_pipeline_args_t * args,
 #   undef MOVE_OUTBND
   }
 
-  args->seg[pipeline_rank].pm        = pm;
-  args->seg[pipeline_rank].max_nm    = max_nm;
-  args->seg[pipeline_rank].nm        = nm;
-  args->seg[pipeline_rank].n_ignored = itmp;
+  seg->nm = nm;
 }
 
 #else
@@ -0,0 +1,289 @@
+#define IN_spa
+
+#define HAS_V4_PIPELINE
+#define HAS_V8_PIPELINE
+
+#include "spa_private.h"
+
+#include "../../../util/pipelines/pipelines_exec.h"
+
+//----------------------------------------------------------------------------//
+// Reference implementation for an accumulate_hydro_p pipeline function which
+// does not make use of explicit calls to vector intrinsic functions.  Each
+// pipeline clears and accumulates into its own hydro array.  The host does
+// the final incomplete block of particles directly into the caller's hydro
+// array.
+//----------------------------------------------------------------------------//
+
+void
+accumulate_hydro_p_pipeline_scalar( accumulate_hydro_p_pipeline_args_t * args,
+                                    int pipeline_rank,
+                                    int n_pipeline )
+{
+  const interpolator_t * ALIGNED(128) f0 = args->f0;
+
+  const particle_t     * ALIGNED(32)  p;
+
+  const interpolator_t * ALIGNED(16)  f;
+
+  hydro_t              * ALIGNED(128) h;
+
+  const float qsp      = args->qsp;
+  const float mspc     = args->mspc;
+  const float qdt_2mc  = args->qdt_2mc;
+  const float qdt_4mc2 = args->qdt_4mc2;
+  const float r8V      = args->r8V;
+  const float c        = args->cvac;
+
+  const int   s10      = args->s10;
+  const int   s21      = args->s21;
+  const int   s43      = args->s43;
+
+  float dx, dy, dz, ux, uy, uz, w, vx, vy, vz, ke_mc;
+  float w0, w1, w2, w3, w4, w5, w6, w7, t;
+  int   i;
+
+  int first, n;
+
+  // Determine which particles this pipeline processes and which hydro
+  // array it accumulates into.
+
+  DISTRIBUTE( args->np, 16, pipeline_rank, n_pipeline, first, n );
+
+  if ( pipeline_rank == n_pipeline )
+  {
+    h = args->h0;
+  }
+
+  else
+  {
+    h = args->h + (size_t) pipeline_rank * (size_t) args->stride;
+
+    CLEAR( h, args->nv );
+  }
+
+  p = args->p0 + first;
+
+  // Process particles for this pipeline.
+
+  for( ; n; n--, p++ )
+  {
+    dx = p->dx;                              // Load position
+    dy = p->dy;
+    dz = p->dz;
+    i  = p->i;
+    ux = p->ux;                              // Load momentum
+    uy = p->uy;
+    uz = p->uz;
+    w  = p->w;
+
+    f  = f0 + i;
+
+    // Half advance E
+    ux += qdt_2mc*((f->ex+dy*f->dexdy) + dz*(f->dexdz+dy*f->d2exdydz));
+    uy += qdt_2mc*((f->ey+dz*f->deydz) + dx*(f->deydx+dz*f->d2eydzdx));
+    uz += qdt_2mc*((f->ez+dx*f->dezdx) + dy*(f->dezdy+dx*f->d2ezdxdy));
+
+    // Boris rotation - Interpolate B field
+    w5 = f->cbx + dx*f->dcbxdx;
+    w6 = f->cby + dy*f->dcbydy;
+    w7 = f->cbz + dz*f->dcbzdz;
+
+    // Boris rotation - curl scalars (0.5 in v0 for half rotate) and
+    // kinetic energy computation. Note: gamma-1 = |u|^2 / (gamma+1)
+    // is the numerically accurate way to compute gamma-1
+    ke_mc = ux*ux + uy*uy + uz*uz; // ke_mc = |u|^2 (invariant)
+    vz = sqrt(1+ke_mc);            // vz = gamma    (invariant)
+    ke_mc *= c/(vz+1);             // ke_mc = c|u|^2/(gamma+1) = c*(gamma-1)
+    vz = c/vz;                     // vz = c/gamma
+    w0 = qdt_4mc2*vz;
+    w1 = w5*w5 + w6*w6 + w7*w7;    // |cB|^2
+    w2 = w0*w0*w1;
+    w3 = w0*(1+(1./3.)*w2*(1+0.4*w2));
+    w4 = w3/(1 + w1*w3*w3); w4 += w4;
+
+    // Boris rotation - uprime
+    w0 = ux + w3*( uy*w7 - uz*w6 );
+    w1 = uy + w3*( uz*w5 - ux*w7 );
+    w2 = uz + w3*( ux*w6 - uy*w5 );
+
+    // Boris rotation - u
+    ux += w4*( w1*w7 - w2*w6 );
+    uy += w4*( w2*w5 - w0*w7 );
+    uz += w4*( w0*w6 - w1*w5 );
+
+    // Compute physical velocities
+    vx  = ux*vz;
+    vy  = uy*vz;
+    vz *= uz;
+
+    // Compute the trilinear coefficients
+    w0  = r8V*w;    // w0 = (1/8)(w/V)
+    dx *= w0;       // dx = (1/8)(w/V) x
+    w1  = w0+dx;    // w1 = (1/8)(w/V) + (1/8)(w/V)x = (1/8)(w/V)(1+x)
+    w0 -= dx;       // w0 = (1/8)(w/V) - (1/8)(w/V)x = (1/8)(w/V)(1-x)
+    w3  = 1+dy;     // w3 = 1+y
+    w2  = w0*w3;    // w2 = (1/8)(w/V)(1-x)(1+y)
+    w3 *= w1;       // w3 = (1/8)(w/V)(1+x)(1+y)
+    dy  = 1-dy;     // dy = 1-y
+    w0 *= dy;       // w0 = (1/8)(w/V)(1-x)(1-y)
+    w1 *= dy;       // w1 = (1/8)(w/V)(1+x)(1-y)
+    w7  = 1+dz;     // w7 = 1+z
+    w4  = w0*w7;    // w4 = (1/8)(w/V)(1-x)(1-y)(1+z) = (w/V) trilin_0 *Done
+    w5  = w1*w7;    // w5 = (1/8)(w/V)(1+x)(1-y)(1+z) = (w/V) trilin_1 *Done
+    w6  = w2*w7;    // w6 = (1/8)(w/V)(1-x)(1+y)(1+z) = (w/V) trilin_2 *Done
+    w7 *= w3;       // w7 = (1/8)(w/V)(1+x)(1+y)(1+z) = (w/V) trilin_3 *Done
+    dz  = 1-dz;     // dz = 1-z
+    w0 *= dz;       // w0 = (1/8)(w/V)(1-x)(1-y)(1-z) = (w/V) trilin_4 *Done
+    w1 *= dz;       // w1 = (1/8)(w/V)(1+x)(1-y)(1-z) = (w/V) trilin_5 *Done
+    w2 *= dz;       // w2 = (1/8)(w/V)(1-x)(1+y)(1-z) = (w/V) trilin_6 *Done
+    w3 *= dz;       // w3 = (1/8)(w/V)(1+x)(1+y)(1-z) = (w/V) trilin_7 *Done
+
+    // Accumulate the hydro fields
+#   define ACCUM_HYDRO( wn)                             \
+    t  = qsp*wn;        /* t  = (qsp w/V) trilin_n */   \
+    h[i].jx  += t*vx;                                   \
+    h[i].jy  += t*vy;                                   \
+    h[i].jz  += t*vz;                                   \
+    h[i].rho += t;                                      \
+    t  = mspc*wn;       /* t = (msp c w/V) trilin_n */  \
+    dx = t*ux;          /* dx = (px w/V) trilin_n */    \
+    dy = t*uy;                                          \
+    dz = t*uz;                                          \
+    h[i].px  += dx;                                     \
+    h[i].py  += dy;                                     \
+    h[i].pz  += dz;                                     \
+    h[i].ke  += t*ke_mc;                                \
+    h[i].txx += dx*vx;                                  \
+    h[i].tyy += dy*vy;                                  \
+    h[i].tzz += dz*vz;                                  \
+    h[i].tyz += dy*vz;                                  \
+    h[i].tzx += dz*vx;                                  \
+    h[i].txy += dx*vy
+
+    /**/      ACCUM_HYDRO(w0); // Cell i,j,k
+    i += s10; ACCUM_HYDRO(w1); // Cell i+1,j,k
+    i += s21; ACCUM_HYDRO(w2); // Cell i,j+1,k
+    i += s10; ACCUM_HYDRO(w3); // Cell i+1,j+1,k
+    i += s43; ACCUM_HYDRO(w4); // Cell i,j,k+1
+    i += s10; ACCUM_HYDRO(w5); // Cell i+1,j,k+1
+    i += s21; ACCUM_HYDRO(w6); // Cell i,j+1,k+1
+    i += s10; ACCUM_HYDRO(w7); // Cell i+1,j+1,k+1
+
+#   undef ACCUM_HYDRO
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Reduce the pipeline hydro arrays into the caller's hydro array.  The
+// voxels are distributed over the pipelines so the reduction is done in
+// parallel; the pipeline arrays are summed in a fixed order so that the
+// result does not depend on which pipeline reduces which voxels.
+//----------------------------------------------------------------------------//
+
+void
+reduce_hydro_p_pipeline_scalar( accumulate_hydro_p_pipeline_args_t * args,
+                                int pipeline_rank,
+                                int n_pipeline )
+{
+  const int    sh = sizeof(hydro_t) / sizeof(float);
+  const size_t sr = (size_t) sh * (size_t) args->stride;
+
+  int i, i1, r, k;
+
+  DISTRIBUTE( args->nv, 16, pipeline_rank, n_pipeline, i, i1 );
+
+  i1 += i;
+
+  /**/  float * RESTRICT ALIGNED(128) a = (float *) args->h0;
+  const float * RESTRICT ALIGNED(128) b = (const float *) args->h;
+
+  for( ; i < i1; i++ )
+  {
+    /**/  float * RESTRICT aa = a + (size_t) i * (size_t) sh;
+    const float * RESTRICT bb = b + (size_t) i * (size_t) sh;
+
+    for( r = 0; r < n_pipeline; r++, bb += sr )
+    {
+      for( k = 0; k < sh; k++ )
+      {
+        aa[k] += bb[k];
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Top level function to select and call the proper accumulate_hydro_p
+// pipeline function.
+//----------------------------------------------------------------------------//
+
+void
+accumulate_hydro_p_pipeline( hydro_array_t * RESTRICT ha,
+                             const species_t * RESTRICT sp,
+                             const interpolator_array_t * RESTRICT ia )
+{
+  DECLARE_ALIGNED_ARRAY( accumulate_hydro_p_pipeline_args_t, 128, args, 1 );
+
+  static hydro_t * ALIGNED(128) scratch = NULL;
+  static size_t             max_scratch = 0;
+
+  size_t sz_scratch;
+
+  if ( !ha        ||
+       !sp        ||
+       !ia        ||
+       ha->g != sp->g ||
+       ha->g != ia->g )
+  {
+    ERROR( ( "Bad args" ) );
+  }
+
+  const grid_t * g = sp->g;
+
+  // Each pipeline gets its own hydro array so that the pipelines do not
+  // need to synchronize their updates.  These are kept between calls.
+
+  sz_scratch = (size_t) N_PIPELINE * (size_t) g->nv;
+
+  if ( sz_scratch > max_scratch )
+  {
+    FREE_ALIGNED( scratch );
+
+    MALLOC_ALIGNED( scratch, sz_scratch, 128 );
+
+    max_scratch = sz_scratch;
+  }
+
+  args->p0       = sp->p;
+  args->f0       = ia->i;
+  args->h0       = ha->h;
+  args->h        = scratch;
+  args->qsp      = sp->q;
+  args->mspc     = sp->m*g->cvac;
+  args->qdt_2mc  = (sp->q*g->dt)/(2*args->mspc);
+  args->qdt_4mc2 = args->qdt_2mc / (2*g->cvac);
+  args->r8V      = g->r8V;
+  args->cvac     = g->cvac;
+  args->np       = sp->np;
+  args->nv       = g->nv;
+  args->stride   = g->nv;
+  args->s10      = VOXEL(1,0,0, g->nx,g->ny,g->nz) -
+                   VOXEL(0,0,0, g->nx,g->ny,g->nz);
+  args->s21      = VOXEL(0,1,0, g->nx,g->ny,g->nz) -
+                   VOXEL(1,0,0, g->nx,g->ny,g->nz);
+  args->s43      = VOXEL(0,0,1, g->nx,g->ny,g->nz) -
+                   VOXEL(1,1,0, g->nx,g->ny,g->nz);
+
+  // Have the pipelines do the bulk of particles in blocks and have the
+  // host do the final incomplete block.
+
+  EXEC_PIPELINES( accumulate_hydro_p, args, 0 );
+  WAIT_PIPELINES();
+
+  // Reduce the pipeline hydro arrays in parallel.  The host does the
+  // final incomplete block of voxels.
+
+  EXEC_PIPELINES( reduce_hydro_p, args, 0 );
+  WAIT_PIPELINES();
+}
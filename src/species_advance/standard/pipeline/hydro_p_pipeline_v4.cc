@@ -0,0 +1,246 @@
+#define IN_spa
+
+#include "spa_private.h"
+
+#if defined(V4_ACCELERATION)
+
+using namespace v4;
+
+void
+accumulate_hydro_p_pipeline_v4( accumulate_hydro_p_pipeline_args_t * args,
+                                int pipeline_rank,
+                                int n_pipeline )
+{
+  const interpolator_t * ALIGNED(128) f0 = args->f0;
+
+  const particle_t     * ALIGNED(128) p;
+
+  hydro_t              * ALIGNED(128) h;
+
+  const float          * ALIGNED(16)  vp00;
+  const float          * ALIGNED(16)  vp01;
+  const float          * ALIGNED(16)  vp02;
+  const float          * ALIGNED(16)  vp03;
+
+  DECLARE_ALIGNED_ARRAY( float, 64, b, 4*16 );
+
+  const v4float qdt_2mc( args->qdt_2mc);
+  const v4float qdt_4mc2(args->qdt_4mc2);
+  const v4float r8V(     args->r8V);
+  const v4float c(       args->cvac);
+  const v4float one(1.0);
+  const v4float one_third(1.0/3.0);
+  const v4float two_fifteenths(2.0/15.0);
+
+  const float qsp  = args->qsp;
+  const float mspc = args->mspc;
+  const int   s10  = args->s10;
+  const int   s21  = args->s21;
+  const int   s43  = args->s43;
+
+  v4float dx, dy, dz, ux, uy, uz, w, vx, vy, vz, ke_mc;
+  v4float hax, hay, haz, cbx, cby, cbz;
+  v4float v00, v01, v02, v03, v04, v05;
+  v4float w0, w1, w2, w3, w4, w5, w6, w7;
+  v4int   ii;
+
+  int itmp, nq;
+
+  // Determine which particle blocks this pipeline processes.
+
+  DISTRIBUTE( args->np, 16, pipeline_rank, n_pipeline, itmp, nq );
+
+  p = args->p0 + itmp;
+
+  nq >>= 2;
+
+  // Clear this pipeline's hydro array.
+
+  h = args->h + (size_t) pipeline_rank * (size_t) args->stride;
+
+  CLEAR( h, args->nv );
+
+  // Process the particle blocks for this pipeline.
+
+  for( ; nq; nq--, p+=4 )
+  {
+    //--------------------------------------------------------------------------
+    // Load particle position data.
+    //--------------------------------------------------------------------------
+    load_4x4_tr( &p[0].dx, &p[1].dx, &p[2].dx, &p[3].dx,
+                 dx, dy, dz, ii );
+
+    //--------------------------------------------------------------------------
+    // Set field interpolation pointers.
+    //--------------------------------------------------------------------------
+    vp00 = ( const float * ALIGNED(16) ) ( f0 + ii(0) );
+    vp01 = ( const float * ALIGNED(16) ) ( f0 + ii(1) );
+    vp02 = ( const float * ALIGNED(16) ) ( f0 + ii(2) );
+    vp03 = ( const float * ALIGNED(16) ) ( f0 + ii(3) );
+
+    //--------------------------------------------------------------------------
+    // Interpolate E and B.
+    //--------------------------------------------------------------------------
+    load_4x4_tr( vp00, vp01, vp02, vp03,
+                 hax, v00, v01, v02 );
+
+    hax = qdt_2mc*fma( fma( dy, v02, v01 ), dz, fma( dy, v00, hax ) );
+
+    load_4x4_tr( vp00+4, vp01+4, vp02+4, vp03+4,
+                 hay, v03, v04, v05 );
+
+    hay = qdt_2mc*fma( fma( dz, v05, v04 ), dx, fma( dz, v03, hay ) );
+
+    load_4x4_tr( vp00+8, vp01+8, vp02+8, vp03+8,
+                 haz, v00, v01, v02 );
+
+    haz = qdt_2mc*fma( fma( dx, v02, v01 ), dy, fma( dx, v00, haz ) );
+
+    load_4x4_tr( vp00+12, vp01+12, vp02+12, vp03+12,
+                 cbx, v03, cby, v04 );
+
+    cbx = fma( v03, dx, cbx );
+    cby = fma( v04, dy, cby );
+
+    load_4x2_tr( vp00+16, vp01+16, vp02+16, vp03+16,
+                 cbz, v05 );
+
+    cbz = fma( v05, dz, cbz );
+
+    //--------------------------------------------------------------------------
+    // Load particle momentum data and half advance E.
+    //--------------------------------------------------------------------------
+    load_4x4_tr( &p[0].ux, &p[1].ux, &p[2].ux, &p[3].ux,
+                 ux, uy, uz, w );
+
+    ux += hax;
+    uy += hay;
+    uz += haz;
+
+    //--------------------------------------------------------------------------
+    // Half Boris rotate and compute the kinetic energy.  Note: gamma-1 =
+    // |u|^2 / (gamma+1) is the numerically accurate way to compute gamma-1.
+    //--------------------------------------------------------------------------
+    ke_mc = fma( ux, ux, fma( uy, uy, uz * uz ) );   // |u|^2
+    v05   = sqrt( one + ke_mc );                     // gamma
+    ke_mc = ke_mc * ( c / ( v05 + one ) );           // c*(gamma-1)
+    vz    = c / v05;                                 // c/gamma
+
+    v00  = qdt_4mc2 * vz;
+    v01  = fma( cbx, cbx, fma( cby, cby, cbz * cbz ) );
+    v02  = ( v00 * v00 ) * v01;
+    v03  = v00 * fma( v02, fma( v02, two_fifteenths, one_third ), one );
+    v04  = v03 / fma( v03 * v03, v01, one );
+    v04 += v04;
+
+    v00  = fma( fms( uy, cbz, uz * cby ), v03, ux );
+    v01  = fma( fms( uz, cbx, ux * cbz ), v03, uy );
+    v02  = fma( fms( ux, cby, uy * cbx ), v03, uz );
+
+    ux   = fma( fms( v01, cbz, v02 * cby ), v04, ux );
+    uy   = fma( fms( v02, cbx, v00 * cbz ), v04, uy );
+    uz   = fma( fms( v00, cby, v01 * cbx ), v04, uz );
+
+    vx   = ux * vz;                                  // Physical velocities
+    vy   = uy * vz;
+    vz  *= uz;
+
+    //--------------------------------------------------------------------------
+    // Compute the trilinear coefficients.
+    //--------------------------------------------------------------------------
+    w0  = r8V * w;                                   // (1/8)(w/V)
+    dx *= w0;
+    w1  = w0 + dx;                                   // (1/8)(w/V)(1+x)
+    w0 -= dx;                                        // (1/8)(w/V)(1-x)
+    w3  = one + dy;
+    w2  = w0 * w3;                                   // (1/8)(w/V)(1-x)(1+y)
+    w3 *= w1;                                        // (1/8)(w/V)(1+x)(1+y)
+    dy  = one - dy;
+    w0 *= dy;                                        // (1/8)(w/V)(1-x)(1-y)
+    w1 *= dy;                                        // (1/8)(w/V)(1+x)(1-y)
+    w7  = one + dz;
+    w4  = w0 * w7;
+    w5  = w1 * w7;
+    w6  = w2 * w7;
+    w7 *= w3;
+    dz  = one - dz;
+    w0 *= dz;
+    w1 *= dz;
+    w2 *= dz;
+    w3 *= dz;
+
+    //--------------------------------------------------------------------------
+    // Store the particle records and scatter them into the hydro array.
+    //--------------------------------------------------------------------------
+    store_4x4_tr( vx, vy, vz, ke_mc, b+ 0, b+16, b+32, b+48 );
+    store_4x4_tr( ux, uy, uz, ii,    b+ 4, b+20, b+36, b+52 );
+    store_4x4_tr( w0, w1, w2, w3,    b+ 8, b+24, b+40, b+56 );
+    store_4x4_tr( w4, w5, w6, w7,    b+12, b+28, b+44, b+60 );
+
+    accumulate_hydro_p_block( h, b, 4, qsp, mspc, s10, s21, s43 );
+  }
+}
+
+void
+reduce_hydro_p_pipeline_v4( accumulate_hydro_p_pipeline_args_t * args,
+                            int pipeline_rank,
+                            int n_pipeline )
+{
+  const size_t sr = 16 * (size_t) args->stride; // hydro_t is 16 floats
+
+  int i, i1, r;
+
+  DISTRIBUTE( args->nv, 16, pipeline_rank, n_pipeline, i, i1 );
+
+  i1 += i;
+
+  /**/  float * RESTRICT ALIGNED(128) a = (float *) ( args->h0 + i );
+  const float * RESTRICT ALIGNED(128) b = (const float *) ( args->h + i );
+
+  v4float v0, v1, v2, v3, v4;
+
+  for( ; i < i1; i++, a += 16, b += 16 )
+  {
+    const float * ALIGNED(16) bb = b;
+
+    load_4x1( a +  0, v0 );
+    load_4x1( a +  4, v1 );
+    load_4x1( a +  8, v2 );
+    load_4x1( a + 12, v3 );
+
+    for( r = 0; r < n_pipeline; r++, bb += sr )
+    {
+      load_4x1( bb +  0, v4 ); v0 += v4;
+      load_4x1( bb +  4, v4 ); v1 += v4;
+      load_4x1( bb +  8, v4 ); v2 += v4;
+      load_4x1( bb + 12, v4 ); v3 += v4;
+    }
+
+    store_4x1( v0, a +  0 );
+    store_4x1( v1, a +  4 );
+    store_4x1( v2, a +  8 );
+    store_4x1( v3, a + 12 );
+  }
+}
+
+#else
+
+void
+accumulate_hydro_p_pipeline_v4( accumulate_hydro_p_pipeline_args_t * args,
+                                int pipeline_rank,
+                                int n_pipeline )
+{
+  // No v4 implementation.
+  ERROR( ( "No accumulate_hydro_p_pipeline_v4 implementation." ) );
+}
+
+void
+reduce_hydro_p_pipeline_v4( accumulate_hydro_p_pipeline_args_t * args,
+                            int pipeline_rank,
+                            int n_pipeline )
+{
+  // No v4 implementation.
+  ERROR( ( "No reduce_hydro_p_pipeline_v4 implementation." ) );
+}
+
+#endif
@@ -0,0 +1,255 @@
+#define IN_spa
+
+#include "spa_private.h"
+
+#if defined(V8_ACCELERATION)
+
+using namespace v8;
+
+void
+accumulate_hydro_p_pipeline_v8( accumulate_hydro_p_pipeline_args_t * args,
+                                int pipeline_rank,
+                                int n_pipeline )
+{
+  const interpolator_t * ALIGNED(128) f0 = args->f0;
+
+  const particle_t     * ALIGNED(128) p;
+
+  hydro_t              * ALIGNED(128) h;
+
+  const float          * ALIGNED(32)  vp00;
+  const float          * ALIGNED(32)  vp01;
+  const float          * ALIGNED(32)  vp02;
+  const float          * ALIGNED(32)  vp03;
+  const float          * ALIGNED(32)  vp04;
+  const float          * ALIGNED(32)  vp05;
+  const float          * ALIGNED(32)  vp06;
+  const float          * ALIGNED(32)  vp07;
+
+  DECLARE_ALIGNED_ARRAY( float, 64, b, 8*16 );
+
+  const v8float qdt_2mc( args->qdt_2mc);
+  const v8float qdt_4mc2(args->qdt_4mc2);
+  const v8float r8V(     args->r8V);
+  const v8float c(       args->cvac);
+  const v8float one(1.0);
+  const v8float one_third(1.0/3.0);
+  const v8float two_fifteenths(2.0/15.0);
+
+  const float qsp  = args->qsp;
+  const float mspc = args->mspc;
+  const int   s10  = args->s10;
+  const int   s21  = args->s21;
+  const int   s43  = args->s43;
+
+  v8float dx, dy, dz, ux, uy, uz, w, vx, vy, vz, ke_mc;
+  v8float hax, hay, haz, cbx, cby, cbz;
+  v8float v00, v01, v02, v03, v04, v05;
+  v8float w0, w1, w2, w3, w4, w5, w6, w7;
+  v8int   ii;
+
+  int itmp, nq;
+
+  // Determine which particle blocks this pipeline processes.
+
+  DISTRIBUTE( args->np, 16, pipeline_rank, n_pipeline, itmp, nq );
+
+  p = args->p0 + itmp;
+
+  nq >>= 3;
+
+  // Clear this pipeline's hydro array.
+
+  h = args->h + (size_t) pipeline_rank * (size_t) args->stride;
+
+  CLEAR( h, args->nv );
+
+  // Process the particle blocks for this pipeline.
+
+  for( ; nq; nq--, p+=8 )
+  {
+    //--------------------------------------------------------------------------
+    // Load particle position data.
+    //--------------------------------------------------------------------------
+    load_8x4_tr( &p[0].dx, &p[1].dx, &p[2].dx, &p[3].dx,
+                 &p[4].dx, &p[5].dx, &p[6].dx, &p[7].dx,
+                 dx, dy, dz, ii );
+
+    //--------------------------------------------------------------------------
+    // Set field interpolation pointers.
+    //--------------------------------------------------------------------------
+    vp00 = ( const float * ALIGNED(32) ) ( f0 + ii(0) );
+    vp01 = ( const float * ALIGNED(32) ) ( f0 + ii(1) );
+    vp02 = ( const float * ALIGNED(32) ) ( f0 + ii(2) );
+    vp03 = ( const float * ALIGNED(32) ) ( f0 + ii(3) );
+    vp04 = ( const float * ALIGNED(32) ) ( f0 + ii(4) );
+    vp05 = ( const float * ALIGNED(32) ) ( f0 + ii(5) );
+    vp06 = ( const float * ALIGNED(32) ) ( f0 + ii(6) );
+    vp07 = ( const float * ALIGNED(32) ) ( f0 + ii(7) );
+
+    //--------------------------------------------------------------------------
+    // Interpolate E and B.
+    //--------------------------------------------------------------------------
+    load_8x4_tr( vp00, vp01, vp02, vp03,
+                 vp04, vp05, vp06, vp07,
+                 hax, v00, v01, v02 );
+
+    hax = qdt_2mc*fma( fma( dy, v02, v01 ), dz, fma( dy, v00, hax ) );
+
+    load_8x4_tr( vp00+4, vp01+4, vp02+4, vp03+4,
+                 vp04+4, vp05+4, vp06+4, vp07+4,
+                 hay, v03, v04, v05 );
+
+    hay = qdt_2mc*fma( fma( dz, v05, v04 ), dx, fma( dz, v03, hay ) );
+
+    load_8x4_tr( vp00+8, vp01+8, vp02+8, vp03+8,
+                 vp04+8, vp05+8, vp06+8, vp07+8,
+                 haz, v00, v01, v02 );
+
+    haz = qdt_2mc*fma( fma( dx, v02, v01 ), dy, fma( dx, v00, haz ) );
+
+    load_8x4_tr( vp00+12, vp01+12, vp02+12, vp03+12,
+                 vp04+12, vp05+12, vp06+12, vp07+12,
+                 cbx, v03, cby, v04 );
+
+    cbx = fma( v03, dx, cbx );
+    cby = fma( v04, dy, cby );
+
+    load_8x2_tr( vp00+16, vp01+16, vp02+16, vp03+16,
+                 vp04+16, vp05+16, vp06+16, vp07+16,
+                 cbz, v05 );
+
+    cbz = fma( v05, dz, cbz );
+
+    //--------------------------------------------------------------------------
+    // Load particle momentum data and half advance E.
+    //--------------------------------------------------------------------------
+    load_8x4_tr( &p[0].ux, &p[1].ux, &p[2].ux, &p[3].ux,
+                 &p[4].ux, &p[5].ux, &p[6].ux, &p[7].ux,
+                 ux, uy, uz, w );
+
+    ux += hax;
+    uy += hay;
+    uz += haz;
+
+    //--------------------------------------------------------------------------
+    // Half Boris rotate and compute the kinetic energy.  Note: gamma-1 =
+    // |u|^2 / (gamma+1) is the numerically accurate way to compute gamma-1.
+    //--------------------------------------------------------------------------
+    ke_mc = fma( ux, ux, fma( uy, uy, uz * uz ) );   // |u|^2
+    v05   = sqrt( one + ke_mc );                     // gamma
+    ke_mc = ke_mc * ( c / ( v05 + one ) );           // c*(gamma-1)
+    vz    = c / v05;                                 // c/gamma
+
+    v00  = qdt_4mc2 * vz;
+    v01  = fma( cbx, cbx, fma( cby, cby, cbz * cbz ) );
+    v02  = ( v00 * v00 ) * v01;
+    v03  = v00 * fma( v02, fma( v02, two_fifteenths, one_third ), one );
+    v04  = v03 / fma( v03 * v03, v01, one );
+    v04 += v04;
+
+    v00  = fma( fms( uy, cbz, uz * cby ), v03, ux );
+    v01  = fma( fms( uz, cbx, ux * cbz ), v03, uy );
+    v02  = fma( fms( ux, cby, uy * cbx ), v03, uz );
+
+    ux   = fma( fms( v01, cbz, v02 * cby ), v04, ux );
+    uy   = fma( fms( v02, cbx, v00 * cbz ), v04, uy );
+    uz   = fma( fms( v00, cby, v01 * cbx ), v04, uz );
+
+    vx   = ux * vz;                                  // Physical velocities
+    vy   = uy * vz;
+    vz  *= uz;
+
+    //--------------------------------------------------------------------------
+    // Compute the trilinear coefficients.
+    //--------------------------------------------------------------------------
+    w0  = r8V * w;                                   // (1/8)(w/V)
+    dx *= w0;
+    w1  = w0 + dx;                                   // (1/8)(w/V)(1+x)
+    w0 -= dx;                                        // (1/8)(w/V)(1-x)
+    w3  = one + dy;
+    w2  = w0 * w3;                                   // (1/8)(w/V)(1-x)(1+y)
+    w3 *= w1;                                        // (1/8)(w/V)(1+x)(1+y)
+    dy  = one - dy;
+    w0 *= dy;                                        // (1/8)(w/V)(1-x)(1-y)
+    w1 *= dy;                                        // (1/8)(w/V)(1+x)(1-y)
+    w7  = one + dz;
+    w4  = w0 * w7;
+    w5  = w1 * w7;
+    w6  = w2 * w7;
+    w7 *= w3;
+    dz  = one - dz;
+    w0 *= dz;
+    w1 *= dz;
+    w2 *= dz;
+    w3 *= dz;
+
+    //--------------------------------------------------------------------------
+    // Store the particle records and scatter them into the hydro array.
+    //--------------------------------------------------------------------------
+    store_8x8_tr( vx, vy, vz, ke_mc, ux, uy, uz, ii,
+                  b+  0, b+ 16, b+ 32, b+ 48, b+ 64, b+ 80, b+ 96, b+112 );
+    store_8x8_tr( w0, w1, w2, w3, w4, w5, w6, w7,
+                  b+  8, b+ 24, b+ 40, b+ 56, b+ 72, b+ 88, b+104, b+120 );
+
+    accumulate_hydro_p_block( h, b, 8, qsp, mspc, s10, s21, s43 );
+  }
+}
+
+void
+reduce_hydro_p_pipeline_v8( accumulate_hydro_p_pipeline_args_t * args,
+                            int pipeline_rank,
+                            int n_pipeline )
+{
+  const size_t sr = 16 * (size_t) args->stride; // hydro_t is 16 floats
+
+  int i, i1, r;
+
+  DISTRIBUTE( args->nv, 16, pipeline_rank, n_pipeline, i, i1 );
+
+  i1 += i;
+
+  /**/  float * RESTRICT ALIGNED(128) a = (float *) ( args->h0 + i );
+  const float * RESTRICT ALIGNED(128) b = (const float *) ( args->h + i );
+
+  v8float v0, v1, v2;
+
+  for( ; i < i1; i++, a += 16, b += 16 )
+  {
+    const float * ALIGNED(32) bb = b;
+
+    load_8x1( a + 0, v0 );
+    load_8x1( a + 8, v1 );
+
+    for( r = 0; r < n_pipeline; r++, bb += sr )
+    {
+      load_8x1( bb + 0, v2 ); v0 += v2;
+      load_8x1( bb + 8, v2 ); v1 += v2;
+    }
+
+    store_8x1( v0, a + 0 );
+    store_8x1( v1, a + 8 );
+  }
+}
+
+#else
+
+void
+accumulate_hydro_p_pipeline_v8( accumulate_hydro_p_pipeline_args_t * args,
+                                int pipeline_rank,
+                                int n_pipeline )
+{
+  // No v8 implementation.
+  ERROR( ( "No accumulate_hydro_p_pipeline_v8 implementation." ) );
+}
+
+void
+reduce_hydro_p_pipeline_v8( accumulate_hydro_p_pipeline_args_t * args,
+                            int pipeline_rank,
+                            int n_pipeline )
+{
+  // No v8 implementation.
+  ERROR( ( "No reduce_hydro_p_pipeline_v8 implementation." ) );
+}
+
+#endif
@@ -0,0 +1,368 @@
+#define IN_spa
+
+#include "spa_private.h"
+
+#include "../../../util/pipelines/pipelines_exec.h"
+
+//----------------------------------------------------------------------------//
+// Generate stage.  Each pipeline runs the generator on a contiguous range of
+// blocks and writes the particles it makes from its slots starting at the
+// particle (and age) of its first slot.  The host then closes the gaps
+// left by slots that did not make a particle.
+//----------------------------------------------------------------------------//
+
+void
+inject_p_generate_pipeline_scalar( inject_p_pipeline_args_t * args,
+                                   int pipeline_rank,
+                                   int n_pipeline )
+{
+  particle_generator_func_t gen = args->gen;
+
+  /**/  void       *                       params = args->params;
+  /**/  particle_t * RESTRICT ALIGNED(128) p      = args->p;
+  /**/  float      * RESTRICT ALIGNED(128) age    = args->age;
+  /**/  rng_t      * RESTRICT              rng    = args->rng[ pipeline_rank ];
+
+  const int n     = args->n;
+  const int block = args->block;
+
+  int b, nb, first, last, s, m, k, np = 0;
+
+  // No straggler cleanup needed.
+  if ( pipeline_rank == n_pipeline )
+  {
+    return;
+  }
+
+  DISTRIBUTE( ( n + block - 1 ) / block, 1, pipeline_rank, n_pipeline, b, nb );
+
+  first = b*block;
+  last  = ( b + nb )*block;
+  if ( last > n ) last = n;
+
+  for( s = first; s < last; s += block, b++ )
+  {
+    m = last - s < block ? last - s : block;
+
+    if ( rng )
+    {
+      seek_rng( rng, args->seed, args->stream, args->step, b );
+    }
+
+    k = gen( params, s, m, p + first + np, age + first + np, rng );
+
+    if ( k < 0 || k > m )
+    {
+      ERROR( ( "Particle generator made %i particles from %i slots", k, m ) );
+    }
+
+    np += k;
+  }
+
+  args->seg[ pipeline_rank ].first = first;
+  args->seg[ pipeline_rank ].np    = np;
+}
+
+//----------------------------------------------------------------------------//
+// Finish stage.  Each pipeline tags its share of the new particles,
+// accumulates their charge into its own rhob array and ages them.  The
+// movers of particles that end up on a boundary go in the pipeline's mover
+// list.
+//----------------------------------------------------------------------------//
+
+void
+inject_p_finish_pipeline_scalar( inject_p_pipeline_args_t * args,
+                                 int pipeline_rank,
+                                 int n_pipeline )
+{
+  /**/  particle_t     * RESTRICT ALIGNED(128) p0  = args->p0;
+  const float          * RESTRICT ALIGNED(128) age = args->age;
+  /**/  int64_t        * RESTRICT ALIGNED(128) tag = args->tag;
+  /**/  accumulator_t  * RESTRICT ALIGNED(128) a   = args->a0;
+  const grid_t         *                       g   = args->g;
+  /**/  inject_p_seg_t *                       seg = args->seg + pipeline_rank;
+  /**/  float          * RESTRICT ALIGNED(128) r   = NULL;
+
+  const float qsp = args->qsp;
+  const float cdt = g->cvac*g->dt;
+
+  DECLARE_ALIGNED_ARRAY( particle_mover_t, 16, local_pm, 1 );
+
+  const particle_t * RESTRICT ALIGNED(32) p;
+  particle_mover_t * pm;
+
+  float t;
+  int i, n;
+
+  // No straggler cleanup needed.
+  if ( pipeline_rank == n_pipeline )
+  {
+    return;
+  }
+
+  DISTRIBUTE( args->n, 1, pipeline_rank, n_pipeline, i, n );
+
+  a += ( 1 + pipeline_rank ) * args->a_stride;
+
+  if ( args->r )
+  {
+    r = args->r + (size_t) pipeline_rank * (size_t) args->stride;
+
+    CLEAR( r, args->nv );
+  }
+
+  seg->nm = 0;
+
+  for( ; n; n--, i++ )
+  {
+    if ( tag ) tag[i] = args->tag0 + i;
+
+    p = &p0[ args->np0 + i ];
+
+    if ( r )
+    {
+      accumulate_rhob_array( r, p, g, -qsp ); // As inject_particle does
+    }
+
+    if ( age[i] == 0 ) continue;
+
+    // Age the particle as inject_particle does.
+
+    t = age[i]*cdt / sqrtf( p->ux*p->ux + p->uy*p->uy + p->uz*p->uz + 1 );
+
+    local_pm->dispx = p->ux*t*g->rdx;
+    local_pm->dispy = p->uy*t*g->rdy;
+    local_pm->dispz = p->uz*t*g->rdz;
+    local_pm->i     = args->np0 + i;
+
+    if ( move_p( p0, local_pm, a, g, qsp ) )    // Unlikely
+    {
+      if ( seg->nm == seg->max_nm )
+      {
+        seg->max_nm = seg->max_nm ? 2*seg->max_nm : 4*MOVER_BLOCK;
+
+        MALLOC_ALIGNED( pm, seg->max_nm, 128 );
+        COPY( pm, seg->pm, seg->nm );
+        FREE_ALIGNED( seg->pm );
+
+        seg->pm = pm;
+      }
+
+      seg->pm[ seg->nm++ ] = local_pm[0];
+    }
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Reduce the pipeline rhob arrays into the rhob of the fields.  The arrays
+// are summed in a fixed order as in reduce_rho_p.
+//----------------------------------------------------------------------------//
+
+void
+inject_p_reduce_pipeline_scalar( inject_p_pipeline_args_t * args,
+                                 int pipeline_rank,
+                                 int n_pipeline )
+{
+  field_t     * RESTRICT ALIGNED(128) f = args->f;
+  const float * RESTRICT ALIGNED(128) r = args->r;
+
+  const size_t sr = args->stride;
+  const int    np = N_PIPELINE;
+
+  const float * RESTRICT rr;
+
+  float rho;
+  int i, i1, k;
+
+  DISTRIBUTE( args->nv, 16, pipeline_rank, n_pipeline, i, i1 );
+
+  i1 += i;
+
+  for( ; i < i1; i++ )
+  {
+    rr  = r + i;
+    rho = f[i].rhob;
+
+    for( k = 0; k < np; k++, rr += sr )
+    {
+      rho += *rr;
+    }
+
+    f[i].rhob = rho;
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Top level function to run the stages of a bulk injection.
+//----------------------------------------------------------------------------//
+
+int
+inject_p_pipeline( species_t * RESTRICT sp,
+                   particle_generator_func_t gen,
+                   void * params,
+                   int n,
+                   int block,
+                   rng_pool_t * RESTRICT rp,
+                   rng_pool_t * RESTRICT crp,
+                   int stream,
+                   field_array_t * RESTRICT fa,
+                   accumulator_array_t * RESTRICT aa )
+{
+  DECLARE_ALIGNED_ARRAY( inject_p_pipeline_args_t, 128, args, 1 );
+  DECLARE_ALIGNED_ARRAY( inject_p_seg_t, 128, seg, MAX_PIPELINE+1 );
+
+  // Kept between calls (as are the pipeline mover lists) so that
+  // emitters do not allocate every step.
+  static float * ALIGNED(128) scratch = NULL;
+  static size_t           max_scratch = 0;
+  static particle_mover_t * pm_list[ MAX_PIPELINE ];
+  static int            max_pm_list[ MAX_PIPELINE ];
+
+  size_t sz_scratch;
+  int rank, stride, nm, np;
+
+  if ( !sp || !gen || n < 0 || block < 1 || !aa || aa->g != sp->g ||
+       ( fa && fa->g != sp->g ) ||
+       ( rp && ( !crp || crp->n_rng < N_PIPELINE ) ) )
+  {
+    ERROR( ( "Bad args" ) );
+  }
+
+  const grid_t * g = sp->g;
+
+  if ( n > sp->max_np - sp->np )
+  {
+    WARNING( ( "Insufficient local particle storage.  Not making the last %i "
+               "of %i slots of a bulk injection into %s",
+               n - ( sp->max_np - sp->np ), n, sp->name ) );
+
+    n = sp->max_np - sp->np;
+  }
+
+  if ( !n ) return 0;
+
+  // The ages come first in the scratch followed, if rhob is updated, by
+  // a rhob array for each pipeline (see accumulate_rho_p_pipeline).
+
+  stride     = POW2_CEIL( g->nv, 32 );
+  sz_scratch = POW2_CEIL( (size_t) n, 32 );
+
+  if ( fa )
+  {
+    sz_scratch += (size_t) N_PIPELINE * (size_t) stride;
+  }
+
+  if ( sz_scratch > max_scratch )
+  {
+    FREE_ALIGNED( scratch );
+
+    MALLOC_ALIGNED( scratch, sz_scratch, 128 );
+
+    max_scratch = sz_scratch;
+  }
+
+  args->p0       = sp->p;
+  args->p        = sp->p + sp->np;
+  args->age      = scratch;
+  args->tag      = sp->tag ? sp->tag + sp->np : NULL;
+  args->r        = fa ? scratch + POW2_CEIL( (size_t) n, 32 ) : NULL;
+  args->f        = fa ? fa->f : NULL;
+  args->a0       = aa->a;
+  args->g        = g;
+  args->seg      = seg;
+  args->params   = params;
+  args->gen      = gen;
+  args->step     = g->step;
+  args->tag0     = sp->next_tag;
+  args->qsp      = sp->q;
+  args->np0      = sp->np;
+  args->n        = n;
+  args->block    = block;
+  args->seed     = rp ? rp->seed : 0;
+  args->stream   = stream;
+  args->nv       = g->nv;
+  args->stride   = stride;
+  args->a_stride = aa->stride;
+
+  for( rank = 0; rank < N_PIPELINE; rank++ )
+  {
+    args->rng[rank]    = rp ? crp->rng[rank] : NULL;
+    seg[rank].pm       = pm_list[rank];
+    seg[rank].max_nm   = max_pm_list[rank];
+    seg[rank].nm       = 0;
+    seg[rank].first    = 0;
+    seg[rank].np       = 0;
+  }
+
+  EXEC_PIPELINES( inject_p_generate, args, 0 );
+
+  WAIT_PIPELINES();
+
+  // Close the gaps between the particles of the pipelines.
+
+  np = 0;
+
+  for( rank = 0; rank < N_PIPELINE; rank++ )
+  {
+    if ( seg[rank].first != np )
+    {
+      MOVE( args->p   + np, args->p   + seg[rank].first, seg[rank].np );
+      MOVE( args->age + np, args->age + seg[rank].first, seg[rank].np );
+    }
+
+    np += seg[rank].np;
+  }
+
+  args->n = np;
+
+  if ( np )
+  {
+    EXEC_PIPELINES( inject_p_finish, args, 0 );
+
+    WAIT_PIPELINES();
+
+    if ( fa )
+    {
+      EXEC_PIPELINES( inject_p_reduce, args, 0 );
+
+      WAIT_PIPELINES();
+    }
+  }
+
+  sp->np += np;
+
+  if ( sp->tag ) sp->next_tag += np;
+
+  // Append the movers in pipeline order.
+
+  nm = sp->nm;
+
+  for( rank = 0; rank < N_PIPELINE; rank++ )
+  {
+    nm += seg[rank].nm;
+  }
+
+  if ( nm > sp->max_nm )
+  {
+    int max_nm = nm + nm/4;
+
+    WARNING( ( "Resizing local %s mover storage from %i to %i",
+               sp->name, sp->max_nm, max_nm ) );
+
+    REALLOC_ARENA( sp->pm, sp->nm, max_nm, 128, "mover" );
+
+    sp->max_nm = max_nm;
+  }
+
+  for( rank = 0; rank < N_PIPELINE; rank++ )
+  {
+    COPY( sp->pm + sp->nm, seg[rank].pm, seg[rank].nm );
+
+    sp->nm += seg[rank].nm;
+
+    pm_list[rank]     = seg[rank].pm;
+    max_pm_list[rank] = seg[rank].max_nm;
+  }
+
+  return np;
+}
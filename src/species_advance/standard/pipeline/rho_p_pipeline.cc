@@ -0,0 +1,215 @@
+#define IN_spa
+
+#define HAS_V4_PIPELINE
+#define HAS_V8_PIPELINE
+#define HAS_V16_PIPELINE
+
+#include "spa_private.h"
+
+#include "../../../util/pipelines/pipelines_exec.h"
+
+//----------------------------------------------------------------------------//
+// Reference implementation for an accumulate_rho_p pipeline function which
+// does not make use of explicit calls to vector intrinsic functions.  Each
+// pipeline clears and accumulates into its own rho array.  The host does the
+// final incomplete block of particles directly into the rhof of the fields.
+//----------------------------------------------------------------------------//
+
+void
+accumulate_rho_p_pipeline_scalar( accumulate_rho_p_pipeline_args_t * args,
+                                  int pipeline_rank,
+                                  int n_pipeline )
+{
+  const particle_t * ALIGNED(32) p;
+
+  const float q_8V = args->q_8V;
+  const int   sy   = args->sy;
+  const int   sz   = args->sz;
+
+  float w0, w1, w2, w3, w4, w5, w6, w7, dz;
+
+  int first, n, v;
+
+  // Determine which particles this pipeline processes.
+
+  DISTRIBUTE( args->np, 16, pipeline_rank, n_pipeline, first, n );
+
+  p = args->p0 + first;
+
+  // Process particles for this pipeline.
+
+  if ( pipeline_rank == n_pipeline )
+  {
+    field_t * RESTRICT ALIGNED(128) f = args->f0;
+
+    for( ; n; n--, p++ )
+    {
+      w0 = p->dx;                            // Load the particle data
+      w1 = p->dy;
+      dz = p->dz;
+      v  = p->i;
+      w7 = p->w*q_8V;
+
+      // Compute the trilinear weights.  See note in accumulate_rhob for
+      // why FMA and FNMS are done this way.
+
+#     define FMA( x,y,z) ((z)+(x)*(y))
+#     define FNMS(x,y,z) ((z)-(x)*(y))
+      w6=FNMS(w0,w7,w7);                    // q(1-dx)
+      w7=FMA( w0,w7,w7);                    // q(1+dx)
+      w4=FNMS(w1,w6,w6); w5=FNMS(w1,w7,w7); // q(1-dx)(1-dy), q(1+dx)(1-dy)
+      w6=FMA( w1,w6,w6); w7=FMA( w1,w7,w7); // q(1-dx)(1+dy), q(1+dx)(1+dy)
+      w0=FNMS(dz,w4,w4); w1=FNMS(dz,w5,w5); w2=FNMS(dz,w6,w6); w3=FNMS(dz,w7,w7);
+      w4=FMA( dz,w4,w4); w5=FMA( dz,w5,w5); w6=FMA( dz,w6,w6); w7=FMA( dz,w7,w7);
+#     undef FNMS
+#     undef FMA
+
+      // Reduce the particle charge to rhof
+
+      f[v      ].rhof += w0; f[v      +1].rhof += w1;
+      f[v   +sy].rhof += w2; f[v   +sy+1].rhof += w3;
+      f[v+sz   ].rhof += w4; f[v+sz   +1].rhof += w5;
+      f[v+sz+sy].rhof += w6; f[v+sz+sy+1].rhof += w7;
+    }
+  }
+
+  else
+  {
+    float * RESTRICT ALIGNED(128) r = args->r +
+                                      (size_t) pipeline_rank *
+                                      (size_t) args->stride;
+
+    CLEAR( r, args->nv );
+
+    for( ; n; n--, p++ )
+    {
+      w0 = p->dx;                            // Load the particle data
+      w1 = p->dy;
+      dz = p->dz;
+      v  = p->i;
+      w7 = p->w*q_8V;
+
+#     define FMA( x,y,z) ((z)+(x)*(y))
+#     define FNMS(x,y,z) ((z)-(x)*(y))
+      w6=FNMS(w0,w7,w7);                    // q(1-dx)
+      w7=FMA( w0,w7,w7);                    // q(1+dx)
+      w4=FNMS(w1,w6,w6); w5=FNMS(w1,w7,w7); // q(1-dx)(1-dy), q(1+dx)(1-dy)
+      w6=FMA( w1,w6,w6); w7=FMA( w1,w7,w7); // q(1-dx)(1+dy), q(1+dx)(1+dy)
+      w0=FNMS(dz,w4,w4); w1=FNMS(dz,w5,w5); w2=FNMS(dz,w6,w6); w3=FNMS(dz,w7,w7);
+      w4=FMA( dz,w4,w4); w5=FMA( dz,w5,w5); w6=FMA( dz,w6,w6); w7=FMA( dz,w7,w7);
+#     undef FNMS
+#     undef FMA
+
+      // Reduce the particle charge to this pipeline's rho array
+
+      r[v      ] += w0; r[v      +1] += w1;
+      r[v   +sy] += w2; r[v   +sy+1] += w3;
+      r[v+sz   ] += w4; r[v+sz   +1] += w5;
+      r[v+sz+sy] += w6; r[v+sz+sy+1] += w7;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Reduce the pipeline rho arrays into the rhof of the fields.  The voxels
+// are distributed over the pipelines so the reduction is done in parallel;
+// the pipeline arrays are summed in a fixed order so that the result does
+// not depend on which pipeline reduces which voxels.
+//----------------------------------------------------------------------------//
+
+void
+reduce_rho_p_pipeline_scalar( accumulate_rho_p_pipeline_args_t * args,
+                              int pipeline_rank,
+                              int n_pipeline )
+{
+  field_t     * RESTRICT ALIGNED(128) f = args->f0;
+  const float * RESTRICT ALIGNED(128) r = args->r;
+
+  const size_t sr = args->stride;
+
+  const float * RESTRICT rr;
+
+  float rho;
+  int i, i1, k;
+
+  DISTRIBUTE( args->nv, 16, pipeline_rank, n_pipeline, i, i1 );
+
+  i1 += i;
+
+  for( ; i < i1; i++ )
+  {
+    rr  = r + i;
+    rho = f[i].rhof;
+
+    for( k = 0; k < n_pipeline; k++, rr += sr )
+    {
+      rho += *rr;
+    }
+
+    f[i].rhof = rho;
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Top level function to select and call the proper accumulate_rho_p
+// pipeline function.
+//----------------------------------------------------------------------------//
+
+void
+accumulate_rho_p_pipeline( field_array_t * RESTRICT fa,
+                           const species_t * RESTRICT sp )
+{
+  DECLARE_ALIGNED_ARRAY( accumulate_rho_p_pipeline_args_t, 128, args, 1 );
+
+  static float * ALIGNED(128) scratch = NULL;
+  static size_t           max_scratch = 0;
+
+  size_t sz_scratch;
+  int    stride;
+
+  if ( !fa        ||
+       !sp        ||
+       fa->g != sp->g )
+  {
+    ERROR( ( "Bad args" ) );
+  }
+
+  const grid_t * g = sp->g;
+
+  // Each pipeline gets its own rho array so that the pipelines do not
+  // need to synchronize their updates.  These are kept between calls.
+
+  stride     = POW2_CEIL( g->nv, 32 );  // Keep each array 128-byte aligned
+  sz_scratch = (size_t) N_PIPELINE * (size_t) stride;
+
+  if ( sz_scratch > max_scratch )
+  {
+    FREE_ALIGNED( scratch );
+
+    MALLOC_ALIGNED( scratch, sz_scratch, 128 );
+
+    max_scratch = sz_scratch;
+  }
+
+  args->p0     = sp->p;
+  args->f0     = fa->f;
+  args->r      = scratch;
+  args->q_8V   = sp->q*g->r8V;
+  args->np     = sp->np;
+  args->nv     = g->nv;
+  args->stride = stride;
+  args->sy     = g->sy;
+  args->sz     = g->sz;
+
+  // Have the pipelines do the bulk of particles in blocks and have the
+  // host do the final incomplete block.
+
+  EXEC_PIPELINES( accumulate_rho_p, args, 0 );
+  WAIT_PIPELINES();
+
+  // Reduce the pipeline rho arrays in parallel.  The host does the final
+  // incomplete block of voxels.
+
+  EXEC_PIPELINES( reduce_rho_p, args, 0 );
+  WAIT_PIPELINES();
+}
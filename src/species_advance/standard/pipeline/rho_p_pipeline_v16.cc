@@ -0,0 +1,151 @@
+#define IN_spa
+
+#include "spa_private.h"
+
+#if defined(V16_ACCELERATION)
+
+using namespace v16;
+
+void
+accumulate_rho_p_pipeline_v16( accumulate_rho_p_pipeline_args_t * args,
+                               int pipeline_rank,
+                               int n_pipeline )
+{
+  const particle_t * ALIGNED(128) p;
+
+  float            * ALIGNED(128) r;
+
+  DECLARE_ALIGNED_ARRAY( float, 64, w, 16*8 );
+  DECLARE_ALIGNED_ARRAY( int,   64, v, 16   );
+
+  const v16float q_8V( args->q_8V );
+
+  const int sy = args->sy;
+  const int sz = args->sz;
+
+  v16float dx, dy, dz, ux, uy, uz, q;
+  v16float w0, w1, w2, w3, w4, w5, w6, w7;
+  v16int   ii;
+
+  int itmp, nq;
+
+  // Determine which particle blocks this pipeline processes.
+
+  DISTRIBUTE( args->np, 16, pipeline_rank, n_pipeline, itmp, nq );
+
+  p = args->p0 + itmp;
+
+  nq >>= 4;
+
+  // Clear this pipeline's rho array.
+
+  r = args->r + (size_t) pipeline_rank * (size_t) args->stride;
+
+  CLEAR( r, args->nv );
+
+  // Process the particle blocks for this pipeline.
+
+  for( ; nq; nq--, p+=16 )
+  {
+    //--------------------------------------------------------------------------
+    // Load particle data.
+    //--------------------------------------------------------------------------
+    load_16x8_tr_p( &p[ 0].dx, &p[ 2].dx, &p[ 4].dx, &p[ 6].dx,
+                    &p[ 8].dx, &p[10].dx, &p[12].dx, &p[14].dx,
+                    dx, dy, dz, ii, ux, uy, uz, q );
+
+    //--------------------------------------------------------------------------
+    // Compute the trilinear weights.
+    //--------------------------------------------------------------------------
+    w7 = q * q_8V;
+    w6 = fnms( dx, w7, w7 );                     // q(1-dx)
+    w7 = fma(  dx, w7, w7 );                     // q(1+dx)
+    w4 = fnms( dy, w6, w6 );                     // q(1-dx)(1-dy)
+    w5 = fnms( dy, w7, w7 );                     // q(1+dx)(1-dy)
+    w6 = fma(  dy, w6, w6 );                     // q(1-dx)(1+dy)
+    w7 = fma(  dy, w7, w7 );                     // q(1+dx)(1+dy)
+    w0 = fnms( dz, w4, w4 );
+    w1 = fnms( dz, w5, w5 );
+    w2 = fnms( dz, w6, w6 );
+    w3 = fnms( dz, w7, w7 );
+    w4 = fma(  dz, w4, w4 );
+    w5 = fma(  dz, w5, w5 );
+    w6 = fma(  dz, w6, w6 );
+    w7 = fma(  dz, w7, w7 );
+
+    //--------------------------------------------------------------------------
+    // Store the weights and scatter them into the rho array.
+    //--------------------------------------------------------------------------
+    store_16x8_tr( w0, w1, w2, w3, w4, w5, w6, w7,
+                   w+  0, w+  8, w+ 16, w+ 24, w+ 32, w+ 40, w+ 48, w+ 56,
+                   w+ 64, w+ 72, w+ 80, w+ 88, w+ 96, w+104, w+112, w+120 );
+    store_16x1( ii, v );
+
+    accumulate_rho_p_block( r, w, v, 16, sy, sz );
+  }
+}
+
+void
+reduce_rho_p_pipeline_v16( accumulate_rho_p_pipeline_args_t * args,
+                           int pipeline_rank,
+                           int n_pipeline )
+{
+  field_t     * ALIGNED(128) f = args->f0;
+  const float * ALIGNED(64)  rr;
+
+  const size_t sr = args->stride;
+
+  v16float rho, t;
+
+  int i, i1, k;
+
+  // Pipelines get whole blocks of 16 voxels.
+
+  DISTRIBUTE( args->nv, 16, pipeline_rank, n_pipeline, i, i1 );
+
+  i1 += i;
+
+  for( ; i < i1; i+=16 )
+  {
+    load_16x1_tr( &f[i   ].rhof, &f[i+ 1].rhof, &f[i+ 2].rhof, &f[i+ 3].rhof,
+                  &f[i+ 4].rhof, &f[i+ 5].rhof, &f[i+ 6].rhof, &f[i+ 7].rhof,
+                  &f[i+ 8].rhof, &f[i+ 9].rhof, &f[i+10].rhof, &f[i+11].rhof,
+                  &f[i+12].rhof, &f[i+13].rhof, &f[i+14].rhof, &f[i+15].rhof,
+                  rho );
+
+    for( k = 0, rr = args->r + i; k < n_pipeline; k++, rr += sr )
+    {
+      load_16x1( rr, t );
+
+      rho += t;
+    }
+
+    store_16x1_tr( rho,
+                   &f[i   ].rhof, &f[i+ 1].rhof, &f[i+ 2].rhof, &f[i+ 3].rhof,
+                   &f[i+ 4].rhof, &f[i+ 5].rhof, &f[i+ 6].rhof, &f[i+ 7].rhof,
+                   &f[i+ 8].rhof, &f[i+ 9].rhof, &f[i+10].rhof, &f[i+11].rhof,
+                   &f[i+12].rhof, &f[i+13].rhof, &f[i+14].rhof, &f[i+15].rhof );
+  }
+}
+
+#else
+
+void
+accumulate_rho_p_pipeline_v16( accumulate_rho_p_pipeline_args_t * args,
+                               int pipeline_rank,
+                               int n_pipeline )
+{
+  // No v16 implementation.
+  ERROR( ( "No accumulate_rho_p_pipeline_v16 implementation." ) );
+}
+
+void
+reduce_rho_p_pipeline_v16( accumulate_rho_p_pipeline_args_t * args,
+                           int pipeline_rank,
+                           int n_pipeline )
+{
+  // No v16 implementation.
+  ERROR( ( "No reduce_rho_p_pipeline_v16 implementation." ) );
+}
+
+#endif
@@ -0,0 +1,251 @@
+#define IN_spa
+
+#include "spa_private.h"
+
+#include "../../../util/pipelines/pipelines_exec.h"
+
+// Hash a particle key (its tag or, for untagged species, its index)
+// into a 32-bit uniform deviate.  This is the 64-bit finalizer of
+// MurmurHash3; it is cheap and the result only depends on the seed and
+// the key.
+
+static inline uint32_t
+select_p_hash( uint64_t x )
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return (uint32_t)( x >> 32 );
+}
+
+//----------------------------------------------------------------------------//
+// Reference implementation for a select_p pipeline function which does not
+// make use of explicit calls to vector intrinsic functions.  Particles are
+// centered exactly as in center_p and the ones kept are compacted to the
+// front of the range this pipeline processes.
+//----------------------------------------------------------------------------//
+
+void
+select_p_pipeline_scalar( select_p_pipeline_args_t * args,
+                          int pipeline_rank,
+                          int n_pipeline )
+{
+  const interpolator_t * ALIGNED(128) f0 = args->f0;
+  const int64_t        * ALIGNED(128) t0 = args->tag;
+
+  particle_t           * ALIGNED(32)  p;
+  particle_t           * ALIGNED(32)  q;
+
+  const interpolator_t * ALIGNED(16)  f;
+
+  const float qdt_2mc        =     args->qdt_2mc;
+  const float qdt_4mc        = 0.5*args->qdt_2mc; // For half Boris rotate
+  const float one            = 1.0;
+  const float one_third      = 1.0/3.0;
+  const float two_fifteenths = 2.0/15.0;
+  const float min_ke         = args->min_ke;
+  const uint64_t seed        = ( (uint64_t)args->seed ) << 32;
+  const uint32_t thresh      = args->thresh;
+  const int sy               = args->sy;
+  const int sz               = args->sz;
+
+  float dx, dy, dz, ux, uy, uz;
+  float hax, hay, haz, cbx, cby, cbz;
+  float v0, v1, v2, v3, v4;
+  int   ii, ix, iy, iz;
+
+  int first, n, kept;
+  int64_t key;
+
+  // Determine which particles this pipeline processes.
+
+  DISTRIBUTE( args->np, 16, pipeline_rank, n_pipeline, first, n );
+
+  p = args->p0 + first;
+  q = p;
+
+  // Process particles for this pipeline.
+
+  for( kept = 0; n; n--, p++ )
+  {
+    dx   = p->dx;                            // Load position
+    dy   = p->dy;
+    dz   = p->dz;
+    ii   = p->i;
+
+    if ( args->use_box )                     // Spatial box
+    {
+      iz  = ii/sz;
+      iy  = ( ii - iz*sz )/sy;
+      ix  = ii - iz*sz - iy*sy;
+      v0  = ( ix - 0.5f ) + 0.5f*dx;         // Local cell coordinates
+      v1  = ( iy - 0.5f ) + 0.5f*dy;
+      v2  = ( iz - 0.5f ) + 0.5f*dz;
+
+      if ( v0 < args->bx0 || v0 > args->bx1 ||
+           v1 < args->by0 || v1 > args->by1 ||
+           v2 < args->bz0 || v2 > args->bz1 ) continue;
+    }
+
+    key = t0 ? t0[ p - args->p0 ] : args->index0 + ( p - args->p0 );
+
+    if ( args->use_tag &&                    // Tag range
+         ( key < args->tag0 || key > args->tag1 ) ) continue;
+
+    if ( thresh &&                           // Random sample
+         select_p_hash( seed ^ (uint64_t)key ) >= thresh ) continue;
+
+    f    = f0 + ii;                          // Interpolate E
+
+    hax  = qdt_2mc*(    ( f->ex    + dy*f->dexdy    ) +
+                     dz*( f->dexdz + dy*f->d2exdydz ) );
+
+    hay  = qdt_2mc*(    ( f->ey    + dz*f->deydz    ) +
+                     dx*( f->deydx + dz*f->d2eydzdx ) );
+
+    haz  = qdt_2mc*(    ( f->ez    + dx*f->dezdx    ) +
+                     dy*( f->dezdy + dx*f->d2ezdxdy ) );
+
+    cbx  = f->cbx + dx*f->dcbxdx;            // Interpolate B
+    cby  = f->cby + dy*f->dcbydy;
+    cbz  = f->cbz + dz*f->dcbzdz;
+
+    ux   = p->ux;                            // Load momentum
+    uy   = p->uy;
+    uz   = p->uz;
+
+    ux  += hax;                              // Half advance E
+    uy  += hay;
+    uz  += haz;
+
+    v0   = qdt_4mc/(float)sqrt(one + (ux*ux + (uy*uy + uz*uz)));
+    /**/                                     // Boris - scalars
+    v1   = cbx*cbx + (cby*cby + cbz*cbz);
+    v2   = (v0*v0)*v1;
+    v3   = v0*(one+v2*(one_third+v2*two_fifteenths));
+    v4   = v3/(one+v1*(v3*v3));
+    v4  += v4;
+
+    v0   = ux + v3*( uy*cbz - uz*cby );      // Boris - uprime
+    v1   = uy + v3*( uz*cbx - ux*cbz );
+    v2   = uz + v3*( ux*cby - uy*cbx );
+
+    ux  += v4*( v1*cbz - v2*cby );           // Boris - rotation
+    uy  += v4*( v2*cbx - v0*cbz );
+    uz  += v4*( v0*cby - v1*cbx );
+
+    if ( min_ke > 0 )                        // Energy threshold
+    {
+      v0 = ux*ux + (uy*uy + uz*uz);
+      if ( v0/(one + sqrtf(one + v0)) < min_ke ) continue;
+    }
+
+    q->dx = dx;                              // Store kept particle
+    q->dy = dy;
+    q->dz = dz;
+    q->i  = ii;
+    q->ux = ux;
+    q->uy = uy;
+    q->uz = uz;
+    q->w  = p->w;
+    if ( args->tag_out ) args->tag_out[ ( q - args->p0 ) ] = key;
+    q++, kept++;
+  }
+
+  args->first[pipeline_rank] = first;
+  args->kept [pipeline_rank] = kept;
+}
+
+//----------------------------------------------------------------------------//
+// Top level function to select and call the proper select_p pipeline
+// function.
+//----------------------------------------------------------------------------//
+
+int
+select_p_pipeline( species_t * RESTRICT sp,
+                   const interpolator_array_t * RESTRICT ia,
+                   const particle_select_t * RESTRICT sel,
+                   int64_t index0,
+                   int64_t * RESTRICT tag_out )
+{
+  DECLARE_ALIGNED_ARRAY( select_p_pipeline_args_t, 128, args, 1 );
+
+  DECLARE_ALIGNED_ARRAY( int, 128, first, MAX_PIPELINE+1 );
+  DECLARE_ALIGNED_ARRAY( int, 128, kept,  MAX_PIPELINE+1 );
+
+  const grid_t * g;
+  int rank, np;
+
+  if ( !sp  ||
+       !ia  ||
+       !sel ||
+       sp->g != ia->g )
+  {
+    ERROR( ( "Bad args" ) );
+  }
+
+  if ( sel->use_tag && !sp->tag )
+  {
+    ERROR( ( "Species \"%s\" is not tagged", sp->name ) );
+  }
+
+  g = sp->g;
+
+  // Have the pipelines do the bulk of particles in blocks and have the
+  // host do the final incomplete block.
+
+  args->p0      = sp->p;
+  args->f0      = ia->i;
+  args->first   = first;
+  args->kept    = kept;
+  args->tag     = sp->tag ? sp->tag + index0 : NULL;
+  args->tag_out = sp->tag ? tag_out : NULL;
+  args->qdt_2mc = (sp->q*g->dt)/(2*sp->m*g->cvac);
+  args->min_ke  = sel->min_ke;
+  args->bx0     = ( sel->x0 - g->x0 )/g->dx;
+  args->by0     = ( sel->y0 - g->y0 )/g->dy;
+  args->bz0     = ( sel->z0 - g->z0 )/g->dz;
+  args->bx1     = ( sel->x1 - g->x0 )/g->dx;
+  args->by1     = ( sel->y1 - g->y0 )/g->dy;
+  args->bz1     = ( sel->z1 - g->z0 )/g->dz;
+  args->thresh  = ( sel->fraction > 0 && sel->fraction < 1 ) ?
+                  (uint32_t)( sel->fraction*4294967296.0 ) : 0;
+  args->seed    = sel->seed;
+  args->index0  = index0;
+  args->tag0    = sel->tag0;
+  args->tag1    = sel->tag1;
+  args->use_box = sel->use_box;
+  args->use_tag = sel->use_tag;
+  args->sy      = g->sy;
+  args->sz      = g->sz;
+  args->np      = sp->np;
+
+  // A fraction small enough to round to zero keeps nothing.
+
+  if ( sel->fraction > 0 && sel->fraction < 1 && !args->thresh ) return 0;
+
+  EXEC_PIPELINES( select_p, args, 0 );
+  WAIT_PIPELINES();
+
+  // Pack the kept particles of each pipeline behind those of the
+  // previous pipelines.  Pipeline 0 is already in place.
+
+  np = kept[0];
+  for( rank = 1; rank <= N_PIPELINE; rank++ )
+  {
+    if ( kept[rank] && first[rank] != np )
+    {
+      memmove( sp->p + np, sp->p + first[rank],
+               kept[rank]*sizeof(particle_t) );
+
+      if ( args->tag_out )
+        memmove( tag_out + np, tag_out + first[rank],
+                 kept[rank]*sizeof(int64_t) );
+    }
+    np += kept[rank];
+  }
+
+  return np;
+}
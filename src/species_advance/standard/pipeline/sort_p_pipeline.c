@@ -7,6 +7,7 @@
 // March/April 2004 - Revised and extened from earlier V4PIC versions.
 //============================================================================//
 
+#define MEM_TAG "sort"
 #define IN_spa
 
 #include "spa_private.h"
@@ -86,7 +87,7 @@ coarse_sort_pipeline_scalar( sort_p_pipeline_args_t * args,
   const particle_t * RESTRICT ALIGNED(128) p_src = args->p;
   /**/  particle_t * RESTRICT ALIGNED(128) p_dst = args->aux_p;
 
-  int i, i1;
+  int i, i0, i1;
   int n_subsort = args->n_subsort;
   int vl        = args->vl;
   int vh        = args->vh;
@@ -111,6 +112,7 @@ coarse_sort_pipeline_scalar( sort_p_pipeline_args_t * args,
   DISTRIBUTE( args->n, 1, pipeline_rank, n_pipeline, i, i1 );
 
   i1 += i;
+  i0  = i;
 
   // Load the local coarse partitioning into next.
   COPY( next,
@@ -133,6 +135,23 @@ coarse_sort_pipeline_scalar( sort_p_pipeline_args_t * args,
 
 #   endif
   }
+
+  // Move the tags the same way.  This is a separate pass so untagged
+  // species pay nothing for it.
+  if ( args->tag )
+  {
+    const int64_t * RESTRICT ALIGNED(128) t_src = args->tag;
+    /**/  int64_t * RESTRICT ALIGNED(128) t_dst = args->aux_tag;
+
+    COPY( next,
+          args->coarse_partition + cp_stride*pipeline_rank,
+          n_subsort );
+
+    for( i = i0; i < i1; i++ )
+    {
+      t_dst[ next[ V2P( p_src[i].i, n_subsort, vl, vh ) ]++ ] = t_src[i];
+    }
+  }
 }
 
 //----------------------------------------------------------------------------//
@@ -210,6 +229,27 @@ subsort_pipeline_scalar( sort_p_pipeline_args_t * args,
 
 #     endif
     }
+
+    // Move the tags the same way (see coarse_sort).
+    if ( args->tag )
+    {
+      const int64_t * RESTRICT ALIGNED(128) t_src = args->aux_tag;
+      /**/  int64_t * RESTRICT ALIGNED(128) t_dst = args->tag;
+
+      COPY( &next[v0], &partition[v0], v1 - v0 );
+
+      for( i = i0; i < i1; i++ )
+      {
+        t_dst[ next[ p_src[i].i ]++ ] = t_src[i];
+      }
+    }
+
+    // Hand the sorted voxels to the fused operation while their
+    // particles are still in cache.
+    if ( args->op )
+    {
+      args->op( args->op_params, v0, v1, pipeline_rank );
+    }
   }
 }
 
@@ -218,7 +258,9 @@ subsort_pipeline_scalar( sort_p_pipeline_args_t * args,
 //----------------------------------------------------------------------------//
 
 void
-sort_p_pipeline( species_t * sp )
+sort_p_pipeline( species_t * sp,
+                 sort_voxel_func_t op,
+                 void * params )
 {
   if ( !sp )
   {
@@ -235,6 +277,9 @@ sort_p_pipeline( species_t * sp )
   particle_t * RESTRICT ALIGNED(128) p = sp->p;
   particle_t * RESTRICT ALIGNED(128) aux_p;
 
+  int64_t * RESTRICT ALIGNED(128) tag = sp->tag;
+  int64_t * RESTRICT ALIGNED(128) aux_tag = NULL;
+
   int n_particle = sp->np;
 
   int * RESTRICT ALIGNED(128) partition = sp->partition;
@@ -274,6 +319,11 @@ sort_p_pipeline( species_t * sp )
 		 128                            +
                  sizeof( *coarse_partition ) * ( cp_stride * n_pipeline + 1 ) );
 
+  if ( tag )
+  {
+    sz_scratch += 128 + sizeof( *tag ) * n_particle;
+  }
+
   if ( sz_scratch > max_scratch )
   {
     FREE_ALIGNED( scratch );
@@ -287,11 +337,21 @@ sort_p_pipeline( species_t * sp )
   next             = ALIGN_PTR( int,        aux_p + n_particle, 128 );
   coarse_partition = ALIGN_PTR( int,        next  + n_voxel,    128 );
 
+  if ( tag )
+  {
+    aux_tag = ALIGN_PTR( int64_t, coarse_partition + cp_stride * n_pipeline + 1,
+                         128 );
+  }
+
   // Setup pipeline arguments.
   args->p                = p;
   args->aux_p            = aux_p;
   args->coarse_partition = coarse_partition;
   args->next             = next;
+  args->tag              = tag;
+  args->aux_tag          = aux_tag;
+  args->op               = op;
+  args->op_params        = params;
   args->partition        = partition;
   args->n                = n_particle;
   args->n_subsort        = n_subsort;
@@ -352,6 +412,13 @@ sort_p_pipeline( species_t * sp )
 
     args->p     = aux_p;
     args->aux_p = p;
+    args->op    = NULL;
+
+    if ( tag )
+    {
+      args->tag     = aux_tag;
+      args->aux_tag = tag;
+    }
 
     subsort_pipeline_scalar( args, 0, 1 );
 
@@ -367,5 +434,17 @@ sort_p_pipeline( species_t * sp )
     // TO MOVE SP->P AROUND AND DO MORE MALLOCS PER STEP I.E. HEAP
     // FRAGMENTATION, COULD AVOID THIS COPY.
     COPY( p, aux_p, n_particle );
+
+    if ( tag )
+    {
+      COPY( tag, aux_tag, n_particle );
+    }
+
+    // The sorted particles only land in the particle array here, so the
+    // fused operation gets all the voxels at once.
+    if ( op )
+    {
+      op( params, vl, vh + 1, 0 );
+    }
   }
 }
@@ -10,14 +10,25 @@
 ///////////////////////////////////////////////////////////////////////////////
 // advance_p_pipeline interface
 
+// Pipelines take the species movers on demand in blocks of MOVER_BLOCK
+// movers (1KB, so blocks stay 128-byte aligned).  A pipeline that
+// needs a mover when no blocks are left keeps the rest of its movers
+// in a private overflow list.  advance_p_pipeline then gathers the
+// movers of each pipeline in pipeline order (growing the mover array
+// if needed), so no mover is ever dropped.
+
+#define MOVER_BLOCK 64
+
 typedef struct particle_mover_seg
 {
-  MEM_PTR( particle_mover_t, 16 ) pm; // First mover in segment
-  int max_nm;                         // Maximum number of movers
-  int nm;                             // Number of movers used
-  int n_ignored;                      // Number of movers ignored
+  MEM_PTR( particle_mover_t, 16 ) pm; // Block (or overflow list) in use
+  int max_nm;                         // Movers pm can hold
+  int nm;                             // Movers in pm
+  int block;                          // Block in use (-1: overflow list,
+                                      //               -2: none yet)
+  int first;                          // First block used (-1 if none)
 
-  PAD_STRUCT( SIZEOF_MEM_PTR+3*sizeof(int) )
+  PAD_STRUCT( SIZEOF_MEM_PTR+4*sizeof(int) )
 
 } particle_mover_seg_t;
 
@@ -29,6 +40,9 @@ typedef struct advance_p_pipeline_args
   MEM_PTR( const interpolator_t, 128 ) f0;       // Interpolator array
   MEM_PTR( particle_mover_seg_t, 128 ) seg;      // Dest for return values
   MEM_PTR( const grid_t,         1   ) g;        // Local domain grid params
+  MEM_PTR( int,                  128 ) block_nm; // Movers in each block
+  MEM_PTR( int,                  128 ) block_next; // Next block of its pipeline
+  MEM_PTR( int,                  16  ) next_block; // Next block to hand out
 
   float                                qdt_2mc;  // Particle/field coupling
   float                                cdt_dx;   // x-space/time coupling
@@ -38,16 +52,38 @@ typedef struct advance_p_pipeline_args
 
   int                                  np;       // Number of particles
   int                                  max_nm;   // Number of movers
+  int                                  n_block;  // Number of mover blocks
   int                                  nx;       // x-mesh resolution
   int                                  ny;       // y-mesh resolution
   int                                  nz;       // z-mesh resolution
  
-  PAD_STRUCT( 6*SIZEOF_MEM_PTR + 5*sizeof(float) + 5*sizeof(int) )
+  PAD_STRUCT( 9*SIZEOF_MEM_PTR + 5*sizeof(float) + 6*sizeof(int) )
 
 } advance_p_pipeline_args_t;
 
 // PROTOTYPE_PIPELINE( advance_p, advance_p_pipeline_args_t );
 
+// Called by a pipeline when the movers in seg are full (seg->nm must
+// be current).  Returns the movers to continue with (seg->pm) and
+// updates seg->nm and seg->max_nm.
+
+particle_mover_t *
+next_movers( advance_p_pipeline_args_t * args,
+             particle_mover_seg_t * seg );
+
+// Set up the mover blocks and segments of args before the pipelines
+// run (args->pm, args->max_nm, args->seg and args->next_block must be
+// set) and gather the movers into sp->pm (setting sp->nm) after they
+// are done.
+
+void
+begin_movers( species_t * sp,
+              advance_p_pipeline_args_t * args );
+
+void
+end_movers( species_t * sp,
+            advance_p_pipeline_args_t * args );
+
 void
 advance_p_pipeline_scalar( advance_p_pipeline_args_t * args,
                            int pipeline_rank,
@@ -125,6 +161,44 @@ uncenter_p_pipeline_v16( center_p_pipeline_args_t * args,
                          int pipeline_rank,
                          int n_pipeline );
 
+///////////////////////////////////////////////////////////////////////////////
+// select_p_pipeline interface
+
+typedef struct select_p_pipeline_args
+{
+  MEM_PTR( particle_t,           128 ) p0;      // Particle array
+  MEM_PTR( const interpolator_t, 128 ) f0;      // Interpolator array
+  MEM_PTR( int,                  128 ) first;   // Return first particle
+  MEM_PTR( int,                  128 ) kept;    // Return number kept
+  MEM_PTR( const int64_t,        128 ) tag;     // Particle tags or NULL
+  MEM_PTR( int64_t,              128 ) tag_out; // Kept tags or NULL
+  float                                qdt_2mc; // Particle/field coupling
+  float                                min_ke;  // Energy threshold
+  float                                bx0, by0, bz0; // Box low corner and
+  float                                bx1, by1, bz1; // high corner (in
+  /**/                                          // local cell coordinates)
+  uint32_t                             thresh;  // Sample threshold
+  uint32_t                             seed;    // Sample seed
+  int64_t                              index0;  // Index of first particle
+  int64_t                              tag0;    // Tag range low
+  int64_t                              tag1;    // Tag range high
+  int                                  use_box; // Box test enabled
+  int                                  use_tag; // Tag test enabled
+  int                                  sy, sz;  // Voxel strides
+  int                                  np;      // Number of particles
+
+  PAD_STRUCT( 6*SIZEOF_MEM_PTR + 8*sizeof(float) + 2*sizeof(uint32_t) +
+              3*sizeof(int64_t) + 5*sizeof(int) )
+
+} select_p_pipeline_args_t;
+
+// PROTOTYPE_PIPELINE( select_p, select_p_pipeline_args_t );
+
+void
+select_p_pipeline_scalar( select_p_pipeline_args_t * args,
+                          int pipeline_rank,
+                          int n_pipeline );
+
 ///////////////////////////////////////////////////////////////////////////////
 // energy_p_pipeline interface
 
@@ -163,6 +237,223 @@ energy_p_pipeline_v16( energy_p_pipeline_args_t * args,
                        int pipeline_rank,
                        int n_pipeline );
 
+///////////////////////////////////////////////////////////////////////////////
+// accumulate_hydro_p_pipeline interface
+
+typedef struct accumulate_hydro_p_pipeline_args
+{
+  MEM_PTR( const particle_t,     128 ) p0;       // Particle array
+  MEM_PTR( const interpolator_t, 128 ) f0;       // Interpolator array
+  MEM_PTR( hydro_t,              128 ) h0;       // Hydro array (host)
+  MEM_PTR( hydro_t,              128 ) h;        // Pipeline hydro arrays
+  float                                qsp;      // Species particle charge
+  float                                mspc;     // Species rest mass * c
+  float                                qdt_2mc;  // Particle/field coupling
+  float                                qdt_4mc2; // For half Boris rotate
+  float                                r8V;      // 1/(8 voxel volume)
+  float                                cvac;     // Speed of light
+  int                                  np;       // Number of particles
+  int                                  nv;       // Voxels per hydro array
+  int                                  stride;   // Hydro array stride
+  int                                  s10;      // Voxel stride, +x
+  int                                  s21;      // Voxel stride, -x +y
+  int                                  s43;      // Voxel stride, -x -y +z
+
+  PAD_STRUCT( 4*SIZEOF_MEM_PTR + 6*sizeof(float) + 6*sizeof(int) )
+
+} accumulate_hydro_p_pipeline_args_t;
+
+// PROTOTYPE_PIPELINE( accumulate_hydro_p,
+//                     accumulate_hydro_p_pipeline_args_t );
+
+void
+accumulate_hydro_p_pipeline_scalar( accumulate_hydro_p_pipeline_args_t * args,
+                                    int pipeline_rank,
+                                    int n_pipeline );
+
+void
+accumulate_hydro_p_pipeline_v4( accumulate_hydro_p_pipeline_args_t * args,
+                                int pipeline_rank,
+                                int n_pipeline );
+
+void
+accumulate_hydro_p_pipeline_v8( accumulate_hydro_p_pipeline_args_t * args,
+                                int pipeline_rank,
+                                int n_pipeline );
+
+// PROTOTYPE_PIPELINE( reduce_hydro_p, accumulate_hydro_p_pipeline_args_t );
+
+void
+reduce_hydro_p_pipeline_scalar( accumulate_hydro_p_pipeline_args_t * args,
+                                int pipeline_rank,
+                                int n_pipeline );
+
+void
+reduce_hydro_p_pipeline_v4( accumulate_hydro_p_pipeline_args_t * args,
+                            int pipeline_rank,
+                            int n_pipeline );
+
+void
+reduce_hydro_p_pipeline_v8( accumulate_hydro_p_pipeline_args_t * args,
+                            int pipeline_rank,
+                            int n_pipeline );
+
+// The vector accumulate_hydro_p pipelines compute the centered
+// velocity, momentum, kinetic energy and trilinear weights of a block
+// of particles in SIMD and store them transposed, one 16 float record
+// per particle:
+//
+//   vx, vy, vz, ke_mc, ux, uy, uz, i (int bits), w0, w1, ..., w7
+//
+// This scatters such a block of records into the hydro array h.
+
+static inline void
+accumulate_hydro_p_block( hydro_t     * RESTRICT ALIGNED(128) h,
+                          const float * RESTRICT ALIGNED(64)  b,
+                          int n,
+                          float qsp,
+                          float mspc,
+                          int s10,
+                          int s21,
+                          int s43 )
+{
+  float vx, vy, vz, ke_mc, ux, uy, uz, t, px, py, pz;
+  int i;
+
+  for( ; n; n--, b+=16 )
+  {
+    vx    = b[0];
+    vy    = b[1];
+    vz    = b[2];
+    ke_mc = b[3];
+    ux    = b[4];
+    uy    = b[5];
+    uz    = b[6];
+    i     = ( (const int *) b )[7];
+
+#   define ACCUM_HYDRO( wn )                                           \
+    t  = qsp*(wn);                                                     \
+    h[i].jx  += t*vx;                                                  \
+    h[i].jy  += t*vy;                                                  \
+    h[i].jz  += t*vz;                                                  \
+    h[i].rho += t;                                                     \
+    t  = mspc*(wn);                                                    \
+    px = t*ux;                                                         \
+    py = t*uy;                                                         \
+    pz = t*uz;                                                         \
+    h[i].px  += px;                                                    \
+    h[i].py  += py;                                                    \
+    h[i].pz  += pz;                                                    \
+    h[i].ke  += t*ke_mc;                                               \
+    h[i].txx += px*vx;                                                 \
+    h[i].tyy += py*vy;                                                 \
+    h[i].tzz += pz*vz;                                                 \
+    h[i].tyz += py*vz;                                                 \
+    h[i].tzx += pz*vx;                                                 \
+    h[i].txy += px*vy
+
+    /**/      ACCUM_HYDRO( b[ 8] ); // Cell i,j,k
+    i += s10; ACCUM_HYDRO( b[ 9] ); // Cell i+1,j,k
+    i += s21; ACCUM_HYDRO( b[10] ); // Cell i,j+1,k
+    i += s10; ACCUM_HYDRO( b[11] ); // Cell i+1,j+1,k
+    i += s43; ACCUM_HYDRO( b[12] ); // Cell i,j,k+1
+    i += s10; ACCUM_HYDRO( b[13] ); // Cell i+1,j,k+1
+    i += s21; ACCUM_HYDRO( b[14] ); // Cell i,j+1,k+1
+    i += s10; ACCUM_HYDRO( b[15] ); // Cell i+1,j+1,k+1
+
+#   undef ACCUM_HYDRO
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// accumulate_rho_p_pipeline interface
+
+typedef struct accumulate_rho_p_pipeline_args
+{
+  MEM_PTR( const particle_t, 128 ) p0;     // Particle array
+  MEM_PTR( field_t,          128 ) f0;     // Field array (host)
+  MEM_PTR( float,            128 ) r;      // Pipeline rho arrays
+  float                            q_8V;   // Species charge / (8 V)
+  int                              np;     // Number of particles
+  int                              nv;     // Voxels per rho array
+  int                              stride; // Rho array stride
+  int                              sy;     // Voxel stride, +y
+  int                              sz;     // Voxel stride, +z
+
+  PAD_STRUCT( 3*SIZEOF_MEM_PTR + sizeof(float) + 5*sizeof(int) )
+
+} accumulate_rho_p_pipeline_args_t;
+
+// PROTOTYPE_PIPELINE( accumulate_rho_p, accumulate_rho_p_pipeline_args_t );
+
+void
+accumulate_rho_p_pipeline_scalar( accumulate_rho_p_pipeline_args_t * args,
+                                  int pipeline_rank,
+                                  int n_pipeline );
+
+void
+accumulate_rho_p_pipeline_v4( accumulate_rho_p_pipeline_args_t * args,
+                              int pipeline_rank,
+                              int n_pipeline );
+
+void
+accumulate_rho_p_pipeline_v8( accumulate_rho_p_pipeline_args_t * args,
+                              int pipeline_rank,
+                              int n_pipeline );
+
+void
+accumulate_rho_p_pipeline_v16( accumulate_rho_p_pipeline_args_t * args,
+                               int pipeline_rank,
+                               int n_pipeline );
+
+// PROTOTYPE_PIPELINE( reduce_rho_p, accumulate_rho_p_pipeline_args_t );
+
+void
+reduce_rho_p_pipeline_scalar( accumulate_rho_p_pipeline_args_t * args,
+                              int pipeline_rank,
+                              int n_pipeline );
+
+void
+reduce_rho_p_pipeline_v4( accumulate_rho_p_pipeline_args_t * args,
+                          int pipeline_rank,
+                          int n_pipeline );
+
+void
+reduce_rho_p_pipeline_v8( accumulate_rho_p_pipeline_args_t * args,
+                          int pipeline_rank,
+                          int n_pipeline );
+
+void
+reduce_rho_p_pipeline_v16( accumulate_rho_p_pipeline_args_t * args,
+                           int pipeline_rank,
+                           int n_pipeline );
+
+// The vector accumulate_rho_p pipelines compute the trilinear charge
+// weights of a block of particles in SIMD and store them transposed,
+// 8 floats per particle, along with the particle voxel indices.  This
+// scatters such a block into the rho array r.
+
+static inline void
+accumulate_rho_p_block( float       * RESTRICT ALIGNED(128) r,
+                        const float * RESTRICT ALIGNED(32)  w,
+                        const int   * RESTRICT ALIGNED(16)  ii,
+                        int n,
+                        int sy,
+                        int sz )
+{
+  int v;
+
+  for( ; n; n--, w+=8, ii++ )
+  {
+    v = *ii;
+
+    r[v      ] += w[0]; r[v      +1] += w[1];
+    r[v   +sy] += w[2]; r[v   +sy+1] += w[3];
+    r[v+sz   ] += w[4]; r[v+sz   +1] += w[5];
+    r[v+sz+sy] += w[6]; r[v+sz+sy+1] += w[7];
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sort_p_pipeline interface
 
@@ -200,12 +491,16 @@ typedef struct sort_p_pipeline_args
   /**/ // (0:max_subsort-1,0:MAX_PIPELINE-1)
   MEM_PTR( int,        128 ) partition;        // Partitioning (0:n_voxel)
   MEM_PTR( int,        128 ) next;             // Aux partitioning (0:n_voxel)
+  MEM_PTR( int64_t,    128 ) tag;              // Particle tags (0:n-1) or NULL
+  MEM_PTR( int64_t,    128 ) aux_tag;          // Aux tag storage (0:n-1)
+  sort_voxel_func_t          op;               // Applied to each sorted
+  MEM_PTR( void,       1   ) op_params;        // voxel range (or NULL)
   int n;         // Number of particles
   int n_subsort; // Number of pipelines to be used for subsorts
   int vl, vh;    // Particles may be contained in voxels [vl,vh].
   int n_voxel;   // Number of voxels total (including ghosts)
 
-  PAD_STRUCT( 5*SIZEOF_MEM_PTR + 5*sizeof(int) )
+  PAD_STRUCT( 8*SIZEOF_MEM_PTR + sizeof(sort_voxel_func_t) + 5*sizeof(int) )
 
 } sort_p_pipeline_args_t;
 
@@ -228,4 +523,75 @@ subsort_pipeline_scalar( sort_p_pipeline_args_t * args,
                          int pipeline_rank,
                          int n_pipeline );
 
+///////////////////////////////////////////////////////////////////////////////
+// inject_p_pipeline interface
+
+// What each pipeline made in the generate stage and the movers of the
+// particles it aged that ended up on a boundary in the finish stage.
+// The mover lists are private to the pipelines and double as needed.
+
+typedef struct inject_p_seg
+{
+  MEM_PTR( particle_mover_t, 16 ) pm; // Mover list
+  int max_nm;                         // Movers pm can hold
+  int nm;                             // Movers in pm
+  int first;                          // First slot of the pipeline
+  int np;                             // Particles made from its slots
+
+  PAD_STRUCT( SIZEOF_MEM_PTR+4*sizeof(int) )
+
+} inject_p_seg_t;
+
+typedef struct inject_p_pipeline_args
+{
+  MEM_PTR( particle_t,       128 ) p;      // First new particle
+  MEM_PTR( float,            128 ) age;    // Ages of the new particles
+  MEM_PTR( int64_t,          128 ) tag;    // Tags of the new ones (or NULL)
+  MEM_PTR( float,            128 ) r;      // Pipeline rhob arrays (or NULL)
+  MEM_PTR( field_t,          128 ) f;      // Field array (or NULL)
+  MEM_PTR( accumulator_t,    128 ) a0;     // Accumulator arrays
+  MEM_PTR( particle_t,       128 ) p0;     // Particle array
+  MEM_PTR( const grid_t,     1   ) g;      // Local domain grid params
+  MEM_PTR( inject_p_seg_t,   128 ) seg;    // Per pipeline results
+  MEM_PTR( void,             1   ) params; // Generator parameters
+  MEM_PTR( rng_t,            128 ) rng[ MAX_PIPELINE ]; // Or NULL
+  particle_generator_func_t        gen;    // Particle generator
+  int64_t                          step;   // Timestep of the rng substreams
+  int64_t                          tag0;   // Tag of the first new particle
+  float                            qsp;    // Species particle charge
+  int                              np0;    // Particles before the injection
+  int                              n;      // Slots (generate stage) or new
+  /**/                                     // particles (finish stage)
+  int                              block;  // Slots per block
+  int                              seed;   // Seed of the rng substreams
+  int                              stream; // Stream of the rng substreams
+  int                              nv;     // Voxels per rhob array
+  int                              stride; // Rhob array stride
+  int                              a_stride; // Accumulator array stride
+
+  PAD_STRUCT( (10+MAX_PIPELINE)*SIZEOF_MEM_PTR +
+              sizeof(particle_generator_func_t) + 2*sizeof(int64_t) +
+              sizeof(float) + 8*sizeof(int) )
+
+} inject_p_pipeline_args_t;
+
+// PROTOTYPE_PIPELINE( inject_p_generate, inject_p_pipeline_args_t );
+// PROTOTYPE_PIPELINE( inject_p_finish,   inject_p_pipeline_args_t );
+// PROTOTYPE_PIPELINE( inject_p_reduce,   inject_p_pipeline_args_t );
+
+void
+inject_p_generate_pipeline_scalar( inject_p_pipeline_args_t * args,
+                                   int pipeline_rank,
+                                   int n_pipeline );
+
+void
+inject_p_finish_pipeline_scalar( inject_p_pipeline_args_t * args,
+                                 int pipeline_rank,
+                                 int n_pipeline );
+
+void
+inject_p_reduce_pipeline_scalar( inject_p_pipeline_args_t * args,
+                                 int pipeline_rank,
+                                 int n_pipeline );
+
 #endif // _spa_private_h_
@@ -22,93 +22,9 @@
 void
 accumulate_rho_p( /**/  field_array_t * RESTRICT fa,
                   const species_t     * RESTRICT sp ) {
-  if( !fa || !sp || fa->g!=sp->g ) ERROR(( "Bad args" ));
-
-  /**/  field_t    * RESTRICT ALIGNED(128) f = fa->f;
-  const particle_t * RESTRICT ALIGNED(128) p = sp->p;
-
-  const float q_8V = sp->q*sp->g->r8V;
-  const int np = sp->np;
-  const int sy = sp->g->sy;
-  const int sz = sp->g->sz;
-
-# if 1
-  float w0, w1, w2, w3, w4, w5, w6, w7, dz;
-# else
-  using namespace v4;
-  v4float q, wl, wh, rl, rh;
-# endif
-
-  int n, v;
-
-  // Load the grid data
-
-  for( n=0; n<np; n++ ) {
-
-#   if 1
-    // After detailed experiments and studying of assembly dumps, it was
-    // determined that if the platform does not support efficient 4-vector
-    // SIMD memory gather/scatter operations, the savings from using
-    // "trilinear" are slightly outweighed by the overhead of the
-    // gather/scatters.
- 
-    // Load the particle data
-
-    w0 = p[n].dx;
-    w1 = p[n].dy;
-    dz = p[n].dz;
-    v  = p[n].i;
-    w7 = p[n].w*q_8V;
-
-    // Compute the trilinear weights
-    // Though the PPE should have hardware fma/fmaf support, it was
-    // measured to be more efficient _not_ to use it here.  (Maybe the
-    // compiler isn't actually generating the assembly for it.
-
-#   define FMA( x,y,z) ((z)+(x)*(y))
-#   define FNMS(x,y,z) ((z)-(x)*(y))
-    w6=FNMS(w0,w7,w7);                    // q(1-dx)
-    w7=FMA( w0,w7,w7);                    // q(1+dx)
-    w4=FNMS(w1,w6,w6); w5=FNMS(w1,w7,w7); // q(1-dx)(1-dy), q(1+dx)(1-dy)
-    w6=FMA( w1,w6,w6); w7=FMA( w1,w7,w7); // q(1-dx)(1+dy), q(1+dx)(1+dy)
-    w0=FNMS(dz,w4,w4); w1=FNMS(dz,w5,w5); w2=FNMS(dz,w6,w6); w3=FNMS(dz,w7,w7);
-    w4=FMA( dz,w4,w4); w5=FMA( dz,w5,w5); w6=FMA( dz,w6,w6); w7=FMA( dz,w7,w7);
-#   undef FNMS
-#   undef FMA
-
-    // Reduce the particle charge to rhof
-
-    f[v      ].rhof += w0; f[v      +1].rhof += w1;
-    f[v   +sy].rhof += w2; f[v   +sy+1].rhof += w3;
-    f[v+sz   ].rhof += w4; f[v+sz   +1].rhof += w5;
-    f[v+sz+sy].rhof += w6; f[v+sz+sy+1].rhof += w7;
-
-#   else
-
-    // Gather rhof for this voxel
-
-    v = p[n].i;
-    rl = v4float( f[v      ].rhof, f[v      +1].rhof,
-                  f[v   +sy].rhof, f[v   +sy+1].rhof);
-    rh = v4float( f[v+sz   ].rhof, f[v+sz   +1].rhof,
-                  f[v+sz+sy].rhof, f[v+sz+sy+1].rhof);
-
-    // Compute the trilinear weights
-
-    load_4x1( &p[n].dx, wl );
-    trilinear( wl, wh );
-    
-    // Reduce the particle charge to rhof and scatter the result
-
-    q = v4float( p[n].w*q_8V );
-    store_4x1_tr( fma(q,wl,rl), &f[v      ].rhof, &f[v      +1].rhof,
-                                &f[v   +sy].rhof, &f[v   +sy+1].rhof );
-    store_4x1_tr( fma(q,wh,rh), &f[v+sz   ].rhof, &f[v+sz   +1].rhof,
-                                &f[v+sz+sy].rhof, &f[v+sz+sy+1].rhof );
-
-#   endif
-
-  }
+  // Once more options are available, this should be conditionally executed
+  // based on user choice.
+  accumulate_rho_p_pipeline( fa, sp );
 }
 
 #if 0
@@ -122,20 +38,33 @@ static const v4float ay[4] = { v4float(1,1,1,1), v4float(2,2,1,1),
                                v4float(1,1,2,2), v4float(2,2,2,2) };
 #endif
 
-void
-accumulate_rhob( field_t          * RESTRICT ALIGNED(128) f,
-                 const particle_t * RESTRICT ALIGNED(32)  p,
-                 const grid_t     * RESTRICT              g,
-                 const float                              qsp ) {
-# if 1
+// Scatter the charge of p to the rhob values r[0], r[s], r[2s], ... of
+// the voxels (r is the rhob of a field array when s is the number of
+// floats in a field_t).
+
+static inline void
+scatter_rhob( float            * RESTRICT              r,
+              const size_t                             s,
+              const particle_t * RESTRICT ALIGNED(32)  p,
+              const grid_t     * RESTRICT              g,
+              const float                              qsp ) {
+
+  // After detailed experiments and studying of assembly dumps, it was
+  // determined that if the platform does not support efficient 4-vector
+  // SIMD memory gather/scatter operations, the savings from using
+  // "trilinear" are slightly outweighed by the overhead of the
+  // gather/scatters.  The accumulate_rho_p pipelines instead compute the
+  // weights for several particles at once and scatter them one particle
+  // at a time.
 
-  // See note in rhof for why this variant is used.
   float w0 = p->dx, w1 = p->dy, w2, w3, w4, w5, w6, w7, dz = p->dz;
   int v = p->i, x, y, z, sy = g->sy, sz = g->sz;
   w7 = (qsp*g->r8V)*p->w;
 
-  // Compute the trilinear weights
-  // See note in rhof for why FMA and FNMS are done this way.
+  // Compute the trilinear weights.  Though the PPE should have hardware
+  // fma/fmaf support, it was measured to be more efficient _not_ to use
+  // it here.  (Maybe the compiler isn't actually generating the assembly
+  // for it.
 
 # define FMA( x,y,z) ((z)+(x)*(y))
 # define FNMS(x,y,z) ((z)-(x)*(y))
@@ -164,10 +93,28 @@ accumulate_rhob( field_t          * RESTRICT ALIGNED(128) f,
 
   // Reduce the particle charge to rhob
 
-  f[v      ].rhob += w0; f[v      +1].rhob += w1;
-  f[v   +sy].rhob += w2; f[v   +sy+1].rhob += w3;
-  f[v+sz   ].rhob += w4; f[v+sz   +1].rhob += w5;
-  f[v+sz+sy].rhob += w6; f[v+sz+sy+1].rhob += w7;
+  r[s*(v      )] += w0; r[s*(v      +1)] += w1;
+  r[s*(v   +sy)] += w2; r[s*(v   +sy+1)] += w3;
+  r[s*(v+sz   )] += w4; r[s*(v+sz   +1)] += w5;
+  r[s*(v+sz+sy)] += w6; r[s*(v+sz+sy+1)] += w7;
+}
+
+void
+accumulate_rhob_array( float            * RESTRICT ALIGNED(16) r,
+                       const particle_t * RESTRICT ALIGNED(32) p,
+                       const grid_t     * RESTRICT             g,
+                       const float                             qsp ) {
+  scatter_rhob( r, 1, p, g, qsp );
+}
+
+void
+accumulate_rhob( field_t          * RESTRICT ALIGNED(128) f,
+                 const particle_t * RESTRICT ALIGNED(32)  p,
+                 const grid_t     * RESTRICT              g,
+                 const float                              qsp ) {
+# if 1
+
+  scatter_rhob( &f->rhob, sizeof(field_t)/sizeof(float), p, g, qsp );
 
 # else
 
@@ -0,0 +1,21 @@
+#define IN_spa
+
+#include "../species_advance.h"
+
+//----------------------------------------------------------------------------//
+// Top level function to select and call particle select function using the
+// desired particle select abstraction.  Currently, the only abstraction
+// available is the pipeline abstraction.
+//----------------------------------------------------------------------------//
+
+int
+select_p( species_t * RESTRICT sp,
+          const interpolator_array_t * RESTRICT ia,
+          const particle_select_t * RESTRICT sel,
+          int64_t index0,
+          int64_t * RESTRICT tag_out )
+{
+  // Once more options are available, this should be conditionally executed
+  // based on user choice.
+  return select_p_pipeline( sp, ia, sel, index0, tag_out );
+}
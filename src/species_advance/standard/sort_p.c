@@ -7,6 +7,7 @@
 // March/April 2004 - Revised and extened from earlier V4PIC versions.
 //============================================================================//
 
+#define MEM_TAG "sort"
 #define IN_spa
 
 #include "../species_advance.h"
@@ -23,6 +24,14 @@
 
 void
 sort_p( species_t * sp )
+{
+  sort_p_fused( sp, NULL, NULL );
+}
+
+void
+sort_p_fused( species_t * sp,
+              sort_voxel_func_t op,
+              void * params )
 {
   if ( !sp )
     ERROR( ( "Bad args" ) );
@@ -88,14 +97,37 @@ sort_p( species_t * sp )
     const particle_t * RESTRICT ALIGNED( 32)  in_p;
     /**/  particle_t * RESTRICT ALIGNED( 32) out_p;
 
-    MALLOC_ALIGNED( new_p, sp->max_np, 128 );
+    MALLOC_ARENA( new_p, sp->max_np, 128, "particle" );
 
     in_p  = sp->p;
     out_p = new_p;
 
-    for( i = 0; i < np; i++ )
+    if ( sp->tag )
+    {
+      // Tagged species need the destinations again for the tags.
+
+      int64_t * ALIGNED(128) new_tag;
+
+      MALLOC_ARENA( new_tag, sp->max_np, 128, "particle" );
+
+      for( i = 0; i < np; i++ )
+      {
+        new_tag[ next[ in_p[i].i ] ] = sp->tag[i];
+
+        out_p[ next[ in_p[i].i ]++ ] = in_p[i];
+      }
+
+      FREE_ALIGNED( sp->tag );
+
+      sp->tag = new_tag;
+    }
+
+    else
     {
-      out_p[ next[ in_p[i].i ]++ ] = in_p[i];
+      for( i = 0; i < np; i++ )
+      {
+        out_p[ next[ in_p[i].i ]++ ] = in_p[i];
+      }
     }
 
     FREE_ALIGNED( sp->p );
@@ -111,6 +143,9 @@ sort_p( species_t * sp )
     particle_t * ALIGNED(32) src;
     particle_t * ALIGNED(32) dest;
 
+    int64_t * ALIGNED(128) tag = sp->tag;
+    int64_t                save_tag;
+
     i = 0;
     while( i < nc )
     {
@@ -132,10 +167,23 @@ sort_p( species_t * sp )
           save_p = *dest;
           *dest  = *src;
           *src   = save_p;
+
+          if ( tag )
+          {
+            save_tag        = tag[ dest - p ];
+            tag[ dest - p ] = tag[ src  - p ];
+            tag[ src  - p ] = save_tag;
+          }
         }
       }
     }
   }
+
+  // The sort is serial, so hand all the voxels over at once.
+  if ( op )
+  {
+    op( params, 0, nc, 0 );
+  }
 }
 
 //----------------------------------------------------------------------------//
@@ -152,6 +200,14 @@ sort_p( species_t * sp )
 
 void
 sort_p( species_t * sp )
+{
+  sort_p_fused( sp, NULL, NULL );
+}
+
+void
+sort_p_fused( species_t * sp,
+              sort_voxel_func_t op,
+              void * params )
 {
   if ( !sp )
   {
@@ -159,7 +215,7 @@ sort_p( species_t * sp )
   }
 
   // Conditionally execute this when more abstractions are available.
-  sort_p_pipeline( sp );
+  sort_p_pipeline( sp, op, params );
 }
 
 #endif
@@ -0,0 +1,537 @@
+#define _GNU_SOURCE /* For MAP_HUGETLB, MADV_HUGEPAGE */
+
+#include "arena.h"
+#include "../mp/mp.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#define MAX_ARENA 64
+#define HUGE_2M   ( ((size_t)1)<<21 )
+#define HUGE_1G   ( ((size_t)1)<<30 )
+
+typedef struct arena {
+  char name[32];
+  int pages;         /* ARENA_PAGES_* */
+  int numa;          /* NUMA node to bind to (-1 for none) */
+  int warned;        /* Fell back from explicit huge pages / mbind */
+  int mapped;        /* Has had blocks from MALLOC_ARENA */
+  int64_t n_block;   /* Blocks in use */
+  int64_t n_byte;    /* Bytes requested by the blocks in use */
+  int64_t n_mapped;  /* Bytes mapped for the blocks in use */
+  int64_t max_byte;  /* High water mark of n_byte */
+} arena_t;
+
+/* Each block starts with this (the aligned memory follows) */
+
+typedef struct arena_block {
+  arena_t * arena;
+  size_t n_byte, n_mapped;
+  size_t page;       /* Granularity of the mapping */
+} arena_block_t;
+
+static arena_t arena[ MAX_ARENA ];
+static int n_arena = 0;
+static int default_pages = ARENA_PAGES_DEFAULT, default_numa = -1;
+static volatile int arena_lock = 0;
+
+/* The standard arenas and the subsystems that MALLOC counts memory
+   against.  These are created first (in this order) so that they lead
+   the memory report. */
+
+static const char * standard_arena[] = {
+  "particle", "mover", "field", "interpolator", "accumulator", "hydro",
+  "grid", NULL
+};
+
+static const char * standard_tag[] = {
+  "sort", "boundary", "collision", "emitter", "field_advance", "grid",
+  "material", "sf_interface", "species_advance", "util", "util/mp",
+  "util/checkpt", "util/pipelines", "util/rng", "vpic", "deck", NULL
+};
+
+/* Cache of the arena of each MEM_TAG string seen (see arena_tag) */
+
+#define N_TAG_CACHE 512
+
+static struct {
+  const char * tag;
+  int arena;
+} tag_cache[ N_TAG_CACHE ];
+
+#define LOCK()   while( __sync_lock_test_and_set( &arena_lock, 1 ) )
+#define UNLOCK() __sync_lock_release( &arena_lock )
+
+static void
+arena_count( arena_t * ar,
+             int64_t d_block,
+             int64_t d_byte,
+             int64_t d_mapped ) {
+  int64_t n, m;
+  __sync_fetch_and_add( &ar->n_block, d_block );
+  if( d_mapped ) __sync_fetch_and_add( &ar->n_mapped, d_mapped );
+  n = __sync_add_and_fetch( &ar->n_byte, d_byte );
+  if( d_byte<=0 ) return;
+  for( m=ar->max_byte; m<n; m=ar->max_byte )
+    if( __sync_bool_compare_and_swap( &ar->max_byte, m, n ) ) break;
+}
+
+static const char * page_name[] = { "4k", "thp", "2m", "1g" };
+
+static int
+parse_pages( const char * s ) {
+  int p;
+  if( !s ) return -1;
+  for( p=0; p<4; p++ ) if( !strcmp( s, page_name[p] ) ) return p;
+  if( !strcmp( s, "none" ) ) return ARENA_PAGES_DEFAULT;
+  ERROR(( "Unknown arena pages \"%s\" (expected 4k, thp, 2m or 1g)", s ));
+  return -1;
+}
+
+/* Must be called with the lock held */
+
+static arena_t *
+find_arena_locked( const char * name ) {
+  arena_t * ar;
+  int n;
+
+  static int booted = 0;
+
+  if( !name ) ERROR(( "NULL arena name" ));
+  if( !booted ) {
+    booted = 1;
+    for( n=0; standard_arena[n]; n++ ) find_arena_locked( standard_arena[n] );
+    for( n=0; standard_tag[n];   n++ ) find_arena_locked( standard_tag[n] );
+  }
+
+  for( n=0; n<n_arena; n++ )
+    if( !strcmp( arena[n].name, name ) ) return arena + n;
+
+  if( n_arena==MAX_ARENA ) ERROR(( "Too many arenas" ));
+  if( strlen(name)>=sizeof(arena[0].name) )
+    ERROR(( "Arena name \"%s\" too long", name ));
+  ar = arena + n_arena;
+  CLEAR( ar, 1 );
+  strcpy( ar->name, name );
+  ar->pages = default_pages;
+  ar->numa  = default_numa;
+  n_arena++;
+  return ar;
+}
+
+static arena_t *
+find_arena( const char * name ) {
+  arena_t * ar;
+  LOCK();
+  ar = find_arena_locked( name );
+  UNLOCK();
+  return ar;
+}
+
+/* The subsystem a MEM_TAG refers to.  A tag without a '/' is the name
+   itself.  Otherwise it is a source file and the subsystem is its
+   directory under src (with the subdirectory for util), or "deck" if
+   it is not under src. */
+
+static void
+tag_name( const char * tag,
+          char * name,
+          size_t len ) {
+  const char * s = NULL, * p, * e;
+
+  if( !strchr( tag, '/' ) ) { snprintf( name, len, "%s", tag ); return; }
+
+  for( p=tag; ( p = strstr( p, "src/" ) )!=NULL; p++ ) s = p + 4;
+  if( !s || !( e = strchr( s, '/' ) ) ) { snprintf( name, len, "deck" ); return; }
+  if( e-s==4 && !strncmp( s, "util", 4 ) && ( p = strchr( e+1, '/' ) ) ) e = p;
+  if( (size_t)(e-s)>=len ) e = s + len - 1;
+  memcpy( name, s, e-s );
+  name[e-s] = '\0';
+}
+
+/* MALLOC calls this for every block, so looking up a tag that has been
+   seen does not take the lock.  Entries are only ever added, under the
+   lock, and the arena of an entry is written before its tag is
+   published.  A lookup that reaches an empty slot takes the lock and
+   looks again before adding the tag. */
+
+int
+arena_tag( const char * tag ) {
+  char name[ sizeof(arena[0].name) ];
+  const char * t;
+  size_t h0, h, k;
+  int n;
+
+  if( !tag ) tag = "deck";
+
+  h0 = ( ((size_t)tag) >> 3 ) % N_TAG_CACHE;
+  for( k=0, h=h0; k<N_TAG_CACHE; k++, h=(h+1)%N_TAG_CACHE ) {
+    t = __atomic_load_n( &tag_cache[h].tag, __ATOMIC_ACQUIRE );
+    if( t==tag ) return tag_cache[h].arena;
+    if( !t ) break;
+  }
+
+  LOCK();
+  for( k=0, h=h0; k<N_TAG_CACHE && tag_cache[h].tag; k++, h=(h+1)%N_TAG_CACHE )
+    if( tag_cache[h].tag==tag ) { n = tag_cache[h].arena; UNLOCK(); return n; }
+
+  tag_name( tag, name, sizeof(name) );
+  n = find_arena_locked( name ) - arena;
+  if( k<N_TAG_CACHE ) {
+    tag_cache[h].arena = n;
+    __atomic_store_n( &tag_cache[h].tag, tag, __ATOMIC_RELEASE );
+  }
+  UNLOCK();
+  return n;
+}
+
+void
+arena_heap( int tag,
+            int64_t n_byte ) {
+  arena_count( arena + tag, n_byte<0 ? -1 : 1, n_byte, 0 );
+}
+
+/* Map at least *len bytes for ar.  *len is set to the bytes actually
+   mapped and *gran to the page size of the mapping.  Returns NULL on
+   failure. */
+
+static char *
+arena_map( arena_t * ar,
+           size_t * len,
+           size_t * gran ) {
+  size_t page = (size_t)sysconf( _SC_PAGESIZE ), n, h;
+  char * p = NULL, * q;
+
+  /* Explicit huge pages, for blocks of at least one huge page */
+
+# if defined(MAP_HUGETLB)
+  if( ar->pages==ARENA_PAGES_2M || ar->pages==ARENA_PAGES_1G ) {
+    h = ar->pages==ARENA_PAGES_2M ? HUGE_2M : HUGE_1G;
+    if( *len>=h ) {
+      n = ( (*len + h-1)/h )*h;
+      p = (char *)mmap( NULL, n, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                        ( ( ar->pages==ARENA_PAGES_2M ? 21 : 30 )
+                          << MAP_HUGE_SHIFT ), -1, 0 );
+      if( p!=(char *)MAP_FAILED ) { *len = n, *gran = h; return p; }
+      if( !(ar->warned & 1) )
+        WARNING(( "No %s huge pages available for arena \"%s\"; using "
+                  "transparent huge pages", page_name[ar->pages], ar->name ));
+      ar->warned |= 1;
+    }
+  }
+# endif
+
+  /* Normal pages.  Blocks that can hold a huge page are aligned on
+     one so that transparent huge pages can back them. */
+
+  n = ( (*len + page-1)/page )*page;
+  if( ar->pages!=ARENA_PAGES_DEFAULT && n>=HUGE_2M ) {
+    p = (char *)mmap( NULL, n+HUGE_2M, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( p==(char *)MAP_FAILED ) return NULL;
+    q = (char *)( ( (size_t)p + HUGE_2M-1 ) & ~( HUGE_2M-1 ) );
+    if( q>p ) munmap( p, q-p );
+    if( q+n < p+n+HUGE_2M ) munmap( q+n, (p+n+HUGE_2M) - (q+n) );
+    p = q;
+#   if defined(MADV_HUGEPAGE)
+    madvise( p, n, MADV_HUGEPAGE );
+#   endif
+  } else {
+    p = (char *)mmap( NULL, n, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( p==(char *)MAP_FAILED ) return NULL;
+  }
+  *len = n, *gran = page;
+  return p;
+}
+
+/* Bind the pages of a new block to the NUMA node of its arena */
+
+static void
+arena_bind( arena_t * ar,
+            char * p,
+            size_t len ) {
+  if( ar->numa<0 ) return;
+# if defined(__linux__) && defined(SYS_mbind)
+  {
+    unsigned long mask[16];
+    CLEAR( mask, 16 );
+    if( ar->numa < 16*8*(int)sizeof(mask[0]) ) {
+      mask[ ar->numa/(8*sizeof(mask[0])) ] |=
+        1UL << ( ar->numa%(8*sizeof(mask[0])) );
+      if( !syscall( SYS_mbind, p, len, 2 /* MPOL_BIND */, mask,
+                    16*8*sizeof(mask[0]), 0 ) ) return;
+    }
+  }
+# endif
+  if( !(ar->warned & 2) )
+    WARNING(( "Unable to bind arena \"%s\" to NUMA node %i",
+              ar->name, ar->numa ));
+  ar->warned |= 2;
+}
+
+void
+boot_arena( int * pargc,
+            char *** pargv ) {
+  char key[64];
+  const char * pages;
+  int n;
+
+  default_pages = parse_pages( strip_cmdline_string( pargc, pargv,
+                                                     "--arena_pages",
+                                                     "4k" ) );
+  default_numa  = strip_cmdline_int( pargc, pargv, "--arena_numa", -1 );
+
+  for( n=0; standard_arena[n]; n++ ) {
+    arena_t * ar = find_arena( standard_arena[n] );
+    snprintf( key, sizeof(key), "--arena_pages_%s", ar->name );
+    pages = strip_cmdline_string( pargc, pargv, key, NULL );
+    if( pages ) ar->pages = parse_pages( pages );
+    snprintf( key, sizeof(key), "--arena_numa_%s", ar->name );
+    ar->numa = strip_cmdline_int( pargc, pargv, key, ar->numa );
+  }
+}
+
+void
+arena_config( const char * name,
+              int pages,
+              int numa_node ) {
+  arena_t * ar = find_arena( name );
+  if( pages<ARENA_PAGES_DEFAULT || pages>ARENA_PAGES_1G )
+    ERROR(( "Bad arena pages" ));
+  ar->pages = pages;
+  ar->numa  = numa_node<0 ? -1 : numa_node;
+}
+
+void
+util_malloc_arena( const char * err,
+                   void * mem_ref,
+                   size_t n,
+                   size_t a,
+                   const char * name ) {
+  arena_t * ar;
+  arena_block_t * blk;
+  char * map, * mem_a;
+  size_t len, gran;
+
+  if( !err ) err = "malloc arena failed (n=%lu, a=%lu)";
+  if( !mem_ref || a==0 || ( a & (a-1) )!=0 )
+    ERROR(( err, (unsigned long)n, (unsigned long)a ));
+  if( n==0 ) { *(char **)mem_ref = NULL; return; }
+  if( a<16 ) a = 16;
+
+  ar  = find_arena( name );
+  len = sizeof(arena_block_t) + sizeof(char *) + (a-1) + n;
+  map = arena_map( ar, &len, &gran );
+  if( !map ) ERROR(( err, (unsigned long)n, (unsigned long)a ));
+  arena_bind( ar, map, len );
+
+  blk = (arena_block_t *)map;
+  blk->arena    = ar;
+  blk->n_byte   = n;
+  blk->n_mapped = len;
+  blk->page     = gran;
+
+  mem_a = (char *)( ( (size_t)( map + sizeof(arena_block_t) +
+                                sizeof(char *) ) + (a-1) ) & ~(a-1) );
+  ((char **)mem_a)[-1] = map + 1;
+
+  ar->mapped = 1;
+  arena_count( ar, 1, n, len );
+
+  *(char **)mem_ref = mem_a;
+}
+
+void
+util_realloc_arena( const char * err,
+                    void * mem_ref,
+                    size_t n_keep,
+                    size_t n,
+                    size_t a,
+                    const char * name ) {
+  arena_block_t * blk;
+  arena_t * ar;
+  char * mem_a, * mem_u, * map;
+  size_t off, len;
+
+  if( !err ) err = "realloc arena failed (n=%lu, a=%lu)";
+  if( !mem_ref ) ERROR(( err, (unsigned long)n, (unsigned long)a ));
+  if( n_keep>n ) n_keep = n;
+
+  mem_a = *(char **)mem_ref;
+  mem_u = mem_a ? ((char **)mem_a)[-1] : NULL;
+
+  /* Resize arena blocks in place.  mremap moves the pages (rather
+     than their contents) if the block cannot grow where it is, so
+     the block is never copied and the old and new blocks do not both
+     exist at once.  The offset of the memory in the mapping (and
+     thus its alignment up to the page size) does not change. */
+
+# if defined(__linux__) && defined(MREMAP_MAYMOVE)
+  if( mem_u && ( ((size_t)mem_u) & 1 ) && n>0 ) {
+    map = mem_u - 1;
+    blk = (arena_block_t *)map;
+    ar  = blk->arena;
+    if( a<16 ) a = 16;
+    if( ( ((size_t)mem_a) & (a-1) )==0 && ( !name || ar==find_arena( name ) ) ) {
+      off = mem_a - map;
+      len = ( ( off + n + blk->page-1 )/blk->page )*blk->page;
+      if( len!=blk->n_mapped ) {
+        char * p = (char *)mremap( map, blk->n_mapped, len, MREMAP_MAYMOVE );
+        if( p==(char *)MAP_FAILED ) ERROR(( err, (unsigned long)n,
+                                            (unsigned long)a ));
+        if( p!=map ) {
+          map = p, blk = (arena_block_t *)map;
+          mem_a = map + off;
+          ((char **)mem_a)[-1] = map + 1;
+        }
+        if( len>blk->n_mapped ) arena_bind( ar, map + blk->n_mapped,
+                                            len - blk->n_mapped );
+        arena_count( ar, 0, 0, (int64_t)len - (int64_t)blk->n_mapped );
+        blk->n_mapped = len;
+      }
+      arena_count( ar, 0, (int64_t)n - (int64_t)blk->n_byte, 0 );
+      blk->n_byte = n;
+      *(char **)mem_ref = mem_a;
+      return;
+    }
+  }
+# endif
+
+  /* Otherwise, copy into a new block */
+
+  util_malloc_arena( err, &map, n, a, name );
+  if( n_keep && mem_a ) memcpy( map, mem_a, n_keep );
+  util_free_aligned( mem_ref );
+  *(char **)mem_ref = map;
+}
+
+void
+arena_free( void * map ) {
+  arena_block_t * blk = (arena_block_t *)map;
+  arena_t * ar = blk->arena;
+  size_t len = blk->n_mapped;
+  arena_count( ar, -1, -(int64_t)blk->n_byte, -(int64_t)len );
+  munmap( map, len );
+}
+
+/* Each process contributes REPORT_WORDS words per arena to the report:
+   the name, packed into the first 4 words, then its usage.  The report
+   combines these by name into at most MAX_ROW rows. */
+
+#define REPORT_WORDS 9
+#define MAX_ROW      ( 4*MAX_ARENA )
+
+typedef struct report_row {
+  char name[32];
+  int pages;         /* Pages of the mappings (-1 if none) */
+  int n_rank;        /* Processes that have the arena */
+  int64_t n_min, n_sum, n_max;
+  int64_t h_min, h_sum, h_max;
+  int64_t mapped, blocks;
+} report_row_t;
+
+void
+arena_report( int dump ) {
+  int64_t * local, * global;
+  report_row_t * row, * w;
+  int n, r, m, n_row, n_drop;
+
+  /* Gather the usage of every arena on every process.  Processes can
+     have arenas the others do not (or have them in a different order),
+     so the usage is combined by arena name.  A process without an
+     arena counts as using none of it. */
+
+  /* (Not MALLOC, so the report does not count itself) */
+  local  = (int64_t *)malloc( REPORT_WORDS*MAX_ARENA*sizeof(int64_t) );
+  global = (int64_t *)malloc( REPORT_WORDS*MAX_ARENA*world_size*
+                              sizeof(int64_t) );
+  if( !local || !global ) ERROR(( "Unable to allocate arena report" ));
+  CLEAR( local, REPORT_WORDS*MAX_ARENA );
+  for( n=0; n<n_arena; n++ ) {
+    int64_t * l = local + REPORT_WORDS*n;
+    memcpy( l, arena[n].name, sizeof(arena[0].name) );
+    l[4] = arena[n].n_byte;
+    l[5] = arena[n].max_byte;
+    l[6] = arena[n].n_mapped;
+    l[7] = arena[n].n_block;
+    l[8] = arena[n].mapped ? 2 + arena[n].pages : 1;
+  }
+  mp_allgather_i64( local, global, REPORT_WORDS*MAX_ARENA );
+
+  if( dump ) {
+
+    /* The rows are in the order the arenas are first seen over the
+       processes in rank order (so the standard arenas come first). */
+
+    row = (report_row_t *)malloc( MAX_ROW*sizeof(report_row_t) );
+    if( !row ) ERROR(( "Unable to allocate arena report" ));
+
+    n_row = n_drop = 0;
+    for( r=0; r<world_size; r++ )
+      for( m=0; m<MAX_ARENA; m++ ) {
+        const int64_t * g = global + REPORT_WORDS*( MAX_ARENA*r + m );
+        if( !g[8] ) continue;
+        for( n=0; n<n_row; n++ )
+          if( !memcmp( row[n].name, g, sizeof(row[n].name) ) ) break;
+        if( n==n_row ) {
+          if( n_row==MAX_ROW ) { n_drop++; continue; }
+          w = row + n_row++;
+          CLEAR( w, 1 );
+          memcpy( w->name, g, sizeof(w->name) );
+          w->name[ sizeof(w->name)-1 ] = '\0';
+          w->pages = -1;
+          w->n_min = w->h_min = INT64_MAX;
+        }
+        w = row + n;
+        w->n_rank++;
+        if( w->n_min>g[4] ) w->n_min = g[4];
+        if( w->n_max<g[4] ) w->n_max = g[4];
+        if( w->h_min>g[5] ) w->h_min = g[5];
+        if( w->h_max<g[5] ) w->h_max = g[5];
+        w->n_sum  += g[4];
+        w->h_sum  += g[5];
+        w->mapped += g[6];
+        w->blocks += g[7];
+        if( g[8]>1 && w->pages<0 ) w->pages = (int)g[8] - 2;
+      }
+
+    log_printf( "\n"
+                "                           |     In use (MB) min/mean/max     |"
+                "   High water (MB) min/mean/max   |  Mapped    Blocks\n"
+                "    Memory           Pages |  (over processes)                |"
+                "  (over processes)                |    (MB)\n"
+                "---------------------------+----------------------------------+"
+                "----------------------------------+------------------\n" );
+    for( n=0; n<n_row; n++ ) {
+      w = row + n;
+      if( !w->h_max ) continue;
+      if( w->n_rank<world_size ) w->n_min = w->h_min = 0;
+      log_printf( "    %-16s %5s | %10.3f %10.3f %10.3f | %10.3f %10.3f %10.3f "
+                  "| %8.1f %8li\n",
+                  w->name, w->pages<0 ? "-" : page_name[w->pages],
+                  w->n_min*1e-6, w->n_sum*1e-6/world_size, w->n_max*1e-6,
+                  w->h_min*1e-6, w->h_sum*1e-6/world_size, w->h_max*1e-6,
+                  w->mapped*1e-6, (long)w->blocks );
+    }
+    if( n_drop )
+      log_printf( "    (Only the first %i arenas are shown)\n", MAX_ROW );
+    log_printf( "\n" );
+
+    free( row );
+  }
+
+  free( global );
+  free( local );
+}
@@ -0,0 +1,98 @@
+#ifndef _arena_h_
+#define _arena_h_
+
+#include "../util_base.h"
+
+/* Memory arenas.  The big arrays (particles, movers, fields,
+   interpolators, accumulators, hydro and grid arrays) are allocated
+   from named arenas with MALLOC_ARENA (see util_base.h) and freed
+   with FREE_ALIGNED.  Each allocation of an arena gets its own
+   anonymous mapping so that the pages backing it can be chosen per
+   arena and returned to the system when the array is freed (or
+   resized).
+
+   An arena can be backed by:
+
+     ARENA_PAGES_DEFAULT - Normal (typically 4KB) pages.
+     ARENA_PAGES_THP     - Transparent huge pages.  Mappings of at
+                           least 2MB are 2MB aligned and madvised as
+                           MADV_HUGEPAGE.
+     ARENA_PAGES_2M      - Explicit 2MB huge pages (MAP_HUGETLB) for
+     ARENA_PAGES_1G        allocations of at least one huge page.
+                           These must be reserved by the system
+                           administrator (e.g. vm.nr_hugepages); if
+                           none are available, the arena warns once
+                           and uses transparent huge pages instead.
+
+   An arena can also be bound to a NUMA node (mbind MPOL_BIND).  The
+   memory is first touched by whoever uses it first, so binding is
+   only needed when that thread does not run on the desired node.
+
+   The arenas are configured on the command line with
+
+     --arena_pages <pages> and --arena_numa <node>
+
+   for all arenas or
+
+     --arena_pages_<name> <pages> and --arena_numa_<name> <node>
+
+   for the arena <name>, where <pages> is one of 4k, thp, 2m or 1g.
+   Processes need not create the same arenas; the memory report
+   combines them by name.
+
+   The memory from MALLOC and MALLOC_ALIGNED is also counted, against
+   an arena named for the subsystem that allocated it (see MEM_TAG in
+   util_base.h).  Such arenas only count memory; they do not map it. */
+
+enum arena_pages {
+  ARENA_PAGES_DEFAULT = 0,
+  ARENA_PAGES_THP     = 1,
+  ARENA_PAGES_2M      = 2,
+  ARENA_PAGES_1G      = 3
+};
+
+BEGIN_C_DECLS
+
+/* Parse the arena options and create the standard arenas */
+
+void
+boot_arena( int * pargc,
+            char *** pargv );
+
+/* Set the pages and NUMA node (-1 for none) of the arena name
+   (creating it if it does not exist).  Only later allocations are
+   affected. */
+
+void
+arena_config( const char * name,
+              int pages,
+              int numa_node );
+
+/* Log the minimum, mean and maximum over processes of the memory in
+   use and of the high water mark of each arena, if dump is true.  This
+   is collective (vpic_simulation::print_memory_usage calls it with
+   the status reports). */
+
+void
+arena_report( int dump );
+
+/* Return the arena that MALLOC counts memory with the given MEM_TAG
+   against and count n_byte (negative when freed) against it.  These
+   are used by MALLOC, MALLOC_ALIGNED and FREE. */
+
+int
+arena_tag( const char * tag );
+
+void
+arena_heap( int tag,
+            int64_t n_byte );
+
+/* Return the block starting at map to the system.  This is used by
+   FREE_ALIGNED. */
+
+void
+arena_free( void * map );
+
+END_C_DECLS
+
+#endif /* _arena_h_ */
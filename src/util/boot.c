@@ -15,6 +15,10 @@ void
 boot_services( int * pargc,
                char *** pargv ) {
 
+  // Set up the memory arenas before anything is allocated from them
+
+  boot_arena( pargc, pargv );
+
   // Start up the checkpointing service.  This should be first.
 
   boot_checkpt( pargc, pargv );
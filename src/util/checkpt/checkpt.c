@@ -12,6 +12,14 @@
 #define IN_checkpt
 #include "checkpt_private.h"
 
+#include "../mp/mp.h"
+#include "../pipelines/pipelines_exec.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
 /* Boolean flag indicating whether or not checkpoint is booted. */
 
 static int booted = 0;
@@ -34,6 +42,9 @@ typedef struct registry {
   restore_func_t restore_func;
   reanimate_func_t reanimate_func;
   size_t id;
+  uint64_t hash;    /* Hash of the object in the base checkpt */
+  size_t n_byte;    /* Size of the object in the base checkpt */
+  int in_base;      /* Is the object in the base checkpt? */
   struct registry * next;
 } registry_t;
 
@@ -44,6 +55,532 @@ static registry_t * registry = NULL;
 
 static size_t next_id = 1;
 
+/* Two-stage checkpointing state.  If stage_dir is not NULL, checkpts
+   are first serialized to a local copy in stage_dir and then drained
+   to their final destination by a background thread while the
+   simulation continues.  At most one drain is in flight.  The drain
+   writes to "<name>.partial" and renames it to <name> when complete,
+   so an interrupted drain never replaces a complete checkpt.  The
+   local copy of the most recent checkpt is kept for restore. */
+
+typedef struct checkpt_drain {
+  char src[1024];         /* Local copy being drained */
+  char dst[1024];         /* Final destination */
+  int  err;               /* Non-zero if the drain failed */
+} checkpt_drain_t;
+
+static char *          stage_dir    = NULL;
+static char            stage_prev[1024];
+static pthread_t       drain_thread;
+static int             drain_active = 0;
+static checkpt_drain_t drain[1];
+
+/* Partner ("buddy") checkpointing state.  If buddy_dir is not NULL,
+   checkpt_buddy_objects writes the checkpt of each rank to buddy_dir
+   (nominally a node-local tmpfs like /dev/shm) and mirrors it in the
+   buddy_dir of the rank buddy_stride ranks above it.  The default
+   stride is the number of ranks on a node so that the mirror is on a
+   different node.  Only the most recent complete buddy checkpt
+   (buddy_prev) is kept. */
+
+#define BUDDY_CHUNK (1<<24)
+#define BUDDY_TAG   0xB0DD
+
+static char * buddy_dir    = NULL;
+static int    buddy_stride = 0;
+static char   buddy_prev[1024];
+
+/* Incremental checkpointing state.  If full_interval is non-zero,
+   every full_interval-th checkpt is a full checkpt (the "base") and
+   the others are deltas against the base.  To build a delta, each
+   object is serialized into a sink that hashes its bytes; only objects
+   whose hash differs from the base are written to the delta.  The sink
+   also keeps a copy of the serialized bytes for objects up to
+   SINK_MAX bytes in size; larger objects are serialized a second time
+   if they need to be written.
+
+   Objects in an incremental checkpt are written as sized records (so
+   that a restore can skip over objects it does not need) or, in
+   deltas, as references to the same object in the base.
+
+   Each base is stamped with a generation (unique to the process and
+   the time it was written) and each delta records the generation of
+   the base it was written against.  A base may be overwritten by a
+   later full checkpt of the same name (e.g. with alternating restart
+   names); restoring a delta whose base has since been rewritten fails
+   instead of silently pulling the wrong unchanged objects from it. */
+
+#define SINK_MAX (1<<24)
+
+#define CHECKPT_DELTA  0xDE17A00D /* Delta header */
+#define CHECKPT_SIZED  0x512EF00D /* Sized object record */
+#define CHECKPT_SAME   0x5A3EF00D /* Object is unchanged from the base */
+#define CHECKPT_GEN    0x6E4EF00D /* Base generation header */
+
+static int      full_interval = 0;
+static int      n_delta       = 0;
+static char     base_name[1024];
+static uint64_t base_gen      = 0;   /* Generation of base_name */
+static uint64_t n_gen         = 0;   /* Bases written by this process */
+
+static int      sinking       = 0;   /* Is checkpt_raw writing to the sink? */
+static int      sink_hashing  = 0;   /* Are sink writes hashed? */
+static int      sink_overflow = 0;   /* Did the sink copy overflow? */
+static char *   sink_buf      = NULL;
+static size_t   sink_max      = 0;
+static size_t   sink_len      = 0;   /* Bytes in the sink copy */
+static size_t   sink_payload  = 0;   /* Hashed bytes */
+static uint64_t sink_hash, sink_carry;
+static int      sink_ncarry;
+static size_t   n_written     = 0;   /* Bytes written to the checkpt */
+static size_t   n_stream      = 0;   /* Bytes written to the stream */
+static int      local_write   = 0;   /* Writing a node-local checkpt */
+
+/* Objects in the restore chain.  chain[0] is the checkpt being
+   restored and chain[k+1] is the base of chain[k]. */
+
+#define MAX_CHAIN 16
+
+typedef struct restore_link {
+  checkpt_t * f;
+  char * base;
+  uint64_t gen;      /* Generation of this checkpt if it is a base */
+  uint64_t base_gen; /* Generation of the base this checkpt was written
+                        against */
+  int summed;        /* Are the records of this checkpt checksummed? */
+} restore_link_t;
+
+static restore_link_t chain[MAX_CHAIN];
+static int n_chain = 0;
+
+/* Detached restore state.  A detached restore reads a checkpt into a
+   registry of its own so that the objects in it can be inspected
+   without replacing the objects of the running application. */
+
+static int          detached          = 0;
+static int          have_detached     = 0;
+static registry_t * detached_registry = NULL;
+
+/* Object checksums.  Every object record in a checkpt is followed by
+   a checksum of the record (less its header) that restore_objects
+   verifies.  The checksum is a tree hash: the record is cut into
+   CHECKPT_LEAF byte leaves at fixed offsets, the leaves are hashed
+   independently (the whole leaves in large writes and reads are hashed
+   by the pipelines in parallel) and the leaf hashes are then hashed
+   in order along with the record length.  Checksums can be turned off
+   (see checkpt_checksums) for checkpts that cannot afford them. */
+
+#define CHECKPT_SUMMED 0x5C0DF00D /* Header: records are checksummed */
+#define CHECKPT_SUM    0x5A7EF00D /* Checksum record */
+#define CHECKPT_LEAF   (1<<16)
+
+static int        sum_on   = 1;     /* Are checkpts checksummed? */
+static int        summing  = 0;     /* Are stream bytes being summed? */
+static char *     sum_leaf = NULL;  /* Partial leaf */
+static size_t     sum_fill = 0;     /* Bytes in the partial leaf */
+static size_t     sum_len  = 0;     /* Bytes summed */
+static uint64_t * sum_hash = NULL;  /* Hashes of the complete leaves */
+static size_t     sum_n    = 0;
+static size_t     sum_max  = 0;
+
+#define SINK_MIX(h,w) ( h = ((h)^(w))*0x100000001b3ULL, \
+                        h = (h<<31) | (h>>33) )
+
+static void
+sink_begin( void ) {
+  sinking       = 1;
+  sink_hashing  = 0;
+  sink_overflow = 0;
+  sink_len      = 0;
+  sink_payload  = 0;
+  sink_hash     = 0xcbf29ce484222325ULL;
+  sink_carry    = 0;
+  sink_ncarry   = 0;
+}
+
+static void
+sink_write( const void * data,
+            size_t n ) {
+  const unsigned char * p = (const unsigned char *)data;
+  uint64_t h, w;
+  size_t m;
+  char * buf;
+
+  /* Keep a copy of the serialized bytes if they fit */
+
+  if( !sink_overflow ) {
+    if( sink_len+n > SINK_MAX ) sink_overflow = 1;
+    else {
+      if( sink_len+n > sink_max ) {
+        for( m = sink_max ? sink_max : 65536; m<sink_len+n; m<<=1 ) ;
+        MALLOC( buf, m );
+        if( sink_len ) memcpy( buf, sink_buf, sink_len );
+        FREE( sink_buf );
+        sink_buf = buf;
+        sink_max = m;
+      }
+      memcpy( sink_buf + sink_len, data, n );
+      sink_len += n;
+    }
+  }
+
+  /* Hash the object bytes a word at a time.  Words can straddle
+     consecutive writes. */
+
+  if( !sink_hashing ) return;
+  sink_payload += n;
+  h = sink_hash;
+  for( ; n && sink_ncarry; n--, p++ ) {
+    sink_carry |= (uint64_t)*p << (8*sink_ncarry);
+    if( ++sink_ncarry==8 ) {
+      SINK_MIX( h, sink_carry );
+      sink_carry = 0, sink_ncarry = 0;
+    }
+  }
+  for( ; n>=8; n-=8, p+=8 ) { memcpy( &w, p, 8 ); SINK_MIX( h, w ); }
+  for( ; n; n--, p++ ) sink_carry |= (uint64_t)*p << (8*sink_ncarry++);
+  sink_hash = h;
+}
+
+static uint64_t
+sink_end( void ) {
+  uint64_t h = sink_hash;
+  sinking = 0;
+  SINK_MIX( h, sink_carry );
+  SINK_MIX( h, (uint64_t)sink_payload );
+  return h;
+}
+
+#define SUM_MIX(h,w) ( h = ((h)^(w))*0x9e3779b97f4a7c15ULL, \
+                       h = (h<<27) | (h>>37) )
+
+/* Hash a leaf.  This is a Fletcher-like sum over four interleaved
+   lanes of words (which runs at memory speed) and the lane sums are
+   mixed at the end. */
+
+static uint64_t
+leaf_hash( const char * p,
+           size_t n ) {
+  uint64_t a0 = 1, a1 = 2, a2 = 3, a3 = 4, b0 = 0, b1 = 0, b2 = 0, b3 = 0;
+  uint64_t w[4], h;
+  size_t m = n;
+
+  for( ; m>=32; m-=32, p+=32 ) {
+    memcpy( w, p, 32 );
+    a0 += w[0]; b0 += a0; a1 += w[1]; b1 += a1;
+    a2 += w[2]; b2 += a2; a3 += w[3]; b3 += a3;
+  }
+  for( ; m>=8; m-=8, p+=8 ) { memcpy( w, p, 8 ); a0 += w[0]; b0 += a0; }
+  if( m ) { w[0] = 0; memcpy( w, p, m ); a1 += w[0]; b1 += a1; }
+
+  h = 0x243f6a8885a308d3ULL;
+  SUM_MIX( h, a0 ); SUM_MIX( h, a1 ); SUM_MIX( h, a2 ); SUM_MIX( h, a3 );
+  SUM_MIX( h, b0 ); SUM_MIX( h, b1 ); SUM_MIX( h, b2 ); SUM_MIX( h, b3 );
+  SUM_MIX( h, (uint64_t)n );
+  return h;
+}
+
+typedef struct checkpt_sum_pipeline_args {
+  const char * p;   /* First whole leaf */
+  uint64_t * h;     /* Hashes of the leaves */
+  int n;            /* Number of leaves */
+} checkpt_sum_pipeline_args_t;
+
+static void
+checkpt_sum_pipeline_scalar( checkpt_sum_pipeline_args_t * args,
+                             int pipeline_rank,
+                             int n_pipeline ) {
+  int i, n;
+  DISTRIBUTE( args->n, 1, pipeline_rank, n_pipeline, i, n );
+  for( ; n; n--, i++ )
+    args->h[i] = leaf_hash( args->p + (size_t)i*CHECKPT_LEAF, CHECKPT_LEAF );
+}
+
+static void
+sum_begin( void ) {
+  summing  = 1;
+  sum_fill = 0;
+  sum_len  = 0;
+  sum_n    = 0;
+}
+
+static void
+sum_push( size_t n_leaf ) {
+  uint64_t * h;
+  size_t m;
+  if( sum_n+n_leaf <= sum_max ) return;
+  for( m = sum_max ? sum_max : 64; m<sum_n+n_leaf; m<<=1 ) ;
+  MALLOC( h, m );
+  if( sum_n ) memcpy( h, sum_hash, sum_n*sizeof(*h) );
+  FREE( sum_hash );
+  sum_hash = h;
+  sum_max  = m;
+}
+
+/* Sum the next n bytes of the record.  If out is not NULL, the bytes
+   are also written to out.  Whole leaves are hashed a batch at a time
+   (by the pipelines if there are several) and each batch is written
+   right after it is hashed, while it is still in cache. */
+
+static void
+sum_update( const void * data,
+            size_t n,
+            checkpt_t * out ) {
+  DECLARE_ALIGNED_ARRAY( checkpt_sum_pipeline_args_t, 128, args, 1 );
+  const char * p = (const char *)data;
+  size_t m, n_leaf, n_batch;
+
+  sum_len += n;
+
+  /* Finish the partial leaf */
+
+  if( sum_fill ) {
+    m = CHECKPT_LEAF - sum_fill;
+    if( m>n ) m = n;
+    memcpy( sum_leaf + sum_fill, p, m );
+    if( out ) checkpt_write( out, p, m );
+    sum_fill += m, p += m, n -= m;
+    if( sum_fill==CHECKPT_LEAF ) {
+      sum_push( 1 );
+      sum_hash[sum_n++] = leaf_hash( sum_leaf, CHECKPT_LEAF );
+      sum_fill = 0;
+    }
+  }
+
+  /* Hash the whole leaves in place */
+
+  n_leaf  = n / CHECKPT_LEAF;
+  n_batch = N_PIPELINE>1 ? 4*(size_t)N_PIPELINE : 4;
+  sum_push( n_leaf );
+  for( ; n_leaf; n_leaf -= m ) {
+    m = n_leaf<n_batch ? n_leaf : n_batch;
+    if( N_PIPELINE>1 && m>1 ) {
+      args->p = p;
+      args->h = sum_hash + sum_n;
+      args->n = (int)m;
+      EXEC_PIPELINES( checkpt_sum, args, 0 );
+      WAIT_PIPELINES();
+    } else {
+      size_t i;
+      for( i=0; i<m; i++ )
+        sum_hash[sum_n+i] = leaf_hash( p + i*CHECKPT_LEAF, CHECKPT_LEAF );
+    }
+    if( out ) checkpt_write( out, p, m*CHECKPT_LEAF );
+    sum_n += m, p += m*CHECKPT_LEAF, n -= m*CHECKPT_LEAF;
+  }
+
+  /* And start a new partial leaf with the rest */
+
+  if( n ) {
+    if( !sum_leaf ) MALLOC( sum_leaf, CHECKPT_LEAF );
+    memcpy( sum_leaf, p, n );
+    if( out ) checkpt_write( out, p, n );
+    sum_fill = n;
+  }
+}
+
+static uint64_t
+sum_end( void ) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  size_t i;
+  summing = 0;
+  for( i=0; i<sum_n; i++ ) SUM_MIX( h, sum_hash[i] );
+  if( sum_fill ) SUM_MIX( h, leaf_hash( sum_leaf, sum_fill ) );
+  SUM_MIX( h, (uint64_t)sum_len );
+  return h;
+}
+
+/* Compute the name of the copy of the checkpt name in the local
+   directory dir.  The path separators of name are mangled so that
+   checkpts with the same file name in different directories do not
+   collide. */
+
+static void
+local_name( char * local,
+            size_t sz,
+            const char * dir,
+            const char * name ) {
+  char * c;
+  int n;
+  n = snprintf( local, sz, "%s/", dir );
+  if( n<0 || (size_t)n>=sz ) ERROR(( "Checkpt local path too long" ));
+  c = local + n;
+  if( (size_t)n + strlen(name) + 1 > sz )
+    ERROR(( "Checkpt local path too long" ));
+  for( ; *name; name++, c++ ) *c = (*name=='/') ? '_' : *name;
+  *c = '\0';
+}
+
+/* A checkpt is considered complete if it ends with the end of
+   registry marker written by checkpt_objects. */
+
+static int
+checkpt_complete( const char * name ) {
+  FILE * fp;
+  size_t marker = 0;
+  fp = fopen( name, "rb" );
+  if( !fp ) return 0;
+  if( fseek( fp, -(long)sizeof(marker), SEEK_END ) ||
+      fread( &marker, sizeof(marker), 1, fp )!=1 ) marker = 0;
+  fclose( fp );
+  return marker==0xBADF00D;
+}
+
+static void *
+drain_main( void * arg ) {
+  checkpt_drain_t * d = (checkpt_drain_t *)arg;
+  char partial[1040];
+  char * buf;
+  FILE * in, * out;
+  size_t n;
+
+  d->err = 1;
+  snprintf( partial, sizeof(partial), "%s.partial", d->dst );
+
+  in = fopen( d->src, "rb" );
+  if( !in ) return NULL;
+  out = fopen( partial, "wb" );
+  if( !out ) { fclose( in ); return NULL; }
+
+  buf = (char *)malloc( 1<<22 );
+  if( buf ) {
+    d->err = 0;
+    while( (n = fread( buf, 1, 1<<22, in ))>0 )
+      if( fwrite( buf, 1, n, out )!=n ) { d->err = 1; break; }
+    if( ferror( in ) ) d->err = 1;
+    free( buf );
+  }
+
+  fclose( in );
+  if( fflush( out ) || fsync( fileno( out ) ) ) d->err = 1;
+  if( fclose( out ) ) d->err = 1;
+  if( !d->err && rename( partial, d->dst ) ) d->err = 1;
+  if( d->err ) unlink( partial );
+  return NULL;
+}
+
+/* Name in buddy_dir of the buddy checkpt name of rank (or, if held,
+   of the mirror of it held by the partner of rank) */
+
+static void
+buddy_name( char * local,
+            size_t sz,
+            const char * name,
+            int rank,
+            int held ) {
+  char tmp[1024];
+  if( snprintf( tmp, sizeof(tmp), "%s.%i%s", name, rank,
+                held ? ".held" : "" )>=(int)sizeof(tmp) )
+    ERROR(( "Checkpt name too long" ));
+  local_name( local, sz, buddy_dir, tmp );
+}
+
+/* Pick the default buddy stride.  Ranks are assumed to be placed on
+   nodes in blocks, so the number of ranks on the node of rank 0 is
+   the stride to a rank on another node. */
+
+static void
+buddy_setup( void ) {
+  char host[256];
+  const char * c;
+  unsigned int u;
+  int h, * hosts, n, r;
+
+  if( buddy_stride>0 ) return;
+
+  if( gethostname( host, sizeof(host) ) ) host[0] = '\0';
+  host[sizeof(host)-1] = '\0';
+  for( u=0x811c9dc5u, c=host; *c; c++ ) u = ( u^(unsigned char)*c )*0x01000193u;
+  h = (int)( u & 0x7fffffff );
+
+  MALLOC( hosts, world_size );
+  mp_allgather_i( &h, hosts, 1 );
+  for( n=0, r=0; r<world_size; r++ ) n += hosts[r]==hosts[0];
+  FREE( hosts );
+
+  if( n>=world_size ) {
+    if( world_size>1 && !world_rank )
+      WARNING(( "All ranks are on one node; buddy checkpts are mirrored on "
+                "the same node" ));
+    n = 1;
+  }
+  buddy_stride = n;
+}
+
+/* Send the file send to rank dst while receiving the file recv from
+   rank src (either can be NULL).  The received file only appears
+   under its name once complete. */
+
+static void
+buddy_shift( const char * send,
+             int dst,
+             const char * recv,
+             int src ) {
+  char partial[1040];
+  FILE * in = NULL, * out = NULL;
+  size_t n_send = 0, n_recv = 0, ns, nr;
+  mp_t * mp;
+
+  if( send ) {
+    in = fopen( send, "rb" );
+    if( !in || fseek( in, 0, SEEK_END ) ||
+        (long)( n_send = (size_t)ftell( in ) )<=0 || fseek( in, 0, SEEK_SET ) )
+      ERROR(( "Unable to read buddy checkpt \"%s\"", send ));
+  }
+  if( recv ) {
+    snprintf( partial, sizeof(partial), "%s.partial", recv );
+    out = fopen( partial, "wb" );
+    if( !out ) ERROR(( "Unable to open \"%s\" for writing", partial ));
+  }
+
+  mp = new_mp( 2 );
+  mp_size_recv_buffer( mp, 0, BUDDY_CHUNK );
+  mp_size_send_buffer( mp, 1, BUDDY_CHUNK );
+
+  /* Exchange the sizes and then the files a chunk at a time */
+
+  if( recv ) mp_begin_recv( mp, 0, sizeof(size_t), src, BUDDY_TAG );
+  if( send ) {
+    memcpy( mp_send_buffer( mp, 1 ), &n_send, sizeof(size_t) );
+    mp_begin_send( mp, 1, sizeof(size_t), dst, BUDDY_TAG );
+  }
+  if( recv ) {
+    mp_end_recv( mp, 0 );
+    memcpy( &n_recv, mp_recv_buffer( mp, 0 ), sizeof(size_t) );
+  }
+  if( send ) mp_end_send( mp, 1 );
+
+  while( n_send || n_recv ) {
+    nr = n_recv<BUDDY_CHUNK ? n_recv : BUDDY_CHUNK;
+    ns = n_send<BUDDY_CHUNK ? n_send : BUDDY_CHUNK;
+    if( nr ) mp_begin_recv( mp, 0, (int)nr, src, BUDDY_TAG );
+    if( ns ) {
+      if( fread( mp_send_buffer( mp, 1 ), 1, ns, in )!=ns )
+        ERROR(( "Unable to read buddy checkpt \"%s\"", send ));
+      mp_begin_send( mp, 1, (int)ns, dst, BUDDY_TAG );
+    }
+    if( nr ) {
+      mp_end_recv( mp, 0 );
+      if( fwrite( mp_recv_buffer( mp, 0 ), 1, nr, out )!=nr )
+        ERROR(( "Unable to write \"%s\"", partial ));
+      n_recv -= nr;
+    }
+    if( ns ) {
+      mp_end_send( mp, 1 );
+      n_send -= ns;
+    }
+  }
+
+  delete_mp( mp );
+
+  if( in ) fclose( in );
+  if( out ) {
+    if( fclose( out ) ) ERROR(( "Unable to write \"%s\"", partial ));
+    if( rename( partial, recv ) )
+      ERROR(( "Unable to rename \"%s\" to \"%s\"", partial, recv ));
+  }
+}
+
 #ifdef VERBOSE_CHECKPOINTING
 
 static void
@@ -91,6 +628,125 @@ dump_registry( void ) {
 
 #endif
 
+/* Name of a checkpt function for the size report */
+
+static const char *
+func_name( const void * saddr ) {
+#ifndef NO_REVERSE_SYMBOL_TABLE_LOOKUP_SUPPORT
+  Dl_info dli[1];
+  if( saddr && dladdr( saddr, dli ) && dli->dli_sname ) return dli->dli_sname;
+#endif
+  return saddr ? "(unknown)" : "(none)";
+}
+
+/* Write the checksum record of the object record just written */
+
+static void
+checkpt_sum( void ) {
+  uint64_t h = sum_end();
+  CHECKPT_VAL( size_t, CHECKPT_SUM );
+  CHECKPT_VAL( uint64_t, h );
+}
+
+/* Check the object record just read against its checksum record */
+
+static void
+restore_sum( const registry_t * node ) {
+  uint64_t h = sum_end(), sum;
+  size_t prefix;
+  RESTORE_VAL( size_t, prefix );
+  if( prefix!=CHECKPT_SUM )
+    ERROR(( "Malformed checkpt (expected a checksum after object %lu)",
+            (unsigned long)node->id ));
+  RESTORE_VAL( uint64_t, sum );
+  if( sum!=h )
+    ERROR(( "Checkpt is corrupt (checksum mismatch for object %lu restored "
+            "by %s)", (unsigned long)node->id,
+            func_name( (void *)(size_t)node->restore_func ) ));
+}
+
+/* Open a checkpt for a restore.  When staging, prefer a complete
+   local copy of the checkpt. */
+
+static checkpt_t *
+open_restore( const char * name ) {
+  char local[1024];
+  if( stage_dir ) {
+    local_name( local, sizeof(local), stage_dir, name );
+    if( checkpt_complete( local ) ) return checkpt_open_rdonly( local );
+  }
+  return checkpt_open_rdonly( name );
+}
+
+/* Read the header of chain[k] and return the next_id it gives. */
+
+static size_t
+restore_header( int k ) {
+  size_t id;
+  restore = chain[k].f;
+  RESTORE_VAL( size_t, id );
+  chain[k].summed = id==CHECKPT_SUMMED;
+  if( chain[k].summed ) RESTORE_VAL( size_t, id );
+  chain[k].gen = 0;
+  if( id==CHECKPT_GEN ) {
+    RESTORE_VAL( uint64_t, chain[k].gen );
+    RESTORE_VAL( size_t, id );
+  }
+  chain[k].base = NULL;
+  chain[k].base_gen = 0;
+  if( id==CHECKPT_DELTA ) {
+    RESTORE_VAL( size_t, id );
+    chain[k].base = restore_str();
+    RESTORE_VAL( uint64_t, chain[k].base_gen );
+  }
+  return id;
+}
+
+/* Position the restore stream at the object id in chain[k] (or, if
+   chain[k] says the object is unchanged, in the base of chain[k]) and
+   return the link it is in.  Objects appear in registry order in
+   every checkpt so each link in the chain only needs to be read
+   forward. */
+
+static int
+find_object( int k,
+             size_t id ) {
+  size_t prefix, rid, n;
+
+  if( k==n_chain ) {
+    if( !chain[k-1].base )
+      ERROR(( "Malformed checkpt (object %lu is not in the base)",
+              (unsigned long)id ));
+    if( k==MAX_CHAIN ) ERROR(( "Checkpt delta chain too long" ));
+    chain[k].f = open_restore( chain[k-1].base );
+    n_chain++;
+    restore_header( k );
+    if( !chain[k].gen || chain[k].gen!=chain[k-1].base_gen )
+      ERROR(( "Checkpt base \"%s\" is not the one its delta was written "
+              "against (it was overwritten or is not a base)",
+              chain[k-1].base ));
+  }
+
+  restore = chain[k].f;
+  for(;;) {
+    RESTORE_VAL( size_t, prefix );
+    if( prefix==CHECKPT_SIZED ) {
+      RESTORE_VAL( size_t, rid );
+      RESTORE_VAL( size_t, n );
+      if( rid==id ) return k;
+      checkpt_skip( restore, n + ( chain[k].summed ? 2*sizeof(size_t) : 0 ) );
+    } else if( prefix==CHECKPT_SAME ) {
+      RESTORE_VAL( size_t, rid );
+      if( rid==id ) return find_object( k+1, id );
+    } else if( prefix==0xBADF00D ) {
+      ERROR(( "Malformed checkpt (object %lu is not in the base)",
+              (unsigned long)id ));
+    } else {
+      ERROR(( "Malformed checkpt (expected a sized object header)" ));
+    }
+  }
+}
+
 void
 boot_checkpt( int * pargc,
               char *** pargv ) {
@@ -106,6 +762,36 @@ boot_checkpt( int * pargc,
   restore  = NULL;
   next_id  = 1;
 
+  /* Enable two-stage checkpointing if requested */
+
+  stage_prev[0] = '\0';
+  if( pargc && pargv )
+    checkpt_staging( strip_cmdline_string( pargc, pargv,
+                                           "--checkpt_stage", NULL ) );
+
+  /* Enable incremental checkpointing if requested */
+
+  base_name[0] = '\0';
+  if( pargc && pargv )
+    checkpt_incremental( strip_cmdline_int( pargc, pargv,
+                                            "--checkpt_incremental", 0 ) );
+
+  /* Disable checksums if requested */
+
+  sum_on = 1;
+  if( pargc && pargv )
+    checkpt_checksums( strip_cmdline_int( pargc, pargv,
+                                          "--checkpt_checksums", 1 ) );
+
+  /* Enable buddy checkpointing if requested */
+
+  buddy_prev[0] = '\0';
+  if( pargc && pargv ) {
+    int stride = strip_cmdline_int( pargc, pargv, "--checkpt_buddy_stride", 0 );
+    checkpt_buddy( strip_cmdline_string( pargc, pargv,
+                                         "--checkpt_buddy", NULL ), stride );
+  }
+
   /* Mark the service as booted */
 
   booted = 1;
@@ -124,11 +810,68 @@ halt_checkpt( void ) {
   if( checkpt  ) ERROR(( "currently writing a checkpt" ));
   if( restore  ) ERROR(( "currently reading a checkpt" ));
 
+  /* Finish any checkpt still being drained */
+
+  checkpt_drain_wait();
+  FREE( stage_dir );
+  FREE( buddy_dir );
+  FREE( sink_buf );
+  sink_max = 0;
+  FREE( sum_leaf );
+  FREE( sum_hash );
+  sum_max = 0;
+
   /* Mark the service as halted */
 
   booted = 0;
 }
 
+void
+checkpt_staging( const char * dir ) {
+  checkpt_drain_wait();
+  FREE( stage_dir );
+  if( dir && dir[0] ) {
+    MALLOC( stage_dir, strlen(dir)+1 );
+    strcpy( stage_dir, dir );
+  }
+}
+
+void
+checkpt_incremental( int interval ) {
+  if( interval<0 ) ERROR(( "Bad args" ));
+  full_interval = interval;
+  n_delta       = 0;
+  base_name[0]  = '\0';
+  base_gen      = 0;
+}
+
+void
+checkpt_checksums( int enable ) {
+  sum_on = enable!=0;
+}
+
+void
+checkpt_buddy( const char * dir,
+               int stride ) {
+  if( stride<0 ) ERROR(( "Bad args" ));
+  FREE( buddy_dir );
+  if( dir && dir[0] ) {
+    MALLOC( buddy_dir, strlen(dir)+1 );
+    strcpy( buddy_dir, dir );
+  }
+  buddy_stride = stride;
+}
+
+void
+checkpt_drain_wait( void ) {
+  if( !drain_active ) return;
+  pthread_join( drain_thread, NULL );
+  drain_active = 0;
+  if( drain->err )
+    ERROR(( "Unable to drain staged checkpt \"%s\" to \"%s\"",
+            drain->src, drain->dst ));
+}
+
 size_t
 object_id( const void * obj ) {
   registry_t * node;
@@ -200,6 +943,9 @@ void register_object(
   node->checkpt_func   = checkpt_func;
   node->restore_func   = restore_func;
   node->reanimate_func = reanimate_func;
+  node->hash           = 0;
+  node->n_byte         = 0;
+  node->in_base        = 0;
   node->next           = NULL;
 
   /* And append it to the end of the registry */
@@ -239,6 +985,10 @@ unregister_object( void * obj ) {
 void
 checkpt_objects( const char * name ) {
   registry_t * node;
+  char local[1024], partial[1040];
+  size_t n_total = 0, n_same = 0, n_obj, n_record;
+  uint64_t hash, gen = 0;
+  int delta, same, throttle;
 
   /* Check input args */
 
@@ -246,21 +996,154 @@ checkpt_objects( const char * name ) {
   if( checkpt ) ERROR(( "currently writing a checkpt" ));
   if( restore ) ERROR(( "currently reading a checkpt" ));
 
-  /* Open the checkpt serialization stream */
+  /* Open the checkpt serialization stream.  When staging, wait for
+     the previous checkpt to finish draining and serialize to a
+     partial local copy first.  Otherwise, the checkpt is written
+     straight to its destination and goes through the I/O token
+     pool (see mp_begin_io). */
+
+  throttle = !stage_dir && !local_write;
+  n_stream = 0;
+  if( stage_dir ) {
+    checkpt_drain_wait();
+    local_name( local, sizeof(local), stage_dir, name );
+    snprintf( partial, sizeof(partial), "%s.partial", local );
+    checkpt = checkpt_open_wronly( partial );
+  } else {
+    if( throttle ) mp_begin_io( 0 );
+    checkpt = checkpt_open_wronly( name );
+  }
 
-  checkpt = checkpt_open_wronly( name );
-  CHECKPT_VAL( size_t, next_id );
+  /* Write a delta if there is a base to write it against.  The base
+     must not be overwritten by its own delta. */
+
+  delta = full_interval>0 && base_name[0] && n_delta+1<full_interval &&
+          strcmp( base_name, name );
+  if( sum_on ) CHECKPT_VAL( size_t, CHECKPT_SUMMED );
+  if( delta ) {
+    CHECKPT_VAL( size_t, CHECKPT_DELTA );
+    CHECKPT_VAL( size_t, next_id );
+    checkpt_str( base_name );
+    CHECKPT_VAL( uint64_t, base_gen );
+  } else {
+    if( full_interval ) {
+      gen = (uint64_t)time( NULL );
+      SUM_MIX( gen, (uint64_t)getpid() );
+      SUM_MIX( gen, ++n_gen );
+      if( !gen ) gen = 1;
+      CHECKPT_VAL( size_t, CHECKPT_GEN );
+      CHECKPT_VAL( uint64_t, gen );
+    }
+    CHECKPT_VAL( size_t, next_id );
+  }
+
+  if( full_interval && !world_rank )
+    log_printf( "*** Checkpt \"%s\" (%s%s%s)\n", name,
+                delta ? "delta against \"" : "full",
+                delta ? base_name : "", delta ? "\"" : "" );
 
   /* Checkpoint the objects */
 
   for( node=registry; node; node=node->next ) {
     dump_node( node );
-    CHECKPT_VAL( size_t, 0x600DF00D );
+
+    if( !full_interval ) {
+      CHECKPT_VAL( size_t, 0x600DF00D );
+      if( sum_on ) sum_begin();
+      checkpt_raw( node, sizeof(*node) );
+      checkpt_sym( (void *)(size_t)node->checkpt_func   );
+      checkpt_sym( (void *)(size_t)node->restore_func   );
+      checkpt_sym( (void *)(size_t)node->reanimate_func );
+      if( node->checkpt_func ) node->checkpt_func( node->obj );
+      if( sum_on ) checkpt_sum();
+      continue;
+    }
+
+    /* Serialize the object into the sink.  Only the object itself is
+       hashed; the registry entry holds addresses that do not say
+       anything about whether the object changed. */
+
+    sink_begin();
     checkpt_raw( node, sizeof(*node) );
     checkpt_sym( (void *)(size_t)node->checkpt_func   );
     checkpt_sym( (void *)(size_t)node->restore_func   );
     checkpt_sym( (void *)(size_t)node->reanimate_func );
+    sink_hashing = 1;
     if( node->checkpt_func ) node->checkpt_func( node->obj );
+    hash = sink_end();
+
+    n_obj = sink_payload;
+    same  = delta && node->in_base && node->hash==hash &&
+            node->n_byte==n_obj;
+
+    if( same ) {
+      CHECKPT_VAL( size_t, CHECKPT_SAME );
+      CHECKPT_VAL( size_t, node->id );
+      n_same += n_obj;
+    } else {
+      CHECKPT_VAL( size_t, CHECKPT_SIZED );
+      CHECKPT_VAL( size_t, node->id );
+      if( !sink_overflow ) {
+        CHECKPT_VAL( size_t, sink_len );
+        if( sum_on ) sum_begin();
+        checkpt_raw( sink_buf, sink_len );
+      } else {
+
+        /* The object did not fit in the sink.  Serialize it again, this
+           time straight to the checkpt.  The record size is not known
+           until the registry entry is written so it is measured on a
+           first pass that only hashes the registry entry. */
+
+        sink_begin();
+        checkpt_raw( node, sizeof(*node) );
+        checkpt_sym( (void *)(size_t)node->checkpt_func   );
+        checkpt_sym( (void *)(size_t)node->restore_func   );
+        checkpt_sym( (void *)(size_t)node->reanimate_func );
+        sink_end();
+        n_record = sink_len + n_obj;
+
+        CHECKPT_VAL( size_t, n_record );
+        n_written = 0;
+        if( sum_on ) sum_begin();
+        checkpt_raw( node, sizeof(*node) );
+        checkpt_sym( (void *)(size_t)node->checkpt_func   );
+        checkpt_sym( (void *)(size_t)node->restore_func   );
+        checkpt_sym( (void *)(size_t)node->reanimate_func );
+        if( node->checkpt_func ) node->checkpt_func( node->obj );
+        if( n_written!=n_record )
+          ERROR(( "Checkpt function %s wrote a different number of bytes "
+                  "for object %lu on a second pass",
+                  func_name( (void *)(size_t)node->checkpt_func ),
+                  (unsigned long)node->id ));
+      }
+      if( sum_on ) checkpt_sum();
+      n_total += n_obj;
+    }
+
+    if( !delta ) {
+      node->hash    = hash;
+      node->n_byte  = n_obj;
+      node->in_base = 1;
+    }
+
+    if( !world_rank )
+      log_printf( "    %6lu %-32s %14lu bytes%s\n",
+                  (unsigned long)node->id,
+                  func_name( (void *)(size_t)node->checkpt_func ),
+                  (unsigned long)n_obj, same ? " (unchanged)" : "" );
+  }
+
+  if( full_interval ) {
+    if( !world_rank )
+      log_printf( "    %lu bytes written, %lu bytes unchanged\n",
+                  (unsigned long)n_total, (unsigned long)n_same );
+    if( delta ) n_delta++;
+    else {
+      if( strlen(name)>=sizeof(base_name) ) ERROR(( "Checkpt name too long" ));
+      strcpy( base_name, name );
+      base_gen = gen;
+      n_delta = 0;
+    }
   }
 
   /* Mark that there are no more objects in the stream, close the
@@ -270,12 +1153,34 @@ checkpt_objects( const char * name ) {
   CHECKPT_VAL( size_t, 0xBADF00D );
   checkpt_close( checkpt );
   checkpt = NULL;
+  if( throttle ) mp_end_io( "Checkpt", (double)n_stream );
+
+  /* When staging, the local copy is now complete.  Replace the
+     previous local copy with it and drain it to its destination in
+     the background. */
+
+  if( stage_dir ) {
+    if( rename( partial, local ) )
+      ERROR(( "Unable to rename \"%s\" to \"%s\"", partial, local ));
+    if( stage_prev[0] && strcmp( stage_prev, local ) ) unlink( stage_prev );
+    strcpy( stage_prev, local );
+
+    strcpy( drain->src, local );
+    if( strlen(name) >= sizeof(drain->dst) )
+      ERROR(( "Checkpt name too long" ));
+    strcpy( drain->dst, name );
+    drain->err = 0;
+    if( pthread_create( &drain_thread, NULL, drain_main, drain ) )
+      ERROR(( "Unable to start the checkpt drain thread" ));
+    drain_active = 1;
+  }
 }
 
 void
 restore_objects( const char * name ) {
   registry_t * node, * prev;
-  size_t prefix;
+  size_t prefix, id;
+  int k, link;
 
   /* Check input args */
 
@@ -294,36 +1199,59 @@ restore_objects( const char * name ) {
   registry = NULL;
   next_id = 0;
 
-  /* Open the checkpt deserialization stream */
+  /* The restored objects are not in any base */
+
+  n_delta = 0;
+  base_name[0] = '\0';
+  base_gen = 0;
 
-  restore = checkpt_open_rdonly( name );
-  RESTORE_VAL( size_t, next_id );
+  /* Open the checkpt deserialization stream.  If the checkpt is a
+     delta, the bases it refers to are opened as they are needed. */
+
+  chain[0].f = open_restore( name );
+  n_chain = 1;
+  next_id = restore_header( 0 );
 
   /* Restore the objects */
 
   prev = NULL;
   for(;;) {
+    restore = chain[0].f;
+    link = 0;
     RESTORE_VAL( size_t, prefix );
     if( prefix== 0xBADF00D ) break;
-    if( prefix!=0x600DF00D )
+    if( prefix==CHECKPT_SIZED ) {
+      RESTORE_VAL( size_t, id );
+      RESTORE_VAL( size_t, id ); /* Record size */
+    } else if( prefix==CHECKPT_SAME ) {
+      RESTORE_VAL( size_t, id );
+      link = find_object( 1, id );
+    } else if( prefix!=0x600DF00D )
       ERROR(( "Malformed checkpt (expected an object header)" ));
     MALLOC( node, 1 );
+    if( chain[link].summed ) sum_begin();
     restore_raw( node, sizeof(*node) );
     node->checkpt_func   = (checkpt_func_t)  (size_t)restore_sym();
     node->restore_func   = (restore_func_t)  (size_t)restore_sym();
     node->reanimate_func = (reanimate_func_t)(size_t)restore_sym();
+    node->in_base = 0;
     node->next = NULL;
     if( !registry ) registry = node;
     if( prev ) prev->next = node;
     prev = node;
     dump_node( node );
     if( node->restore_func ) node->obj = node->restore_func();
+    if( chain[link].summed ) restore_sum( node );
   }
 
-  /* Close the checkpt deserialization stream and indicate that we are
-     no longer reading a checkpt */
+  /* Close the checkpt deserialization streams and indicate that we
+     are no longer reading a checkpt */
 
-  checkpt_close( restore );
+  for( k=0; k<n_chain; k++ ) {
+    checkpt_close( chain[k].f );
+    FREE( chain[k].base );
+  }
+  n_chain = 0;
   restore = NULL;
 }
 
@@ -345,6 +1273,186 @@ reanimate_objects( void ) {
   }
 }
 
+void
+checkpt_buddy_objects( const char * name ) {
+  char own[1024], held[1024], partial[1040];
+  char * save_stage_dir = stage_dir;
+  int save_full_interval = full_interval, p, q;
+
+  /* Check input args */
+
+  if( !booted ) ERROR(( "checkpt not booted" ));
+  if( !buddy_dir ) ERROR(( "buddy checkpointing is not enabled" ));
+  if( !name ) ERROR(( "NULL name" ));
+
+  buddy_setup();
+  p = ( world_rank + buddy_stride ) % world_size;
+  q = ( world_rank + world_size - buddy_stride % world_size ) % world_size;
+  buddy_name( own,  sizeof(own),  name, world_rank, 0 );
+  buddy_name( held, sizeof(held), name, q, 1 );
+
+  /* Write the local copy.  Buddy checkpts are always full checkpts
+     and are not staged. */
+
+  snprintf( partial, sizeof(partial), "%s.partial", own );
+  stage_dir = NULL, full_interval = 0, local_write = 1;
+  checkpt_objects( partial );
+  stage_dir = save_stage_dir, full_interval = save_full_interval;
+  local_write = 0;
+  if( rename( partial, own ) )
+    ERROR(( "Unable to rename \"%s\" to \"%s\"", partial, own ));
+
+  /* Mirror it on the partner (and hold the copy of the rank whose
+     partner this rank is) */
+
+  if( p!=world_rank ) buddy_shift( own, p, held, q );
+
+  /* Once every rank has both copies, the previous buddy checkpt is no
+     longer needed */
+
+  mp_barrier();
+  if( buddy_prev[0] && strcmp( buddy_prev, name ) ) {
+    buddy_name( own, sizeof(own), buddy_prev, world_rank, 0 );
+    unlink( own );
+    if( p!=world_rank ) {
+      buddy_name( held, sizeof(held), buddy_prev, q, 1 );
+      unlink( held );
+    }
+  }
+  if( strlen(name)>=sizeof(buddy_prev) ) ERROR(( "Checkpt name too long" ));
+  strcpy( buddy_prev, name );
+}
+
+int
+restore_buddy_objects( const char * name ) {
+  char own[1024], held[1024];
+  int have[2], * all, p, q, r, n_lost;
+
+  /* Check input args */
+
+  if( !booted ) ERROR(( "checkpt not booted" ));
+  if( !name ) ERROR(( "NULL name" ));
+  if( !buddy_dir ) return 0;
+
+  buddy_setup();
+  p = ( world_rank + buddy_stride ) % world_size;
+  q = ( world_rank + world_size - buddy_stride % world_size ) % world_size;
+  buddy_name( own,  sizeof(own),  name, world_rank, 0 );
+  buddy_name( held, sizeof(held), name, q, 1 );
+
+  /* Find which copies survived.  The checkpt of rank r can be
+     restored if either r still has it or the partner of r does. */
+
+  have[0] = checkpt_complete( own );
+  have[1] = p==world_rank || checkpt_complete( held );
+  MALLOC( all, 2*world_size );
+  mp_allgather_i( have, all, 2 );
+  for( n_lost=0, r=0; r<world_size; r++ ) {
+    if( all[2*r] ) continue;
+    if( !all[2*((r+buddy_stride)%world_size)+1] ||
+        (r+buddy_stride)%world_size==r ) {
+      FREE( all );
+      if( !world_rank )
+        log_printf( "*** No complete buddy checkpt \"%s\" (rank %i is "
+                    "lost)\n", name, r );
+      return 0;
+    }
+    n_lost++;
+  }
+
+  /* Recover lost local copies from the partners and then replace the
+     copies that the partners lost */
+
+  if( p!=world_rank ) {
+    buddy_shift( all[2*q]   ? NULL : held, q, have[0] ? NULL : own,  p );
+    buddy_shift( all[2*p+1] ? NULL : own,  p, have[1] ? NULL : held, q );
+  }
+  FREE( all );
+
+  if( !world_rank )
+    log_printf( "*** Restoring from buddy checkpt \"%s\" (%i rank%s "
+                "recovered from partners)\n", name, n_lost,
+                n_lost==1 ? "" : "s" );
+
+  restore_objects( own );
+  strcpy( buddy_prev, name );
+  return 1;
+}
+
+void *
+restore_detached( const char * name,
+                  restore_func_t root ) {
+  registry_t * live_registry = registry, * node;
+  size_t live_next_id = next_id;
+  int live_n_delta = n_delta;
+  uint64_t live_base_gen = base_gen;
+  char live_base_name[sizeof(base_name)];
+  void * obj = NULL;
+
+  /* Check input args */
+
+  if( !booted ) ERROR(( "checkpt not booted" ));
+  if( checkpt ) ERROR(( "currently writing a checkpt" ));
+  if( restore ) ERROR(( "currently reading a checkpt" ));
+  if( have_detached ) ERROR(( "a detached checkpt is already restored" ));
+  if( !root ) ERROR(( "NULL root" ));
+
+  /* Restore and reanimate the checkpt into an empty registry */
+
+  strcpy( live_base_name, base_name );
+  registry = NULL;
+  detached = 1;
+  restore_objects( name );
+  reanimate_objects();
+  detached = 0;
+
+  for( node=registry; node; node=node->next )
+    if( node->restore_func==root ) { obj = node->obj; break; }
+
+  /* Put the application's registry back */
+
+  detached_registry = registry;
+  have_detached     = 1;
+  registry          = live_registry;
+  next_id           = live_next_id;
+  n_delta           = live_n_delta;
+  strcpy( base_name, live_base_name );
+  base_gen          = live_base_gen;
+
+  if( !obj ) ERROR(( "\"%s\" has no root object", name ));
+  return obj;
+}
+
+void
+release_detached( void (*delete_func)( void * ),
+                  void * obj ) {
+  registry_t * live_registry = registry, * node, * prev;
+
+  if( !have_detached ) ERROR(( "no detached checkpt is restored" ));
+
+  /* Delete the objects with the detached registry in place (so that
+     they unregister from it) and then free whatever is left in it.
+     Objects still registered (e.g. the pipeline dispatchers) are not
+     owned by the detached restore. */
+
+  registry = detached_registry;
+  if( delete_func ) delete_func( obj );
+  node = registry;
+  while( node ) {
+    prev = node;
+    node = node->next;
+    FREE( prev );
+  }
+  registry          = live_registry;
+  detached_registry = NULL;
+  have_detached     = 0;
+}
+
+int
+restoring_detached( void ) {
+  return detached;
+}
+
 /* Primitive checkpt helpers */
 
 void
@@ -356,9 +1464,16 @@ checkpt_raw( const void * data,
   if( !checkpt ) ERROR(( "not writing a checkpt" ));
   if( !data && n_byte ) ERROR(( "NULL data" ));
 
-  /* Write data to the serialization stream */
+  /* Write data to the serialization stream (or, when building an
+     incremental checkpt, to the sink) */
 
-  if( n_byte ) checkpt_write( checkpt, data, n_byte );
+  if( sinking ) sink_write( data, n_byte );
+  else if( n_byte ) {
+    if( summing ) sum_update( data, n_byte, checkpt );
+    else          checkpt_write( checkpt, data, n_byte );
+    n_written += n_byte;
+    n_stream  += n_byte;
+  }
 }
 
 void
@@ -372,7 +1487,20 @@ restore_raw( void * data,
 
   /* Read data from the deserialization stream */
 
-  if( n_byte ) checkpt_read( restore, data, n_byte );
+  if( !summing ) {
+    if( n_byte ) checkpt_read( restore, data, n_byte );
+  } else {
+
+    /* Sum large reads a piece at a time while they are in cache */
+
+    char * p = (char *)data;
+    size_t n;
+    for( ; n_byte; n_byte -= n, p += n ) {
+      n = n_byte<16*CHECKPT_LEAF ? n_byte : 16*CHECKPT_LEAF;
+      checkpt_read( restore, p, n );
+      sum_update( p, n, NULL );
+    }
+  }
 }
 
 /* Composiite checkpt helpers */
@@ -399,13 +1527,19 @@ checkpt_data( const void * _data,
   CHECKPT_VAL( size_t, n_ele  ); CHECKPT_VAL( size_t, max_ele );
   CHECKPT_VAL( size_t, align  );
 
-  /* Write out the individual elements */
+  /* Write out the individual elements (in one go if they are packed) */
 
-  for( n=0; n<n_ele; n++ ) checkpt_raw( data+n*str_ele, sz_ele );
+  if( sz_ele==str_ele ) checkpt_raw( data, n_ele*sz_ele );
+  else for( n=0; n<n_ele; n++ ) checkpt_raw( data+n*str_ele, sz_ele );
 }
 
 void *
 restore_data( void ) {
+  return restore_data_arena( NULL );
+}
+
+void *
+restore_data_arena( const char * arena ) {
   char * data;
   size_t n, sz_ele, str_ele, n_ele, max_ele, align;
 
@@ -421,12 +1555,14 @@ restore_data( void ) {
 
   /* Allocate the data according to the header */
 
-  if( align==0 ) MALLOC(         data, max_ele*str_ele        );
-  else           MALLOC_ALIGNED( data, max_ele*str_ele, align );
+  if(      align==0 ) MALLOC(         data, max_ele*str_ele               );
+  else if( !arena   ) MALLOC_ALIGNED( data, max_ele*str_ele, align        );
+  else                MALLOC_ARENA(   data, max_ele*str_ele, align, arena );
 
   /* And read in the checkpointed elements */
 
-  for( n=0; n<n_ele; n++ ) restore_raw( data+n*str_ele, sz_ele );
+  if( sz_ele==str_ele ) restore_raw( data, n_ele*sz_ele );
+  else for( n=0; n<n_ele; n++ ) restore_raw( data+n*str_ele, sz_ele );
   return data;
 }
 
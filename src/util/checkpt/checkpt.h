@@ -95,7 +95,13 @@ object_ptr( size_t id );
    practically (and the objects registered during boot_services
    know how to handle this case).  In short, restore_objects
    nominally should be called after boot_services and before
-   and before any new objects are registered. */
+   and before any new objects are registered.
+
+   Each object is written with a checksum of its serialized bytes
+   (hashed in parallel by the pipelines as it is written) and
+   restore_objects verifies it, so a corrupt checkpt is detected
+   when it is read rather than when the simulation goes wrong.
+   Checkpts written without checksums can still be restored. */
 
 void
 checkpt_objects( const char * name );
@@ -103,6 +109,101 @@ checkpt_objects( const char * name );
 void
 restore_objects( const char * name );
 
+/* Enable or disable the object checksums written by later calls to
+   checkpt_objects (e.g. to skip them for frequent checkpts that are
+   only kept briefly).  Checksums are enabled by default.  They can
+   also be disabled with the --checkpt_checksums 0 command line
+   option. */
+
+void
+checkpt_checksums( int enable );
+
+/* Enable two-stage checkpointing.  When dir is not NULL,
+   checkpt_objects serializes to a local copy of the checkpt in dir
+   (e.g. a tmpfs or node-local disk) and then drains that copy to the
+   requested name from a background thread while the caller continues.
+   The drained checkpt only appears under its name once complete.
+   restore_objects prefers a complete local copy if one exists.
+   Passing NULL disables staging.  Staging can also be enabled with
+   the --checkpt_stage <dir> command line option.
+
+   checkpt_drain_wait blocks until any checkpt being drained is
+   complete.  It is called automatically before the next checkpt and
+   when the checkpt service is halted. */
+
+void
+checkpt_staging( const char * dir );
+
+void
+checkpt_drain_wait( void );
+
+/* Enable incremental checkpointing.  When interval is non-zero, every
+   interval-th checkpt written by checkpt_objects is a full checkpt and
+   the others are deltas that only hold the objects that changed since
+   the most recent full checkpt (objects are compared by a hash of
+   their serialized bytes).  A delta refers to its full checkpt by
+   name, so the full checkpt must be kept for as long as the delta is;
+   a checkpt that would overwrite its own base is written in full.
+   restore_objects follows a delta to its base as needed and fails if
+   the base has been overwritten since the delta was written.  A size
+   report of every object is logged with each checkpt.  Passing 0
+   (the default) disables incremental checkpointing.  It can also be
+   enabled with the --checkpt_incremental <interval> command line
+   option. */
+
+void
+checkpt_incremental( int interval );
+
+/* Enable partner ("buddy") checkpointing.  When dir is not NULL,
+   checkpt_buddy_objects writes the checkpt of each rank to dir
+   (nominally node-local memory like /dev/shm) and mirrors it in the
+   dir of a partner rank stride ranks above it.  A stride of 0 (the
+   default) picks the number of ranks per node, so that after losing a
+   node every checkpt survives on some other node (this assumes ranks
+   are placed on nodes in blocks and that a restart keeps the ranks of
+   the surviving nodes on those nodes).  Buddy checkpts are always
+   full checkpts; only the most recent complete one is kept.  Buddy
+   checkpointing can also be enabled with the --checkpt_buddy <dir>
+   and --checkpt_buddy_stride <stride> command line options.
+
+   checkpt_buddy_objects is collective.  restore_buddy_objects is too;
+   it recovers the local copies lost with a node from the partners and
+   restores from them (the caller still reanimates).  It returns 0
+   without restoring anything if buddy checkpointing is not enabled or
+   if some rank's checkpt did not survive, in which case a checkpt
+   written by checkpt_objects should be restored instead. */
+
+void
+checkpt_buddy( const char * dir,
+               int stride );
+
+void
+checkpt_buddy_objects( const char * name );
+
+int
+restore_buddy_objects( const char * name );
+
+/* Restore and reanimate the checkpt name into a registry separate
+   from the application's (e.g. to read a checkpt written by a
+   different process).  Returns the first object restored by root.
+   Restore functions can call restoring_detached to skip consistency
+   checks against the state of the current process (e.g. its rank).
+   Only one detached checkpt can be restored at a time;
+   release_detached calls delete_func on obj (typically the root) and
+   then forgets the detached registry.  Detached objects not deleted by
+   delete_func are not freed. */
+
+void *
+restore_detached( const char * name,
+                  restore_func_t root );
+
+void
+release_detached( void (*delete_func)( void * ),
+                  void * obj );
+
+int
+restoring_detached( void );
+
 /* Call the reanimate functions on all objects.  This is typically
    done after the restore process. */
 
@@ -150,6 +251,13 @@ checkpt_data( const void * data,
 void *
 restore_data( void );
 
+/* Same as restore_data, but data checkpointed with a non-zero align
+   is allocated as:
+     MALLOC_ARENA( (char *)data, max_ele*str_ele, align, arena ) */
+
+void *
+restore_data_arena( const char * arena );
+
 /* Checkpt(restore) a '\0'-terminated string.  The returned pointer of
    restore_str heap_allocated as:
      MALLOC( (char *)string, strlen_string+1 )
@@ -311,6 +419,7 @@ restore_sym( void );
   } while(0)
 
 #define RESTORE_ALIGNED(p) CXX_ILLEGAL_PTR_COPY( (p), restore_data() )
+#define RESTORE_ARENA(p,a) CXX_ILLEGAL_PTR_COPY( (p), restore_data_arena((a)) )
 #define RESTORE(p)         RESTORE_ALIGNED((p))
 #define RESTORE_STR(p)     CXX_ILLEGAL_PTR_COPY( (p), restore_str()  )
 #define RESTORE_FPTR(p)    CXX_ILLEGAL_PTR_COPY( (p), restore_fptr() )
@@ -30,3 +30,9 @@ checkpt_write( checkpt_t * checkpt,
                size_t sz ) {
 	return CheckPtIO::checkpt_write(checkpt, data, sz);
 }
+
+void
+checkpt_skip( checkpt_t * checkpt,
+              size_t sz ) {
+	return CheckPtIO::checkpt_skip(checkpt, sz);
+}
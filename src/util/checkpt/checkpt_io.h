@@ -48,8 +48,12 @@ struct CheckPtIO {
 
 		FileIO * fileIO = reinterpret_cast<FileIO *>(checkpt);
 
-		// FIXME: add return values
-		fileIO->read(reinterpret_cast<char *>(data), sz);
+		// A short read means the checkpt was cut short (e.g. a partial
+		// copy left by an interrupted drain)
+		if(fileIO->read(reinterpret_cast<char *>(data), sz) != sz) {
+  			ERROR(("Truncated checkpt (unable to read %lu bytes)",
+				(unsigned long)sz));
+		} // if
 	} // checkpt_read
 
 	static void checkpt_write(checkpt_t * checkpt, const void * data,
@@ -63,6 +67,18 @@ struct CheckPtIO {
 		fileIO->write(reinterpret_cast<const char *>(data), sz);
 	} // checkpt_write
 
+	static void checkpt_skip(checkpt_t * checkpt, size_t sz) {
+		if(!sz) return;
+		if(!checkpt) ERROR(("Invalid checkpt_skip request"));
+
+		FileIO * fileIO = reinterpret_cast<FileIO *>(checkpt);
+
+		if(fileIO->seek(uint64_t(sz), SEEK_CUR) != 0) {
+  			ERROR(("Unable to skip %lu bytes of checkpt",
+				(unsigned long)sz));
+		} // if
+	} // checkpt_skip
+
 }; // struct CheckPtIO
 
 #endif // CheckPtIO_h
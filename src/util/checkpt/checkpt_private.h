@@ -31,6 +31,10 @@ checkpt_write( checkpt_t * checkpt,
                const void * data,
                size_t sz );
 
+void
+checkpt_skip( checkpt_t * checkpt,
+              size_t sz );
+
 END_C_DECLS
 
 #endif /* _checkpt_private_h_ */
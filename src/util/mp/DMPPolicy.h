@@ -32,6 +32,17 @@ collective_t * _world = &__world;
 int _world_rank = 0;
 int _world_size = 1;
 
+/* The I/O token pools.  _io_comm[0] holds all processes and
+   _io_comm[1] the processes on this node.  The lowest rank of each
+   holds its tokens. */
+
+static MPI_Comm _io_comm[2] = { MPI_COMM_NULL, MPI_COMM_NULL };
+static int _io_default = 0, _io_per_node = 0; // Set by mp_io_tokens
+static int _io_token = 0, _io_pool = 0;       // Of the current I/O
+static int _io_depth = 0;                     // Nesting of the current I/O
+static int _io_active = 0, _io_done = 0;      // Token holder state
+static double _io_begin = 0, _io_start = 0;   // Wait and write start
+
 /* collective checkpointer */
 /* FIXME: SINCE RIGHT NOW, THERE IS ONLY THE WORLD COLLECTIVE AND NO WAY
    TO CREATE CHILDREN COLLECTIVES, THIS IS BASICALLY A PLACEHOLDER. */
@@ -47,6 +58,7 @@ restore_collective( void ) {
   int rank, size;
   RESTORE_VAL( int, rank );
   RESTORE_VAL( int, size );
+  if( restoring_detached() ) return world;
   if( size!=world_size )
     ERROR(( "The number of nodes that made this checkpt (%i) is different "
             "from the number of nodes currently (%i)",
@@ -95,6 +107,9 @@ struct DMPPolicy {
   // be removed in the long haul.
 
 # define RESIZE_FACTOR 1.3125
+# define IO_REQUEST 1
+# define IO_GRANT   2
+# define IO_RELEASE 3
 # define TRAP( x ) do {                                                  \
      int ierr = (x);                                                     \
      if( ierr!=MPI_SUCCESS ) ERROR(( "MPI error %i on "#x, ierr ));      \
@@ -108,12 +123,22 @@ struct DMPPolicy {
     __world.parent = NULL, __world.color = 0, __world.key = 0;
     TRAP( MPI_Comm_rank( __world.comm, &_world_rank ) );
     TRAP( MPI_Comm_size( __world.comm, &_world_size ) );
+    TRAP( MPI_Comm_dup( MPI_COMM_WORLD, &_io_comm[0] ) );
+    TRAP( MPI_Comm_split_type( MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0,
+                               MPI_INFO_NULL, &_io_comm[1] ) );
     REGISTER_OBJECT( &__world, checkpt_collective, restore_collective, NULL );
+
+    int n_node_token = strip_cmdline_int( pargc, pargv, "--io_tokens_per_node", 0 );
+    int n_token      = strip_cmdline_int( pargc, pargv, "--io_tokens",          0 );
+    if( n_node_token>0 ) mp_io_tokens( n_node_token, 1 );
+    else                 mp_io_tokens( n_token,      0 );
   }
   
   inline void
   halt_mp( void ) {
     UNREGISTER_OBJECT( &__world );
+    TRAP( MPI_Comm_free( &_io_comm[1] ) );
+    TRAP( MPI_Comm_free( &_io_comm[0] ) );
     TRAP( MPI_Comm_free( &__world.comm ) );
     __world.parent = NULL, __world.color = 0, __world.key = 0;
     __world.comm = MPI_COMM_SELF;
@@ -192,6 +217,103 @@ struct DMPPolicy {
     TRAP( MPI_Recv( buf, n, MPI_INT, src, 0, world->comm, MPI_STATUS_IGNORE ) );
   }
   
+  inline void
+  mp_io_tokens( int n_token,
+                int per_node ) {
+    _io_default  = n_token>0 ? n_token : 0;
+    _io_per_node = per_node ? 1 : 0;
+  }
+
+  inline void
+  mp_begin_io( int n_token ) {
+    MPI_Status status;
+    MPI_Comm comm;
+    int rank, size, n_grant, head, tail, * queue, buf = 0;
+
+    if( _io_depth++ ) return; // Already holds a token
+
+    _io_begin = MPI_Wtime();
+    _io_token = n_token>0 ? n_token : n_token<0 ? 0 : _io_default;
+    _io_pool  = n_token>0 ? 0       : _io_per_node;
+    if( !_io_token ) {
+      _io_start = _io_begin;
+      return;
+    }
+
+    comm = _io_comm[_io_pool];
+    TRAP( MPI_Comm_rank( comm, &rank ) );
+    TRAP( MPI_Comm_size( comm, &size ) );
+
+    if( rank ) {
+      TRAP( MPI_Send( &buf, 1, MPI_INT, 0, IO_REQUEST, comm ) );
+      TRAP( MPI_Recv( &buf, 1, MPI_INT, 0, IO_GRANT, comm, MPI_STATUS_IGNORE ) );
+      _io_start = MPI_Wtime();
+      return;
+    }
+
+    // Hand the tokens to the other processes in the order they ask for
+    // them until all have had one.  The token holder takes its own
+    // token last so that it is never busy writing while others wait.
+
+    MALLOC( queue, size );
+    n_grant = head = tail = 0;
+    _io_active = _io_done = 0;
+    while( n_grant<size-1 || _io_active>=_io_token ) {
+      TRAP( MPI_Recv( &buf, 1, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, comm,
+                      &status ) );
+      if( status.MPI_TAG==IO_REQUEST ) queue[tail++] = status.MPI_SOURCE;
+      else                             _io_active--, _io_done++;
+      for( ; head<tail && _io_active<_io_token; head++, n_grant++ ) {
+        TRAP( MPI_Send( &buf, 1, MPI_INT, queue[head], IO_GRANT, comm ) );
+        _io_active++;
+      }
+    }
+    FREE( queue );
+    _io_active++;
+    _io_start = MPI_Wtime();
+  }
+
+  inline void
+  mp_end_io( const char * what,
+             double n_byte ) {
+    double local[3], global[3], t = MPI_Wtime();
+    int rank = 0, size = 1, buf = 0;
+
+    if( _io_depth<1 ) ERROR(( "mp_end_io without mp_begin_io" ));
+    if( --_io_depth ) return; // Still holds the outer token
+
+    if( _io_token ) {
+      MPI_Comm comm = _io_comm[_io_pool];
+      TRAP( MPI_Comm_rank( comm, &rank ) );
+      TRAP( MPI_Comm_size( comm, &size ) );
+      if( rank )
+        TRAP( MPI_Send( &buf, 1, MPI_INT, 0, IO_RELEASE, comm ) );
+      else
+        for( ; _io_done<size-1; _io_done++ )
+          TRAP( MPI_Recv( &buf, 1, MPI_INT, MPI_ANY_SOURCE, IO_RELEASE, comm,
+                          MPI_STATUS_IGNORE ) );
+      _io_active = 0;
+    }
+    if( !what || !_io_token ) return;
+
+    // Report the bytes written, the time spent writing and the tokens.
+    // This is a reduction over all processes, so it is only done when
+    // throttled (every process takes part in a throttled write anyway);
+    // unthrottled writes stay local to the processes that make them.
+
+    local[0] = n_byte;
+    local[1] = t - _io_start;
+    local[2] = rank ? 0 : ( _io_token<size ? _io_token : size );
+    TRAP( MPI_Allreduce( local, global, 3, MPI_DOUBLE, MPI_SUM, world->comm ) );
+    if( world_rank ) return;
+    t = MPI_Wtime() - _io_begin;
+    log_printf( "*** %s: %.4g MB in %.4g s (%.4g MB/s aggregate, "
+                "%.4g MB/s per writer, %.0f tokens %.0f%% busy)\n", what,
+                global[0]*1e-6, t, global[0]*1e-6/t,
+                global[1]>0 ? global[0]*1e-6/global[1] : 0., global[2],
+                100*global[1]/( global[2]*t ) );
+  }
+
   inline mp_t *
   new_mp( int n_port ) {
     mp_t * mp;
@@ -342,6 +464,9 @@ struct DMPPolicy {
     TRAP( MPI_Wait( &mp->sreq[port], MPI_STATUS_IGNORE ) );
   }
   
+# undef IO_RELEASE
+# undef IO_GRANT
+# undef IO_REQUEST
 # undef RESIZE_FACTOR
 # undef TRAP
 
@@ -30,6 +30,12 @@ collective_t * _world = &__world;
 int _world_rank = 0;
 int _world_size = 1;
 
+/* The I/O token pool */
+
+static int _io_default = 0;   // Set by mp_io_tokens
+static int _io_token   = 0;   // Of the current I/O
+static int _io_depth   = 0;   // Nesting of the current I/O
+
 /* collective checkpointer */
 /* FIXME: SINCE RIGHT NOW, THERE IS ONLY THE WORLD COLLECTIVE AND NO WAY
    TO CREATE CHILDREN COLLECTIVES (NOT EVEN IN PRINCIPLE WITH THE CURRENT
@@ -46,6 +52,7 @@ restore_collective( void ) {
   int rank, size;
   RESTORE_VAL( int, rank );
   RESTORE_VAL( int, size );
+  if( restoring_detached() ) return world;
   if( size!=world_size )
     ERROR(( "The number of processes that made this checkpt (%i) is different "
             "from the number of processes currently (%i)", size, world_size ));
@@ -216,6 +223,35 @@ struct RelayPolicy {
     p2p.recv( buf, request.count, request.tag, request.id );
   }
 
+  // FIXME: RELAY CANNOT RECEIVE FROM ANY SOURCE, SO THE I/O TOKENS ARE
+  // PASSED ALONG IN RANK ORDER (THE OLD TURNSTILE), THERE ARE NO PER
+  // NODE POOLS AND NOTHING IS REPORTED.
+
+  inline void
+  mp_io_tokens( int n_token,
+                int per_node ) {
+    _io_default = n_token>0 ? n_token : 0;
+  }
+
+  inline void
+  mp_begin_io( int n_token ) {
+    int baton;
+    if( _io_depth++ ) return; // Already holds a token
+    _io_token = n_token>0 ? n_token : n_token<0 ? 0 : _io_default;
+    if( _io_token && world_rank>=_io_token )
+      mp_recv_i( &baton, 1, world_rank-_io_token );
+  }
+
+  inline void
+  mp_end_io( const char * what,
+             double n_byte ) {
+    int baton = 0;
+    if( _io_depth<1 ) ERROR(( "mp_end_io without mp_begin_io" ));
+    if( --_io_depth ) return; // Still holds the outer token
+    if( _io_token && world_rank+_io_token<world_size )
+      mp_send_i( &baton, 1, world_rank+_io_token );
+  }
+
   /* ---- BEGIN EXACT CUT-AND-PASTE JOB FROM DMPPOLICY ---- */
   /* FIXME-KJB: AT THIS POINT, MUCH OF MP IN DMP AND RELAY COULD BE EXTRACTED
      INTO A UNIFIED IMPLEMENTATION (AND, AT THE SAME TIME, THE API FIXED) */
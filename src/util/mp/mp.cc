@@ -49,6 +49,18 @@ void mp_recv_i( int *buf, int n, int src ) {
   return MPWrapper::instance().mp_recv_i( buf, n, src );
 }
 
+void mp_io_tokens( int n_token, int per_node ) {
+  MPWrapper::instance().mp_io_tokens( n_token, per_node );
+}
+
+void mp_begin_io( int n_token ) {
+  MPWrapper::instance().mp_begin_io( n_token );
+}
+
+void mp_end_io( const char * what, double n_byte ) {
+  MPWrapper::instance().mp_end_io( what, n_byte );
+}
+
 mp_t * new_mp( int n_port ) { return MPWrapper::instance().new_mp( n_port ); }
 
 void delete_mp( mp_t * mp ) { MPWrapper::instance().delete_mp( mp ); }
@@ -28,19 +28,23 @@ typedef struct mp mp_t;
    BEGIN_TURNSTILE(1) (i.e., one turnstile) effectively serializes the
    code.  This construct is robust.  Turnstiles should not be nested.
    Code in turnstiles should not attempt to communicate with other
-   processes.
+   processes.  A process in a turnstile holds an I/O token (see
+   mp_begin_io), so dumps and checkpts written in a turnstile are
+   not throttled again.
   
    If everything were perfectly synchronous, then, when
    using a 10 turnstiles, processes 0:9 would enter the turnstile,
    followed by 10:19, followed by 20:29, ... */
 
 #define BEGIN_TURNSTILE(n_turnstile) do {               \
-   int _n_turnstile = (n_turnstile), _baton;            \
+   int _n_turnstile = (n_turnstile), _baton = 0;        \
    if( world_rank>=_n_turnstile )                       \
       mp_recv_i( &_baton, 1, world_rank-_n_turnstile ); \
+   mp_begin_io( -1 );                                   \
    do
 
 #define END_TURNSTILE while(0);                         \
+   mp_end_io( NULL, 0 );                                \
    if( world_rank+_n_turnstile < world_size )           \
      mp_send_i( &_baton, 1, world_rank+_n_turnstile );  \
  } while(0)
@@ -101,6 +105,36 @@ mp_recv_i( int * buf,
            int n,
            int src );
 
+/* Throttled I/O.  At most n_token processes (in all or, if per_node
+   is set, on each node) are between mp_begin_io and mp_end_io at any
+   given time.  The tokens are held by the lowest rank of each pool,
+   which hands them to the other processes in the order they ask for
+   them and takes its own token last.  When throttled, all processes
+   must call both; code in between should not communicate with other
+   processes.  When not throttled (n_token<0 or no pool set), both are
+   local and need only be called by the processes that write.  Calls
+   nested in an mp_begin_io / mp_end_io pair (e.g. a dump in a
+   turnstile) do nothing, as the process already holds a token.
+
+   mp_io_tokens sets the pool used when mp_begin_io is passed
+   n_token==0 (n_token<1 here disables throttling).  It can also be
+   set with the --io_tokens <n> and --io_tokens_per_node <n> command
+   line options.  When throttled and what is not NULL, mp_end_io logs
+   the bytes written (n_byte summed over all processes), the aggregate
+   and per writer bandwidth and the fraction of the time the tokens
+   were in use. */
+
+void
+mp_io_tokens( int n_token,
+              int per_node );
+
+void
+mp_begin_io( int n_token );
+
+void
+mp_end_io( const char * what,
+           double n_byte );
+
 /* Buffered non-blocking point-to-point communications */
 
 mp_t *
@@ -17,7 +17,7 @@ pipeline_dispatcher_t *
 restore_serial( void ) {
   int n_pipeline;
   RESTORE_VAL( int, n_pipeline );
-  if( serial.n_pipeline!=n_pipeline )
+  if( serial.n_pipeline!=n_pipeline && !restoring_detached() )
     ERROR(( "--serial.n_pipeline changed between checkpt (%i) and "
             "restore (%i)", serial.n_pipeline, n_pipeline ));
   return &serial;
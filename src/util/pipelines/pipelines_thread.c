@@ -85,7 +85,7 @@ pipeline_dispatcher_t *
 restore_thread( void ) {
   int n_pipeline;
   RESTORE_VAL( int, n_pipeline );
-  if( thread.n_pipeline!=n_pipeline )
+  if( thread.n_pipeline!=n_pipeline && !restoring_detached() )
     ERROR(( "--tpp changed between checkpt (%i) and restore (%i)",
             n_pipeline, thread.n_pipeline ));
   return &thread;
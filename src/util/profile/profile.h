@@ -40,7 +40,8 @@
   _( user_particle_injection ) \
   _( user_current_injection ) \
   _( user_field_injection ) \
-  _( user_diagnostics  )
+  _( user_diagnostics  ) \
+  _( trace_particles   )
 
 // TIC / TOC are used to update the timing profile.  For example:
 //
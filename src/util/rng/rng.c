@@ -16,6 +16,32 @@ restore_rng( void ) {
   return r;
 }
 
+/* Copy the next n_ele sz_ele-byte rands of r into x.  This draws
+   exactly the rands n_ele RNG_NEXT of that size would but copies whole
+   runs of the state at a time.  The bulk generators below work on
+   chunks of RNG_CHUNK rands copied this way such that their inner
+   loops are free of the state management and can be vectorized. */
+
+enum { RNG_CHUNK = 256 };
+
+static void
+rng_copy( rng_t * RESTRICT r,
+          void  * RESTRICT x,
+          uint32_t sz_ele,
+          size_t n_ele ) {
+  unsigned char * RESTRICT y = (unsigned char *)x;
+  uint32_t _n = ( r->n + sz_ele-1 ) & ~( sz_ele-1 );
+  size_t m;
+  while( n_ele ) {
+    if( _n >= SFMT_NC ) _n = rng_next( r );
+    m = ( SFMT_NC - _n ) / sz_ele;
+    if( m > n_ele ) m = n_ele;
+    memcpy( y, r->state.uc + _n, m*sz_ele );
+    y += m*sz_ele, n_ele -= m, _n += (uint32_t)( m*sz_ele );
+  }
+  r->n = _n;
+}
+
 /* Public API ***************************************************************/
 
 /* Structors */
@@ -71,6 +97,25 @@ seed_rng( rng_t * RESTRICT r,
     u(n) = ((uint32_t)1812433253) * (u(n-1)^(u(n-1)>>30)) + n;
   adjust_rng( r );
   r->n = SFMT_NC;
+  r->philox = 0;
+  return r;
+}
+
+rng_t *
+seek_rng( rng_t * RESTRICT r,
+          int seed,
+          int stream,
+          int64_t step,
+          int index ) {
+  if( !r ) ERROR(( "Bad args" ));
+  r->philox = 1;
+  r->key[0] = (uint32_t)seed;
+  r->key[1] = (uint32_t)stream;
+  r->ctr[0] = 0;
+  r->ctr[1] = (uint32_t)index;
+  r->ctr[2] = (uint32_t)(uint64_t)step;
+  r->ctr[3] = (uint32_t)(((uint64_t)step)>>32);
+  r->n = SFMT_NC;
   return r;
 }
 
@@ -94,6 +139,10 @@ prefix##rand_fill( rng_t * RESTRICT r,                          \
   size_t n;                                                     \
   if( !n_ele ) return x;                                        \
   if( !r || !x ) ERROR(( "Bad args" ));                         \
+  if( str_ele==1 && !is_signed ) {                              \
+    rng_copy( r, x, (uint32_t)sizeof(type), n_ele );            \
+    return x;                                                   \
+  }                                                             \
   for( n=0; n<n_ele; n++ )                                      \
     RNG_NEXT( x[n*str_ele], type, r, state_prefix, is_signed ); \
   return x;                                                     \
@@ -125,13 +174,15 @@ prefix##rand##variant##_fill( rng_t * RESTRICT r,               \
                               type  * RESTRICT x,               \
                               size_t str_ele,                   \
                               size_t n_ele ) {                  \
-  state_type u;                                                 \
-  size_t n;                                                     \
+  state_type u[ RNG_CHUNK ];                                    \
+  size_t n, m, k;                                               \
   if( !n_ele ) return x;                                        \
   if( !r || !x ) ERROR(( "Bad args" ));                         \
-  for( n=0; n<n_ele; n++ ) {                                    \
-    RNG_NEXT( u, state_type, r, state_prefix, 0 );              \
-    x[n*str_ele] = conv_##prefix##rand##variant( u );           \
+  for( n=0; n<n_ele; n+=m ) {                                   \
+    m = n_ele-n < RNG_CHUNK ? n_ele-n : RNG_CHUNK;              \
+    rng_copy( r, u, (uint32_t)sizeof(state_type), m );          \
+    for( k=0; k<m; k++ )                                        \
+      x[(n+k)*str_ele] = conv_##prefix##rand##variant( u[k] );  \
   }                                                             \
   return x;                                                     \
 }
@@ -333,15 +384,64 @@ frandn( rng_t * RESTRICT r ) {
  return sgn[s]*x; // FIXME: Use copysign, trinary or branch? 
 }
 
+/* The mass production variants run the first trial of the ziggurat
+   for a whole chunk of rands at once.  This is branch free and
+   vectorizes (the table lookups become gathers).  The few points not
+   accepted by the first trial then finish their trial as frandn does
+   and, if rejected there too, are replaced by a fresh frandn. */
+
 float *
 frandn_fill( rng_t * RESTRICT r,
              float * RESTRICT x,
              size_t str_ele,
              size_t n_ele ) {
-  size_t n;
+  uint32_t a[ RNG_CHUNK ], i[ RNG_CHUNK ], j;
+  float    y[ RNG_CHUNK ], u, v;
+  size_t n, m, k;
+
+  static const float scale = 1.f/4.294967296e+09f;
+
   if( !n_ele ) return x;
   if( !r || !x ) ERROR(( "Bad args" ));
-  for( n=0; n<n_ele; n++ ) x[ n*str_ele ] = frandn( r );
+
+  for( n=0; n<n_ele; n+=m ) {
+    m = n_ele-n < RNG_CHUNK ? n_ele-n : RNG_CHUNK;
+    rng_copy( r, a, (uint32_t)sizeof(uint32_t), m );
+
+    // First trial.  i[k] is left at FRANDN_N if accepted.
+
+    for( k=0; k<m; k++ ) {
+      i[k] = ( a[k] &   (uint32_t)0x7e  ) >> 1;
+      j    = ( a[k] &   (uint32_t)0x80  ) << 1;
+      j    = ( a[k] & (~(uint32_t)0xff) ) + j;
+      y[k] = (float)j*(scale*frandn_zig_x[i[k]+1]);
+      i[k] = y[k]<frandn_zig_x[i[k]] ? (uint32_t)FRANDN_N : i[k];
+    }
+
+    for( k=0; k<m; k++ ) x[(n+k)*str_ele] = ( a[k] & 1 ) ? -y[k] : y[k];
+
+    // Finish the trials of the rest.  (Kept out of the above loop as
+    // it keeps that loop from vectorizing.)
+
+    for( k=0; k<m; k++ ) {
+      if( UNLIKELY( i[k]!=FRANDN_N ) ) {
+        v = y[k];
+        RNG_NEXT( j, uint32_t, r, u32, 0 );
+        u = conv_frand_c(j);
+        if( LIKELY( i[k]!=FRANDN_N-1 ) )
+          u = frandn_zig_y[i[k]] +
+              ( frandn_zig_y[i[k]+1] - frandn_zig_y[i[k]] )*u;
+        else { // In tail
+          RNG_NEXT( j, uint32_t, r, u32, 0 );
+          v  = FRANDN_R - (1.f/FRANDN_R)*logf( conv_frand_c1(j) );
+          u *= expf( -FRANDN_R*( v - 0.5f*FRANDN_R ) );
+        }
+        x[(n+k)*str_ele] = u < expf(-0.5f*v*v) ? ( ( a[k] & 1 ) ? -v : v )
+                                              : frandn( r );
+      }
+    }
+  }
+
   return x;
 }
 
@@ -397,10 +497,53 @@ drandn_fill( rng_t  * RESTRICT r,
              double * RESTRICT x,
              size_t str_ele,
              size_t n_ele ) {
-  size_t n;
+  uint64_t a[ RNG_CHUNK ], i[ RNG_CHUNK ], j;
+  double   y[ RNG_CHUNK ], u, v;
+  size_t n, m, k;
+
+  static const double scale = 1./1.8446744073709551616e+19;
+
   if( !n_ele ) return x;
   if( !r || !x ) ERROR(( "Bad args" ));
-  for( n=0; n<n_ele; n++ ) x[ n*str_ele ] = drandn( r );
+
+  for( n=0; n<n_ele; n+=m ) {
+    m = n_ele-n < RNG_CHUNK ? n_ele-n : RNG_CHUNK;
+    rng_copy( r, a, (uint32_t)sizeof(uint64_t), m );
+
+    // First trial (see frandn_fill)
+
+    for( k=0; k<m; k++ ) {
+      i[k] = ( a[k] &   (uint64_t)0x1fe ) >> 1;
+      j    = ( a[k] &   (uint64_t)0x400 ) << 1;
+      j    = ( a[k] & (~(uint64_t)0x3ff)) + j;
+      y[k] = (double)j*(scale*drandn_zig_x[i[k]+1]);
+      i[k] = y[k]<drandn_zig_x[i[k]] ? (uint64_t)DRANDN_N : i[k];
+    }
+
+    for( k=0; k<m; k++ ) x[(n+k)*str_ele] = ( a[k] & 1 ) ? -y[k] : y[k];
+
+    // Finish the trials of the rest.  (Kept out of the above loop as
+    // it keeps that loop from vectorizing.)
+
+    for( k=0; k<m; k++ ) {
+      if( UNLIKELY( i[k]!=DRANDN_N ) ) {
+        v = y[k];
+        RNG_NEXT( j, uint64_t, r, u64, 0 );
+        u = conv_drand_c(j);
+        if( LIKELY( i[k]!=DRANDN_N-1 ) )
+          u = drandn_zig_y[i[k]] +
+              ( drandn_zig_y[i[k]+1] - drandn_zig_y[i[k]] )*u;
+        else { // In tail
+          RNG_NEXT( j, uint64_t, r, u64, 0 );
+          v  = DRANDN_R - (1./DRANDN_R)*log( conv_drand_c1(j) );
+          u *= exp( -DRANDN_R*( v - 0.5*DRANDN_R ) );
+        }
+        x[(n+k)*str_ele] = u < exp(-0.5*v*v) ? ( ( a[k] & 1 ) ? -v : v )
+                                              : drandn( r );
+      }
+    }
+  }
+
   return x;
 }
 
@@ -420,10 +563,15 @@ frande_fill( rng_t * RESTRICT r,
              float * RESTRICT x,
              size_t str_ele,
              size_t n_ele ) {
-  size_t n;
+  uint32_t a[ RNG_CHUNK ];
+  size_t n, m, k;
   if( !n_ele ) return x;
   if( !r || !x ) ERROR(( "Bad args" ));
-  for( n=0; n<n_ele; n++ ) x[ n*str_ele ] = frande( r );
+  for( n=0; n<n_ele; n+=m ) {
+    m = n_ele-n < RNG_CHUNK ? n_ele-n : RNG_CHUNK;
+    rng_copy( r, a, (uint32_t)sizeof(uint32_t), m );
+    for( k=0; k<m; k++ ) x[(n+k)*str_ele] = -logf( conv_frand_c1(a[k]) );
+  }
   return x;
 }
 
@@ -439,10 +587,15 @@ drande_fill( rng_t  * RESTRICT r,
              double * RESTRICT x,
              size_t str_ele,
              size_t n_ele ) {
-  size_t n;
+  uint64_t a[ RNG_CHUNK ];
+  size_t n, m, k;
   if( !n_ele ) return x;
   if( !r || !x ) ERROR(( "Bad args" ));
-  for( n=0; n<n_ele; n++ ) x[ n*str_ele ] = drande( r );
+  for( n=0; n<n_ele; n+=m ) {
+    m = n_ele-n < RNG_CHUNK ? n_ele-n : RNG_CHUNK;
+    rng_copy( r, a, (uint32_t)sizeof(uint64_t), m );
+    for( k=0; k<m; k++ ) x[(n+k)*str_ele] = -log( conv_drand_c1(a[k]) );
+  }
   return x;
 }
 
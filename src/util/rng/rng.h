@@ -13,6 +13,9 @@ typedef struct rng rng_t;
 typedef struct rng_pool {
   rng_t ** rng; /* Random number generators (indexed 0:n_rng-1) */
   int n_rng;    /* Number of random number generators in pool */
+  int seed;     /* Counter-based stream seed (unique to each calling
+                   process for local pools, identical for sync pools) */
+  int n_stream; /* Streams of seed handed out by rng_pool_stream */
 } rng_pool_t;
 
 BEGIN_C_DECLS
@@ -27,12 +30,25 @@ new_rng_pool( int n_rng,  /* Number of generators for pool */
 void
 delete_rng_pool( rng_pool_t * RESTRICT rp ); /* Pool to delete */
 
+/* Return a counter-based stream of rp->seed (see seek_rng) that no
+   other call for rp returns.  Operators that draw from substreams of
+   a pool (collision operators, refluxes and emitters) each take one
+   when created, so no two of them share random numbers.  Processes
+   that create the same operators in the same order get the same
+   streams.  The streams are negative; the non-negative ones are left
+   to the deck (see vpic_simulation::inject_particles). */
+
+int
+rng_pool_stream( rng_pool_t * RESTRICT rp );
+
 /* In seed_rng_pool, seeding is done such that:
      local_pool = seed_rng_pool( rp, seed, 0 );   
      sync_pool  = seed_rng_pool( rp, seed, 1 );
    gives each local_pool rng and each sync_pool rng has a unique seed
    on all calling processes and that the sync pool rngs are
-   identically initialized on all calling processes. */
+   identically initialized on all calling processes.  rp->seed is set
+   likewise for use with seek_rng; unlike the rng seeds, it does not
+   depend on n_rng. */
 
 /* FIXME: WE NEED BIGGER SEEDS.  NOTE THAT THE EFFECT SEED SPACE FOR
    POOLS IS ROUGHLY FLOOR( UINT_MAX / (n_rng*(world_size+1)) )  */
@@ -57,6 +73,24 @@ rng_t *                            /* Returns r */
 seed_rng( rng_t * RESTRICT r,      /* Generator to seed */
           int              seed ); /* Seed */
 
+/* seek_rng switches r to the counter-based (Philox4x32-10) stream
+   keyed by (seed,stream) and positions it at the start of the
+   substream (step,index).  Subsequent draws from r by any of the
+   generators below come from that substream until r is sought or
+   seeded again.  The draws depend only on the arguments, so work
+   that seeks a generator to, for example, (pool seed, operator,
+   timestep, voxel) before processing a voxel gets the same random
+   numbers no matter which thread processes it.  Each substream has a
+   practically inexhaustible period (2^36 bytes).  Seeking is cheap
+   but refills the generator output buffer on the next draw. */
+
+rng_t *                              /* Returns r */
+seek_rng( rng_t * RESTRICT r,        /* Generator to position */
+          int              seed,     /* Stream seed (e.g. rp->seed) */
+          int              stream,   /* Stream of the seed */
+          int64_t          step,     /* Substream of the stream ... */
+          int              index );  /* ... (e.g. timestep and voxel) */
+
 /* Integer random generators make uniform rands on [0,INTTYPE_MAX] for
    signed types and on [0,UINTTYPE_MAX] for unsigned types.  There are
    singleton generators for each primitive integral type (including
@@ -157,7 +191,9 @@ _( float, f, _c  ) _( double, d, _c  )
 
 /* The normal generators generate a normally distributed random number
    (f(x) = exp( -x^2 / 2 ) / sqrt( 2*pi ) for x in (-inf,inf)).  Based
-   on the Ziggurat method under the hood. */
+   on the Ziggurat method under the hood.  The mass production variants
+   are several times faster per deviate than the singletons (but do not
+   draw the same deviates). */
 
 float                         /* Returns sample deviate */
 frandn( rng_t * RESTRICT r ); /* Generator to use */
@@ -177,6 +213,29 @@ drandn_fill( rng_t  * RESTRICT r,        /* Generator to use */
              size_t            str_ele,  /* Element stride */
              size_t            n_ele );  /* Number of elements */
 
+/* A frandn_buf_t buffers normal deviates made by frandn_fill for
+   consumers that draw them one at a time (e.g. once per particle in a
+   boundary handler or emitter).  Keep one per pipeline and draw from
+   it with frandn_buf.  Zero n to discard the buffered deviates (e.g.
+   after seeking the generator with seek_rng). */
+
+enum { FRANDN_BUF = 128 };
+
+typedef struct frandn_buf {
+  float x[ FRANDN_BUF ]; /* Buffered deviates (x[0:n-1] unused) */
+  int n;                 /* Number of unused buffered deviates */
+} frandn_buf_t;
+
+STATIC_INLINE float                       /* Returns sample deviate */
+frandn_buf( rng_t        * RESTRICT r,    /* Generator to refill with */
+            frandn_buf_t * RESTRICT b ) { /* Buffer to draw from */
+  if( UNLIKELY( !b->n ) ) {
+    frandn_fill( r, b->x, 1, FRANDN_BUF );
+    b->n = FRANDN_BUF;
+  }
+  return b->x[ --b->n ];
+}
+
 /* The exponential generators generate an exponentially distributed
    random number (f(x) = exp(-x) for x in [0,inf).  Based on the
    transformation method under the hood. */
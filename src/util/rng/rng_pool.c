@@ -34,6 +34,7 @@ new_rng_pool( int n_rng,
   MALLOC( rp->rng, n_rng );
   for( n=0; n<n_rng; n++ ) rp->rng[n] = new_rng( 0 );
   rp->n_rng = n_rng;
+  rp->n_stream = 0;
   seed_rng_pool( rp, seed, sync );
   REGISTER_OBJECT( rp, checkpt_rng_pool, restore_rng_pool, NULL );
   return rp;
@@ -49,12 +50,19 @@ delete_rng_pool( rng_pool_t * rp ) {
   FREE( rp );
 }
 
+int
+rng_pool_stream( rng_pool_t * RESTRICT rp ) {
+  if( !rp ) ERROR(( "Bad args" ));
+  return -1 - rp->n_stream++;
+}
+
 rng_pool_t *
 seed_rng_pool( rng_pool_t * RESTRICT rp,
                int seed,
                int sync ) {
   int n;
   if( !rp ) ERROR(( "Bad args" ));
+  rp->seed = (sync ? world_size : world_rank) + (world_size+1)*seed;
   seed = (sync ? world_size : world_rank) + (world_size+1)*rp->n_rng*seed;
   for( n=0; n<rp->n_rng; n++ ) seed_rng( rp->rng[n], seed + (world_size+1)*n );
   return rp;
@@ -201,7 +201,9 @@ struct rng {
     uint64_t u64[ SFMT_N64 ];
   } state;
   uint32_t n;      /* Next unextracted byte */
-  uint32_t pad[3]; /* 16-byte align */
+  uint32_t philox; /* Non-zero if drawing from a counter-based stream */
+  uint32_t key[2]; /* Philox key of the counter-based stream */
+  uint32_t ctr[4]; /* Philox counter of the next block of the stream */
 };
 
 #if defined(__SSE2__)
@@ -257,12 +259,163 @@ sfmt_next( sfmt_128_t * RESTRICT sfmt ) {
 # undef SFMT
 # undef DECL_SFMT
 
-/* Note that SFMT_NC is sizeof(r->state.p[0]) aligned */
+/* Philox4x32-10 counter-based generator (Salmon et al, "Parallel
+   random numbers: as easy as 1, 2, 3", SC11).  A stream is given by a
+   64-bit key and the 128-bit counter of its first block.  Block b of
+   the stream is the 10 round bijection of counter + b under the key.
+
+   When drawing from a counter-based stream (see seek_rng), the last
+   PHILOX_NC bytes of the state are used as the output buffer and are
+   refilled PHILOX_NB blocks at a time.  The refill runs the rounds of
+   the blocks as a structure of arrays, several blocks per SIMD vector
+   when possible. */
+
+enum philox_parameters {
+  PHILOX_NB  = 16,
+  PHILOX_NC  = PHILOX_NB*4*sizeof(uint32_t),
+  PHILOX_N32 = PHILOX_NC/sizeof(uint32_t)
+};
+
+#define PHILOX_M0 ((uint32_t)0xd2511f53)
+#define PHILOX_M1 ((uint32_t)0xcd9e8d57)
+#define PHILOX_W0 ((uint32_t)0x9e3779b9)
+#define PHILOX_W1 ((uint32_t)0xbb67ae85)
+
+/* Compilers do not vectorize the 32x32->64 bit multiplies of a Philox
+   round well, so use the unsigned even lane multiply directly when
+   available.  PHILOX_MULHILO( a, m, hi, lo ) computes the high and low
+   32 bits of the products of each lane of a with m. */
+
+#if defined(__AVX2__) /* Use AVX2 accelerated version */
+
+#include <immintrin.h>
+
+# define PHILOX_VL 8
+# define PHILOX_V  __m256i
+# define PHILOX_LD(p)    _mm256_load_si256( (const __m256i *)(p) )
+# define PHILOX_ST(p,a)  _mm256_store_si256( (__m256i *)(p), (a) )
+# define PHILOX_SET(x)   _mm256_set1_epi32( (int)(x) )
+# define PHILOX_XOR(a,b) _mm256_xor_si256( (a), (b) )
+# define PHILOX_MULHILO( a, m, hi, lo ) do {                            \
+    __m256i _e = _mm256_mul_epu32( (a), (m) );                          \
+    __m256i _o = _mm256_mul_epu32( _mm256_srli_epi64( (a), 32 ), (m) ); \
+    _e = _mm256_shuffle_epi32( _e, _MM_SHUFFLE(3,1,2,0) );              \
+    _o = _mm256_shuffle_epi32( _o, _MM_SHUFFLE(3,1,2,0) );              \
+    (lo) = _mm256_unpacklo_epi32( _e, _o );                             \
+    (hi) = _mm256_unpackhi_epi32( _e, _o );                             \
+  } while(0)
+
+#elif defined(__SSE2__) /* Use SSE-2 accelerated version */
+
+# define PHILOX_VL 4
+# define PHILOX_V  __m128i
+# define PHILOX_LD(p)    _mm_load_si128( (const __m128i *)(p) )
+# define PHILOX_ST(p,a)  _mm_store_si128( (__m128i *)(p), (a) )
+# define PHILOX_SET(x)   _mm_set1_epi32( (int)(x) )
+# define PHILOX_XOR(a,b) _mm_xor_si128( (a), (b) )
+# define PHILOX_MULHILO( a, m, hi, lo ) do {                            \
+    __m128i _e = _mm_mul_epu32( (a), (m) );                             \
+    __m128i _o = _mm_mul_epu32( _mm_srli_epi64( (a), 32 ), (m) );       \
+    _e = _mm_shuffle_epi32( _e, _MM_SHUFFLE(3,1,2,0) );                 \
+    _o = _mm_shuffle_epi32( _o, _MM_SHUFFLE(3,1,2,0) );                 \
+    (lo) = _mm_unpacklo_epi32( _e, _o );                                \
+    (hi) = _mm_unpackhi_epi32( _e, _o );                                \
+  } while(0)
+
+#endif
+
+STATIC_INLINE void
+philox_next( rng_t * RESTRICT r ) {
+  DECLARE_ALIGNED_ARRAY( uint32_t, 32, c0, PHILOX_NB );
+  DECLARE_ALIGNED_ARRAY( uint32_t, 32, c1, PHILOX_NB );
+  DECLARE_ALIGNED_ARRAY( uint32_t, 32, c2, PHILOX_NB );
+  DECLARE_ALIGNED_ARRAY( uint32_t, 32, c3, PHILOX_NB );
+  uint32_t * RESTRICT out = r->state.u32 + ( SFMT_N32 - PHILOX_N32 );
+  uint32_t k0 = r->key[0], k1 = r->key[1];
+  int b, n;
+
+  for( b=0; b<PHILOX_NB; b++ ) {
+    c0[b] = r->ctr[0] + (uint32_t)b;
+    c1[b] = r->ctr[1];
+    c2[b] = r->ctr[2];
+    c3[b] = r->ctr[3];
+  }
+
+# if defined(PHILOX_VL)
+
+  const PHILOX_V m0 = PHILOX_SET( PHILOX_M0 ), m1 = PHILOX_SET( PHILOX_M1 );
+  PHILOX_V x0, x1, x2, x3, h0, l0, h1, l1, v0, v1;
+
+  for( b=0; b<PHILOX_NB; b+=PHILOX_VL ) {
+    x0 = PHILOX_LD( c0+b ), x1 = PHILOX_LD( c1+b );
+    x2 = PHILOX_LD( c2+b ), x3 = PHILOX_LD( c3+b );
+    for( n=0; n<10; n++ ) {
+      v0 = PHILOX_SET( k0 + (uint32_t)n*PHILOX_W0 );
+      v1 = PHILOX_SET( k1 + (uint32_t)n*PHILOX_W1 );
+      PHILOX_MULHILO( x0, m0, h0, l0 );
+      PHILOX_MULHILO( x2, m1, h1, l1 );
+      x0 = PHILOX_XOR( PHILOX_XOR( h1, x1 ), v0 );
+      x2 = PHILOX_XOR( PHILOX_XOR( h0, x3 ), v1 );
+      x1 = l1;
+      x3 = l0;
+    }
+    PHILOX_ST( c0+b, x0 ), PHILOX_ST( c1+b, x1 );
+    PHILOX_ST( c2+b, x2 ), PHILOX_ST( c3+b, x3 );
+  }
+
+# else
+
+  uint64_t p0, p1;
+
+  for( n=0; n<10; n++ ) {
+    if( n ) k0 += PHILOX_W0, k1 += PHILOX_W1;
+    for( b=0; b<PHILOX_NB; b++ ) {
+      p0 = (uint64_t)PHILOX_M0 * (uint64_t)c0[b];
+      p1 = (uint64_t)PHILOX_M1 * (uint64_t)c2[b];
+      c0[b] = ( (uint32_t)( p1>>32 ) ^ c1[b] ) ^ k0;
+      c2[b] = ( (uint32_t)( p0>>32 ) ^ c3[b] ) ^ k1;
+      c1[b] = (uint32_t)p1;
+      c3[b] = (uint32_t)p0;
+    }
+  }
+
+# endif
+
+  for( b=0; b<PHILOX_NB; b++ ) {
+    out[4*b  ] = c0[b];
+    out[4*b+1] = c1[b];
+    out[4*b+2] = c2[b];
+    out[4*b+3] = c3[b];
+  }
+
+  r->ctr[0] += PHILOX_NB;
+}
+
+# undef PHILOX_MULHILO
+# undef PHILOX_XOR
+# undef PHILOX_SET
+# undef PHILOX_ST
+# undef PHILOX_LD
+# undef PHILOX_V
+# undef PHILOX_VL
+
+/* Refill the state of r.  Returns the byte offset of the first fresh
+   random byte. */
+
+STATIC_INLINE uint32_t
+rng_next( rng_t * RESTRICT r ) {
+  if( LIKELY( !r->philox ) ) { sfmt_next( r->state.sfmt ); return 0; }
+  philox_next( r );
+  return SFMT_NC - PHILOX_NC;
+}
+
+/* Note that SFMT_NC and SFMT_NC - PHILOX_NC are sizeof(r->state.p[0])
+   aligned */
 
 #define RNG_NEXT( a, t, r, p, rs ) do {                                   \
     uint32_t _n = ((r)->n +   ((uint32_t)sizeof((r)->state.p[0]))-1 ) &   \
       /**/                 (~(((uint32_t)sizeof((r)->state.p[0]))-1));    \
-    if( _n >= SFMT_NC ) sfmt_next( (r)->state.sfmt ), _n = 0;             \
+    if( _n >= SFMT_NC ) _n = rng_next( (r) );                             \
     (a) = ((r)->state.p[ _n/(uint32_t)sizeof((r)->state.p[0]) ] >> (rs)); \
     (r)->n =             _n+(uint32_t)sizeof((r)->state.p[0]);            \
   } while(0)
@@ -212,10 +212,18 @@ static const unsigned int seq[] = {
   2072997009, 1332330347,  179681555, 2315290438, 2429393974, 
    509881964, 3807607878, 3055319970,  671840881, 3477325874 };
 
+/* The checkpt service can only be booted once per process */
+
+static void
+boot( void ) {
+  static int booted = 0;
+  if( !booted ) boot_checkpt(NULL, NULL), booted = 1;
+}
+
 /* FIXME: IMPROVE COVERAGE */
 TEST_CASE("uirand", "[rng]") {
 
-  boot_checkpt(NULL, NULL);
+  boot();
 
   int i;
   rng_t * rng = new_rng( 1234 );
@@ -223,3 +231,84 @@ TEST_CASE("uirand", "[rng]") {
   REQUIRE_FALSE( i!=N );
   delete_rng(rng);
 } // TEST
+
+/* Philox4x32-10 known answer (from the Random123 distribution) for a
+   zero key and counter */
+
+TEST_CASE("seek_rng", "[rng]") {
+
+  boot();
+
+  static const unsigned int kat0[4] =
+    { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 };
+
+  unsigned int a[N], b[N];
+  int i;
+  rng_t * rng = new_rng( 1234 );
+
+  seek_rng( rng, 0, 0, 0, 0 );
+  for( i=0; i<4; i++ ) if( uirand( rng )!=kat0[i] ) break;
+  REQUIRE_FALSE( i!=4 );
+
+  /* Substreams are reproducible, independent of what was drawn
+     before, and differ from each other */
+
+  seek_rng( rng, 1234, 7, 100, 5 );
+  uirand_fill( rng, a, 1, N );
+  for( i=0; i<N/3; i++ ) frandn( rng );
+  seek_rng( rng, 1234, 7, 100, 5 );
+  uirand_fill( rng, b, 1, N );
+  for( i=0; i<N; i++ ) if( a[i]!=b[i] ) break;
+  REQUIRE_FALSE( i!=N );
+
+  seek_rng( rng, 1234, 7, 100, 6 );
+  uirand_fill( rng, b, 1, N );
+  for( i=0; i<N; i++ ) if( a[i]==b[i] ) break;
+  REQUIRE_FALSE( i!=N );
+
+  /* Reseeding returns to the SFMT sequence */
+
+  seed_rng( rng, 1234 );
+  for( i=0; i<N; i++ ) if( uirand( rng )!=seq[i] ) break;
+  REQUIRE_FALSE( i!=N );
+  delete_rng(rng);
+} // TEST
+
+TEST_CASE("fill", "[rng]") {
+
+  boot();
+
+  unsigned int a[N];
+  float f[N], g[N];
+  double m1, m2;
+  int i;
+  rng_t * rng = new_rng( 1234 );
+
+  /* The uniform mass production generators draw exactly what the
+     singletons do, also from unaligned positions in the state */
+
+  uirand_fill( rng, a, 1, N );
+  for( i=0; i<N; i++ ) if( a[i]!=seq[i] ) break;
+  REQUIRE_FALSE( i!=N );
+
+  seed_rng( rng, 1234 );
+  ucrand( rng );
+  frand_c0_fill( rng, f, 1, N );
+  seed_rng( rng, 1234 );
+  ucrand( rng );
+  for( i=0; i<N; i++ ) g[i] = frand_c0( rng );
+  for( i=0; i<N; i++ ) if( f[i]!=g[i] ) break;
+  REQUIRE_FALSE( i!=N );
+
+  /* The normal mass production generators have the right moments */
+
+  m1 = m2 = 0;
+  for( i=0; i<100; i++ ) {
+    frandn_fill( rng, f, 1, N );
+    for( int j=0; j<N; j++ ) m1 += f[j], m2 += f[j]*f[j];
+  }
+  m1 /= 100*N, m2 /= 100*N;
+  REQUIRE( fabs( m1 )   < 0.02 );
+  REQUIRE( fabs( m2-1 ) < 0.02 );
+  delete_rng(rng);
+} // TEST
@@ -7,6 +7,7 @@
 #include "v4/v4.h"
 #include "v8/v8.h"
 #include "v16/v16.h"
+#include "arena/arena.h"
 #include "checkpt/checkpt.h"
 #include "mp/mp.h"
 #include "rng/rng.h"
@@ -9,6 +9,7 @@
  */
 
 #include "util_base.h" // Declarations
+#include "arena/arena.h" // For arena_free, arena_tag, arena_heap
 #include <stdio.h>     // For vfprintf
 #include <stdarg.h>    // For va_list, va_start, va_end
 #include <string.h>    // for strstr
@@ -155,10 +156,37 @@ void detect_old_style_arguments(int* pargc, char *** pargv)
 
 }
 
+// Heap blocks start with this (the memory follows).  It is 16 bytes
+// so the memory keeps malloc's alignment.
+
+typedef struct heap_header {
+  size_t n;
+  int tag, pad;
+} heap_header_t;
+
+static char *
+heap_malloc( size_t n,
+             const char * tag ) {
+  heap_header_t * h = (heap_header_t *)malloc( sizeof(heap_header_t) + n );
+  if( !h ) return NULL;
+  h->n   = n;
+  h->tag = arena_tag( tag );
+  arena_heap( h->tag, (int64_t)n );
+  return (char *)( h + 1 );
+}
+
+static void
+heap_free( char * mem ) {
+  heap_header_t * h = ((heap_header_t *)mem) - 1;
+  arena_heap( h->tag, -(int64_t)h->n );
+  free( h );
+}
+
 void
 util_malloc( const char * err,
              void * mem_ref,
-             size_t n ) {
+             size_t n,
+             const char * tag ) {
   char * mem;
 
   // If no err given, use a default error
@@ -171,7 +199,7 @@ util_malloc( const char * err,
   if( n==0 ) { *(char **)mem_ref = NULL; return; }
 
   // Allocate the memory ... abort if the allocation fails
-  mem = (char *)malloc(n);
+  mem = heap_malloc( n, tag );
   if( !mem ) ERROR(( err, (unsigned long)n ));
   *(char **)mem_ref = mem;
 }
@@ -181,7 +209,7 @@ util_free( void * mem_ref ) {
   char * mem;
   if( !mem_ref ) return;
   mem = *(char **)mem_ref;
-  if( mem ) free( mem );
+  if( mem ) heap_free( mem );
   *(char **)mem_ref = NULL;
 }
 
@@ -189,7 +217,8 @@ void
 util_malloc_aligned( const char * err,
                      void * mem_ref,
                      size_t n,
-                     size_t a )
+                     size_t a,
+                     const char * tag )
 {
   char *mem_u, *mem_a, **mem_p;
 
@@ -216,7 +245,7 @@ util_malloc_aligned( const char * err,
   a--;
 
   // Allocate the raw unaligned memory.  Abort if the allocation fails.
-  mem_u = (char *) malloc( n + a + sizeof(char *) );
+  mem_u = heap_malloc( n + a + sizeof(char *), tag );
 
   if ( !mem_u )
     ERROR( ( err, (unsigned long) n, (unsigned long) a ) );
@@ -242,7 +271,11 @@ util_free_aligned( void * mem_ref ) {
   if( mem_a ) {
     mem_p = (char **)(mem_a - sizeof(char *));
     mem_u = mem_p[0];
-    free( mem_u );
+
+    // Blocks from MALLOC_ARENA save a pointer to their mapping with
+    // the low bit set (malloc never returns an odd address).
+    if( ( (size_t)mem_u ) & 1 ) arena_free( mem_u - 1 );
+    else                        heap_free( mem_u );
   }
   *(char **)mem_ref = NULL;
 }
@@ -335,6 +335,17 @@ strip_cmdline_string( int * pargc,
 // In util.c
 void detect_old_style_arguments(int* pargc, char *** pargv);
 
+// Memory from MALLOC and MALLOC_ALIGNED is counted against the
+// subsystem that allocated it (see arena_report in arena/arena.h).
+// By default, the subsystem is given by the directory under src of the
+// file doing the allocation (code outside src counts as "deck").  A
+// file can instead define MEM_TAG to a name of its own before it
+// includes anything.
+
+#ifndef MEM_TAG
+#define MEM_TAG __FILE__
+#endif
+
 // MALLOC is guaranteed to succeed from the caller's point of view
 // (thus, _no_ NULL checking the pointer is necessary).  n is the
 // number of elements of the type of x to allocate (_not_ the number
@@ -344,12 +355,13 @@ void detect_old_style_arguments(int* pargc, char *** pargv);
 #define MALLOC(x,n)                                                    \
   util_malloc( "MALLOC( "#x", "#n" (%lu bytes) ) at "                  \
                __FILE__ "(" EXPAND_AND_STRINGIFY(__LINE__) ") failed", \
-               &(x), (n)*sizeof(*(x)) ) 
+               &(x), (n)*sizeof(*(x)), MEM_TAG )
 
 void
 util_malloc( const char * err_fmt, // Has exactly one %lu in it
              void * mem_ref,
-             size_t n );
+             size_t n,
+             const char * tag );
 
 // FREE frees memory allocated via MALLOC above.  It is safe to pass
 // any value returned by MALLOC to FREE (_including_ a null pointer).
@@ -370,14 +382,14 @@ util_free( void * mem_ref );
                                          #n" (%lu bytes), "                    \
                                          #a" (%lu bytes) ) at "                \
                        __FILE__ "(" EXPAND_AND_STRINGIFY(__LINE__) ") failed", \
-                       &(x), (n)*sizeof(*(x)), (a) ) 
-
+                       &(x), (n)*sizeof(*(x)), (a), MEM_TAG )
 
 void
 util_malloc_aligned( const char * err_fmt, // Has exactly two %lu in it
                      void * mem_ref,
                      size_t n,
-                     size_t a );
+                     size_t a,
+                     const char * tag );
 
 // FREE_ALIGNED behaves equivalently to FREE.
 
@@ -386,6 +398,45 @@ util_malloc_aligned( const char * err_fmt, // Has exactly two %lu in it
 void
 util_free_aligned( void * mem_ref );
 
+// MALLOC_ARENA behaves equivalently to MALLOC_ALIGNED but takes the
+// memory from the named arena (see arena/arena.h).  It is freed with
+// FREE_ALIGNED.
+
+#define MALLOC_ARENA(x,n,a,arena)                                              \
+  util_malloc_arena( "MALLOC_ARENA( "#x", "                                    \
+                                       #n" (%lu bytes), "                      \
+                                       #a" (%lu bytes), "#arena" ) at "        \
+                     __FILE__ "(" EXPAND_AND_STRINGIFY(__LINE__) ") failed",   \
+                     &(x), (n)*sizeof(*(x)), (a), (arena) )
+
+void
+util_malloc_arena( const char * err_fmt, // Has exactly two %lu in it
+                   void * mem_ref,
+                   size_t n,
+                   size_t a,
+                   const char * arena );
+
+// REALLOC_ARENA resizes x (from MALLOC_ARENA, MALLOC_ALIGNED or NULL)
+// to hold n elements from the named arena, preserving the first n_keep
+// of them.  Arena blocks are resized in place by remapping their pages
+// and are never copied.
+
+#define REALLOC_ARENA(x,n_keep,n,a,arena)                                      \
+  util_realloc_arena( "REALLOC_ARENA( "#x", "                                  \
+                                        #n" (%lu bytes), "                     \
+                                        #a" (%lu bytes), "#arena" ) at "       \
+                      __FILE__ "(" EXPAND_AND_STRINGIFY(__LINE__) ") failed",  \
+                      &(x), (n_keep)*sizeof(*(x)), (n)*sizeof(*(x)), (a),      \
+                      (arena) )
+
+void
+util_realloc_arena( const char * err_fmt, // Has exactly two %lu in it
+                    void * mem_ref,
+                    size_t n_keep,
+                    size_t n,
+                    size_t a,
+                    const char * arena );
+
 void
 log_printf( const char *fmt, ... );
 
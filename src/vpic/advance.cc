@@ -20,10 +20,12 @@ int vpic_simulation::advance(void) {
 
   if( num_step>0 && step()>=num_step ) return 0;
 
-  // Sort the particles for performance if desired.
+  // Sort the particles for performance if desired.  Species sorted by a
+  // collision operator fused with the sort are left to it.
 
   LIST_FOR_EACH( sp, species_list )
-    if( (sp->sort_interval>0) && ((step() % sp->sort_interval)==0) ) {
+    if( (sp->sort_interval>0) && ((step() % sp->sort_interval)==0) &&
+        !sorted_by_collision_op_list( collision_op_list, sp ) ) {
       if( rank()==0 ) MESSAGE(( "Performance sorting \"%s\"", sp->name ));
       TIC sort_p( sp ); TOC( sort_p, 1 );
     } 
@@ -95,6 +97,7 @@ int vpic_simulation::advance(void) {
       // accumulate the particle's charge to the mesh
       accumulate_rhob( field_array->f, p0+i, sp->g, sp->q );
       p0[i] = p0[sp->np-1]; // put the last particle into position i
+      MOVE_TAG( sp, i, sp->np-1 );
       sp->np--; // decrement the number of particles
     }
     sp->nm = 0;
@@ -191,8 +194,13 @@ int vpic_simulation::advance(void) {
   if( (status_interval>0) && ((step() % status_interval)==0) ) {
     if( rank()==0 ) MESSAGE(( "Completed step %i of %i", step(), num_step ));
     update_profile( rank()==0 );
+    print_memory_usage();
   }
 
+  // Record tagged particle trajectories
+
+  if( tracer_list ) TIC trace_particles(); TOC( trace_particles, 1 );
+
   // Let the user compute diagnostics
 
   TIC user_diagnostics(); TOC( user_diagnostics, 1 );
@@ -14,6 +14,7 @@
 #include "vpic.h"
 #include "dumpmacros.h"
 #include "../util/io/FileUtils.h"
+#include "../util/pipelines/pipelines_exec.h"
 
 /* -1 means no ranks talk */
 #define VERBOSE_rank -1
@@ -145,6 +146,7 @@ vpic_simulation::dump_grid( const char *fbase ) {
   if( rank()==0 ) MESSAGE(( "Dumping grid to \"%s\"", fbase ));
 
   sprintf( fname, "%s.%i", fbase, rank() );
+  mp_begin_io( 0 );
   FileIOStatus status = fileIO.open(fname, io_write);
   if( status==fail ) ERROR(( "Could not open \"%s\".", fname ));
 
@@ -175,7 +177,9 @@ vpic_simulation::dump_grid( const char *fbase ) {
   WRITE_ARRAY_HEADER( grid->neighbor, 4, dim, fileIO );
   fileIO.write( grid->neighbor, dim[0]*dim[1]*dim[2]*dim[3] );
 
+  double n_byte = fileIO.size();
   if( fileIO.close() ) ERROR(( "File close failed on dump grid!!!" ));
+  mp_end_io( "Grid dump", n_byte );
 }
 
 void
@@ -191,6 +195,7 @@ vpic_simulation::dump_fields( const char *fbase, int ftag ) {
   if( ftag ) sprintf( fname, "%s.%li.%i", fbase, (long)step(), rank() );
   else       sprintf( fname, "%s.%i", fbase, rank() );
 
+  mp_begin_io( 0 );
   FileIOStatus status = fileIO.open(fname, io_write);
   if( status==fail ) ERROR(( "Could not open \"%s\".", fname ));
 
@@ -209,7 +214,9 @@ vpic_simulation::dump_fields( const char *fbase, int ftag ) {
   dim[2] = grid->nz+2;
   WRITE_ARRAY_HEADER( field_array->f, 3, dim, fileIO );
   fileIO.write( field_array->f, dim[0]*dim[1]*dim[2] );
+  double n_byte = fileIO.size();
   if( fileIO.close() ) ERROR(( "File close failed on dump fields!!!" ));
+  mp_end_io( "Field dump", n_byte );
 }
 
 void
@@ -235,6 +242,7 @@ vpic_simulation::dump_hydro( const char *sp_name,
 
   if( ftag ) sprintf( fname, "%s.%li.%i", fbase, (long)step(), rank() );
   else       sprintf( fname, "%s.%i", fbase, rank() );
+  mp_begin_io( 0 );
   FileIOStatus status = fileIO.open(fname, io_write);
   if( status==fail) ERROR(( "Could not open \"%s\".", fname ));
 
@@ -253,7 +261,9 @@ vpic_simulation::dump_hydro( const char *sp_name,
   dim[2] = grid->nz+2;
   WRITE_ARRAY_HEADER( hydro_array->h, 3, dim, fileIO );
   fileIO.write( hydro_array->h, dim[0]*dim[1]*dim[2] );
+  double n_byte = fileIO.size();
   if( fileIO.close() ) ERROR(( "File close failed on dump hydro!!!" ));
+  mp_end_io( "Hydro dump", n_byte );
 }
 
 void
@@ -279,6 +289,7 @@ vpic_simulation::dump_particles( const char *sp_name,
 
   if( ftag ) sprintf( fname, "%s.%li.%i", fbase, (long)step(), rank() );
   else       sprintf( fname, "%s.%i", fbase, rank() );
+  mp_begin_io( 0 );
   FileIOStatus status = fileIO.open(fname, io_write);
   if( status==fail ) ERROR(( "Could not open \"%s\"", fname ));
 
@@ -316,7 +327,97 @@ vpic_simulation::dump_particles( const char *sp_name,
   sp->np     = sp_np;
   sp->max_np = sp_max_np;
 
+  double n_byte = fileIO.size();
   if( fileIO.close() ) ERROR(("File close failed on dump particles!!!"));
+  mp_end_io( "Particle dump", n_byte );
+}
+
+int64_t
+vpic_simulation::dump_particles( const char *sp_name,
+                                 const char *fbase,
+                                 const particle_select_t & sel,
+                                 int ftag ) {
+  species_t *sp;
+  char fname[256];
+  FileIO fileIO;
+  int dim[1], buf_start;
+  int64_t dim_pos, np_out;
+  double local[2], global[2];
+  static particle_t * ALIGNED(128) p_buf = NULL;
+
+  sp = find_species_name( sp_name, species_list );
+  if( !sp ) ERROR(( "Invalid species name \"%s\".", sp_name ));
+
+  if( !fbase ) ERROR(( "Invalid filename" ));
+
+  if( !p_buf ) MALLOC_ALIGNED( p_buf, PBUF_SIZE, 128 );
+
+  if( rank()==0 )
+    MESSAGE(("Dumping selected \"%s\" particles to \"%s\"",sp->name,fbase));
+
+  if( ftag ) sprintf( fname, "%s.%li.%i", fbase, (long)step(), rank() );
+  else       sprintf( fname, "%s.%i", fbase, rank() );
+  mp_begin_io( 0 );
+  FileIOStatus status = fileIO.open(fname, io_write);
+  if( status==fail ) ERROR(( "Could not open \"%s\"", fname ));
+
+  /* IMPORTANT: these values are written in WRITE_HEADER_V0 */
+  nxout = grid->nx;
+  nyout = grid->ny;
+  nzout = grid->nz;
+  dxout = grid->dx;
+  dyout = grid->dy;
+  dzout = grid->dz;
+
+  WRITE_HEADER_V0( dump_type::particle_dump, sp->id, sp->q/sp->m, fileIO );
+
+  // The number of particles written is not known until the selection
+  // is done.  Write a placeholder and patch it at the end.
+
+  dim[0] = 0;
+  WRITE( int, sizeof(p_buf[0]), fileIO );
+  WRITE( int, 1,                fileIO );
+  dim_pos = fileIO.tell();
+  fileIO.write( dim, 1 );
+
+  // As in dump_particles above, but the centering, predicate and
+  // sampling are done in one pass by select_p and only the kept
+  // particles of each hunk are written.
+
+  np_out = 0;
+  particle_t * sp_p = sp->p;      sp->p      = p_buf;
+  int sp_np         = sp->np;     sp->np     = 0;
+  int sp_max_np     = sp->max_np; sp->max_np = PBUF_SIZE;
+  for( buf_start=0; buf_start<sp_np; buf_start += PBUF_SIZE ) {
+    sp->np = sp_np-buf_start; if( sp->np > PBUF_SIZE ) sp->np = PBUF_SIZE;
+    COPY( sp->p, &sp_p[buf_start], sp->np );
+    int n = select_p( sp, interpolator_array, &sel, buf_start, NULL );
+    fileIO.write( sp->p, n );
+    np_out += n;
+  }
+  sp->p      = sp_p;
+  sp->np     = sp_np;
+  sp->max_np = sp_max_np;
+
+  WRITE( int64_t, sp_np,  fileIO );
+  WRITE( int64_t, np_out, fileIO );
+
+  dim[0] = np_out;
+  fileIO.seek( dim_pos, SEEK_SET );
+  fileIO.write( dim, 1 );
+
+  double n_byte = fileIO.size();
+  if( fileIO.close() ) ERROR(("File close failed on dump particles!!!"));
+  mp_end_io( "Particle dump", n_byte );
+
+  local[0] = sp_np;
+  local[1] = np_out;
+  mp_allsum_d( local, global, 2 );
+  if( rank()==0 )
+    MESSAGE(( "Wrote %.0f of %.0f \"%s\" particles",
+              global[1], global[0], sp->name ));
+
+  return (int64_t)global[1];
 }
 
 /*------------------------------------------------------------------------------
@@ -515,6 +616,133 @@ vpic_simulation::global_header( const char * base,
   if( fileIO.close() ) ERROR(( "File close failed on global header!!!" ));
 }
 
+/*------------------------------------------------------------------------------
+ * Staged gather for band and strided dumps
+ *
+ * Banded and strided dumps select scattered words out of the native
+ * Array-of-Structure storage.  Rather than handing each word to FileIO
+ * one at a time, the selection is gathered into a large staging buffer
+ * (in parallel on the pipelines) a slab of output z-planes at a time and
+ * each slab is written with a single call.  The bytes written are
+ * identical to the element-by-element path.
+ *---------------------------------------------------------------------------*/
+
+// Target staging buffer size in words (16MB).  A slab always holds at
+// least one output z-plane, so the buffer can grow past this for very
+// large planes.
+
+enum { dump_stage_words = 4*1024*1024 };
+
+typedef struct dump_gather_pipeline_args
+{
+  MEM_PTR( const uint32_t, 128 ) src;  // First word of the source array
+  MEM_PTR( uint32_t,       128 ) dst;  // Staging buffer for this slab
+  MEM_PTR( const int,      1   ) ioff; // Output i -> source x voxel index
+  MEM_PTR( const int,      1   ) joff; // Output j -> source y voxel index
+  MEM_PTR( const int,      1   ) koff; // Output k -> source z voxel index
+  int sy, sz;                          // Source voxel strides
+  int rec;                             // Source record size in words
+  int off;                             // First word gathered per record
+  int nw;                              // Words gathered per record
+  int ni, nj, nk;                      // Output extents of this slab
+
+  PAD_STRUCT( 5*SIZEOF_MEM_PTR + 8*sizeof(int) )
+
+} dump_gather_pipeline_args_t;
+
+// Pipelines are assigned whole output rows.  The host has no stragglers.
+
+static void
+dump_gather_pipeline_scalar( dump_gather_pipeline_args_t * args,
+                             int pipeline_rank,
+                             int n_pipeline ) {
+  const uint32_t * RESTRICT ALIGNED(128) src = args->src;
+  /**/  uint32_t * RESTRICT ALIGNED(128) dst = args->dst;
+  const int * RESTRICT ioff = args->ioff;
+  const int * RESTRICT joff = args->joff;
+  const int * RESTRICT koff = args->koff;
+  const size_t rec = args->rec, nw = args->nw;
+  const int ni = args->ni, nj = args->nj;
+  const uint32_t * RESTRICT s;
+  uint32_t * RESTRICT d;
+  int r, nr, i;
+
+  DISTRIBUTE( nj*args->nk, 1, pipeline_rank, n_pipeline, r, nr );
+
+  for( ; nr; r++, nr-- ) {
+    s = src + rec*( (size_t)joff[r%nj]*args->sy +
+                    (size_t)koff[r/nj]*args->sz ) + args->off;
+    d = dst + nw*ni*(size_t)r;
+    if( nw==1 ) for( i=0; i<ni; i++ ) d[i] = s[rec*ioff[i]];
+    else for( i=0; i<ni; i++, d+=nw ) COPY( d, s + rec*ioff[i], nw );
+  }
+}
+
+// Build the output -> voxel index map for one axis.  For unit strides
+// this is the identity; otherwise the ghost layers plus every stride-th
+// voxel are selected.
+
+static void
+dump_index_map( int * map, int nmap, int nout, int n, int stride,
+                int strided ) {
+  for( int i=0; i<nmap; i++ )
+    map[i] = !strided ? i :
+             i==0 ? 0 : i==nout+1 ? n+1 : i*stride-1;
+}
+
+// Gather nw words starting at word off out of each rec word record of
+// the voxel array at src and write them out in slabs of output
+// z-planes.  stage holds max_stage words and is grown as needed (the
+// caller owns it).
+
+static void
+dump_staged_write( FileIO & fileIO,
+                   uint32_t * ALIGNED(128) & stage,
+                   size_t & max_stage,
+                   const void * src,
+                   int rec,
+                   int off,
+                   int nw,
+                   const int * ioff, int ni,
+                   const int * joff, int nj,
+                   const int * koff, int nk,
+                   const grid_t * g ) {
+  DECLARE_ALIGNED_ARRAY( dump_gather_pipeline_args_t, 128, args, 1 );
+
+  if( ni<1 || nj<1 || nk<1 ) return;
+
+  const size_t plane = (size_t)ni*(size_t)nj*(size_t)nw;
+  int nk_slab = dump_stage_words/plane;
+  if( nk_slab<1  ) nk_slab = 1;
+  if( nk_slab>nk ) nk_slab = nk;
+
+  if( max_stage < nk_slab*plane ) {
+    FREE_ALIGNED( stage );
+    max_stage = nk_slab*plane;
+    MALLOC_ALIGNED( stage, max_stage, 128 );
+  }
+
+  args->src  = (const uint32_t *)src;
+  args->dst  = stage;
+  args->ioff = ioff;
+  args->joff = joff;
+  args->sy   = g->sy;
+  args->sz   = g->sz;
+  args->rec  = rec;
+  args->off  = off;
+  args->nw   = nw;
+  args->ni   = ni;
+  args->nj   = nj;
+
+  for( int k=0; k<nk; k+=nk_slab ) {
+    args->koff = koff + k;
+    args->nk   = nk-k < nk_slab ? nk-k : nk_slab;
+    EXEC_PIPELINES( dump_gather, args, 0 );
+    WAIT_PIPELINES();
+    fileIO.write( stage, args->nk*plane );
+  }
+}
+
 void
 vpic_simulation::field_dump( DumpParameters & dumpParams ) {
 
@@ -531,6 +759,7 @@ vpic_simulation::field_dump( DumpParameters & dumpParams ) {
   FileIO fileIO;
   FileIOStatus status;
 
+  mp_begin_io( 0 );
   status = fileIO.open(filename, io_write);
   if( status==fail ) ERROR(( "Failed opening file: %s", filename ));
 
@@ -597,36 +826,23 @@ vpic_simulation::field_dump( DumpParameters & dumpParams ) {
 
     if( rank()==VERBOSE_rank ) printf("\nBEGIN_OUTPUT\n");
 
-    // more efficient for standard case
-    if(istride == 1 && jstride == 1 && kstride == 1)
-      for(size_t v(0); v<numvars; v++) {
-      for(size_t k(0); k<nzout+2; k++) {
-      for(size_t j(0); j<nyout+2; j++) {
-      for(size_t i(0); i<nxout+2; i++) {
-              const uint32_t * fref = reinterpret_cast<uint32_t *>(&field_array->f(i,j,k));
-              fileIO.write(&fref[varlist[v]], 1);
-              if(rank()==VERBOSE_rank) printf("%f ", field_array->f(i,j,k).ex);
-              if(rank()==VERBOSE_rank) std::cout << "(" << i << " " << j << " " << k << ")" << std::endl;
-      } if(rank()==VERBOSE_rank) std::cout << std::endl << "ROW_BREAK " << j << " " << k << std::endl;
-      } if(rank()==VERBOSE_rank) std::cout << std::endl << "PLANE_BREAK " << k << std::endl;
-      } if(rank()==VERBOSE_rank) std::cout << std::endl << "BLOCK_BREAK" << std::endl;
-      }
+    // Gather each selected variable of the (possibly strided) field
+    // array into staging slabs and write those out.
+    const int strided = istride!=1 || jstride!=1 || kstride!=1;
+    int * ioff = new int[dim[0]+dim[1]+dim[2]];
+    int * joff = ioff + dim[0];
+    int * koff = joff + dim[1];
+    dump_index_map( ioff, dim[0], nxout, grid->nx, istride, strided );
+    dump_index_map( joff, dim[1], nyout, grid->ny, jstride, strided );
+    dump_index_map( koff, dim[2], nzout, grid->nz, kstride, strided );
 
-    else
-
-      for(size_t v(0); v<numvars; v++) {
-      for(size_t k(0); k<nzout+2; k++) { const size_t koff = (k == 0) ? 0 : (k == nzout+1) ? grid->nz+1 : k*kstride-1;
-      for(size_t j(0); j<nyout+2; j++) { const size_t joff = (j == 0) ? 0 : (j == nyout+1) ? grid->ny+1 : j*jstride-1;
-      for(size_t i(0); i<nxout+2; i++) { const size_t ioff = (i == 0) ? 0 : (i == nxout+1) ? grid->nx+1 : i*istride-1;
-              const uint32_t * fref = reinterpret_cast<uint32_t *>(&field_array->f(ioff,joff,koff));
-              fileIO.write(&fref[varlist[v]], 1);
-              if(rank()==VERBOSE_rank) printf("%f ", field_array->f(ioff,joff,koff).ex);
-              if(rank()==VERBOSE_rank) std::cout << "(" << ioff << " " << joff << " " << koff << ")" << std::endl;
-      } if(rank()==VERBOSE_rank) std::cout << std::endl << "ROW_BREAK " << joff << " " << koff << std::endl;
-      } if(rank()==VERBOSE_rank) std::cout << std::endl << "PLANE_BREAK " << koff << std::endl;
-      } if(rank()==VERBOSE_rank) std::cout << std::endl << "BLOCK_BREAK" << std::endl;
-      }
+    for(size_t v(0); v<numvars; v++)
+      dump_staged_write( fileIO, dump_stage, max_dump_stage,
+                         field_array->f,
+                         sizeof(field_t)/sizeof(uint32_t), varlist[v], 1,
+                         ioff, dim[0], joff, dim[1], koff, dim[2], grid );
 
+    delete[] ioff;
     delete[] varlist;
 
   } else { // band_interleave
@@ -641,19 +857,28 @@ vpic_simulation::field_dump( DumpParameters & dumpParams ) {
 
     if(istride == 1 && jstride == 1 && kstride == 1)
       fileIO.write(field_array->f, dim[0]*dim[1]*dim[2]);
-    else
-      for(size_t k(0); k<nzout+2; k++) { const size_t koff = (k == 0) ? 0 : (k == nzout+1) ? grid->nz+1 : k*kstride-1;
-      for(size_t j(0); j<nyout+2; j++) { const size_t joff = (j == 0) ? 0 : (j == nyout+1) ? grid->ny+1 : j*jstride-1;
-      for(size_t i(0); i<nxout+2; i++) { const size_t ioff = (i == 0) ? 0 : (i == nxout+1) ? grid->nx+1 : i*istride-1;
-            fileIO.write(&field_array->f(ioff,joff,koff), 1);
-      }
-      }
-      }
+    else {
+      // Gather whole strided records into staging slabs.
+      int * ioff = new int[dim[0]+dim[1]+dim[2]];
+      int * joff = ioff + dim[0];
+      int * koff = joff + dim[1];
+      dump_index_map( ioff, dim[0], nxout, grid->nx, istride, 1 );
+      dump_index_map( joff, dim[1], nyout, grid->ny, jstride, 1 );
+      dump_index_map( koff, dim[2], nzout, grid->nz, kstride, 1 );
+      dump_staged_write( fileIO, dump_stage, max_dump_stage,
+                         field_array->f,
+                         sizeof(field_t)/sizeof(uint32_t), 0,
+                         sizeof(field_t)/sizeof(uint32_t),
+                         ioff, dim[0], joff, dim[1], koff, dim[2], grid );
+      delete[] ioff;
+    }
   }
 
 # undef f
 
+  double n_byte = fileIO.size();
   if( fileIO.close() ) ERROR(( "File close failed on field dump!!!" ));
+  mp_end_io( "Field dump", n_byte );
 }
 
 void
@@ -670,12 +895,6 @@ vpic_simulation::hydro_dump( const char * speciesname,
   sprintf( filename, "%s/T.%ld/%s.%ld.%d", dumpParams.baseDir, (long)step(),
            dumpParams.baseFileName, (long)step(), rank() );
 
-  FileIO fileIO;
-  FileIOStatus status;
-
-  status = fileIO.open(filename, io_write);
-  if(status == fail) ERROR(("Failed opening file: %s", filename));
-
   species_t * sp = find_species_name(speciesname, species_list);
   if( !sp ) ERROR(( "Invalid species name: %s", speciesname ));
 
@@ -683,6 +902,15 @@ vpic_simulation::hydro_dump( const char * speciesname,
   accumulate_hydro_p( hydro_array, sp, interpolator_array );
   synchronize_hydro_array( hydro_array );
 
+  // The file is opened once the hydro array is synchronized as no
+  // communication can be done while holding an I/O token.
+  FileIO fileIO;
+  FileIOStatus status;
+
+  mp_begin_io( 0 );
+  status = fileIO.open(filename, io_write);
+  if(status == fail) ERROR(("Failed opening file: %s", filename));
+
   // convenience
   const size_t istride(dumpParams.stride_x);
   const size_t jstride(dumpParams.stride_y);
@@ -736,28 +964,23 @@ vpic_simulation::hydro_dump( const char * speciesname,
     for(size_t i(0), c(0); i<total_hydro_variables; i++)
       if( dumpParams.output_vars.bitset(i) ) varlist[c++] = i;
 
-    // More efficient for standard case
-    if(istride == 1 && jstride == 1 && kstride == 1)
-
-      for(size_t v(0); v<numvars; v++)
-      for(size_t k(0); k<nzout+2; k++)
-      for(size_t j(0); j<nyout+2; j++)
-      for(size_t i(0); i<nxout+2; i++) {
-              const uint32_t * href = reinterpret_cast<uint32_t *>(&hydro(i,j,k));
-              fileIO.write(&href[varlist[v]], 1);
-      }
+    // Gather each selected variable of the (possibly strided) hydro
+    // array into staging slabs and write those out.
+    const int strided = istride!=1 || jstride!=1 || kstride!=1;
+    int * ioff = new int[dim[0]+dim[1]+dim[2]];
+    int * joff = ioff + dim[0];
+    int * koff = joff + dim[1];
+    dump_index_map( ioff, dim[0], nxout, grid->nx, istride, strided );
+    dump_index_map( joff, dim[1], nyout, grid->ny, jstride, strided );
+    dump_index_map( koff, dim[2], nzout, grid->nz, kstride, strided );
 
-    else
+    for(size_t v(0); v<numvars; v++)
+      dump_staged_write( fileIO, dump_stage, max_dump_stage,
+                         hydro_array->h,
+                         sizeof(hydro_t)/sizeof(uint32_t), varlist[v], 1,
+                         ioff, dim[0], joff, dim[1], koff, dim[2], grid );
 
-      for(size_t v(0); v<numvars; v++)
-      for(size_t k(0); k<nzout+2; k++) { const size_t koff = (k == 0) ? 0 : (k == nzout+1) ? grid->nz+1 : k*kstride-1;
-      for(size_t j(0); j<nyout+2; j++) { const size_t joff = (j == 0) ? 0 : (j == nyout+1) ? grid->ny+1 : j*jstride-1;
-      for(size_t i(0); i<nxout+2; i++) { const size_t ioff = (i == 0) ? 0 : (i == nxout+1) ? grid->nx+1 : i*istride-1;
-              const uint32_t * href = reinterpret_cast<uint32_t *>(&hydro(ioff,joff,koff));
-              fileIO.write(&href[varlist[v]], 1);
-      }
-      }
-      }
+    delete[] ioff;
 
     delete[] varlist;
 
@@ -775,18 +998,28 @@ vpic_simulation::hydro_dump( const char * speciesname,
 
       fileIO.write(hydro_array->h, dim[0]*dim[1]*dim[2]);
 
-    else
+    else {
 
-      for(size_t k(0); k<nzout; k++) { const size_t koff = (k == 0) ? 0 : (k == nzout+1) ? grid->nz+1 : k*kstride-1;
-      for(size_t j(0); j<nyout; j++) { const size_t joff = (j == 0) ? 0 : (j == nyout+1) ? grid->ny+1 : j*jstride-1;
-      for(size_t i(0); i<nxout; i++) { const size_t ioff = (i == 0) ? 0 : (i == nxout+1) ? grid->nx+1 : i*istride-1;
-            fileIO.write(&hydro(ioff,joff,koff), 1);
-      }
-      }
-      }
+      // Gather whole strided records into staging slabs.
+      int * ioff = new int[dim[0]+dim[1]+dim[2]];
+      int * joff = ioff + dim[0];
+      int * koff = joff + dim[1];
+      dump_index_map( ioff, dim[0], nxout, grid->nx, istride, 1 );
+      dump_index_map( joff, dim[1], nyout, grid->ny, jstride, 1 );
+      dump_index_map( koff, dim[2], nzout, grid->nz, kstride, 1 );
+      dump_staged_write( fileIO, dump_stage, max_dump_stage,
+                         hydro_array->h,
+                         sizeof(hydro_t)/sizeof(uint32_t), 0,
+                         sizeof(hydro_t)/sizeof(uint32_t),
+                         ioff, dim[0], joff, dim[1], koff, dim[2], grid );
+      delete[] ioff;
+
+    }
   }
 
 # undef hydro
 
+  double n_byte = fileIO.size();
   if( fileIO.close() ) ERROR(( "File close failed on hydro dump!!!" ));
+  mp_end_io( "Hydro dump", n_byte );
 }
@@ -61,11 +61,14 @@ vpic_simulation::initialize( int argc,
 
   if( rank()==0 ) MESSAGE(( "Initialization complete" ));
   update_profile( rank()==0 ); // Let the user know how initialization went
+  print_memory_usage();
 }
 
 void
 vpic_simulation::finalize( void ) {
+  flush_tracers();
   barrier();
   update_profile( rank()==0 );
+  print_memory_usage();
 }
 
@@ -0,0 +1,435 @@
+/*------------------------------------------------------------------------------
+ * Region masks and the regular region helpers
+ *
+ * The region macros in deck/wrapper.h used to evaluate the user's region
+ * predicate voxel by voxel on the host, up to eight times per cell center
+ * (and twice over for emitters).  Here the predicate is evaluated once per
+ * cell center into a mask on the pipelines and the materials, fields,
+ * particle boundary conditions and emitter components are then set from
+ * the mask on the pipelines.  The results are identical to the serial
+ * macros.
+ *---------------------------------------------------------------------------*/
+
+#include "vpic.h"
+
+#include "../util/pipelines/pipelines_exec.h"
+
+typedef struct region_pipeline_args
+{
+  MEM_PTR( uint8_t,             128 ) m;        // Region mask
+  MEM_PTR( field_t,             128 ) f;        // Field array
+  MEM_PTR( int64_t,             128 ) neighbor; // Voxel face neighbors
+  MEM_PTR( int32_t,             1   ) c;        // Emitter components
+  MEM_PTR( int,                 1   ) n;        // Per pipeline counts
+  MEM_PTR( void,                1   ) params;   // Predicate parameters
+  region_func_t                       rgn;      // Region predicate
+  region_field_func_t                 eqn;      // Region field function
+  double x0, y0, z0;                            // Local domain low corner
+  double dx, dy, dz;                            // Cell dimensions
+  double cvac;                                  // Speed of light
+  int64_t vpbc, ipbc, epbc;                     // Particle bcs (0: none)
+  material_id vmat, smat;                       // Materials (-1: none)
+  int nx, ny, nz;                               // Local domain resolution
+  int sx, sy;                                   // Mask strides
+  int surface;                                  // Surface emitter
+
+  PAD_STRUCT( 6*SIZEOF_MEM_PTR + 2*sizeof(void *) + 7*sizeof(double) +
+              3*sizeof(int64_t) + 2*sizeof(material_id) + 6*sizeof(int) )
+
+} region_pipeline_args_t;
+
+// The mask entry of cell (0,j,k).  The entries of cell i and its
+// neighbors are at offsets i, -1, +1 (x), -sx, +sx (y) and -sx*sy, +sx*sy
+// (z) from it.
+
+#define MASK_ROW( a, j, k ) \
+  ( (a)->m + 1 + (size_t)(a)->sx*( (size_t)( (j) + 1 ) + \
+                                   (size_t)(a)->sy*(size_t)( (k) + 1 ) ) )
+
+// Pipelines are assigned whole rows of cells in this file.  The host has
+// no stragglers.
+
+static void
+region_mask_pipeline_scalar( region_pipeline_args_t * args,
+                             int pipeline_rank,
+                             int n_pipeline ) {
+  const region_func_t rgn = args->rgn;
+  void * params = args->params;
+  const double x0 = args->x0, y0 = args->y0, z0 = args->z0;
+  const double dx = args->dx, dy = args->dy, dz = args->dz;
+  const int nx = args->nx, sy = args->sy;
+  uint8_t * RESTRICT m;
+  double y, z;
+  int r, nr, i, j, k;
+
+  if( pipeline_rank==n_pipeline ) return;
+
+  DISTRIBUTE( sy*( args->nz + 3 ), 1, pipeline_rank, n_pipeline, r, nr );
+
+  for( ; nr; r++, nr-- ) {
+    j = r%sy - 1;
+    k = r/sy - 1;
+    y = y0 + dy*(j-0.5);
+    z = z0 + dz*(k-0.5);
+    m = MASK_ROW( args, j, k );
+    for( i=-1; i<nx+2; i++ ) m[i] = rgn( params, x0 + dx*(i-0.5), y, z )!=0;
+  }
+}
+
+region_mask_t *
+new_region_mask( const grid_t * g,
+                 region_func_t rgn,
+                 void * params ) {
+  DECLARE_ALIGNED_ARRAY( region_pipeline_args_t, 128, args, 1 );
+  region_mask_t * rm;
+
+  if( !g || !rgn ) ERROR(( "Bad args" ));
+
+  MALLOC( rm, 1 );
+  rm->nx = g->nx; rm->sx = g->nx + 3;
+  rm->ny = g->ny; rm->sy = g->ny + 3;
+  rm->nz = g->nz; rm->sz = g->nz + 3;
+  MALLOC_ALIGNED( rm->m, (size_t)rm->sx*(size_t)rm->sy*(size_t)rm->sz, 128 );
+
+  args->m      = rm->m;
+  args->params = params;
+  args->rgn    = rgn;
+  args->x0     = g->x0; args->dx = g->dx;
+  args->y0     = g->y0; args->dy = g->dy;
+  args->z0     = g->z0; args->dz = g->dz;
+  args->nx     = rm->nx;
+  args->ny     = rm->ny;
+  args->nz     = rm->nz;
+  args->sx     = rm->sx;
+  args->sy     = rm->sy;
+
+  EXEC_PIPELINES( region_mask, args, 0 );
+  WAIT_PIPELINES();
+
+  return rm;
+}
+
+void
+delete_region_mask( region_mask_t * rm ) {
+  if( !rm ) return;
+  FREE_ALIGNED( rm->m );
+  FREE( rm );
+}
+
+// Fill in the arguments common to the helpers below.
+
+static void
+region_args( region_pipeline_args_t * args,
+             const region_mask_t * rm,
+             const grid_t * g ) {
+  if( !rm || !g ) ERROR(( "Bad args" ));
+  if( rm->nx!=g->nx || rm->ny!=g->ny || rm->nz!=g->nz )
+    ERROR(( "Region mask was made for a %ix%ix%i domain, not %ix%ix%i",
+            rm->nx, rm->ny, rm->nz, g->nx, g->ny, g->nz ));
+
+  CLEAR( args, 1 );
+  args->m  = rm->m;
+  args->x0 = g->x0; args->dx = g->dx;
+  args->y0 = g->y0; args->dy = g->dy;
+  args->z0 = g->z0; args->dz = g->dz;
+  args->cvac = g->cvac;
+  args->nx = g->nx;
+  args->ny = g->ny;
+  args->nz = g->nz;
+  args->sx = rm->sx;
+  args->sy = rm->sy;
+}
+
+/*------------------------------------------------------------------------------
+ * Materials (all voxels, including ghosts)
+ *---------------------------------------------------------------------------*/
+
+static void
+region_material_pipeline_scalar( region_pipeline_args_t * args,
+                                 int pipeline_rank,
+                                 int n_pipeline ) {
+  const material_id vmat = args->vmat, smat = args->smat;
+  const int nx = args->nx, ny = args->ny;
+  const size_t sx = args->sx, sxy = sx*args->sy;
+  const uint8_t * RESTRICT m;
+  field_t * RESTRICT f;
+  int r, nr, i;
+
+  if( pipeline_rank==n_pipeline ) return;
+
+  DISTRIBUTE( (ny+2)*(args->nz+2), 1, pipeline_rank, n_pipeline, r, nr );
+
+  for( ; nr; r++, nr-- ) {
+    m = MASK_ROW( args, r%(ny+2), r/(ny+2) );
+    f = args->f + (size_t)(nx+2)*(size_t)r;
+    for( i=0; i<nx+2; i++, m++, f++ ) {
+      const int rccc = m[0],      rlcc = m[-1];
+      const int rclc = m[-sx],    rllc = m[-1-sx];
+      const int rccl = m[-sxy],   rlcl = m[-1-sxy];
+      const int rcll = m[-sx-sxy], rlll = m[-1-sx-sxy];
+      if( smat!=-1 ) {
+        if( rccc || rclc || rccl || rcll ) f->ematx = smat;
+        if( rccc || rccl || rlcc || rlcl ) f->ematy = smat;
+        if( rccc || rlcc || rclc || rllc ) f->ematz = smat;
+        if( rccc || rlcc )                 f->fmatx = smat;
+        if( rccc || rclc )                 f->fmaty = smat;
+        if( rccc || rccl )                 f->fmatz = smat;
+        if( rccc || rlcc || rclc || rllc ||
+            rccl || rlcl || rcll || rlll ) f->nmat  = smat;
+      }
+      if( vmat!=-1 ) {
+        if( rccc && rclc && rccl && rcll ) f->ematx = vmat;
+        if( rccc && rccl && rlcc && rlcl ) f->ematy = vmat;
+        if( rccc && rlcc && rclc && rllc ) f->ematz = vmat;
+        if( rccc && rlcc )                 f->fmatx = vmat;
+        if( rccc && rclc )                 f->fmaty = vmat;
+        if( rccc && rccl )                 f->fmatz = vmat;
+        if( rccc && rlcc && rclc && rllc &&
+            rccl && rlcl && rcll && rlll ) f->nmat  = vmat;
+        if( rccc )                         f->cmat  = vmat;
+      }
+    }
+  }
+}
+
+void
+vpic_simulation::set_mask_material( const region_mask_t * rm,
+                                    material_id vmat,
+                                    material_id smat ) {
+  DECLARE_ALIGNED_ARRAY( region_pipeline_args_t, 128, args, 1 );
+  if( vmat==-1 && smat==-1 ) return;
+  if( !field_array ) ERROR(( "Define the field array first" ));
+  region_args( args, rm, grid );
+  args->f    = field_array->f;
+  args->vmat = vmat;
+  args->smat = smat;
+  EXEC_PIPELINES( region_material, args, 0 );
+  WAIT_PIPELINES();
+}
+
+/*------------------------------------------------------------------------------
+ * Fields (all voxels, including ghosts).  The field equations are only
+ * evaluated inside the mesh-mapped region.
+ *---------------------------------------------------------------------------*/
+
+static void
+region_field_pipeline_scalar( region_pipeline_args_t * args,
+                              int pipeline_rank,
+                              int n_pipeline ) {
+  const region_field_func_t eqn = args->eqn;
+  void * params = args->params;
+  const double x0 = args->x0, y0 = args->y0, z0 = args->z0;
+  const double dx = args->dx, dy = args->dy, dz = args->dz;
+  const double c  = args->cvac;
+  const int nx = args->nx, ny = args->ny;
+  const size_t sx = args->sx, sxy = sx*args->sy;
+  const uint8_t * RESTRICT m;
+  field_t * RESTRICT f;
+  double xe, xc, ye, yc, ze, zc;
+  int r, nr, i, j, k;
+
+  if( pipeline_rank==n_pipeline ) return;
+
+  DISTRIBUTE( (ny+2)*(args->nz+2), 1, pipeline_rank, n_pipeline, r, nr );
+
+  for( ; nr; r++, nr-- ) {
+    j  = r%(ny+2);
+    k  = r/(ny+2);
+    ye = y0 + dy*j; yc = y0 + dy*(j-0.5);
+    ze = z0 + dz*k; zc = z0 + dz*(k-0.5);
+    m  = MASK_ROW( args, j, k );
+    f  = args->f + (size_t)(nx+2)*(size_t)r;
+    for( i=0; i<nx+2; i++, m++, f++ ) {
+      const int rccc = m[0],    rlcc = m[-1];
+      const int rclc = m[-sx],  rllc = m[-1-sx];
+      const int rccl = m[-sxy], rlcl = m[-1-sxy];
+      const int rcll = m[-sx-sxy];
+      xe = x0 + dx*i; xc = x0 + dx*(i-0.5);
+      if( rccc || rclc || rccl || rcll ) f->ex  =   eqn( params, 0, xc, ye, ze );
+      if( rccc || rccl || rlcc || rlcl ) f->ey  =   eqn( params, 1, xe, yc, ze );
+      if( rccc || rlcc || rclc || rllc ) f->ez  =   eqn( params, 2, xe, ye, zc );
+      if( rccc || rlcc )                 f->cbx = c*eqn( params, 3, xe, yc, zc );
+      if( rccc || rclc )                 f->cby = c*eqn( params, 4, xc, ye, zc );
+      if( rccc || rccl )                 f->cbz = c*eqn( params, 5, xc, yc, ze );
+    }
+  }
+}
+
+void
+vpic_simulation::set_mask_field( const region_mask_t * rm,
+                                 region_field_func_t eqn,
+                                 void * params ) {
+  DECLARE_ALIGNED_ARRAY( region_pipeline_args_t, 128, args, 1 );
+  if( !eqn ) ERROR(( "Bad args" ));
+  if( !field_array ) ERROR(( "Define the field array first" ));
+  region_args( args, rm, grid );
+  args->f      = field_array->f;
+  args->eqn    = eqn;
+  args->params = params;
+  EXEC_PIPELINES( region_field, args, 0 );
+  WAIT_PIPELINES();
+}
+
+/*------------------------------------------------------------------------------
+ * Particle boundary conditions (interior voxels)
+ *---------------------------------------------------------------------------*/
+
+static void
+region_bc_pipeline_scalar( region_pipeline_args_t * args,
+                           int pipeline_rank,
+                           int n_pipeline ) {
+  const int64_t vpbc = args->vpbc, ipbc = args->ipbc, epbc = args->epbc;
+  const int nx = args->nx, ny = args->ny;
+  const size_t sx = args->sx, sxy = sx*args->sy;
+  const uint8_t * RESTRICT m;
+  int64_t * RESTRICT n;
+  int r, nr, i, j, k;
+
+  if( pipeline_rank==n_pipeline ) return;
+
+  DISTRIBUTE( ny*args->nz, 1, pipeline_rank, n_pipeline, r, nr );
+
+  for( ; nr; r++, nr-- ) {
+    j = 1 + r%ny;
+    k = 1 + r/ny;
+    m = MASK_ROW( args, j, k ) + 1;
+    n = args->neighbor + 6*( 1 + (size_t)(nx+2)*( j + (size_t)(ny+2)*k ) );
+    for( i=1; i<nx+1; i++, m++, n+=6 ) {
+      const int rc = m[0];
+      const int r0 = m[-1],   r1 = m[-sx], r2 = m[-sxy];
+      const int r3 = m[ 1],   r4 = m[ sx], r5 = m[ sxy];
+      if( vpbc ) {
+        if( rc && r0  ) n[0] = vpbc;
+        if( rc && r1  ) n[1] = vpbc;
+        if( rc && r2  ) n[2] = vpbc;
+        if( rc && r3  ) n[3] = vpbc;
+        if( rc && r4  ) n[4] = vpbc;
+        if( rc && r5  ) n[5] = vpbc;
+      }
+      if( ipbc ) {
+        if( rc && !r0 ) n[0] = ipbc;
+        if( rc && !r1 ) n[1] = ipbc;
+        if( rc && !r2 ) n[2] = ipbc;
+        if( rc && !r3 ) n[3] = ipbc;
+        if( rc && !r4 ) n[4] = ipbc;
+        if( rc && !r5 ) n[5] = ipbc;
+      }
+      if( epbc ) {
+        if( !rc && r0 ) n[0] = epbc;
+        if( !rc && r1 ) n[1] = epbc;
+        if( !rc && r2 ) n[2] = epbc;
+        if( !rc && r3 ) n[3] = epbc;
+        if( !rc && r4 ) n[4] = epbc;
+        if( !rc && r5 ) n[5] = epbc;
+      }
+    }
+  }
+}
+
+void
+vpic_simulation::set_mask_bc( const region_mask_t * rm,
+                              int64_t vpbc,
+                              int64_t ipbc,
+                              int64_t epbc ) {
+  DECLARE_ALIGNED_ARRAY( region_pipeline_args_t, 128, args, 1 );
+  if( !vpbc && !ipbc && !epbc ) return;
+  region_args( args, rm, grid );
+  args->neighbor = grid->neighbor;
+  args->vpbc     = vpbc;
+  args->ipbc     = ipbc;
+  args->epbc     = epbc;
+  EXEC_PIPELINES( region_bc, args, 0 );
+  WAIT_PIPELINES();
+}
+
+/*------------------------------------------------------------------------------
+ * Emitters (interior voxels).  A volume emitter has the cells inside the
+ * region.  A surface emitter has the faces of the cells outside the region
+ * that neighbor cells inside it (it emits into the exterior).  Pipelines
+ * first count their components (args->c NULL) and then, from the offsets
+ * the host makes from the counts, write them in the serial order.
+ *---------------------------------------------------------------------------*/
+
+static void
+region_emitter_pipeline_scalar( region_pipeline_args_t * args,
+                                int pipeline_rank,
+                                int n_pipeline ) {
+  /**/  int32_t * RESTRICT c = args->c;
+  const int nx = args->nx, ny = args->ny;
+  const size_t sx = args->sx, sxy = sx*args->sy;
+  const uint8_t * RESTRICT m;
+  int r, nr, i, j, k, v, nc;
+
+  if( pipeline_rank==n_pipeline ) return;
+
+  DISTRIBUTE( ny*args->nz, 1, pipeline_rank, n_pipeline, r, nr );
+
+  nc = c ? args->n[pipeline_rank] : 0;
+
+# define EMIT( t ) do {                                 \
+    if( c ) c[nc] = COMPONENT_ID( v, BOUNDARY t );      \
+    nc++;                                               \
+  } while(0)
+
+  for( ; nr; r++, nr-- ) {
+    j = 1 + r%ny;
+    k = 1 + r/ny;
+    m = MASK_ROW( args, j, k ) + 1;
+    v = 1 + (nx+2)*( j + (ny+2)*k );
+    for( i=1; i<nx+1; i++, m++, v++ ) {
+      if( !args->surface ) {
+        if( m[0] ) EMIT( ( 0, 0, 0) );
+        continue;
+      }
+      if( m[0] ) continue;
+      if( m[-1]   ) EMIT( (-1, 0, 0) );
+      if( m[-sx]  ) EMIT( ( 0,-1, 0) );
+      if( m[-sxy] ) EMIT( ( 0, 0,-1) );
+      if( m[ 1]   ) EMIT( ( 1, 0, 0) );
+      if( m[ sx]  ) EMIT( ( 0, 1, 0) );
+      if( m[ sxy] ) EMIT( ( 0, 0, 1) );
+    }
+  }
+
+# undef EMIT
+
+  if( !c ) args->n[pipeline_rank] = nc;
+}
+
+static void
+region_emitter( region_pipeline_args_t * args,
+                emitter_t * e ) {
+  int n[ MAX_PIPELINE ], rank, nc, t;
+
+  args->n = n;
+  args->c = NULL;
+  EXEC_PIPELINES( region_emitter, args, 0 );
+  WAIT_PIPELINES();
+
+  for( nc=0, rank=0; rank<N_PIPELINE; rank++ ) t = n[rank], n[rank] = nc, nc += t;
+
+  args->c = size_emitter( e, nc );
+  if( !nc ) return;
+  EXEC_PIPELINES( region_emitter, args, 0 );
+  WAIT_PIPELINES();
+}
+
+void
+vpic_simulation::define_mask_volume_emitter( emitter_t * e,
+                                             const region_mask_t * rm ) {
+  DECLARE_ALIGNED_ARRAY( region_pipeline_args_t, 128, args, 1 );
+  region_args( args, rm, grid );
+  args->surface = 0;
+  region_emitter( args, define_emitter( e ) );
+}
+
+void
+vpic_simulation::define_mask_surface_emitter( emitter_t * e,
+                                              const region_mask_t * rm ) {
+  DECLARE_ALIGNED_ARRAY( region_pipeline_args_t, 128, args, 1 );
+  region_args( args, rm, grid );
+  args->surface = 1;
+  region_emitter( args, define_emitter( e ) );
+}
+
+#undef MASK_ROW
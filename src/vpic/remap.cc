@@ -0,0 +1,272 @@
+/*
+ * Restart from a checkpt written on a different number of ranks.
+ *
+ * The simulation is set up by the input deck on the current ranks,
+ * which gives the new domain decomposition.  Each rank then restores
+ * (detached, see restore_detached) only the checkpts of the old ranks
+ * whose domains overlap its own and copies the fields (including the
+ * material ids) and the particles it now owns out of them.  Old
+ * domains are assumed to come from one of the partition_*_box
+ * helpers: they tile the same global mesh as the new domains and all
+ * have the same size.
+ */
+
+#include "vpic.h"
+#define FAK field_array->kernel
+
+vpic_simulation *
+restore_vpic_simulation( void );
+
+static void
+delete_detached_simulation( void * vpic ) {
+  delete (vpic_simulation *)vpic;
+}
+
+static vpic_simulation *
+restore_old_rank( const char * fbase,
+                  int orank ) {
+  char fname[256];
+  snprintf( fname, sizeof(fname), "%s.%i", fbase, orank );
+  return (vpic_simulation *)
+    restore_detached( fname, (restore_func_t)restore_vpic_simulation );
+}
+
+// New voxel (i,j,k) is old voxel (i-di,j-dj,k-dk).  Old voxels on the
+// high side ghost layers hold the values on the faces, edges and
+// corners shared with the high side neighbors, but only the components
+// that lie on those faces are valid there.  A voxel is thus taken from
+// the old domain where it is in the ghost layers in the fewest
+// directions; copied holds 4 minus that count for each voxel copied
+// so far.
+
+static void
+remap_fields( field_t * RESTRICT f,
+              char * RESTRICT copied,
+              const grid_t * g,
+              const field_t * RESTRICT of,
+              const grid_t * og,
+              int di, int dj, int dk ) {
+  const int nx = g->nx, ny = g->ny, nz = g->nz;
+  const int onx = og->nx, ony = og->ny, onz = og->nz;
+  int i, j, k, oi, oj, ok, v, score;
+
+  for( k=1; k<=nz+1; k++ ) {
+    ok = k - dk;
+    if( ok<1 || ok>onz+1 ) continue;
+    for( j=1; j<=ny+1; j++ ) {
+      oj = j - dj;
+      if( oj<1 || oj>ony+1 ) continue;
+      for( i=1; i<=nx+1; i++ ) {
+        oi = i - di;
+        if( oi<1 || oi>onx+1 ) continue;
+        score = 4 - (oi>onx) - (oj>ony) - (ok>onz);
+        v = VOXEL( i,j,k, nx,ny,nz );
+        if( score>copied[v] ) {
+          f[v] = of[ VOXEL( oi,oj,ok, onx,ony,onz ) ];
+          copied[v] = score;
+        }
+      }
+    }
+  }
+}
+
+static void
+grow_species( species_t * sp ) {
+  int max_np = sp->max_np + sp->max_np/2 + 16;
+  REALLOC_ARENA( sp->p, sp->np, max_np, 128, "particle" );
+  if( sp->tag ) REALLOC_ARENA( sp->tag, sp->np, max_np, 128, "particle" );
+  sp->max_np = max_np;
+}
+
+// Append the particles of osp that are in the local domain to sp.
+
+static void
+remap_particles( species_t * sp,
+                 const species_t * osp,
+                 const grid_t * og,
+                 int di, int dj, int dk ) {
+  const grid_t * g = sp->g;
+  const int nx = g->nx, ny = g->ny, nz = g->nz;
+  const int sx = og->nx+2, sy = og->ny+2;
+  const particle_t * RESTRICT op = osp->p;
+  int n, i, j, k, v;
+
+  if( (sp->tag!=NULL) != (osp->tag!=NULL) )
+    ERROR(( "Species \"%s\" is %stagged in the checkpt but %stagged by the "
+            "deck", sp->name, osp->tag ? "" : "not ",
+            sp->tag ? "" : "not " ));
+
+  for( n=0; n<osp->np; n++ ) {
+    v = op[n].i;
+    i = v % sx; v /= sx;
+    j = v % sy;
+    k = v / sy;
+    i += di, j += dj, k += dk;
+    if( i<1 || i>nx || j<1 || j>ny || k<1 || k>nz ) continue;
+
+    if( sp->np==sp->max_np ) grow_species( sp );
+    sp->p[sp->np] = op[n];
+    sp->p[sp->np].i = VOXEL( i,j,k, nx,ny,nz );
+    if( sp->tag ) sp->tag[sp->np] = osp->tag[n];
+    sp->np++;
+  }
+}
+
+void
+vpic_simulation::restore_remap( const char * fbase,
+                                int argc,
+                                char ** argv ) {
+  vpic_simulation * old = NULL;
+  species_t * sp, * osp;
+  char * copied;
+  double lo[3], glo[3];
+  int ext[3], oext[3], * gext;
+  int ox, oy, oz, gnx, gny, gnz, opx, opy, opz;
+  int pi, pj, pk, pi0, pj0, pk0, n_sp, s;
+  int64_t * max_tag, * gmax_tag;
+
+  if( !fbase ) ERROR(( "NULL checkpt base" ));
+
+  // Let the deck set up the simulation on the current ranks.  The
+  // fields it creates are replaced below.  Its particle loads are
+  // skipped (see inject_particle) and any particles it made otherwise
+  // are discarded below.
+
+  remapping = 1;
+  TIC user_initialization( argc, argv ); TOC( user_initialization, 1 );
+  remapping = 0;
+
+  if( !grid || !field_array ) ERROR(( "The deck did not set up a grid" ));
+
+  const int nx = grid->nx, ny = grid->ny, nz = grid->nz;
+
+  // Locate the local domain in the global mesh.  Rank 0 holds the low
+  // corner of the global domain in any decomposition.
+
+  lo[0] = rank()==0 ? grid->x0 : 0;
+  lo[1] = rank()==0 ? grid->y0 : 0;
+  lo[2] = rank()==0 ? grid->z0 : 0;
+  mp_allsum_d( lo, glo, 3 );
+  ox = (int)floor( ( grid->x0 - glo[0] )*grid->rdx + 0.5 );
+  oy = (int)floor( ( grid->y0 - glo[1] )*grid->rdy + 0.5 );
+  oz = (int)floor( ( grid->z0 - glo[2] )*grid->rdz + 0.5 );
+
+  MALLOC( gext, 3*nproc() );
+  ext[0] = ox+nx, ext[1] = oy+ny, ext[2] = oz+nz;
+  mp_allgather_i( ext, gext, 3 );
+  gnx = gny = gnz = 0;
+  for( s=0; s<nproc(); s++ ) {
+    gnx = gext[3*s+0]>gnx ? gext[3*s+0] : gnx;
+    gny = gext[3*s+1]>gny ? gext[3*s+1] : gny;
+    gnz = gext[3*s+2]>gnz ? gext[3*s+2] : gnz;
+  }
+  FREE( gext );
+
+  // Rank 0 reads the checkpt of old rank 0 (it needs it anyway) to find
+  // the size of the old domains.
+
+  ext[0] = ext[1] = ext[2] = 0;
+  if( rank()==0 ) {
+    old = restore_old_rank( fbase, 0 );
+    if( old->grid->dx!=grid->dx || old->grid->dy!=grid->dy ||
+        old->grid->dz!=grid->dz )
+      ERROR(( "The deck and the checkpt have different cell sizes" ));
+    ext[0] = old->grid->nx, ext[1] = old->grid->ny, ext[2] = old->grid->nz;
+  }
+  mp_allsum_i( ext, oext, 3 );
+
+  if( gnx%oext[0] || gny%oext[1] || gnz%oext[2] )
+    ERROR(( "The old domains (%ix%ix%i) do not tile the global mesh "
+            "(%ix%ix%i)", oext[0], oext[1], oext[2], gnx, gny, gnz ));
+  opx = gnx/oext[0], opy = gny/oext[1], opz = gnz/oext[2];
+
+  if( rank()==0 )
+    MESSAGE(( "Remapping a %ix%ix%i checkpt onto %i ranks",
+              opx, opy, opz, nproc() ));
+
+  // Replace the deck's particles and fields with those of the old
+  // ranks that overlap the local domain.
+
+  LIST_FOR_EACH( sp, species_list ) sp->np = 0, sp->nm = 0;
+
+  n_sp = num_species( species_list );
+  MALLOC( max_tag, n_sp );
+  for( s=0; s<n_sp; s++ ) max_tag[s] = 0;
+
+  MALLOC( copied, grid->nv );
+  CLEAR( copied, grid->nv );
+
+  pi0 = ox/oext[0], pj0 = oy/oext[1], pk0 = oz/oext[2];
+  for( pk=pk0; pk<=(oz+nz-1)/oext[2]; pk++ )
+    for( pj=pj0; pj<=(oy+ny-1)/oext[1]; pj++ )
+      for( pi=pi0; pi<=(ox+nx-1)/oext[0]; pi++ ) {
+        int orank = pi + opx*( pj + opy*pk );
+        int di = pi*oext[0] - ox, dj = pj*oext[1] - oy, dk = pk*oext[2] - oz;
+
+        if( !old || orank!=0 ) old = restore_old_rank( fbase, orank );
+
+        // The old rank holding the low corner of the local domain
+        // provides the time step and user globals.
+
+        if( pi==pi0 && pj==pj0 && pk==pk0 ) {
+          grid->step = old->grid->step;
+          COPY( user_global, old->user_global, USER_GLOBAL_SIZE );
+        }
+
+        remap_fields( field_array->f, copied, grid,
+                      old->field_array->f, old->grid, di, dj, dk );
+
+        LIST_FOR_EACH( osp, old->species_list ) {
+          sp = find_species_name( osp->name, species_list );
+          if( !sp ) ERROR(( "Species \"%s\" is not defined by the deck",
+                            osp->name ));
+          remap_particles( sp, osp, old->grid, di, dj, dk );
+
+          // Every tag the old rank handed out is below its next_tag
+          // (including those of particles that have since moved to
+          // other old ranks or left the domain).
+
+          int64_t t = osp->next_tag & ((((int64_t)1)<<40)-1);
+          if( max_tag[sp->id]<t ) max_tag[sp->id] = t;
+        }
+
+        release_detached( delete_detached_simulation, old );
+        old = NULL;
+      }
+
+  if( old ) release_detached( delete_detached_simulation, old );
+  FREE( copied );
+
+  // New tags must not collide with any tag an old rank handed out.
+  // The old domains tile the new ones, so every old rank's next_tag was
+  // seen by some new rank.
+
+  MALLOC( gmax_tag, n_sp*nproc() );
+  mp_allgather_i64( max_tag, gmax_tag, n_sp );
+  LIST_FOR_EACH( sp, species_list ) {
+    if( !sp->tag ) continue;
+    int64_t t = 0;
+    for( s=0; s<nproc(); s++ )
+      if( t<gmax_tag[s*n_sp+sp->id] ) t = gmax_tag[s*n_sp+sp->id];
+    sp->next_tag = ( ((int64_t)rank())<<40 ) + t;
+  }
+  FREE( gmax_tag );
+  FREE( max_tag );
+
+  // The particles were appended in old rank order.  Sort them so the
+  // partitions (used by the collision operators) describe them.
+
+  LIST_FOR_EACH( sp, species_list ) TIC sort_p( sp ); TOC( sort_p, 1 );
+
+  // Reconcile the shared faces and load the interpolators the first
+  // step will use.  The particles are already uncentered.
+
+  TIC FAK->synchronize_tang_e_norm_b( field_array ); TOC( synchronize_tang_e_norm_b, 1 );
+  if( species_list ) {
+    TIC load_interpolator_array( interpolator_array, field_array ); TOC( load_interpolator, 1 );
+  }
+
+  if( rank()==0 ) MESSAGE(( "Remap complete" ));
+  update_profile( rank()==0 );
+  print_memory_usage();
+}
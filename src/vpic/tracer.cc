@@ -0,0 +1,176 @@
+/*
+ * Particle tracers: periodically buffer the state of selected tagged
+ * particles and write it out in batches.
+ */
+
+#include <unistd.h>
+
+#include "vpic.h"
+
+#define TRACER_CHUNK 32768 // 1MB of particles
+
+/* Private interface *********************************************************/
+
+void
+checkpt_tracer( const tracer_t * t ) {
+  CHECKPT( t, 1 );
+  CHECKPT_PTR( t->sp );
+  CHECKPT_STR( t->fname );
+  checkpt_data( t->buf,
+                t->nbuf   *sizeof(tracer_record_t),
+                t->max_buf*sizeof(tracer_record_t), 1, 1, 128 );
+  CHECKPT_PTR( t->next );
+}
+
+tracer_t *
+restore_tracer( void ) {
+  tracer_t * t;
+  RESTORE( t );
+  RESTORE_PTR( t->sp );
+  RESTORE_STR( t->fname );
+  t->buf = (tracer_record_t *)restore_data();
+  RESTORE_PTR( t->next );
+
+  // Records written after the checkpoint was taken are stale.  The
+  // file is trimmed on the next flush.
+  t->synced = 0;
+  t->p_buf  = NULL;
+  t->t_buf  = NULL;
+  return t;
+}
+
+void
+delete_tracer( tracer_t * t ) {
+  UNREGISTER_OBJECT( t );
+  FREE_ALIGNED( t->t_buf );
+  FREE_ALIGNED( t->p_buf );
+  FREE_ALIGNED( t->buf );
+  FREE( t->fname );
+  FREE( t );
+}
+
+void
+delete_tracer_list( tracer_t * tracer_list ) {
+  tracer_t * t;
+  while( tracer_list ) {
+    t = tracer_list;
+    tracer_list = tracer_list->next;
+    delete_tracer( t );
+  }
+}
+
+static void
+flush_tracer( tracer_t * t ) {
+  FileIO fileIO;
+  FileIOStatus status;
+
+  if( !t->nbuf ) return;
+
+  if( !t->synced && t->n_written &&
+      truncate( t->fname, t->n_written*sizeof(tracer_record_t) ) )
+    ERROR(( "Could not truncate \"%s\"", t->fname ));
+  t->synced = 1;
+
+  status = fileIO.open( t->fname, t->n_written ? io_append : io_write );
+  if( status==fail ) ERROR(( "Could not open \"%s\"", t->fname ));
+  fileIO.write( t->buf, t->nbuf );
+  if( fileIO.close() ) ERROR(( "File close failed on tracer flush!!!" ));
+
+  t->n_written += t->nbuf;
+  t->nbuf = 0;
+}
+
+/* Public interface **********************************************************/
+
+tracer_t *
+vpic_simulation::define_tracer( const char * sp_name,
+                                const char * fbase,
+                                int interval,
+                                const particle_select_t & sel,
+                                int max_buf ) {
+  species_t * sp;
+  tracer_t * t;
+  char fname[256];
+
+  sp = find_species_name( sp_name, species_list );
+  if( !sp ) ERROR(( "Invalid species name \"%s\".", sp_name ));
+  if( !sp->tag ) ERROR(( "Species \"%s\" is not tagged", sp->name ));
+  if( !fbase ) ERROR(( "Invalid filename" ));
+  if( interval<1 ) ERROR(( "Bad tracer interval" ));
+  if( max_buf<1 ) max_buf = 1;
+
+  snprintf( fname, sizeof(fname), "%s.%i", fbase, rank() );
+
+  MALLOC( t, 1 );
+  CLEAR( t, 1 );
+  MALLOC( t->fname, strlen(fname)+1 );
+  strcpy( t->fname, fname );
+  t->sp       = sp;
+  t->interval = interval;
+  t->sel      = sel;
+  MALLOC_ALIGNED( t->buf, max_buf, 128 );
+  t->max_buf  = max_buf;
+  t->synced   = 1;
+  t->next     = tracer_list;
+  tracer_list = t;
+
+  REGISTER_OBJECT( t, checkpt_tracer, restore_tracer, NULL );
+  return t;
+}
+
+void
+vpic_simulation::trace_particles( void ) {
+  tracer_t * t;
+
+  LIST_FOR_EACH( t, tracer_list ) {
+    if( step() % t->interval ) continue;
+
+    if( !t->p_buf ) {
+      MALLOC_ALIGNED( t->p_buf, TRACER_CHUNK, 128 );
+      MALLOC_ALIGNED( t->t_buf, TRACER_CHUNK, 128 );
+    }
+
+    particle_t * ALIGNED(128) p_buf = t->p_buf;
+    int64_t    * ALIGNED(128) t_buf = t->t_buf;
+    species_t * sp = t->sp;
+    const grid_t * g = sp->g;
+    const int sy = g->sy, sz = g->sz;
+
+    // Same trick as dump_particles: select_p works on a scratch copy
+    // of each hunk of the particle list.
+
+    particle_t * sp_p = sp->p;      sp->p      = p_buf;
+    int sp_np         = sp->np;     sp->np     = 0;
+    int sp_max_np     = sp->max_np; sp->max_np = TRACER_CHUNK;
+    for( int buf_start=0; buf_start<sp_np; buf_start += TRACER_CHUNK ) {
+      sp->np = sp_np-buf_start; if( sp->np>TRACER_CHUNK ) sp->np = TRACER_CHUNK;
+      COPY( sp->p, &sp_p[buf_start], sp->np );
+      int n = select_p( sp, interpolator_array, &t->sel, buf_start, t_buf );
+      for( int m=0; m<n; m++ ) {
+        const particle_t * p = p_buf + m;
+        int iz = p->i/sz, iy = (p->i - iz*sz)/sy, ix = p->i - iz*sz - iy*sy;
+        if( t->nbuf==t->max_buf ) flush_tracer( t );
+        tracer_record_t * r = t->buf + (t->nbuf++);
+        r->tag  = t_buf[m];
+        r->step = step();
+        r->x    = g->x0 + ( (ix-1) + 0.5f*(p->dx+1) )*g->dx;
+        r->y    = g->y0 + ( (iy-1) + 0.5f*(p->dy+1) )*g->dy;
+        r->z    = g->z0 + ( (iz-1) + 0.5f*(p->dz+1) )*g->dz;
+        r->ux   = p->ux;
+        r->uy   = p->uy;
+        r->uz   = p->uz;
+        r->w    = p->w;
+        r->pad  = 0;
+      }
+    }
+    sp->p      = sp_p;
+    sp->np     = sp_np;
+    sp->max_np = sp_max_np;
+  }
+}
+
+void
+vpic_simulation::flush_tracers( void ) {
+  tracer_t * t;
+  LIST_FOR_EACH( t, tracer_list ) flush_tracer( t );
+}
@@ -26,6 +26,7 @@ checkpt_vpic_simulation( const vpic_simulation * vpic ) {
   CHECKPT( vpic, 1 );
   CHECKPT_PTR( vpic->entropy );
   CHECKPT_PTR( vpic->sync_entropy );
+  CHECKPT_PTR( vpic->inject_entropy );
   CHECKPT_PTR( vpic->grid );
   CHECKPT_FPTR( vpic->material_list );
   CHECKPT_FPTR( vpic->field_array );
@@ -36,6 +37,7 @@ checkpt_vpic_simulation( const vpic_simulation * vpic ) {
   CHECKPT_FPTR( vpic->particle_bc_list );
   CHECKPT_FPTR( vpic->emitter_list );
   CHECKPT_FPTR( vpic->collision_op_list );
+  CHECKPT_FPTR( vpic->tracer_list );
 }
 
 vpic_simulation *
@@ -44,6 +46,7 @@ restore_vpic_simulation( void ) {
   RESTORE( vpic );
   RESTORE_PTR( vpic->entropy );
   RESTORE_PTR( vpic->sync_entropy );
+  RESTORE_PTR( vpic->inject_entropy );
   RESTORE_PTR( vpic->grid );
   RESTORE_FPTR( vpic->material_list );
   RESTORE_FPTR( vpic->field_array );
@@ -54,6 +57,9 @@ restore_vpic_simulation( void ) {
   RESTORE_FPTR( vpic->particle_bc_list );
   RESTORE_FPTR( vpic->emitter_list );
   RESTORE_FPTR( vpic->collision_op_list );
+  RESTORE_FPTR( vpic->tracer_list );
+  vpic->dump_stage     = NULL;
+  vpic->max_dump_stage = 0;
   return vpic;
 }
 
@@ -68,6 +74,7 @@ reanimate_vpic_simulation( vpic_simulation * vpic ) {
   REANIMATE_FPTR( vpic->particle_bc_list );
   REANIMATE_FPTR( vpic->emitter_list );
   REANIMATE_FPTR( vpic->collision_op_list );
+  REANIMATE_FPTR( vpic->tracer_list );
 }
 
 
@@ -101,8 +108,9 @@ vpic_simulation::vpic_simulation() {
 
   n_rng++; 
 
-  entropy      = new_rng_pool( n_rng, 0, 0 );
-  sync_entropy = new_rng_pool( n_rng, 0, 1 );
+  entropy        = new_rng_pool( n_rng, 0, 0 );
+  sync_entropy   = new_rng_pool( n_rng, 0, 1 );
+  inject_entropy = new_rng_pool( n_rng, 0, 0 );
   grid = new_grid();
 
   REGISTER_OBJECT( this, checkpt_vpic_simulation,
@@ -111,6 +119,8 @@ vpic_simulation::vpic_simulation() {
  
 vpic_simulation::~vpic_simulation() {
   UNREGISTER_OBJECT( this );
+  FREE_ALIGNED( dump_stage );
+  delete_tracer_list( tracer_list );
   delete_emitter_list( emitter_list );
   delete_particle_bc_list( particle_bc_list );
   delete_species_list( species_list );
@@ -120,6 +130,7 @@ vpic_simulation::~vpic_simulation() {
   delete_field_array( field_array );
   delete_material_list( material_list );
   delete_grid( grid );
+  delete_rng_pool( inject_entropy );
   delete_rng_pool( sync_entropy );
   delete_rng_pool( entropy );
 }
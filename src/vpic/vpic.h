@@ -117,12 +117,98 @@ struct DumpParameters {
 
 }; // struct DumpParameters
 
+/*----------------------------------------------------------------------------
+ * Particle tracers
+----------------------------------------------------------------------------*/
+
+// Every interval steps, a tracer records the time centered state of
+// the particles of a tagged species accepted by its particle_select_t
+// (a tag range and/or a sample fraction give a fixed set of particles
+// to follow).  Records are buffered in memory and appended to
+// "<fbase>.<rank>" in batches of max_buf records.  The file is a plain
+// array of tracer_record_t.
+
+typedef struct tracer_record {
+  int64_t tag;      // Particle tag
+  int64_t step;     // Step when the state was recorded
+  float x, y, z;    // Particle position (global coordinates)
+  float ux, uy, uz; // Particle normalized momentum (time centered)
+  float w;          // Particle weight
+  int32_t pad;      // Pad to 48 bytes
+} tracer_record_t;
+
+typedef struct tracer {
+  species_t * sp;          // Species traced (must be tagged)
+  char * fname;            // Output file for this rank
+  int interval;            // Record every interval steps
+  particle_select_t sel;   // Particles to record
+  tracer_record_t * buf;   // Buffered records
+  int nbuf, max_buf;       // Number of and max buffered records
+  int64_t n_written;       // Records already written to fname
+  int synced;              // Is fname known to hold n_written records
+  particle_t * p_buf;      // Scratch hunk of the particle list and the
+  int64_t * t_buf;         // tags kept from it (not checkpointed)
+  struct tracer * next;    // Next tracer in the list
+} tracer_t;
+
+void
+delete_tracer_list( tracer_t * tracer_list );
+
+/*----------------------------------------------------------------------------
+ * Region masks
+----------------------------------------------------------------------------*/
+
+// A region predicate returns nonzero if the point (x,y,z) (in global
+// coordinates) is inside the region.  A region field function returns
+// field component c (0-5 for ex, ey, ez, bx, by, bz) at the point.  Both
+// are called from the pipelines, so they must be thread safe.
+
+typedef int
+(*region_func_t)( void * params, double x, double y, double z );
+
+typedef double
+(*region_field_func_t)( void * params, int c, double x, double y, double z );
+
+// A region mask holds the value of a region predicate at the cell
+// centers of a local domain.  The regular region helpers look at the
+// neighbors of the ghost cells too, so the mask covers cells -1:n+1 in
+// each direction.  A mask can be used any number of times on the domain
+// it was made for.
+
+typedef struct region_mask {
+  uint8_t * m;      // m[ (i+1) + sx*( (j+1) + sy*(k+1) ) ]
+  int nx, ny, nz;   // Local domain resolution
+  int sx, sy, sz;   // nx+3, ny+3, nz+3
+} region_mask_t;
+
+region_mask_t *
+new_region_mask( const grid_t * g,
+                 region_func_t rgn,
+                 void * params );
+
+void
+delete_region_mask( region_mask_t * rm );
+
 class vpic_simulation {
 public:
   vpic_simulation();
   ~vpic_simulation();
+
+  // Simulations restored from a checkpt are allocated with MALLOC (see
+  // restore_vpic_simulation), so new and delete must use it too.
+  static void * operator new( size_t sz ) {
+    char * p;
+    MALLOC( p, sz );
+    return p;
+  }
+  static void operator delete( void * p ) {
+    char * q = (char *)p;
+    FREE( q );
+  }
+
   void initialize( int argc, char **argv );
   void modify( const char *fname );
+  void restore_remap( const char *fbase, int argc, char **argv );
   int advance( void );
   void finalize( void );
 
@@ -182,6 +268,7 @@ protected:
 
   rng_pool_t           * entropy;            // Local entropy pool
   rng_pool_t           * sync_entropy;       // Synchronous entropy pool
+  rng_pool_t           * inject_entropy;     // inject_particles generators
   grid_t               * grid;               // define_*_grid et al
   material_t           * material_list;      // define_material
   field_array_t        * field_array;        // define_field_array
@@ -195,6 +282,19 @@ protected:
   emitter_t            * emitter_list;       // define_emitter /
                                              // emitter helpers
   collision_op_t       * collision_op_list;  // collision helpers
+  tracer_t             * tracer_list;        // define_tracer
+
+  // Set while restore_remap runs the deck.  The particles the deck would
+  // load are replaced by the remapped ones, so inject_particle(s) skip
+  // them.
+
+  int remapping;
+
+  // Staging buffer of the banded and strided dumps (see dump.cc).  Not
+  // checkpointed.
+
+  uint32_t * ALIGNED(128) dump_stage;
+  size_t max_dump_stage;
 
   // User defined checkpt preserved variables
   // Note: user_global is aliased with user_global_t (see deck_wrapper.cxx)
@@ -220,6 +320,11 @@ protected:
     SystemRAM::print_available();
   } // print_available_ram
 
+  // Memory in use and high water marks per subsystem (collective)
+  void print_memory_usage() {
+    arena_report( rank()==0 );
+  } // print_memory_usage
+
   ///////////////
   // Dump helpers
 
@@ -239,6 +344,23 @@ protected:
   void dump_particles( const char *sp_name, const char *fbase,
                        int fname_tag = 1 );
 
+  // Dump only the particles accepted by sel.  The file has the same
+  // layout as a full particle dump followed by two int64_t trailer
+  // values: the number of local particles examined and the number
+  // written (for normalizing sampled data).  Returns the global
+  // number of particles written.
+  int64_t dump_particles( const char *sp_name, const char *fbase,
+                          const particle_select_t & sel,
+                          int fname_tag = 1 );
+
+  // Particle tracers (see tracer.cc).  trace_particles is called by
+  // advance every step and flush_tracers by finalize.
+  tracer_t * define_tracer( const char *sp_name, const char *fbase,
+                            int interval, const particle_select_t & sel,
+                            int max_buf = 16384 );
+  void trace_particles( void );
+  void flush_tracers( void );
+
   // convenience functions for simlog output
   void create_field_list(char * strlist, DumpParameters & dumpParams);
   void create_hydro_list(char * strlist, DumpParameters & dumpParams);
@@ -398,6 +520,37 @@ protected:
     set_pbc( grid, boundary, pbc );
   }
 
+  /////////////////
+  // Region helpers
+
+  // These apply a region mask (see new_region_mask) the way the regular
+  // region macros in deck/wrapper.h describe.  Each runs on the
+  // pipelines.
+
+  void
+  set_mask_material( const region_mask_t * rm,
+                     material_id vmat,
+                     material_id smat );
+
+  void
+  set_mask_field( const region_mask_t * rm,
+                  region_field_func_t eqn,
+                  void * params );
+
+  void
+  set_mask_bc( const region_mask_t * rm,
+               int64_t vpbc,
+               int64_t ipbc,
+               int64_t epbc );
+
+  void
+  define_mask_volume_emitter( emitter_t * e,
+                              const region_mask_t * rm );
+
+  void
+  define_mask_surface_emitter( emitter_t * e,
+                               const region_mask_t * rm );
+
   ///////////////////
   // Material helpers
 
@@ -493,11 +646,11 @@ protected:
                   double sort_out_of_place ) {
     // Compute a reasonble number of movers if user did not specify
     // Based on the twice the number of particles expected to hit the boundary
-    // of a wpdt=0.2 / dx=lambda species in a 3x3x3 domain
+    // of a wpdt=0.2 / dx=lambda species in a 3x3x3 domain.  (advance_p grows
+    // the movers if they run out, so this need not be generous.)
     if( max_local_nm<0 ) {
       max_local_nm = 2*max_local_np/25;
-      if( max_local_nm<16*(MAX_PIPELINE+1) )
-        max_local_nm = 16*(MAX_PIPELINE+1);
+      if( max_local_nm<64 ) max_local_nm = 64;
     }
     return append_species( species( name, (float)q, (float)m,
                                     (size_t)max_local_np, (size_t)max_local_nm,
@@ -544,6 +697,7 @@ protected:
     particle_t * RESTRICT p = sp->p + (sp->np++);
     p->dx = dx; p->dy = dy; p->dz = dz; p->i = i;
     p->ux = ux; p->uy = uy; p->uz = uz; p->w = w;
+    TAG_NEW_PARTICLE( sp, sp->np-1 );
   }
 
   // This variant does a raw inject and moves the particles
@@ -558,11 +712,36 @@ protected:
     particle_mover_t * RESTRICT pm = sp->pm + sp->nm;
     p->dx = dx; p->dy = dy; p->dz = dz; p->i = i;
     p->ux = ux; p->uy = uy; p->uz = uz; p->w = w;
+    TAG_NEW_PARTICLE( sp, sp->np-1 );
     pm->dispx = dispx; pm->dispy = dispy; pm->dispz = dispz; pm->i = sp->np-1;
     if( update_rhob ) accumulate_rhob( field_array->f, p, grid, -sp->q );
     sp->nm += move_p( sp->p, pm, accumulator_array->a, grid, sp->q );
   }
 
+  // Bulk injection.  The first variant injects a list of particles
+  // (in global coordinates, as inject_particle takes them).  The second
+  // runs a particle generator over n slots (see inject_p) with random
+  // numbers drawn from the substreams of stream of the entropy pool
+  // seed; calls in the same step should use different non-negative
+  // streams (the negative ones belong to the operators that draw from
+  // entropy, see rng_pool_stream).  Both
+  // inject in parallel, and in slot order, and return the number of
+  // particles injected locally.
+
+  int
+  inject_particles( species_t * sp,
+                    const particle_load_t * pl,
+                    int n,
+                    int update_rhob = 1 );
+
+  int
+  inject_particles( species_t * sp,
+                    particle_generator_func_t gen,
+                    void * params,
+                    int n,
+                    int stream,
+                    int update_rhob = 1 );
+
   //////////////////////////////////
   // Random number generator helpers
 
@@ -594,6 +773,22 @@ protected:
     return mu + sigma*drandn( rng );
   }
 
+  // Mass production variants of the above.  These fill x[0:n-1] and
+  // are much faster per number (especially normal_fill), so particle
+  // loaders should draw the numbers for a batch of particles with these
+  // before injecting them.
+  inline void uniform_fill( rng_t * rng, double low, double high,
+                            double * x, int n ) {
+    drand_fill( rng, x, 1, n );
+    for( int i=0; i<n; i++ ) x[i] = low*(1-x[i]) + high*x[i];
+  }
+
+  inline void normal_fill( rng_t * rng, double mu, double sigma,
+                           double * x, int n ) {
+    drandn_fill( rng, x, 1, n );
+    for( int i=0; i<n; i++ ) x[i] = mu + sigma*x[i];
+  }
+
   /////////////////////////////////
   // Emitter and particle bc helpers
 
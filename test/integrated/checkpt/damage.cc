@@ -0,0 +1,39 @@
+// Damage a checkpt for the checkpt tests.  "truncate src dst" copies
+// the first half of src to dst (like the partial copy an interrupted
+// drain leaves behind).  "flip src dst" copies src to dst with the
+// bits of one byte three quarters of the way in (in the bulk of the
+// array data) inverted.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+int
+main( int argc,
+      char ** argv ) {
+  if( argc!=4 || ( strcmp( argv[1], "truncate" ) &&
+                    strcmp( argv[1], "flip" ) ) ) {
+    fprintf( stderr, "Usage: %s truncate|flip <src> <dst>\n", argv[0] );
+    return 1;
+  }
+
+  FILE * in = fopen( argv[2], "rb" );
+  if( !in ) { fprintf( stderr, "Unable to read \"%s\"\n", argv[2] ); return 1; }
+  std::vector<char> buf;
+  char chunk[65536];
+  size_t n;
+  while( (n = fread( chunk, 1, sizeof(chunk), in ))>0 )
+    buf.insert( buf.end(), chunk, chunk+n );
+  fclose( in );
+
+  if( !strcmp( argv[1], "truncate" ) ) buf.resize( buf.size()/2 );
+  else if( !buf.empty() )              buf[ 3*(buf.size()/4) ] ^= 0xff;
+
+  FILE * out = fopen( argv[3], "wb" );
+  if( !out ) { fprintf( stderr, "Unable to write \"%s\"\n", argv[3] ); return 1; }
+  if( !buf.empty() && fwrite( &buf[0], 1, buf.size(), out )!=buf.size() ) {
+    fprintf( stderr, "Unable to write \"%s\"\n", argv[3] ); return 1;
+  }
+  fclose( out );
+  return 0;
+}
@@ -1,6 +1,3 @@
-// FIXME: PARTICLE MOVERS NEED TO BE OVERALLOCATED IN STRUCTORS TO
-// ACCOUNT FOR SPLITTING THE MOVER ARRAY BETWEEN HOST AND PIPELINES
-
 #define IN_spa
 #include "src/species_advance/standard/pipeline/spa_private.h"
 #include "src/util/pipelines/pipelines_exec.h"
@@ -16,6 +13,7 @@ advance_p2_pipeline_scalar( advance_p_pipeline_args_t * args,
 
     particle_t           * ALIGNED(32)  p;
     particle_mover_t     * ALIGNED(16)  pm;
+    particle_mover_seg_t *              seg;
     const interpolator_t * ALIGNED(16)  f;
     float                * ALIGNED(16)  a;
 
@@ -41,20 +39,12 @@ advance_p2_pipeline_scalar( advance_p_pipeline_args_t * args,
     DISTRIBUTE( args->np, 16, pipeline_rank, n_pipeline, itmp, n );
     p = args->p0 + itmp;
 
-    // Determine which movers are reserved for this pipeline
-    // Movers (16 bytes) should be reserved for pipelines in at least
-    // multiples of 8 such that the set of particle movers reserved for
-    // a pipeline is 128-byte aligned and a multiple of 128-byte in
-    // size.  The host is guaranteed to get enough movers to process its
-    // particles with this allocation.
-
-    max_nm = args->max_nm - (args->np&15);
-    if( max_nm<0 ) max_nm = 0;
-    DISTRIBUTE( max_nm, 8, pipeline_rank, n_pipeline, itmp, max_nm );
-    if( pipeline_rank==n_pipeline ) max_nm = args->max_nm - itmp;
-    pm   = args->pm + itmp;
-    nm   = 0;
-    int ignore = 0;
+    // Movers are taken from the shared pool as needed (see next_movers)
+
+    seg    = args->seg + pipeline_rank;
+    pm     = seg->pm;
+    nm     = 0;
+    max_nm = 0;
 
     // Determine which accumulator array to use
     // The host gets the first accumulator array
@@ -178,21 +168,19 @@ advance_p2_pipeline_scalar( advance_p_pipeline_args_t * args,
             local_pm->i = i + itmp; //p_ - p0;
 
             if( move_p( p0, local_pm, a0, g, qsp ) ) { // Unlikely
-                if( nm<max_nm ) {
-                    pm[nm++] = local_pm[0];
-                }
-                else {
-                    ignore++;                 // Unlikely
+                if( nm==max_nm ) {            // Unlikely
+                    seg->nm = nm;
+                    pm      = next_movers( args, seg );
+                    nm      = seg->nm;
+                    max_nm  = seg->max_nm;
                 } // if
+                pm[nm++] = local_pm[0];
             } // if
         }
 
     }
 
-    args->seg[pipeline_rank].pm        = pm;
-    args->seg[pipeline_rank].max_nm    = max_nm;
-    args->seg[pipeline_rank].nm        = nm;
-    args->seg[pipeline_rank].n_ignored = ignore;
+    seg->nm = nm;
 }
 
 void
@@ -201,7 +189,7 @@ advance_p2( /**/  species_t            * RESTRICT sp,
         const interpolator_array_t * RESTRICT ia ) {
     DECLARE_ALIGNED_ARRAY( advance_p_pipeline_args_t, 128, args, 1 );
     DECLARE_ALIGNED_ARRAY( particle_mover_seg_t, 128, seg, MAX_PIPELINE+1 );
-    int rank;
+    DECLARE_ALIGNED_ARRAY( int, 128, next_block, 1 );
 
     if( !sp || !aa || !ia || sp->g!=aa->g || sp->g!=ia->g )
         ERROR(( "Bad args" ));
@@ -212,6 +200,7 @@ advance_p2( /**/  species_t            * RESTRICT sp,
     args->f0       = ia->i;
     args->seg      = seg;
     args->g        = sp->g;
+    args->next_block = next_block;
 
     args->qdt_2mc  = (sp->q*sp->g->dt)/(2*sp->m*sp->g->cvac);
     args->cdt_dx   = sp->g->cvac*sp->g->dt*sp->g->rdx;
@@ -236,20 +225,8 @@ advance_p2( /**/  species_t            * RESTRICT sp,
     // However, it is worth reconsidering this at some point in the
     // future.
 
+    begin_movers( sp, args );
     EXEC_PIPELINES( advance_p2, args, 0 );
     WAIT_PIPELINES();
-
-    // FIXME: HIDEOUS HACK UNTIL BETTER PARTICLE MOVER SEMANTICS
-    // INSTALLED FOR DEALING WITH PIPELINES.  COMPACT THE PARTICLE
-    // MOVERS TO ELIMINATE HOLES FROM THE PIPELINING.
-
-    sp->nm = 0;
-    for( rank=0; rank<=N_PIPELINE; rank++ ) {
-        if( args->seg[rank].n_ignored )
-            WARNING(( "Pipeline %i ran out of storage for %i movers",
-                        rank, args->seg[rank].n_ignored ));
-        if( sp->pm+sp->nm != args->seg[rank].pm )
-            MOVE( sp->pm+sp->nm, args->seg[rank].pm, args->seg[rank].nm );
-        sp->nm += args->seg[rank].nm;
-    }
+    end_movers( sp, args );
 }
@@ -0,0 +1,126 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main()
+#include "catch.hpp"
+
+#include "src/species_advance/species_advance.h"
+#include "src/vpic/vpic.h"
+
+void vpic_simulation::user_diagnostics() {}
+
+void
+vpic_simulation::user_initialization( int num_cmdline_arguments,
+                                      char ** cmdline_argument )
+{
+  // Fast particles in a small absorbing box leave many movers.  The
+  // same particles are advanced in species with enough movers and with
+  // so few that the pipelines run out of mover blocks (or get none)
+  // and overflow.  Every species has to end up with the same movers,
+  // in particle order.
+
+  int npart = 20000;
+  float vt  = 2.0;
+
+  define_units( 1, 1 );
+  define_timestep( 0.5 );
+  define_absorbing_grid( 0, 0, 0,   // Grid low corner
+                         4, 4, 4,   // Grid high corner
+                         4, 4, 4,   // Grid resolution
+                         1, 1, 1,   // Processor configuration
+                         absorb_particles );
+  define_material( "vacuum", 1.0, 1.0, 0.0 );
+  define_field_array();
+
+  const int n_sp = 4;
+  const int max_nm[ n_sp ] = { npart, 1, 100, 3*64 + 5 };
+  species_t * sp[ n_sp ];
+
+  for( int s = 0; s < n_sp; s++ )
+  {
+    char name[16];
+    sprintf( name, "electron%i", s );
+    sp[s] = define_species( name, -1., 1., npart, max_nm[s], 0, 0 );
+  }
+
+  for( int n = 0; n < npart; n++ )
+  {
+    inject_particle( sp[0], uniform( rng(0), 0, 4 ),
+                            uniform( rng(0), 0, 4 ),
+                            uniform( rng(0), 0, 4 ),
+                            normal( rng(0), 0, vt ),
+                            normal( rng(0), 0, vt ),
+                            normal( rng(0), 0, vt ), 1, 0, 0 );
+  }
+
+  REQUIRE( sp[0]->nm == 0 );
+
+  for( int s = 1; s < n_sp; s++ )
+  {
+    COPY( sp[s]->p, sp[0]->p, npart );
+    sp[s]->np = npart;
+  }
+
+  load_interpolator_array( interpolator_array, field_array );
+
+  for( int s = 0; s < n_sp; s++ )
+  {
+    clear_accumulator_array( accumulator_array );
+    advance_p( sp[s], accumulator_array, interpolator_array );
+
+    INFO( sp[s]->name << ": " << sp[s]->nm << " movers (max_nm "
+          << max_nm[s] << " -> " << sp[s]->max_nm << ")" );
+
+    REQUIRE( sp[s]->nm <= sp[s]->max_nm );
+
+    for( int m = 1; m < sp[s]->nm; m++ )
+    {
+      REQUIRE( sp[s]->pm[m-1].i < sp[s]->pm[m].i );
+    }
+  }
+
+  // Enough movers that every pipeline overflows in the smaller species
+
+  REQUIRE( sp[0]->nm > 8*64 );
+
+  for( int s = 1; s < n_sp; s++ )
+  {
+    REQUIRE( sp[s]->nm == sp[0]->nm );
+    REQUIRE( memcmp( sp[s]->pm, sp[0]->pm,
+                     sp[0]->nm*sizeof(particle_mover_t) ) == 0 );
+    REQUIRE( memcmp( sp[s]->p, sp[0]->p, npart*sizeof(particle_t) ) == 0 );
+  }
+
+  // The particles of the movers are left on the boundary faces (see
+  // boundary_p), so drop the particles before the rest of initialize.
+
+  for( int s = 0; s < n_sp; s++ )
+  {
+    sp[s]->np = 0;
+    sp[s]->nm = 0;
+  }
+}
+
+TEST_CASE( "advance_p keeps the movers of overflowing pipelines in order",
+           "[advance_p]" )
+{
+  // Run with several pipelines so that they compete for the mover
+  // blocks and overflow at different points.
+
+  int pargc = 3;
+  char str0[] = "bin/vpic";
+  char str1[] = "--tpp";
+  char str2[] = "3";
+  char **pargv = (char **) malloc( (pargc+1)*sizeof(char *) );
+  pargv[0] = str0;
+  pargv[1] = str1;
+  pargv[2] = str2;
+  pargv[3] = NULL;
+  boot_services( &pargc, &pargv );
+
+  vpic_simulation* simulation = new vpic_simulation;
+  simulation->initialize( pargc, pargv );
+
+  simulation->finalize();
+  delete simulation;
+  if( world_rank==0 ) log_printf( "normal exit\n" );
+
+  halt_mp();
+}
@@ -0,0 +1,194 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main()
+#include "catch.hpp"
+
+#include "src/species_advance/species_advance.h"
+#include "src/boundary/boundary.h"
+#include "src/vpic/vpic.h"
+
+void vpic_simulation::user_diagnostics() {}
+
+void
+vpic_simulation::user_initialization( int num_cmdline_arguments,
+                                      char ** cmdline_argument )
+{
+  // Particles that strike the x walls are refluxed and those that strike
+  // the others are absorbed and tallied.  Both of these run on the
+  // pipelines in boundary_p.
+
+  int npart = 20000;
+  float vt  = 1.0;
+
+  define_units( 1, 1 );
+  define_timestep( 0.5 );
+  define_absorbing_grid( 0, 0, 0,   // Grid low corner
+                         8, 6, 5,   // Grid high corner
+                         8, 6, 5,   // Grid resolution
+                         1, 1, 1,   // Processor configuration
+                         absorb_particles );
+  define_material( "vacuum", 1.0, 1.0, 0.0 );
+  define_field_array();
+
+  species_t * sp =
+    define_species( "electron", -1., 1., npart, npart, 0, 0 );
+
+  tag_species( sp );
+
+  particle_bc_t * reflux =
+    define_particle_bc( maxwellian_reflux( species_list, entropy ) );
+  particle_bc_t * tally =
+    define_particle_bc( absorb_tally( species_list, field_array ) );
+
+  set_reflux_temp( reflux, sp, vt, vt );
+
+  set_domain_particle_bc( BOUNDARY(-1, 0, 0), get_particle_bc_id( reflux ) );
+  set_domain_particle_bc( BOUNDARY( 1, 0, 0), get_particle_bc_id( reflux ) );
+  set_domain_particle_bc( BOUNDARY( 0,-1, 0), get_particle_bc_id( tally  ) );
+  set_domain_particle_bc( BOUNDARY( 0, 1, 0), get_particle_bc_id( tally  ) );
+  set_domain_particle_bc( BOUNDARY( 0, 0,-1), get_particle_bc_id( tally  ) );
+  set_domain_particle_bc( BOUNDARY( 0, 0, 1), get_particle_bc_id( tally  ) );
+
+  for( int n = 0; n < npart; n++ )
+  {
+    inject_particle( sp, uniform( rng(0), 0, 8 ),
+                         uniform( rng(0), 0, 6 ),
+                         uniform( rng(0), 0, 5 ),
+                         normal( rng(0), 0, vt ),
+                         normal( rng(0), 0, vt ),
+                         normal( rng(0), 0, vt ), 1, 0, 0 );
+  }
+
+  load_interpolator_array( interpolator_array, field_array );
+
+  particle_t * p_start;
+  int64_t * t_start;
+  float * rhob;
+  MALLOC( p_start, npart );
+  MALLOC( t_start, npart );
+  MALLOC( rhob, grid->nv );
+
+  COPY( p_start, sp->p, npart );
+  COPY( t_start, sp->tag, npart );
+
+  int np_ref = 0;
+  particle_t * p_ref;
+  MALLOC( p_ref, npart );
+
+  for( int pass = 0; pass < 2; pass++ )
+  {
+    // The second pass starts over from the same particles and step and
+    // has to reflux them the same way.  (It is kept short enough that
+    // boundary_p does not shrink the particle storage.)
+
+    COPY( sp->p, p_start, npart );
+    COPY( sp->tag, t_start, npart );
+    sp->np = npart;
+    sp->nm = 0;
+    grid->step = 0;
+
+    int n_lost = 0, n_tally = get_absorb_tally( tally )[ sp->id ];
+
+    for( int step = 0; step < 4; step++ )
+    {
+      clear_accumulator_array( accumulator_array );
+      advance_p( sp, accumulator_array, interpolator_array );
+
+      // The charge the absorbed movers should leave behind.
+
+      float max_rho = 0, max_err = 0;
+
+      for( int v = 0; v < grid->nv; v++ )
+      {
+        rhob[v] = field_array->f[v].rhob;
+      }
+
+      int np = sp->np;
+
+      for( int round = 0; round < 4 && sp->nm; round++ )
+      {
+        for( int m = 0; m < sp->nm; m++ )
+        {
+          particle_t p = sp->p[ sp->pm[m].i ];
+          int face = p.i & 7;
+
+          p.i >>= 3;
+
+          if( face % 3 ) accumulate_rhob_array( rhob, &p, grid, sp->q );
+        }
+
+        boundary_p( particle_bc_list, species_list,
+                    field_array, accumulator_array );
+      }
+
+      n_lost += np - sp->np;
+
+      for( int v = 0; v < grid->nv; v++ )
+      {
+        float err = fabs( field_array->f[v].rhob - rhob[v] );
+
+        if( max_rho < fabs( rhob[v] ) ) max_rho = fabs( rhob[v] );
+        if( max_err < err             ) max_err = err;
+      }
+
+      REQUIRE( sp->nm == 0 );
+      REQUIRE( get_absorb_tally( tally )[ sp->id ] - n_tally == n_lost );
+      REQUIRE( max_err <= 1e-5*max_rho );
+
+      grid->step++;
+    }
+
+    INFO( "pass " << pass << ": " << n_lost << " particles absorbed, "
+          << sp->np << " left" );
+
+    REQUIRE( n_lost > 0 );
+    REQUIRE( sp->np > npart/4 );
+
+    for( int n = 0; n < sp->np; n++ )
+    {
+      REQUIRE( sp->p[n].i >= 0 );
+      REQUIRE( sp->p[n].i < grid->nv );
+    }
+
+    if( pass == 0 )
+    {
+      np_ref = sp->np;
+      COPY( p_ref, sp->p, sp->np );
+    }
+
+    else
+    {
+      REQUIRE( sp->np == np_ref );
+      REQUIRE( memcmp( sp->p, p_ref, np_ref*sizeof(particle_t) ) == 0 );
+    }
+  }
+
+  FREE( p_ref );
+  FREE( rhob );
+  FREE( t_start );
+  FREE( p_start );
+}
+
+TEST_CASE( "pipelined custom particle boundaries", "[boundary_p]" )
+{
+  // Run with several pipelines so that the per-pipeline injectors, rhob
+  // arrays and tallies and their merge are exercised.
+
+  int pargc = 3;
+  char str0[] = "bin/vpic";
+  char str1[] = "--tpp";
+  char str2[] = "3";
+  char **pargv = (char **) malloc( (pargc+1)*sizeof(char *) );
+  pargv[0] = str0;
+  pargv[1] = str1;
+  pargv[2] = str2;
+  pargv[3] = NULL;
+  boot_services( &pargc, &pargv );
+
+  vpic_simulation* simulation = new vpic_simulation;
+  simulation->initialize( pargc, pargv );
+
+  simulation->finalize();
+  delete simulation;
+  if( world_rank==0 ) log_printf( "normal exit\n" );
+
+  halt_mp();
+}
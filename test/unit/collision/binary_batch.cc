@@ -0,0 +1,273 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main()
+#include "catch.hpp"
+
+#include "src/species_advance/species_advance.h"
+#include "src/collision/pipeline/binary_batch.h"
+#include "src/vpic/vpic.h"
+
+void vpic_simulation::user_diagnostics() {}
+
+// The SIMD kernels binary_batch.cc uses
+
+#if defined(V16_ACCELERATION)
+# define SIMD(name) name##_v16
+#elif defined(V8_ACCELERATION)
+# define SIMD(name) name##_v8
+#elif defined(V4_ACCELERATION)
+# define SIMD(name) name##_v4
+#else
+# define SIMD(name) name##_scalar
+#endif
+
+static float
+max_rel_err( const float * a,
+             const float * b,
+             int n )
+{
+  float err = 0, max_b = 0;
+
+  for( int c = 0; c < n; c++ )
+  {
+    if ( err   < fabs( a[c] - b[c] ) ) err   = fabs( a[c] - b[c] );
+    if ( max_b < fabs( b[c] )        ) max_b = fabs( b[c] );
+  }
+
+  return err / max_b;
+}
+
+static void
+sum_momentum( const species_t * sp,
+              double * m )
+{
+  const particle_t * p = sp->p;
+
+  for( int i = 0; i < 5; i++ ) m[i] = 0;
+
+  for( int n = 0; n < sp->np; n++ )
+  {
+    m[0] += p[n].w*p[n].ux;
+    m[1] += p[n].w*p[n].uy;
+    m[2] += p[n].w*p[n].uz;
+    m[3] += p[n].w*( p[n].ux*p[n].ux + p[n].uy*p[n].uy + p[n].uz*p[n].uz );
+    m[4] += p[n].w*sqrt( p[n].ux*p[n].ux + p[n].uy*p[n].uy +
+                         p[n].uz*p[n].uz );
+  }
+}
+
+void
+vpic_simulation::user_initialization( int num_cmdline_arguments,
+                                      char ** cmdline_argument )
+{
+  int npart = 4000;
+  float vt  = 0.1;
+
+  define_units( 1, 1 );
+  define_timestep( 0.5 );
+  define_periodic_grid( 0, 0, 0,   // Grid low corner
+                        4, 4, 4,   // Grid high corner
+                        4, 4, 4,   // Grid resolution
+                        1, 1, 1 ); // Processor configuration
+  define_material( "vacuum", 1.0, 1.0, 0.0 );
+  define_field_array();
+
+  species_t * sp =
+    define_species( "test_species", 1., 1., npart, npart, 0, 0 );
+
+  for( int i = 0; i < npart; i++ )
+  {
+    inject_particle( sp,
+                     uniform( rng(0), 0, 4 ),
+                     uniform( rng(0), 0, 4 ),
+                     uniform( rng(0), 0, 4 ),
+                     normal( rng(0), 0, vt ),
+                     normal( rng(0), 0, vt ),
+                     normal( rng(0), 0, vt ), 1., 0., 0 );
+  }
+
+  // Some particles with momenta along the axes and with equal
+  // components to exercise the T vector selection.
+
+  for( int i = 0; i < 9; i++ )
+  {
+    sp->p[i].ux = ( i%3 == 0 ) ? vt : 0;
+    sp->p[i].uy = ( i%3 == 1 ) ? vt : 0;
+    sp->p[i].uz = ( i%3 == 2 ) ? vt : 0;
+  }
+
+  for( int i = 9; i < 12; i++ )
+  {
+    sp->p[i].ux = sp->p[i].uy = sp->p[i].uz = vt;
+  }
+
+  // Compare the SIMD kernels with the scalar ones on a batch whose
+  // size is not a multiple of the SIMD width.
+
+  DECLARE_ALIGNED_ARRAY( int,   64, k,  BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( int,   64, l,  BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( float, 64, K0, BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( float, 64, K1, BINARY_BATCH );
+  DECLARE_ALIGNED_ARRAY( binary_scatter_t, 64, s0, 1 );
+  DECLARE_ALIGNED_ARRAY( binary_scatter_t, 64, s1, 1 );
+
+  int n = BINARY_BATCH - 3;
+
+  for( int c = 0; c < BINARY_BATCH; c++ )
+  {
+    k[c] = c < 12 ? c : uirand( rng(0) ) % npart;
+    l[c] = c < 12 ? ( c + 3 ) % 12 : uirand( rng(0) ) % npart;
+  }
+
+  relative_speed_batch_scalar( sp->p, sp->p, k, l, 2., K0, n );
+  SIMD(relative_speed_batch)( sp->p, sp->p, k, l, 2., K1, n );
+
+  float err = max_rel_err( K1, K0, n );
+
+  INFO( "relative_speed_batch max error " << err );
+
+  REQUIRE( err <= 1e-6 );
+
+  for( int c = 0; c < BINARY_BATCH; c++ )
+  {
+    float bcs, bsn;
+
+    do {
+      bcs = 2*frand_c0( rng(0) ) - 1;
+      bsn = 2*frand_c0( rng(0) ) - 1;
+    } while( bcs*bcs + bsn*bsn >= 1 );
+
+    s0->urx[c] = sp->p[k[c]].ux - sp->p[l[c]].ux;
+    s0->ury[c] = sp->p[k[c]].uy - sp->p[l[c]].uy;
+    s0->urz[c] = sp->p[k[c]].uz - sp->p[l[c]].uz;
+    s0->bcs[c] = bcs;
+    s0->bsn[c] = bsn;
+  }
+
+  for( int pass = 0; pass < 2; pass++ )
+  {
+    *s1 = *s0;
+
+    if ( pass == 0 )
+    {
+      hard_sphere_transfer_scalar( s0, BINARY_BATCH );
+      SIMD(hard_sphere_transfer)( s1, BINARY_BATCH );
+    }
+
+    else
+    {
+      coulomb_transfer_scalar( s0, 0.7, BINARY_BATCH );
+      SIMD(coulomb_transfer)( s1, 0.7, BINARY_BATCH );
+    }
+
+    err = max_rel_err( s1->urx, s0->urx, BINARY_BATCH );
+    err = std::max( err, max_rel_err( s1->ury, s0->ury, BINARY_BATCH ) );
+    err = std::max( err, max_rel_err( s1->urz, s0->urz, BINARY_BATCH ) );
+
+    INFO( ( pass ? "coulomb" : "hard_sphere" )
+          << "_transfer max error " << err );
+
+    REQUIRE( err <= 1e-5 );
+  }
+
+  // The fluid rate constant kernels on contiguous particles
+
+  fluid_rate_constant_batch_scalar( sp->p+16, 0.01, -0.02, 0.03, vt*vt,
+                                    2.5, 0.3, 0.4, K0, BINARY_BATCH );
+  SIMD(fluid_rate_constant_batch)( sp->p+16, 0.01, -0.02, 0.03, vt*vt,
+                                   2.5, 0.3, 0.4, K1, BINARY_BATCH );
+
+  err = max_rel_err( K1, K0, BINARY_BATCH );
+
+  INFO( "fluid_rate_constant_batch max error " << err );
+
+  REQUIRE( err <= 1e-6 );
+
+  // Equal mass, equal weight elastic collisions conserve the total
+  // momentum and energy.  Apply a batched large_angle_coulomb model
+  // and check that they are conserved and that particles collided.
+
+  collision_op_t * lac = large_angle_coulomb( "lac", sp, sp, 0.15, entropy,
+                                              4, 1 );
+
+  double m0[5], m1[5];
+  int n_moved = 0;
+
+  sum_momentum( sp, m0 );
+
+  float * u0;
+  MALLOC( u0, npart );
+  sort_p( sp );
+  for( int i = 0; i < npart; i++ ) u0[i] = sp->p[i].ux;
+
+  apply_collision_op_list( lac );
+
+  for( int i = 0; i < npart; i++ ) n_moved += ( u0[i] != sp->p[i].ux );
+  FREE( u0 );
+
+  sum_momentum( sp, m1 );
+
+  double dp = sqrt( ( m1[0] - m0[0] )*( m1[0] - m0[0] ) +
+                    ( m1[1] - m0[1] )*( m1[1] - m0[1] ) +
+                    ( m1[2] - m0[2] )*( m1[2] - m0[2] ) ) / m0[4];
+  double de = fabs( m1[3] - m0[3] ) / m0[3];
+
+  INFO( n_moved << " particles collided, momentum error " << dp
+        << " energy error " << de );
+
+  REQUIRE( n_moved > npart/10 );
+  REQUIRE( dp <= 1e-5 );
+  REQUIRE( de <= 1e-5 );
+
+  // A model fused with the sort makes the same collisions as sorting
+  // and then applying the model.  Scramble the particles so the sort
+  // has work to do and run the model unfused and then fused (the same
+  // operator, so it draws the same random numbers) from the same state.
+
+  for( int i = npart - 1; i > 0; i-- )
+  {
+    int j = uirand( rng(0) ) % ( i + 1 );
+    particle_t t = sp->p[i]; sp->p[i] = sp->p[j]; sp->p[j] = t;
+  }
+
+  collision_op_t * lac_sep = large_angle_coulomb( "lacf", sp, sp, 0.15,
+                                                  entropy, 1, 1 );
+
+  particle_t * p0, * p1;
+  MALLOC( p0, npart );
+  MALLOC( p1, npart );
+  COPY( p0, sp->p, npart );
+
+  sp->last_sorted = -1;
+  apply_collision_op_list( lac_sep );
+  COPY( p1, sp->p, npart );
+
+  COPY( sp->p, p0, npart );
+  sp->last_sorted = -1;
+  collision_op_t * lac_fused = fuse_sort_binary_collision_model( lac_sep );
+  REQUIRE( sorted_by_collision_op_list( lac_fused, sp ) );
+  apply_collision_op_list( lac_fused );
+
+  REQUIRE( sp->last_sorted == sp->g->step );
+  REQUIRE( memcmp( p1, sp->p, npart*sizeof(particle_t) ) == 0 );
+
+  FREE( p1 );
+  FREE( p0 );
+}
+
+TEST_CASE( "batched binary collision kernels match the per-pair ones", "[collision]" )
+{
+  int pargc = 1;
+  char str0[] = "bin/vpic";
+  char **pargv = (char **) malloc( (pargc+1)*sizeof(char *) );
+  pargv[0] = str0;
+  pargv[1] = NULL;
+  boot_services( &pargc, &pargv );
+
+  vpic_simulation* simulation = new vpic_simulation;
+  simulation->initialize( pargc, pargv );
+
+  simulation->finalize();
+  delete simulation;
+  if( world_rank==0 ) log_printf( "normal exit\n" );
+
+  halt_mp();
+}
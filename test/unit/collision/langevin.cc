@@ -0,0 +1,136 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main()
+#include "catch.hpp"
+
+#define IN_collision
+#include "src/collision/pipeline/collision_pipeline.h"
+#include "src/vpic/vpic.h"
+
+void vpic_simulation::user_diagnostics() {}
+
+// The SIMD pipeline apply_langevin_pipeline uses
+
+#if defined(V16_ACCELERATION)
+# define SIMD(name) name##_v16
+#elif defined(V8_ACCELERATION)
+# define SIMD(name) name##_v8
+#elif defined(V4_ACCELERATION)
+# define SIMD(name) name##_v4
+#else
+# define SIMD(name) name##_scalar
+#endif
+
+// Apply n_rep steps of the pipeline to the particles of args (see
+// sample/bench/collision for the throughput of the pipelines)
+
+typedef void (*langevin_pipeline_func_t)( langevin_pipeline_args_t *,
+                                          int, int );
+
+static void
+run( langevin_pipeline_func_t pipeline,
+     langevin_pipeline_args_t * args,
+     int n_rep )
+{
+  for( int r = 0; r < n_rep; r++ )
+  {
+    args->step = r;
+    pipeline( args, 0, 1 );
+  }
+}
+
+void
+vpic_simulation::user_initialization( int num_cmdline_arguments,
+                                      char ** cmdline_argument )
+{
+  // Enough particles for several blocks and some left over in the last
+
+  int npart = 64*COLLISION_BLOCK + 37;
+  int n_rep = 100;
+
+  define_units( 1, 1 );
+  define_timestep( 0.5 );
+  define_periodic_grid( 0, 0, 0,   // Grid low corner
+                        4, 4, 4,   // Grid high corner
+                        4, 4, 4,   // Grid resolution
+                        1, 1, 1 ); // Processor configuration
+  define_material( "vacuum", 1.0, 1.0, 0.0 );
+  define_field_array();
+
+  species_t * sp0 =
+    define_species( "scalar", 1., 1., npart, npart, 0, 0 );
+  species_t * sp1 =
+    define_species( "simd",   1., 1., npart, npart, 0, 0 );
+
+  for( int i = 0; i < npart; i++ )
+  {
+    inject_particle( sp0,
+                     uniform( rng(0), 0, 4 ),
+                     uniform( rng(0), 0, 4 ),
+                     uniform( rng(0), 0, 4 ),
+                     normal( rng(0), 0, 0.1 ),
+                     normal( rng(0), 0, 0.1 ),
+                     normal( rng(0), 0, 0.1 ), 1., 0., 0 );
+  }
+
+  COPY( sp1->p, sp0->p, npart );
+  sp1->np = npart;
+
+  // Apply the scalar and SIMD pipelines to the same particles with
+  // the same rng substreams.
+
+  DECLARE_ALIGNED_ARRAY( langevin_pipeline_args_t, 128, args, 1 );
+
+  args->rng[0] = new_rng( 0 );
+  args->decay  = 0.9;
+  args->drive  = 0.05;
+  args->np     = npart;
+  args->seed   = 1;
+  args->stream = 2;
+
+  args->p = sp0->p;
+  run( langevin_pipeline_scalar, args, n_rep );
+
+  args->p = sp1->p;
+  run( SIMD(langevin_pipeline), args, n_rep );
+
+  delete_rng( args->rng[0] );
+
+  float err = 0, max_u = 0;
+  int n_bad = 0;
+
+  for( int i = 0; i < npart; i++ )
+  {
+    const particle_t * p0 = sp0->p + i, * p1 = sp1->p + i;
+
+    err = std::max( err, fabsf( p1->ux - p0->ux ) );
+    err = std::max( err, fabsf( p1->uy - p0->uy ) );
+    err = std::max( err, fabsf( p1->uz - p0->uz ) );
+    max_u = std::max( max_u, fabsf( p0->ux ) );
+
+    n_bad += ( p1->dx != p0->dx || p1->dy != p0->dy || p1->dz != p0->dz ||
+               p1->i  != p0->i  || p1->w  != p0->w );
+  }
+
+  INFO( "langevin_pipeline max error " << err/max_u );
+
+  REQUIRE( n_bad == 0 );
+  REQUIRE( err <= 1e-5*max_u );
+}
+
+TEST_CASE( "SIMD langevin pipelines match the scalar one", "[collision]" )
+{
+  int pargc = 1;
+  char str0[] = "bin/vpic";
+  char **pargv = (char **) malloc( (pargc+1)*sizeof(char *) );
+  pargv[0] = str0;
+  pargv[1] = NULL;
+  boot_services( &pargc, &pargv );
+
+  vpic_simulation* simulation = new vpic_simulation;
+  simulation->initialize( pargc, pargv );
+
+  simulation->finalize();
+  delete simulation;
+  if( world_rank==0 ) log_printf( "normal exit\n" );
+
+  halt_mp();
+}
@@ -0,0 +1,203 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main()
+#include "catch.hpp"
+
+#include "src/species_advance/species_advance.h"
+#include "src/vpic/vpic.h"
+
+void vpic_simulation::user_diagnostics() {}
+
+// A generator of uniformly distributed particles at rest.
+
+static int
+uniform_p( void * params,
+           int first,
+           int n,
+           particle_t * RESTRICT ALIGNED(32) p,
+           float * RESTRICT age,
+           rng_t * RESTRICT rng )
+{
+  const grid_t * g = (const grid_t *)params;
+
+  for( int k = 0; k < n; k++ )
+  {
+    p[k].dx = 2*frand_c0( rng ) - 1;
+    p[k].dy = 2*frand_c0( rng ) - 1;
+    p[k].dz = 2*frand_c0( rng ) - 1;
+    p[k].i  = VOXEL( 1 + uirand( rng ) % g->nx,
+                     1 + uirand( rng ) % g->ny,
+                     1 + uirand( rng ) % g->nz, g->nx, g->ny, g->nz );
+    p[k].ux = p[k].uy = p[k].uz = 0;
+    p[k].w  = 1;
+    age[k]  = 0;
+  }
+
+  return n;
+}
+
+void
+vpic_simulation::user_initialization( int num_cmdline_arguments,
+                                      char ** cmdline_argument )
+{
+  // Use a load size that is not a multiple of the injection block and
+  // put some of the load outside the domain so the compaction of the
+  // pipeline outputs is exercised.  The domain absorbs particles so
+  // aged particles that reach its walls leave movers (and the bulk
+  // species starts with too few movers for them).
+
+  int npart = 5003;
+  float vt  = 0.5;
+
+  define_units( 1, 1 );
+  define_timestep( 0.5 );
+  define_absorbing_grid( 0, 0, 0,   // Grid low corner
+                         8, 6, 5,   // Grid high corner
+                         8, 6, 5,   // Grid resolution
+                         1, 1, 1,   // Processor configuration
+                         absorb_particles );
+  define_material( "vacuum", 1.0, 1.0, 0.0 );
+  define_field_array();
+
+  species_t * sp0 =
+    define_species( "serial", -1., 1., npart, npart, 0, 0 );
+  species_t * sp1 =
+    define_species( "bulk",   -1., 1., npart, 16, 0, 0 );
+
+  tag_species( sp0 );
+  tag_species( sp1 );
+
+  particle_load_t * pl;
+  MALLOC( pl, npart );
+
+  for( int n = 0; n < npart; n++ )
+  {
+    pl[n].x   = uniform( rng(0), -1, 9 );
+    pl[n].y   = uniform( rng(0),  0, 6 );
+    pl[n].z   = uniform( rng(0),  0, 5 );
+    pl[n].ux  = normal( rng(0), 0, vt );
+    pl[n].uy  = normal( rng(0), 0, vt );
+    pl[n].uz  = normal( rng(0), 0, vt );
+    pl[n].w   = uniform( rng(0), 0.5, 1.5 );
+    pl[n].age = n%3 ? frand_c0( rng(0) ) : 0;
+  }
+
+  // Inject the load one particle at a time and in bulk and compare the
+  // particles, the movers and rhob.
+
+  float * rhob;
+  MALLOC( rhob, grid->nv );
+
+  for( int v = 0; v < grid->nv; v++ ) field_array->f[v].rhob = 0;
+
+  for( int n = 0; n < npart; n++ )
+  {
+    inject_particle( sp0, pl[n].x, pl[n].y, pl[n].z,
+                     pl[n].ux, pl[n].uy, pl[n].uz, pl[n].w, pl[n].age, 1 );
+  }
+
+  for( int v = 0; v < grid->nv; v++ )
+  {
+    rhob[v] = field_array->f[v].rhob;
+    field_array->f[v].rhob = 0;
+  }
+
+  int np = inject_particles( sp1, pl, npart );
+
+  REQUIRE( np == sp0->np );
+  REQUIRE( sp1->np == sp0->np );
+  REQUIRE( sp1->next_tag == sp0->next_tag );
+  REQUIRE( np > npart/2 );
+  REQUIRE( np < npart );
+
+  float max_err = 0, max_rho = 0;
+  int n_bad = 0;
+
+  for( int n = 0; n < np; n++ )
+  {
+    const particle_t * p0 = sp0->p + n;
+    const particle_t * p1 = sp1->p + n;
+
+    float err = std::max( std::max( fabs( p0->dx - p1->dx ),
+                                    fabs( p0->dy - p1->dy ) ),
+                          fabs( p0->dz - p1->dz ) );
+
+    if ( max_err < err ) max_err = err;
+
+    n_bad += p0->i != p1->i || p0->ux != p1->ux || p0->w != p1->w ||
+             sp0->tag[n] != sp1->tag[n];
+  }
+
+  INFO( np << " particles injected, max position error " << max_err
+        << ", " << sp0->nm << " and " << sp1->nm << " movers" );
+
+  REQUIRE( n_bad == 0 );
+  REQUIRE( max_err <= 1e-5 );
+  REQUIRE( sp0->nm > 0 );
+  REQUIRE( sp1->nm == sp0->nm );
+  REQUIRE( sp1->max_nm >= sp1->nm );
+
+  for( int m = 0; m < sp0->nm; m++ )
+  {
+    REQUIRE( sp1->pm[m].i == sp0->pm[m].i );
+  }
+
+  max_err = 0;
+
+  for( int v = 0; v < grid->nv; v++ )
+  {
+    float err = fabs( field_array->f[v].rhob - rhob[v] );
+
+    if ( max_rho < fabs( rhob[v] ) ) max_rho = fabs( rhob[v] );
+    if ( max_err < err             ) max_err = err;
+  }
+
+  INFO( "max |rhob| " << max_rho << " max error " << max_err );
+
+  REQUIRE( max_rho > 0 );
+  REQUIRE( max_err <= 1e-5*max_rho );
+
+  FREE( rhob );
+  FREE( pl );
+
+  // A generator run twice on the same stream and step makes the same
+  // particles.
+
+  sp0->np = sp1->np = 0;
+
+  REQUIRE( inject_particles( sp0, uniform_p, grid, 3001, 7, 0 ) == 3001 );
+  REQUIRE( inject_particles( sp1, uniform_p, grid, 3001, 7, 0 ) == 3001 );
+  REQUIRE( memcmp( sp0->p, sp1->p, 3001*sizeof(particle_t) ) == 0 );
+
+  // A different stream makes different ones.
+
+  sp1->np = 0;
+
+  inject_particles( sp1, uniform_p, grid, 3001, 8, 0 );
+
+  REQUIRE( memcmp( sp0->p, sp1->p, 3001*sizeof(particle_t) ) != 0 );
+}
+
+TEST_CASE( "bulk injection matches inject_particle", "[inject_p]" )
+{
+  // Run with several pipelines so that the per-pipeline outputs and
+  // their merge are exercised.
+
+  int pargc = 3;
+  char str0[] = "bin/vpic";
+  char str1[] = "--tpp";
+  char str2[] = "3";
+  char **pargv = (char **) malloc( (pargc+1)*sizeof(char *) );
+  pargv[0] = str0;
+  pargv[1] = str1;
+  pargv[2] = str2;
+  pargv[3] = NULL;
+  boot_services( &pargc, &pargv );
+
+  vpic_simulation* simulation = new vpic_simulation;
+  simulation->initialize( pargc, pargv );
+
+  simulation->finalize();
+  delete simulation;
+  if( world_rank==0 ) log_printf( "normal exit\n" );
+
+  halt_mp();
+}
@@ -0,0 +1,170 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main()
+#include "catch.hpp"
+
+#define IN_emitter
+#include "deck/wrapper.h"
+#include "src/emitter/emitter_private.h"
+
+void vpic_simulation::user_diagnostics() {}
+
+// A ball that cuts through the ghost cells on the low x side.
+
+#define BALL ( (x-1.5)*(x-1.5) + (y-4)*(y-4) + (z-3.2)*(z-3.2) < 2.6*2.6 )
+
+begin_initialization {
+
+  // The region macros run on the pipelines from a region mask.  Check
+  // what they set against the region evaluated directly at the cell
+  // centers the way the serial macros did.
+
+  define_units( 1, 1 );
+  define_timestep( 0.5 );
+  define_periodic_grid( 0, 0, 0,   // Grid low corner
+                        10, 8, 6,  // Grid high corner
+                        10, 8, 6,  // Grid resolution
+                        1, 1, 1 ); // Processor configuration
+  material_t * vacuum = define_material( "vacuum", 1.0 );
+  material_t * metal  = define_material( "metal",  1.0, 1.0, 1.0 );
+  material_t * skin   = define_material( "skin",   2.0 );
+  define_field_array();
+
+  species_t * sp = define_species( "electron", -1., 1., 100, 100, 0, 0 );
+
+  const int nx = grid->nx, ny = grid->ny, nz = grid->nz;
+  const double x0 = grid->x0, y0 = grid->y0, z0 = grid->z0;
+  const double dx = grid->dx, dy = grid->dy, dz = grid->dz;
+
+  // Is the center of cell (i,j,k) in the ball?
+
+  auto in = [&]( int i, int j, int k ) -> int {
+    double x = x0 + dx*(i-0.5), y = y0 + dy*(j-0.5), z = z0 + dz*(k-0.5);
+    return BALL;
+  };
+
+  const material_id mv = get_material_id( vacuum );
+  const material_id mm = get_material_id( metal  );
+  const material_id ms = get_material_id( skin   );
+
+  // Materials
+
+  set_region_material( BALL, metal, skin );
+
+  int n_in = 0;
+
+  for( int k=0; k<nz+2; k++ ) for( int j=0; j<ny+2; j++ ) for( int i=0; i<nx+2; i++ ) {
+    const field_t & f = field( i, j, k );
+    const int c = in(i,j,k), l = in(i-1,j,k), b = in(i,j-1,k), d = in(i,j,k-1);
+    const int lb = in(i-1,j-1,k), ld = in(i-1,j,k-1), bd = in(i,j-1,k-1);
+    const int lbd = in(i-1,j-1,k-1);
+    n_in += c;
+    REQUIRE( f.cmat  == ( c ? mm : mv ) );
+    REQUIRE( f.fmatx == ( c && l ? mm : c || l ? ms : mv ) );
+    REQUIRE( f.ematx == ( c && b && d && bd ? mm : c || b || d || bd ? ms : mv ) );
+    REQUIRE( f.nmat  == ( c && l && b && d && lb && ld && bd && lbd ? mm :
+                          c || l || b || d || lb || ld || bd || lbd ? ms : mv ) );
+  }
+
+  REQUIRE( n_in > 0 );
+
+  // Fields
+
+  set_region_field( BALL, x, y, z, 1, 2, x*y );
+
+  for( int k=0; k<nz+2; k++ ) for( int j=0; j<ny+2; j++ ) for( int i=0; i<nx+2; i++ ) {
+    const field_t & f = field( i, j, k );
+    const int c = in(i,j,k), l = in(i-1,j,k), b = in(i,j-1,k), d = in(i,j,k-1);
+    const double xc = x0 + dx*(i-0.5), yc = y0 + dy*(j-0.5);
+    REQUIRE( f.ex  == ( c || b || d || in(i,j-1,k-1) ? (float)xc : 0 ) );
+    REQUIRE( f.cbx == ( c || l ? (float)grid->cvac : 0 ) );
+    REQUIRE( f.cbz == ( c || d ? (float)( grid->cvac*( xc*yc ) ) : 0 ) );
+  }
+
+  // A region evaluated once serves the particle boundary conditions and
+  // the emitters.
+
+  region_mask_t * ball = define_region( BALL );
+
+  int64_t * n0;
+  MALLOC( n0, 6*grid->nv );
+  COPY( n0, grid->neighbor, 6*grid->nv );
+
+  set_region_bc( ball, leave_unchanged, reflect_particles, absorb_particles );
+
+  int n_face = 0;
+
+  for( int k=1; k<nz+1; k++ ) for( int j=1; j<ny+1; j++ ) for( int i=1; i<nx+1; i++ ) {
+    const int64_t * n = grid->neighbor + 6*voxel(i,j,k);
+    const int64_t * o = n0             + 6*voxel(i,j,k);
+    const int c = in(i,j,k);
+    const int r[6] = { in(i-1,j,k), in(i,j-1,k), in(i,j,k-1),
+                       in(i+1,j,k), in(i,j+1,k), in(i,j,k+1) };
+    for( int face=0; face<6; face++ ) {
+      n_face += !c && r[face];
+      REQUIRE( n[face] == (  c && !r[face] ? reflect_particles :
+                            !c &&  r[face] ? absorb_particles  : o[face] ) );
+    }
+  }
+
+  REQUIRE( n_face > 0 );
+
+  emitter_t * es = child_langmuir( sp, interpolator_array, field_array,
+                                   accumulator_array, entropy, 1, 0, 0, 0, 1 );
+  emitter_t * ev = child_langmuir( sp, interpolator_array, field_array,
+                                   accumulator_array, entropy, 1, 0, 0, 0, 1 );
+
+  define_surface_emitter( es, ball );
+  define_volume_emitter( ev, BALL );
+
+  REQUIRE( es->n_component == n_face );
+
+  int nc = 0, nv = 0;
+
+  for( int k=1; k<nz+1; k++ ) for( int j=1; j<ny+1; j++ ) for( int i=1; i<nx+1; i++ ) {
+    const int c = in(i,j,k);
+    const int r[6] = { in(i-1,j,k), in(i,j-1,k), in(i,j,k-1),
+                       in(i+1,j,k), in(i,j+1,k), in(i,j,k+1) };
+    const int t[6] = { BOUNDARY(-1, 0, 0), BOUNDARY( 0,-1, 0),
+                       BOUNDARY( 0, 0,-1), BOUNDARY( 1, 0, 0),
+                       BOUNDARY( 0, 1, 0), BOUNDARY( 0, 0, 1) };
+    if( c ) {
+      REQUIRE( ev->component[nv++] ==
+               COMPONENT_ID( voxel(i,j,k), BOUNDARY(0,0,0) ) );
+      continue;
+    }
+    for( int face=0; face<6; face++ )
+      if( r[face] )
+        REQUIRE( es->component[nc++] == COMPONENT_ID( voxel(i,j,k), t[face] ) );
+  }
+
+  REQUIRE( ev->n_component == nv );
+  REQUIRE( nv > 0 );
+
+  delete_region_mask( ball );
+  FREE( n0 );
+}
+
+TEST_CASE( "region macros match the region", "[region]" )
+{
+  // Run with several pipelines so that the rows of the mask and of the
+  // helpers are split between them.
+
+  int pargc = 3;
+  char str0[] = "bin/vpic";
+  char str1[] = "--tpp";
+  char str2[] = "3";
+  char **pargv = (char **) malloc( (pargc+1)*sizeof(char *) );
+  pargv[0] = str0;
+  pargv[1] = str1;
+  pargv[2] = str2;
+  pargv[3] = NULL;
+  boot_services( &pargc, &pargv );
+
+  vpic_simulation* simulation = new vpic_simulation;
+  simulation->initialize( pargc, pargv );
+
+  simulation->finalize();
+  delete simulation;
+  if( world_rank==0 ) log_printf( "normal exit\n" );
+
+  halt_mp();
+}
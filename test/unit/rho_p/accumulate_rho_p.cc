@@ -0,0 +1,134 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main()
+#include "catch.hpp"
+
+#include "src/species_advance/species_advance.h"
+#include "src/vpic/vpic.h"
+
+void vpic_simulation::user_diagnostics() {}
+
+// Serial reference deposition of the species charge density, as done
+// by accumulate_rho_p before it was pipelined.
+
+static void
+reference_rho_p( float * rho,
+                 const species_t * sp )
+{
+  const particle_t * p = sp->p;
+
+  const float q_8V = sp->q*sp->g->r8V;
+  const int   sy   = sp->g->sy;
+  const int   sz   = sp->g->sz;
+
+  float w0, w1, w2, w3, w4, w5, w6, w7, dz;
+  int n, v;
+
+  for( n=0; n<sp->np; n++ ) {
+    w0 = p[n].dx;
+    w1 = p[n].dy;
+    dz = p[n].dz;
+    v  = p[n].i;
+    w7 = p[n].w*q_8V;
+
+    w6 = w7 - w0*w7; w7 = w7 + w0*w7;
+    w4 = w6 - w1*w6; w5 = w7 - w1*w7;
+    w6 = w6 + w1*w6; w7 = w7 + w1*w7;
+    w0 = w4 - dz*w4; w1 = w5 - dz*w5; w2 = w6 - dz*w6; w3 = w7 - dz*w7;
+    w4 = w4 + dz*w4; w5 = w5 + dz*w5; w6 = w6 + dz*w6; w7 = w7 + dz*w7;
+
+    rho[v      ] += w0; rho[v      +1] += w1;
+    rho[v   +sy] += w2; rho[v   +sy+1] += w3;
+    rho[v+sz   ] += w4; rho[v+sz   +1] += w5;
+    rho[v+sz+sy] += w6; rho[v+sz+sy+1] += w7;
+  }
+}
+
+void
+vpic_simulation::user_initialization( int num_cmdline_arguments,
+                                      char ** cmdline_argument )
+{
+  // Use a particle count that is not a multiple of any pipeline block
+  // size so the host straggler path is exercised too.
+
+  int npart = 20011;
+
+  define_units( 1, 1 );
+  define_timestep( 0.5 );
+  define_periodic_grid( 0, 0, 0,   // Grid low corner
+                        8, 6, 5,   // Grid high corner
+                        8, 6, 5,   // Grid resolution
+                        1, 1, 1 ); // Processor configuration
+  define_material( "vacuum", 1.0, 1.0, 0.0 );
+  define_field_array();
+
+  species_t * sp =
+    define_species( "test_species", -1., 1., npart, npart, 0, 0 );
+
+  for( int i = 0; i < npart; i++ )
+  {
+    inject_particle( sp,
+                     uniform( rng(0), 0, 8 ),
+                     uniform( rng(0), 0, 6 ),
+                     uniform( rng(0), 0, 5 ),
+                     0., 0., 0.,
+                     uniform( rng(0), 0.5, 1.5 ), 0., 0 );
+  }
+
+  // Deposit twice so that the accumulate (rather than overwrite)
+  // semantics of accumulate_rho_p are checked as well.
+
+  float * rho;
+  MALLOC( rho, grid->nv );
+  CLEAR( rho, grid->nv );
+
+  reference_rho_p( rho, sp );
+  reference_rho_p( rho, sp );
+
+  for( int v = 0; v < grid->nv; v++ ) field_array->f[v].rhof = 0;
+
+  accumulate_rho_p( field_array, sp );
+  accumulate_rho_p( field_array, sp );
+
+  float max_rho = 0, max_err = 0;
+
+  for( int v = 0; v < grid->nv; v++ )
+  {
+    float err = fabs( field_array->f[v].rhof - rho[v] );
+
+    if ( max_rho < fabs( rho[v] ) ) max_rho = fabs( rho[v] );
+    if ( max_err < err            ) max_err = err;
+  }
+
+  FREE( rho );
+
+  std::cout << "max |rho| " << max_rho << " max error " << max_err
+            << std::endl;
+
+  REQUIRE( max_rho > 0 );
+  REQUIRE( max_err <= 1e-5*max_rho );
+}
+
+TEST_CASE( "pipelined accumulate_rho_p matches the serial deposition", "[rho_p]" )
+{
+  // Run with several pipelines so that the per-pipeline rho arrays
+  // and their reduction are exercised.
+
+  int pargc = 3;
+  char str0[] = "bin/vpic";
+  char str1[] = "--tpp";
+  char str2[] = "3";
+  char **pargv = (char **) malloc( (pargc+1)*sizeof(char *) );
+  pargv[0] = str0;
+  pargv[1] = str1;
+  pargv[2] = str2;
+  pargv[3] = NULL;
+  boot_services( &pargc, &pargv );
+
+  vpic_simulation* simulation = new vpic_simulation;
+  simulation->initialize( pargc, pargv );
+
+  simulation->finalize();
+  delete simulation;
+  if( world_rank==0 ) log_printf( "normal exit\n" );
+
+  halt_mp();
+}
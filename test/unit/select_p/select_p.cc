@@ -0,0 +1,331 @@
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main()
+#include "catch.hpp"
+
+#include "src/species_advance/species_advance.h"
+#include "src/vpic/vpic.h"
+
+void vpic_simulation::user_diagnostics() {}
+
+// The sample hash of select_p_pipeline (the 64-bit finalizer of
+// MurmurHash3)
+
+static uint32_t
+sample_hash( uint64_t x )
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return (uint32_t)( x >> 32 );
+}
+
+// Brute force version of the select_p tests on the centered particle c
+// with the given key.  Returns 1 if the particle is kept, 0 if not and
+// -1 if it is close enough to the edge of the box or to the energy
+// threshold that roundoff decides.
+
+static int
+brute_keep( const grid_t * g,
+            const particle_t * c,
+            int64_t key,
+            const particle_select_t * sel )
+{
+  int undecided = 0;
+
+  if( sel->use_tag && ( key < sel->tag0 || key > sel->tag1 ) ) return 0;
+
+  uint32_t thresh = ( sel->fraction > 0 && sel->fraction < 1 ) ?
+                    (uint32_t)( sel->fraction*4294967296.0 ) : 0;
+  if( thresh &&
+      sample_hash( ( ( (uint64_t)sel->seed ) << 32 ) ^ (uint64_t)key ) >=
+      thresh ) return 0;
+
+  if( sel->use_box )
+  {
+    int iz = c->i/g->sz;
+    int iy = ( c->i - iz*g->sz )/g->sy;
+    int ix = c->i - iz*g->sz - iy*g->sy;
+    double r[3], lo[3], hi[3], d = 1e30;
+    r[0] = g->x0 + ( ix - 1 + 0.5*( c->dx + 1 ) )*g->dx;
+    r[1] = g->y0 + ( iy - 1 + 0.5*( c->dy + 1 ) )*g->dy;
+    r[2] = g->z0 + ( iz - 1 + 0.5*( c->dz + 1 ) )*g->dz;
+    lo[0] = sel->x0; lo[1] = sel->y0; lo[2] = sel->z0;
+    hi[0] = sel->x1; hi[1] = sel->y1; hi[2] = sel->z1;
+    for( int a = 0; a < 3; a++ )
+      d = std::min( d, std::min( r[a] - lo[a], hi[a] - r[a] ) );
+    if( d < -1e-4 ) return 0;
+    if( d <= 1e-4 ) undecided = 1;
+  }
+
+  if( sel->min_ke > 0 )
+  {
+    double u2 = (double)c->ux*c->ux + (double)c->uy*c->uy +
+                (double)c->uz*c->uz;
+    double ke = u2/( 1 + sqrt( 1 + u2 ) );
+    if( ke < sel->min_ke*( 1 - 1e-5 ) ) return 0;
+    if( ke <= sel->min_ke*( 1 + 1e-5 ) ) undecided = 1;
+  }
+
+  return undecided ? -1 : 1;
+}
+
+// Select from a scratch copy of the n particles of sp starting at first
+// (as dump_particles does) and check the kept particles and their tags
+// against brute_keep on the centered particles c.  Mismatches are
+// counted in n_bad and the kept particles are left in out if not NULL.
+// Returns the number kept.
+
+static int
+check_select( species_t * sp,
+              const interpolator_array_t * ia,
+              const particle_t * c,
+              const particle_select_t * sel,
+              int first,
+              int n,
+              int * n_bad,
+              particle_t * out )
+{
+  particle_t * buf;
+  int64_t * tag_out;
+
+  MALLOC_ALIGNED( buf, n, 128 );
+  MALLOC( tag_out, n );
+  COPY( buf, sp->p + first, n );
+
+  particle_t * sp_p = sp->p;      sp->p      = buf;
+  int sp_np         = sp->np;     sp->np     = n;
+  int sp_max_np     = sp->max_np; sp->max_np = n;
+  int kept = select_p( sp, ia, sel, first, tag_out );
+  sp->p      = sp_p;
+  sp->np     = sp_np;
+  sp->max_np = sp_max_np;
+
+  int k = 0;
+  for( int m = first; m < first + n; m++ )
+  {
+    int64_t key = sp->tag ? sp->tag[m] : m;
+    int keep = brute_keep( sp->g, c + m, key, sel );
+    if( !keep ) continue;
+
+    const particle_t * q = buf + k;
+    bool match = k < kept &&
+      q->i  == c[m].i  && q->dx == c[m].dx && q->dy == c[m].dy &&
+      q->dz == c[m].dz && q->w  == c[m].w  &&
+      fabs( q->ux - c[m].ux ) <= 1e-6*( 1 + fabs( c[m].ux ) ) &&
+      fabs( q->uy - c[m].uy ) <= 1e-6*( 1 + fabs( c[m].uy ) ) &&
+      fabs( q->uz - c[m].uz ) <= 1e-6*( 1 + fabs( c[m].uz ) ) &&
+      ( !sp->tag || tag_out[k] == key );
+
+    if( match )        k++;
+    else if( keep>0 ) (*n_bad)++;
+  }
+  *n_bad += kept - k;
+
+  if( out ) COPY( out, buf, kept );
+  FREE( tag_out );
+  FREE_ALIGNED( buf );
+  return kept;
+}
+
+void
+vpic_simulation::user_initialization( int num_cmdline_arguments,
+                                      char ** cmdline_argument )
+{
+  // Enough particles that a particle dump takes two hunks
+
+  int npart = 40000;
+
+  define_units( 1, 1 );
+  define_timestep( 0.5 );
+  define_periodic_grid( 0, 0, 0,   // Grid low corner
+                        8, 6, 5,   // Grid high corner
+                        8, 6, 5,   // Grid resolution
+                        1, 1, 1 ); // Processor configuration
+  define_material( "vacuum", 1.0, 1.0, 0.0 );
+  define_field_array();
+
+  species_t * sp0 = define_species( "tagged", -1., 1., npart, 16, 0, 0 );
+  species_t * sp1 = define_species( "plain",  -1., 1., npart, 16, 0, 0 );
+
+  tag_species( sp0 );
+
+  // Fields that vary over the domain so that the centering matters
+
+  for( int k = 0; k <= grid->nz+1; k++ )
+    for( int j = 0; j <= grid->ny+1; j++ )
+      for( int i = 0; i <= grid->nx+1; i++ )
+      {
+        field_t * f = field_array->f + VOXEL( i, j, k, grid->nx, grid->ny,
+                                              grid->nz );
+        f->ex  = 0.1*sin( 2*M_PI*i/8 );
+        f->ey  = 0.05*cos( 2*M_PI*j/6 );
+        f->ez  = 0.02;
+        f->cbx = 0.3;
+        f->cby = 0.02*sin( 2*M_PI*k/5 );
+        f->cbz = 0.1;
+      }
+  load_interpolator_array( interpolator_array, field_array );
+
+  for( int n = 0; n < npart; n++ )
+  {
+    inject_particle( sp0,
+                     uniform( rng(0), 0, 8 ),
+                     uniform( rng(0), 0, 6 ),
+                     uniform( rng(0), 0, 5 ),
+                     normal( rng(0), 0, 0.3 ),
+                     normal( rng(0), 0, 0.3 ),
+                     normal( rng(0), 0, 0.3 ),
+                     uniform( rng(0), 0.5, 1.5 ), 0, 0 );
+  }
+
+  COPY( sp1->p, sp0->p, npart );
+  sp1->np = npart;
+
+  // The centered particles the selections are made from
+
+  particle_t * c;
+  MALLOC_ALIGNED( c, npart, 128 );
+  COPY( c, sp0->p, npart );
+
+  particle_t * sp_p = sp0->p; sp0->p = c;
+  center_p( sp0, interpolator_array );
+  sp0->p = sp_p;
+
+  // Each filter on its own and all of them together
+
+  particle_select_t sel[5];
+  CLEAR( sel, 5 );
+
+  sel[0].use_box = 1;
+  sel[0].x0 = 2.3; sel[0].y0 = 1.2; sel[0].z0 = 0.5;
+  sel[0].x1 = 6.1; sel[0].y1 = 4.7; sel[0].z1 = 3.9;
+
+  sel[1].min_ke = 0.05;
+
+  sel[2].use_tag = 1;
+  sel[2].tag0 = sp0->tag[1234];
+  sel[2].tag1 = sp0->tag[25000];
+
+  sel[3].fraction = 0.25;
+  sel[3].seed = 7;
+
+  sel[4] = sel[0];
+  sel[4].min_ke   = sel[1].min_ke;
+  sel[4].use_tag  = 1;
+  sel[4].tag0     = sel[2].tag0;
+  sel[4].tag1     = sel[2].tag1;
+  sel[4].fraction = 0.5;
+  sel[4].seed     = 11;
+
+  for( int s = 0; s < 5; s++ )
+    for( int t = 0; t < 2; t++ )
+    {
+      species_t * sp = t ? sp1 : sp0;
+      if( sel[s].use_tag && !sp->tag ) continue;
+
+      // The whole list and a piece of it not starting at the front
+      // (the piece keys untagged particles by their index in the list)
+
+      int n_bad = 0;
+      int kept  = check_select( sp, interpolator_array, c, sel + s,
+                                0, npart, &n_bad, NULL );
+      int part  = check_select( sp, interpolator_array, c, sel + s,
+                                1000, npart-1037, &n_bad, NULL );
+
+      INFO( sp->name << " selection " << s << ": kept " << kept <<
+            " and " << part << " of the piece" );
+
+      REQUIRE( n_bad == 0 );
+      REQUIRE( kept > 0 );
+      REQUIRE( kept < npart );
+      if( s == 3 ) REQUIRE( fabs( kept - 0.25*npart ) < 0.02*npart );
+    }
+
+  // A filtered dump holds the particles select_p keeps, the dimension
+  // is patched to their number and the trailer gives the number of
+  // particles examined and written.
+
+  sel[4].use_tag = 0;
+
+  particle_t * out;
+  MALLOC_ALIGNED( out, npart, 128 );
+
+  for( int t = 0; t < 2; t++ )
+  {
+    species_t * sp = t ? sp1 : sp0;
+
+    int n_bad = 0;
+    int kept  = check_select( sp, interpolator_array, c, sel + 4,
+                              0, npart, &n_bad, out );
+
+    REQUIRE( n_bad == 0 );
+    REQUIRE( dump_particles( sp->name, "select", sel[4], 0 ) == kept );
+
+    FILE * fp = fopen( "select.0", "rb" );
+    REQUIRE( fp );
+
+    // The header written by WRITE_HEADER_V0 is 103 bytes
+
+    char header[103];
+    short int cafe;
+    int deadbeef, sz, ndim, dim;
+    int64_t trailer[2];
+
+    REQUIRE( fread( header, 1, 103, fp ) == 103 );
+    memcpy( &cafe,     header + 5, sizeof(cafe) );
+    memcpy( &deadbeef, header + 7, sizeof(deadbeef) );
+    REQUIRE( cafe == (short int)0xcafe );
+    REQUIRE( deadbeef == (int)0xdeadbeef );
+
+    REQUIRE( fread( &sz,   sizeof(int), 1, fp ) == 1 );
+    REQUIRE( fread( &ndim, sizeof(int), 1, fp ) == 1 );
+    REQUIRE( fread( &dim,  sizeof(int), 1, fp ) == 1 );
+    REQUIRE( sz == (int)sizeof(particle_t) );
+    REQUIRE( ndim == 1 );
+    REQUIRE( dim == kept );
+
+    particle_t * p;
+    MALLOC_ALIGNED( p, npart, 128 );
+    REQUIRE( fread( p, sizeof(particle_t), dim, fp ) == (size_t)dim );
+    REQUIRE( memcmp( p, out, dim*sizeof(particle_t) ) == 0 );
+    FREE_ALIGNED( p );
+
+    REQUIRE( fread( trailer, sizeof(int64_t), 2, fp ) == 2 );
+    REQUIRE( trailer[0] == npart );
+    REQUIRE( trailer[1] == kept );
+    REQUIRE( fgetc( fp ) == EOF );
+
+    fclose( fp );
+    remove( "select.0" );
+  }
+
+  FREE_ALIGNED( out );
+  FREE_ALIGNED( c );
+}
+
+TEST_CASE( "select_p matches a brute force selection", "[select_p]" )
+{
+  // Run with several pipelines so that the compaction of the pipeline
+  // outputs is exercised.
+
+  int pargc = 3;
+  char str0[] = "bin/vpic";
+  char str1[] = "--tpp";
+  char str2[] = "3";
+  char **pargv = (char **) malloc( (pargc+1)*sizeof(char *) );
+  pargv[0] = str0;
+  pargv[1] = str1;
+  pargv[2] = str2;
+  pargv[3] = NULL;
+  boot_services( &pargc, &pargv );
+
+  vpic_simulation* simulation = new vpic_simulation;
+  simulation->initialize( pargc, pargv );
+
+  simulation->finalize();
+  delete simulation;
+  if( world_rank==0 ) log_printf( "normal exit\n" );
+
+  halt_mp();
+}